@@ -0,0 +1,207 @@
+#include "bench.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#else
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+#ifdef ESP_PLATFORM
+// CCOUNT of the calling core: latency cases run on the core of the esp_timer task
+uint64_t bench_cycles(void)
+{
+    return esp_cpu_get_cycle_count();
+}
+
+uint64_t bench_ns(void)
+{
+    return (uint64_t)esp_timer_get_time() * 1000;
+}
+
+uint64_t bench_cycles_between(uint64_t from, uint64_t to)
+{
+    return (uint32_t)((uint32_t)to - (uint32_t)from);
+}
+#else
+// the simulation's esp_timer runs on virtual time, so the host measures the real clock
+uint64_t bench_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t bench_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return bench_ns();
+#endif
+}
+
+uint64_t bench_cycles_between(uint64_t from, uint64_t to)
+{
+    return to - from;
+}
+#endif
+
+static void sort(uint64_t *v, size_t n)
+{
+    for (size_t i = 1; i < n; ++i) {
+        uint64_t x = v[i];
+        size_t j = i;
+        for (; j > 0 && v[j - 1] > x; --j) v[j] = v[j - 1];
+        v[j] = x;
+    }
+}
+
+esp_err_t bench_run(const bench_case_t *c, bench_result_t *out)
+{
+    if (!c || !out || (!c->op && !c->sample) || (c->op && !c->iters)) return ESP_ERR_INVALID_ARG;
+    uint64_t cycles[BENCH_SAMPLES], ns[BENCH_SAMPLES];
+    // sample -1 warms up caches and lazily allocated state and is dropped
+    for (int s = -1; s < BENCH_SAMPLES; ++s) {
+        bench_result_t r;
+        if (c->sample) {
+            esp_err_t err = c->sample(&r);
+            if (err != ESP_OK) return err;
+        } else {
+            uint64_t c0 = bench_cycles(), t0 = bench_ns();
+            for (uint32_t i = 0; i < c->iters; ++i) c->op();
+            uint64_t c1 = bench_cycles(), t1 = bench_ns();
+            r.cycles = bench_cycles_between(c0, c1) / c->iters;
+            r.ns = (t1 - t0) / c->iters;
+        }
+        if (s >= 0) {
+            cycles[s] = r.cycles;
+            ns[s] = r.ns;
+        }
+    }
+    sort(cycles, BENCH_SAMPLES);
+    sort(ns, BENCH_SAMPLES);
+    out->cycles = cycles[BENCH_SAMPLES / 2];
+    out->ns = ns[BENCH_SAMPLES / 2];
+    // spread of whichever counter bench_compare will use
+    const uint64_t *v = out->cycles ? cycles : ns;
+    uint64_t iqr = v[BENCH_SAMPLES * 3 / 4] - v[BENCH_SAMPLES / 4];
+    uint64_t mid = v[BENCH_SAMPLES / 2];
+    out->spread_pct = mid ? (uint32_t)(100 * iqr / mid) : 0;
+    return ESP_OK;
+}
+
+size_t bench_baseline_parse(const char *text, size_t len, bench_baseline_t *out, size_t max)
+{
+    size_t n = 0;
+    while (len > 0 && n < max) {
+        const char *nl = memchr(text, '\n', len);
+        size_t line_len = nl ? (size_t)(nl - text) : len;
+        char line[96];
+        size_t copy = line_len < sizeof(line) - 1 ? line_len : sizeof(line) - 1;
+        memcpy(line, text, copy);
+        line[copy] = '\0';
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+
+        char name[BENCH_NAME_MAX];
+        unsigned long long cycles, ns;
+        if (sscanf(line, "%31s %llu %llu", name, &cycles, &ns) == 3) {
+            strcpy(out[n].name, name);
+            out[n].cycles = cycles;
+            out[n].ns = ns;
+            n++;
+        }
+        text += line_len + (nl ? 1 : 0);
+        len -= line_len + (nl ? 1 : 0);
+    }
+    return n;
+}
+
+const bench_baseline_t *bench_baseline_find(const bench_baseline_t *base, size_t n, const char *name)
+{
+    for (size_t i = 0; base && i < n; ++i) {
+        if (strcmp(base[i].name, name) == 0) return &base[i];
+    }
+    return NULL;
+}
+
+static uint64_t metric(const bench_result_t *r, const bench_baseline_t *base)
+{
+    return base->cycles ? r->cycles : r->ns;
+}
+
+double bench_change_pct(const bench_result_t *r, const bench_baseline_t *base, double scale)
+{
+    double was = (double)(base->cycles ? base->cycles : base->ns);
+    return 100.0 * ((double)metric(r, base) * scale - was) / was;
+}
+
+bench_verdict_t bench_compare(const bench_result_t *r, const bench_baseline_t *base, double scale,
+                              unsigned threshold_pct)
+{
+    if (!base || (!base->cycles && !base->ns)) return BENCH_NEW;
+    double change = bench_change_pct(r, base, scale);
+    double limit = (double)threshold_pct + 2.0 * r->spread_pct;
+    if (change > limit) return BENCH_REGRESSED;
+    if (change < -limit) return BENCH_FASTER;
+    return BENCH_OK;
+}
+
+int bench_run_all(const bench_baseline_t *base, size_t n, unsigned threshold_pct, bool need_baseline,
+                  bench_result_t *results)
+{
+    static const char *VERDICT[] = { "new", "ok", "faster", "REGRESSED" };
+    int failed = 0;
+    double scale = 1.0;
+    const bench_case_t *ref_case = NULL;
+    const bench_baseline_t *ref_base = NULL;
+    printf("%-20s %12s %12s %7s %12s %8s\n", "case", "cycles/op", "ns/op", "spread", "baseline", "change");
+    for (size_t i = 0; i < bench_case_count; ++i) {
+        const bench_case_t *c = &bench_cases[i];
+        bench_result_t r = { 0 };
+        // the machine speed is taken again right before each case, so a busy
+        // stretch of the host slows both and cancels out
+        bench_result_t now;
+        if (ref_case && bench_run(ref_case, &now) == ESP_OK) {
+            scale = (double)(ref_base->cycles ? ref_base->cycles : ref_base->ns) / (double)metric(&now, ref_base);
+        }
+        esp_err_t err = c->setup ? c->setup() : ESP_OK;
+        if (err == ESP_OK) err = bench_run(c, &r);
+        results[i] = r;
+        if (err != ESP_OK) {
+            printf("%-20s failed: %s\n", c->name, esp_err_to_name(err));
+            failed++;
+            continue;
+        }
+        const bench_baseline_t *b = bench_baseline_find(base, n, c->name);
+        bool ref = strcmp(c->name, BENCH_REFERENCE) == 0;
+        bench_verdict_t v = bench_compare(&r, b, ref ? 1.0 : scale, threshold_pct);
+        if (v == BENCH_NEW) {
+            printf("%-20s %12" PRIu64 " %12" PRIu64 " %6" PRIu32 "%% %12s %8s %s\n", c->name, r.cycles, r.ns,
+                   r.spread_pct, "-", "-", need_baseline ? "NO BASELINE" : VERDICT[v]);
+            if (need_baseline) failed++;
+            continue;
+        }
+        printf("%-20s %12" PRIu64 " %12" PRIu64 " %6" PRIu32 "%% %12" PRIu64 " %+7.1f%% %s\n", c->name, r.cycles,
+               r.ns, r.spread_pct, b->cycles ? b->cycles : b->ns, bench_change_pct(&r, b, ref ? 1.0 : scale),
+               ref ? "machine speed" : VERDICT[v]);
+        if (ref) {
+            ref_case = c;
+            ref_base = b;
+        } else if (v == BENCH_REGRESSED) {
+            failed++;
+        }
+    }
+    printf("# name cycles ns (threshold %u%% + 2x spread, others scaled by %s)\n", threshold_pct, BENCH_REFERENCE);
+    for (size_t i = 0; i < bench_case_count; ++i) {
+        printf("%s %" PRIu64 " %" PRIu64 "\n", bench_cases[i].name, results[i].cycles, results[i].ns);
+    }
+    return failed;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Microbenchmarks of firmware hot paths. The same cases build into the on-target
+// app (bench/) and the host simulation (sim/). A case either repeats an operation
+// (op, `iters` times per sample) or measures one occurrence itself (sample).
+// Results are per operation, the median of BENCH_SAMPLES samples after one
+// warm-up, with the interquartile range as the run's own noise: a slower
+// result only counts as a regression beyond the threshold plus that spread.
+#define BENCH_SAMPLES 31
+#define BENCH_NAME_MAX 32
+// Case with a fixed CPU workload, run first and again before every other case.
+// Each case is compared scaled by the reference's baseline/now ratio taken just
+// before it, which cancels a slower or busier machine (host runs).
+#define BENCH_REFERENCE "reference"
+
+typedef struct {
+    uint64_t cycles;   // CPU cycles on target, TSC ticks (or ns) on the host
+    uint64_t ns;
+    uint32_t spread_pct;   // interquartile range of the samples, % of the median
+} bench_result_t;
+
+typedef struct {
+    const char *name;
+    esp_err_t (*setup)(void);                  // may be NULL
+    void (*op)(void);
+    uint32_t iters;
+    esp_err_t (*sample)(bench_result_t *out);  // latency cases; op is NULL then
+} bench_case_t;
+
+extern const bench_case_t bench_cases[];
+extern const size_t bench_case_count;
+
+// Baselines are text, one "name cycles ns" line per case, '#' starts a comment.
+// bench_run_all prints its results in the same format.
+typedef struct {
+    char name[BENCH_NAME_MAX];
+    uint64_t cycles;
+    uint64_t ns;
+} bench_baseline_t;
+
+typedef enum {
+    BENCH_NEW,         // no baseline for this case
+    BENCH_OK,
+    BENCH_FASTER,      // better than the baseline by more than the threshold
+    BENCH_REGRESSED,   // worse than the baseline by more than the threshold
+} bench_verdict_t;
+
+uint64_t bench_cycles(void);
+uint64_t bench_ns(void);
+// cycles from `from` to `to`; the target counter is 32 bits and wraps
+uint64_t bench_cycles_between(uint64_t from, uint64_t to);
+
+esp_err_t bench_run(const bench_case_t *c, bench_result_t *out);
+
+size_t bench_baseline_parse(const char *text, size_t len, bench_baseline_t *out, size_t max);
+const bench_baseline_t *bench_baseline_find(const bench_baseline_t *base, size_t n, const char *name);
+// Change against the baseline in percent, after scaling the result by `scale`;
+// compares cycles, or ns when the baseline has no cycle count.
+double bench_change_pct(const bench_result_t *r, const bench_baseline_t *base, double scale);
+// Regressed or faster once the change exceeds threshold_pct plus twice the
+// result's spread_pct.
+bench_verdict_t bench_compare(const bench_result_t *r, const bench_baseline_t *base, double scale,
+                              unsigned threshold_pct);
+
+// Run every case, print a report and the results as baseline lines; `results`
+// gets bench_case_count entries. Returns failed plus regressed cases, plus the
+// cases without a baseline when `need_baseline` is set.
+int bench_run_all(const bench_baseline_t *base, size_t n, unsigned threshold_pct, bool need_baseline,
+                  bench_result_t *results);
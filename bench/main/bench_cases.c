@@ -0,0 +1,298 @@
+#include "bench.h"
+#include "hx711.h"
+#include "hx711_backend.h"
+#include "weight_filter.h"
+#include "record.h"
+#include "record_codec.h"
+#include "sync_proto.h"
+#include "export.h"
+#include "export_loopback.h"
+#include "button.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+// wiring of main.c
+static const gpio_num_t DT_PINS[4] = { GPIO_NUM_5, GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_21 };
+static const gpio_num_t SCK_PINS[4] = { GPIO_NUM_4, GPIO_NUM_23, GPIO_NUM_22, GPIO_NUM_25 };
+// not connected on the board; driven as input/output so the button ISR sees real edges
+#define BENCH_BTN_PIN GPIO_NUM_26
+#define BENCH_RECORDS 64
+#define BENCH_CONN 1
+#define BENCH_MTU 185
+#define BENCH_BTN_TIMEOUT_MS 100
+#define BENCH_EXPORT_RECORDS 1000
+#define BENCH_EXPORT_CHUNK 244   // one notification at a 247-byte MTU
+#define BENCH_FILTER_SAMPLES 64   // power of two
+
+// ---- reference ----
+
+// table lookups and multiplies, roughly the mix of the codec and driver paths;
+// fixed forever so its time only tracks the machine
+static volatile uint32_t ref_sink;
+
+static void reference_op(void)
+{
+    static const uint8_t table[16] = { 3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 8, 9, 7, 9, 3 };
+    uint32_t x = ref_sink;
+    for (int i = 0; i < 256; ++i) x = x * 1664525u + 1013904223u + table[x >> 28];
+    ref_sink = x;
+}
+
+// ---- HX711 ----
+
+// 25 SCK pulses on all four channels in lock-step: the bit-banged conversion read
+static esp_err_t gpio_pulses_setup(void)
+{
+    return hx711_backend_gpio.init(DT_PINS, SCK_PINS, 4);
+}
+
+static void gpio_pulses_op(void)
+{
+    uint32_t data[4];
+    hx711_backend_gpio.read(0xF, HX711_GAIN_A_128, data);
+}
+
+// driver side of a frame (ready mask, read, sign extension, mg conversion) on the
+// software backend, so the number does not depend on attached chips
+static esp_err_t frame_setup(void)
+{
+    esp_err_t err = hx711_init_with_backend(DT_PINS, SCK_PINS, 4, &hx711_backend_sim);
+    if (err != ESP_OK) return err;
+    for (size_t i = 0; i < 4; ++i) {
+        hx711_sim_set_raw(i, 84000 + 1000 * (int32_t)i);
+        hx711_set_calibration(i, 420.0f);
+    }
+    return ESP_OK;
+}
+
+static void frame_op(void)
+{
+    int32_t raw[4], mg[4];
+    hx711_read_frame(raw);
+    hx711_frame_to_mg(raw, mg, 4);
+}
+
+// ---- weight filter ----
+
+// one stage per case, fed counts around a 0.42 g pill with noise and a spike
+// every 16 samples; the chain case is sensor_task's configuration
+static int32_t filter_in[BENCH_FILTER_SAMPLES];
+static weight_filter_t filter;
+static uint32_t filter_pos;
+static volatile int32_t filter_sink;
+
+static esp_err_t filter_setup(const weight_filter_cfg_t *cfg)
+{
+    for (uint32_t i = 0; i < BENCH_FILTER_SAMPLES; ++i) {
+        filter_in[i] = 84000 + (int32_t)((i * 7919) % 61) - 30 + (i % 16 == 5 ? 40000 : 0);
+    }
+    filter_pos = 0;
+    return weight_filter_init(&filter, cfg);
+}
+
+static esp_err_t filter_median_setup(void)
+{
+    return filter_setup(&(weight_filter_cfg_t){ .median_len = 5, .decimate = 1 });
+}
+
+static esp_err_t filter_avg_setup(void)
+{
+    return filter_setup(&(weight_filter_cfg_t){ .median_len = 1, .smooth = WEIGHT_FILTER_SMOOTH_AVG, .avg_len = 4,
+                                                .decimate = 1 });
+}
+
+static esp_err_t filter_iir_setup(void)
+{
+    return filter_setup(&(weight_filter_cfg_t){ .median_len = 1, .smooth = WEIGHT_FILTER_SMOOTH_IIR, .iir_shift = 3,
+                                                .decimate = 1 });
+}
+
+static esp_err_t filter_chain_setup(void)
+{
+    return filter_setup(&(weight_filter_cfg_t){ .median_len = 5, .smooth = WEIGHT_FILTER_SMOOTH_AVG, .avg_len = 4,
+                                                .decimate = 1 });
+}
+
+static void filter_op(void)
+{
+    int32_t out;
+    if (weight_filter_push(&filter, filter_in[filter_pos++ & (BENCH_FILTER_SAMPLES - 1)], &out)) filter_sink = out;
+}
+
+// ---- records ----
+
+// five minutes apart: two bytes per record, so a full log read fits one ATT response
+static record_t records[BENCH_RECORDS];
+
+static esp_err_t records_setup(void)
+{
+    for (size_t i = 0; i < BENCH_RECORDS; ++i) {
+        records[i] = (record_t){ .seq = 1 + i, .ts_ms = 3600000ULL + i * 300000ULL + (i * 7919) % 60000,
+                                 .boot = 1, .val = i & RECORD_VAL_MASK };
+    }
+    return ESP_OK;
+}
+
+static void encode_op(void)
+{
+    uint8_t buf[BENCH_MTU - 3];
+    size_t used;
+    record_codec_encode(records, BENCH_RECORDS, buf, sizeof(buf), &used);
+}
+
+static size_t store_read(uint32_t from_seq, record_t *out, size_t max)
+{
+    if (from_seq < 1) from_seq = 1;
+    size_t first = from_seq - 1, n = 0;
+    for (; first + n < BENCH_RECORDS && n < max; ++n) out[n] = records[first + n];
+    return n;
+}
+
+// 0xA001 read: what gatt_svr_access_cb does besides the NimBLE mbuf append, which
+// needs the host stack; the payload fits one response, so every read re-encodes
+static esp_err_t gatt_setup(void)
+{
+    static const sync_store_t store = { .read = store_read };
+    records_setup();
+    esp_err_t err = sync_proto_init(&store, 1);
+    if (err == ESP_OK) err = sync_proto_open(BENCH_CONN);
+    return err;
+}
+
+static void gatt_read_op(void)
+{
+    size_t len;
+    sync_proto_read(BENCH_CONN, BENCH_MTU, &len);
+}
+
+// ---- export ----
+
+// a day-long log of pill events (whole seconds, the wire resolution) sent over the in-memory transport; the link is
+// dropped half way, the receiver reconnects and restarts at the seq it stored,
+// which starts a new transfer id like a BLE client after a reconnect
+static record_t export_log[BENCH_EXPORT_RECORDS];
+static record_t export_sink[BENCH_EXPORT_RECORDS];
+static export_t exporter;
+static export_loopback_t loopback;
+
+static size_t export_read(uint32_t from_seq, record_t *out, size_t max)
+{
+    if (from_seq < 1) from_seq = 1;
+    size_t first = from_seq - 1, n = 0;
+    for (; first + n < BENCH_EXPORT_RECORDS && n < max; ++n) out[n] = export_log[first + n];
+    return n;
+}
+
+static uint32_t export_run(void)
+{
+    const uint32_t end = BENCH_EXPORT_RECORDS + 1;
+    export_loopback_init(&loopback, BENCH_EXPORT_CHUNK, export_sink, BENCH_EXPORT_RECORDS);
+    loopback.drop_after = 4;
+    export_set_link(&exporter, &loopback);
+    export_start(&exporter, 1, end);
+    uint32_t resumes = 0;
+    for (uint32_t now_ms = 0; !export_done(&exporter); ++now_ms) {
+        export_pump(&exporter, now_ms);
+        if (!loopback.connected) {
+            loopback.connected = true;
+            export_start(&exporter, loopback.next_seq, end);
+            resumes++;
+            continue;
+        }
+        export_loopback_poll(&loopback, &exporter, now_ms);
+    }
+    return resumes;
+}
+
+// the same run once with checks: every record arrives once, in order, after one resume
+static esp_err_t export_setup(void)
+{
+    for (size_t i = 0; i < BENCH_EXPORT_RECORDS; ++i) {
+        export_log[i] = (record_t){ .seq = 1 + i, .ts_ms = 3600000ULL + i * 86000ULL + (i % 5) * 1000,
+                                    .boot = 1, .val = i & RECORD_VAL_MASK };
+    }
+    esp_err_t err = export_init(&exporter, &export_transport_loopback, &loopback, export_read);
+    if (err != ESP_OK) return err;
+    if (export_run() != 1 || loopback.sink_len != BENCH_EXPORT_RECORDS || loopback.bad) return ESP_FAIL;
+    return memcmp(export_sink, export_log, sizeof(export_log)) ? ESP_FAIL : ESP_OK;
+}
+
+static void export_op(void)
+{
+    export_run();
+}
+
+// ---- buttons ----
+
+static SemaphoreHandle_t btn_sem;
+static volatile button_event_t btn_expect;
+static volatile uint64_t btn_cb_cycles, btn_cb_ns;
+
+static void bench_button_cb(size_t index, button_event_t event)
+{
+    if (event != btn_expect) return;
+    btn_cb_cycles = bench_cycles();
+    btn_cb_ns = bench_ns();
+    xSemaphoreGive(btn_sem);
+}
+
+// gestures off and the shortest debounce (1 ms): PRESS follows the edge as soon as it can
+static esp_err_t button_setup(void)
+{
+    btn_sem = xSemaphoreCreateBinary();
+    if (!btn_sem) return ESP_ERR_NO_MEM;
+    button_config_t cfg = BUTTON_CONFIG_DEFAULT();
+    cfg.debounce_ms = 1;
+    cfg.double_click_ms = 0;
+    cfg.chord_ms = 0;
+    cfg.long_press_ms = 0;
+    const gpio_num_t pin = BENCH_BTN_PIN;
+    esp_err_t err = button_init_cfg(&pin, 1, bench_button_cb, &cfg);
+    if (err != ESP_OK) return err;
+    // released level first, or switching to output drives the latch's 0 for a moment
+    gpio_set_level(pin, 1);
+    gpio_set_direction(pin, GPIO_MODE_INPUT_OUTPUT);
+    vTaskDelay(pdMS_TO_TICKS(20));
+    xSemaphoreTake(btn_sem, 0);
+    return ESP_OK;
+}
+
+static esp_err_t button_edge(int level, button_event_t ev, bench_result_t *out)
+{
+    btn_expect = ev;
+    uint64_t c0 = bench_cycles(), t0 = bench_ns();
+    gpio_set_level(BENCH_BTN_PIN, level);
+    if (xSemaphoreTake(btn_sem, pdMS_TO_TICKS(BENCH_BTN_TIMEOUT_MS)) != pdTRUE) return ESP_ERR_TIMEOUT;
+    if (out) {
+        out->cycles = bench_cycles_between(c0, btn_cb_cycles);
+        out->ns = btn_cb_ns - t0;
+    }
+    return ESP_OK;
+}
+
+// edge to PRESS callback; on target this includes the 1 ms debounce, on the host
+// (virtual clock) only the CPU time of ISR, timer task and engine
+static esp_err_t button_sample(bench_result_t *out)
+{
+    esp_err_t err = button_edge(0, BUTTON_EVENT_PRESS, out);
+    if (err == ESP_OK) err = button_edge(1, BUTTON_EVENT_RELEASE, NULL);
+    return err;
+}
+
+const bench_case_t bench_cases[] = {
+    { .name = BENCH_REFERENCE, .op = reference_op, .iters = 200 },
+    { .name = "hx711_gpio_pulses", .setup = gpio_pulses_setup, .op = gpio_pulses_op, .iters = 200 },
+    { .name = "hx711_read_frame", .setup = frame_setup, .op = frame_op, .iters = 2000 },
+    { .name = "filter_median5", .setup = filter_median_setup, .op = filter_op, .iters = 2000 },
+    { .name = "filter_avg4", .setup = filter_avg_setup, .op = filter_op, .iters = 2000 },
+    { .name = "filter_iir3", .setup = filter_iir_setup, .op = filter_op, .iters = 2000 },
+    { .name = "filter_chain", .setup = filter_chain_setup, .op = filter_op, .iters = 2000 },
+    { .name = "record_encode", .setup = records_setup, .op = encode_op, .iters = 2000 },
+    { .name = "gatt_read_a001", .setup = gatt_setup, .op = gatt_read_op, .iters = 2000 },
+    { .name = "export_1000_resume", .setup = export_setup, .op = export_op, .iters = 20 },
+    { .name = "button_isr_to_cb", .setup = button_setup, .sample = button_sample },
+};
+const size_t bench_case_count = sizeof(bench_cases) / sizeof(bench_cases[0]);
@@ -0,0 +1,30 @@
+#include "bench.h"
+#include "esp_log.h"
+#include <stdio.h>
+
+static const char *TAG = "bench";
+
+// cycle counts on target are repeatable, so a tight threshold is enough
+#define BENCH_THRESHOLD_PCT 10
+#define BENCH_BASELINE_MAX 32
+
+// baselines/esp32.txt, embedded by the component (EMBED_TXTFILES)
+extern const char baseline_start[] asm("_binary_esp32_txt_start");
+extern const char baseline_end[] asm("_binary_esp32_txt_end");
+
+void app_main(void)
+{
+    static bench_baseline_t base[BENCH_BASELINE_MAX];
+    static bench_result_t results[BENCH_BASELINE_MAX];
+    size_t n = bench_baseline_parse(baseline_start, (size_t)(baseline_end - baseline_start), base, BENCH_BASELINE_MAX);
+    ESP_LOGI(TAG, "%d cases, %d baselines", (int)bench_case_count, (int)n);
+    if (n < bench_case_count) {
+        ESP_LOGW(TAG, "cases without a board baseline fail: paste this run's baseline lines into baselines/esp32.txt");
+    }
+
+    // a case never measured on the board has nothing to hold it to, which is a failure here
+    int failed = bench_run_all(base, n, BENCH_THRESHOLD_PCT, true, results);
+    // the summary line is what a test runner on the serial port looks for
+    if (failed) printf("BENCH FAIL: %d case(s)\n", failed);
+    else printf("BENCH PASS\n");
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "export.h"
+
+// In-memory transport: chunks are checked and decoded into `sink` right away, and acked
+// on the next export_loopback_poll(). Can drop the link after a number of chunks.
+typedef struct {
+    size_t chunk_len;
+    uint32_t drop_after;   // 0 = never
+    uint32_t received;
+    uint32_t bad;
+    uint32_t next_seq;     // seq after the last stored record
+    uint16_t xfer;
+    uint16_t expect_chunk;
+    record_t *sink;
+    size_t sink_cap;
+    size_t sink_len;
+    bool connected;
+} export_loopback_t;
+
+extern const export_transport_t export_transport_loopback;
+void export_loopback_init(export_loopback_t *lb, size_t chunk_len, record_t *sink, size_t sink_cap);
+void export_loopback_poll(export_loopback_t *lb, export_t *x, uint32_t now_ms);
@@ -8,31 +8,188 @@
 #include "sys/param.h"
 #include "os_mbuf.h"
 #include "esp_log.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "trace.h"
+#include "time_sync.h"
+#include "metrics.h"
+#include <stdint.h>
 #include <string.h>
 
 static const char *TAG = "ble_mod";
 static ble_read_cb_t g_read_cb = NULL;
+static ble_write_cb_t g_write_cb = NULL;
+static ble_conn_cb_t g_conn_cb = NULL;
 static bool g_ble_synced = false;
 
 // Simple custom 16-bit service/char UUIDs (private)
 #define BLE_SVC_UUID 0xA000
 #define BLE_CHAR_UUID 0xA001
+#define BLE_CTRL_UUID 0xA002
+#define BLE_CTRL_MAX_LEN 16
+#define BLE_EVENT_UUID 0xA003
+#define BLE_TLM_UUID 0xA004
+#define BLE_EXPORT_UUID 0xA005
+#define BLE_METRICS_UUID 0xA006
+#define BLE_TRACE_UUID 0xA007
+// standard Current Time Service, written by the phone on connect
+#define BLE_CTS_SVC_UUID 0x1805
+#define BLE_CTS_CHAR_UUID 0x2A2B
+
+// telemetry: batch is sent when it fills the MTU or gets this old
+#define BLE_TLM_MAX_LATENCY_MS 500
+#define BLE_TLM_BUF_LEN 244
+#define BLE_TLM_HDR_LEN 5
+// keep this many msys blocks for events and ATT responses
+#define BLE_TLM_MIN_FREE_MBUFS 4
+
+typedef struct {
+    bool used;
+    uint16_t handle;
+    uint16_t mtu;
+    bool evt_notify;
+    bool evt_indicate;
+    bool tlm_notify;
+    bool exp_notify;
+} ble_conn_t;
+
+static ble_conn_t g_conns[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+static portMUX_TYPE g_conn_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t g_evt_val_handle;
+static uint16_t g_tlm_val_handle;
+static uint16_t g_exp_val_handle;
+
+// telemetry batch: [t0_ms u32][channels u8] then frames [dt_ms u16][mg i32 x channels]
+static uint8_t g_tlm_buf[BLE_TLM_BUF_LEN];
+static size_t g_tlm_len = 0;
+static uint32_t g_tlm_t0 = 0;
+static uint32_t g_tlm_dropped = 0;
+
+// metrics snapshot per connection slot of g_conns; used from the NimBLE host task only
+static metrics_snap_t g_metrics[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+
+static ble_conn_t *conn_find(uint16_t handle)
+{
+    for (size_t i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; ++i) {
+        if (g_conns[i].used && g_conns[i].handle == handle) return &g_conns[i];
+    }
+    return NULL;
+}
+
+static size_t conn_snapshot(ble_conn_t *out)
+{
+    size_t n = 0;
+    portENTER_CRITICAL(&g_conn_lock);
+    for (size_t i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; ++i) {
+        if (g_conns[i].used) out[n++] = g_conns[i];
+    }
+    portEXIT_CRITICAL(&g_conn_lock);
+    return n;
+}
+
+static void put_u32le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
 
 static int gatt_svr_access_cb(uint16_t conn_handle, uint16_t attr_handle,
                                struct ble_gatt_access_ctxt *ctxt, void *arg)
 {
     if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR) {
         if (!g_read_cb) return BLE_ATT_ERR_UNLIKELY;
-        uint8_t buf[512];
-        size_t len = g_read_cb(buf, sizeof(buf));
-        if (len > 0) {
-            os_mbuf_append(ctxt->om, buf, len);
-        }
-        return 0;
+        TRACE_BEGIN(TRACE_SPAN_GATT_ACCESS);
+        // NimBLE slices the value by the blob offset itself, so the whole value is appended every time
+        uint16_t mtu = BLE_ATT_MTU_DFLT;
+        portENTER_CRITICAL(&g_conn_lock);
+        ble_conn_t *c = conn_find(conn_handle);
+        if (c) mtu = c->mtu;
+        portEXIT_CRITICAL(&g_conn_lock);
+
+        size_t len = 0;
+        const uint8_t *val = g_read_cb(conn_handle, mtu, &len);
+        int rc = 0;
+        if (val && len > 0 && os_mbuf_append(ctxt->om, val, (uint16_t)len) != 0) rc = BLE_ATT_ERR_INSUFFICIENT_RES;
+        TRACE_END(TRACE_SPAN_GATT_ACCESS);
+        return rc;
     }
     return BLE_ATT_ERR_WRITE_NOT_PERMITTED;
 }
 
+static int gatt_metrics_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+                                  struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    portENTER_CRITICAL(&g_conn_lock);
+    ble_conn_t *c = conn_find(conn_handle);
+    portEXIT_CRITICAL(&g_conn_lock);
+    if (!c) return BLE_ATT_ERR_UNLIKELY;
+
+    // the access callback does not get the blob offset, so the value stays pinned until
+    // the central asks for a new one with a write (any value) or connects again
+    metrics_snap_t *m = &g_metrics[c - g_conns];
+    if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
+        metrics_snap_refresh(m);
+        return 0;
+    }
+    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) return BLE_ATT_ERR_UNLIKELY;
+    size_t len;
+    const uint8_t *val = metrics_snap_read(m, &len);
+    return os_mbuf_append(ctxt->om, val, (uint16_t)len) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+// trace dump: a write selects the window (and freezes the ring), reads return it
+static int gatt_trace_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+                                struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    static uint8_t buf[TRACE_WINDOW_MAX];
+    if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR) {
+        size_t len = trace_window_read(buf, sizeof(buf));
+        return os_mbuf_append(ctxt->om, buf, (uint16_t)len) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+    if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) return BLE_ATT_ERR_UNLIKELY;
+    uint16_t len = 0;
+    if (OS_MBUF_PKTLEN(ctxt->om) > 2) return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    if (ble_hs_mbuf_to_flat(ctxt->om, buf, 2, &len) != 0) return BLE_ATT_ERR_UNLIKELY;
+    return trace_window_select(buf, len) == ESP_OK ? 0 : BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+}
+
+static int gatt_ctrl_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+                               struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) return BLE_ATT_ERR_READ_NOT_PERMITTED;
+    if (!g_write_cb) return BLE_ATT_ERR_UNLIKELY;
+
+    uint8_t buf[BLE_CTRL_MAX_LEN];
+    uint16_t len = 0;
+    if (OS_MBUF_PKTLEN(ctxt->om) > sizeof(buf)) return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    if (ble_hs_mbuf_to_flat(ctxt->om, buf, sizeof(buf), &len) != 0) return BLE_ATT_ERR_UNLIKELY;
+
+    esp_err_t err = g_write_cb(conn_handle, buf, len);
+    if (err == ESP_ERR_INVALID_ARG) return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    if (err != ESP_OK) return BLE_ATT_ERR_UNLIKELY;
+    return 0;
+}
+
+static int gatt_cts_access_cb(uint16_t conn_handle, uint16_t attr_handle,
+                              struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    uint8_t buf[TIME_CTS_LEN];
+    if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR) {
+        size_t len = time_sync_to_cts(buf, sizeof(buf));
+        return os_mbuf_append(ctxt->om, buf, (uint16_t)len) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+    if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) return BLE_ATT_ERR_UNLIKELY;
+
+    uint16_t len = 0;
+    if (OS_MBUF_PKTLEN(ctxt->om) > sizeof(buf)) return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    if (ble_hs_mbuf_to_flat(ctxt->om, buf, sizeof(buf), &len) != 0) return BLE_ATT_ERR_UNLIKELY;
+    esp_err_t err = time_sync_from_cts(buf, len);
+    if (err == ESP_ERR_INVALID_SIZE) return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+    // CTS: 0x80 = data field ignored (out of range)
+    if (err != ESP_OK) return 0x80;
+    ESP_LOGI(TAG, "time set by conn %d", conn_handle);
+    return 0;
+}
+
 static const struct ble_gatt_svc_def gatt_svr_svcs[] = {
     {
         .type = BLE_GATT_SVC_TYPE_PRIMARY,
@@ -43,6 +200,53 @@ static const struct ble_gatt_svc_def gatt_svr_svcs[] = {
                 .access_cb = gatt_svr_access_cb,
                 .flags = BLE_GATT_CHR_F_READ,
             },
+            {
+                .uuid = BLE_UUID16_DECLARE(BLE_CTRL_UUID),
+                .access_cb = gatt_ctrl_access_cb,
+                .flags = BLE_GATT_CHR_F_WRITE,
+            },
+            {
+                // notify/indicate only, CCCD is managed by NimBLE
+                .uuid = BLE_UUID16_DECLARE(BLE_EVENT_UUID),
+                .access_cb = gatt_svr_access_cb,
+                .flags = BLE_GATT_CHR_F_NOTIFY | BLE_GATT_CHR_F_INDICATE,
+                .val_handle = &g_evt_val_handle,
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(BLE_TLM_UUID),
+                .access_cb = gatt_svr_access_cb,
+                .flags = BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &g_tlm_val_handle,
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(BLE_EXPORT_UUID),
+                .access_cb = gatt_svr_access_cb,
+                .flags = BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &g_exp_val_handle,
+            },
+            {
+                // device health, metrics.h wire format
+                .uuid = BLE_UUID16_DECLARE(BLE_METRICS_UUID),
+                .access_cb = gatt_metrics_access_cb,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(BLE_TRACE_UUID),
+                .access_cb = gatt_trace_access_cb,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+            },
+            { 0 }
+        },
+    },
+    {
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid = BLE_UUID16_DECLARE(BLE_CTS_SVC_UUID),
+        .characteristics = (struct ble_gatt_chr_def[]) {
+            {
+                .uuid = BLE_UUID16_DECLARE(BLE_CTS_CHAR_UUID),
+                .access_cb = gatt_cts_access_cb,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+            },
             { 0 }
         },
     },
@@ -79,16 +283,55 @@ static void ble_app_on_sync(void)
 
 static int ble_gap_event(struct ble_gap_event *event, void *arg)
 {
+    ble_conn_t *c;
     switch (event->type) {
     case BLE_GAP_EVENT_CONNECT:
         if (event->connect.status == 0) {
-            ESP_LOGI(TAG, "BLE connected");
+            ESP_LOGI(TAG, "BLE connected; handle=%d", event->connect.conn_handle);
+            portENTER_CRITICAL(&g_conn_lock);
+            for (size_t i = 0; i < CONFIG_BT_NIMBLE_MAX_CONNECTIONS; ++i) {
+                if (g_conns[i].used) continue;
+                g_conns[i] = (ble_conn_t){ .used = true, .handle = event->connect.conn_handle, .mtu = BLE_ATT_MTU_DFLT };
+                metrics_snap_refresh(&g_metrics[i]);
+                break;
+            }
+            portEXIT_CRITICAL(&g_conn_lock);
+            TRACE(TRACE_EV_BLE_CONN, event->connect.conn_handle, 1);
+            if (g_conn_cb) g_conn_cb(event->connect.conn_handle, true);
         } else {
             ESP_LOGI(TAG, "BLE connection failed; status=%d", event->connect.status);
         }
         break;
     case BLE_GAP_EVENT_DISCONNECT:
         ESP_LOGI(TAG, "BLE disconnected; reason=%d", event->disconnect.reason);
+        portENTER_CRITICAL(&g_conn_lock);
+        c = conn_find(event->disconnect.conn.conn_handle);
+        if (c) c->used = false;
+        portEXIT_CRITICAL(&g_conn_lock);
+        TRACE(TRACE_EV_BLE_CONN, event->disconnect.conn.conn_handle, 0);
+        if (g_conn_cb) g_conn_cb(event->disconnect.conn.conn_handle, false);
+        break;
+    case BLE_GAP_EVENT_SUBSCRIBE:
+        portENTER_CRITICAL(&g_conn_lock);
+        c = conn_find(event->subscribe.conn_handle);
+        if (c && event->subscribe.attr_handle == g_evt_val_handle) {
+            c->evt_notify = event->subscribe.cur_notify;
+            c->evt_indicate = event->subscribe.cur_indicate;
+        } else if (c && event->subscribe.attr_handle == g_tlm_val_handle) {
+            c->tlm_notify = event->subscribe.cur_notify;
+        } else if (c && event->subscribe.attr_handle == g_exp_val_handle) {
+            c->exp_notify = event->subscribe.cur_notify;
+        }
+        portEXIT_CRITICAL(&g_conn_lock);
+        ESP_LOGI(TAG, "subscribe handle=%d attr=%d notify=%d indicate=%d", event->subscribe.conn_handle,
+                 event->subscribe.attr_handle, event->subscribe.cur_notify, event->subscribe.cur_indicate);
+        break;
+    case BLE_GAP_EVENT_MTU:
+        portENTER_CRITICAL(&g_conn_lock);
+        c = conn_find(event->mtu.conn_handle);
+        if (c) c->mtu = event->mtu.value;
+        portEXIT_CRITICAL(&g_conn_lock);
+        ESP_LOGI(TAG, "MTU updated; handle=%d mtu=%d", event->mtu.conn_handle, event->mtu.value);
         break;
     case BLE_GAP_EVENT_ADV_COMPLETE:
         ESP_LOGI(TAG, "Advertising complete");
@@ -106,9 +349,11 @@ static void ble_host_task(void *param)
     nimble_port_freertos_deinit();
 }
 
-esp_err_t ble_init(ble_read_cb_t read_cb)
+esp_err_t ble_init(ble_read_cb_t read_cb, ble_write_cb_t write_cb, ble_conn_cb_t conn_cb)
 {
     g_read_cb = read_cb;
+    g_write_cb = write_cb;
+    g_conn_cb = conn_cb;
 
     nimble_port_init();
 
@@ -187,3 +432,144 @@ esp_err_t ble_start_advertising(void)
     ESP_LOGI(TAG, "BLE advertising started");
     return ESP_OK;
 }
+
+esp_err_t ble_notify_event(const uint8_t *data, size_t len)
+{
+    ble_conn_t conns[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+    size_t n = conn_snapshot(conns);
+    esp_err_t ret = ESP_OK;
+    for (size_t i = 0; i < n; ++i) {
+        if (!conns[i].evt_notify && !conns[i].evt_indicate) continue;
+        if (len > (size_t)conns[i].mtu - 3) {
+            ret = ESP_ERR_INVALID_SIZE;
+            continue;
+        }
+        struct os_mbuf *om = ble_hs_mbuf_from_flat(data, (uint16_t)len);
+        if (!om) {
+            ret = ESP_ERR_NO_MEM;
+            continue;
+        }
+        // indication is preferred: the client confirms it; the mbuf is consumed either way
+        int rc = conns[i].evt_indicate ? ble_gatts_indicate_custom(conns[i].handle, g_evt_val_handle, om)
+                                       : ble_gatts_notify_custom(conns[i].handle, g_evt_val_handle, om);
+        if (rc) {
+            ESP_LOGW(TAG, "event push to %d failed %d", conns[i].handle, rc);
+            ret = ESP_FAIL;
+        }
+    }
+    return ret;
+}
+
+bool ble_telemetry_active(void)
+{
+    ble_conn_t conns[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+    size_t n = conn_snapshot(conns);
+    for (size_t i = 0; i < n; ++i) {
+        if (conns[i].tlm_notify) return true;
+    }
+    return false;
+}
+
+static void tlm_flush(const ble_conn_t *conns, size_t n)
+{
+    if (g_tlm_len <= BLE_TLM_HDR_LEN) return;
+    for (size_t i = 0; i < n; ++i) {
+        if (!conns[i].tlm_notify) continue;
+        // back-pressure: drop the batch rather than starve events and ATT responses
+        if (os_msys_num_free() < BLE_TLM_MIN_FREE_MBUFS) {
+            g_tlm_dropped++;
+            TRACE(TRACE_EV_BLE_TLM_DROP, g_tlm_dropped, 0);
+            continue;
+        }
+        struct os_mbuf *om = ble_hs_mbuf_from_flat(g_tlm_buf, (uint16_t)g_tlm_len);
+        if (!om || ble_gatts_notify_custom(conns[i].handle, g_tlm_val_handle, om) != 0) g_tlm_dropped++;
+    }
+    g_tlm_len = 0;
+}
+
+esp_err_t ble_telemetry_push(uint32_t t_ms, const int32_t *mg, size_t channels)
+{
+    if (!mg || channels == 0) return ESP_ERR_INVALID_ARG;
+    ble_conn_t conns[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+    size_t n = conn_snapshot(conns);
+
+    // the batch must fit the smallest MTU among subscribers
+    size_t limit = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (!conns[i].tlm_notify) continue;
+        size_t cap = (size_t)conns[i].mtu - 3;
+        if (limit == 0 || cap < limit) limit = cap;
+    }
+    if (limit == 0) {
+        g_tlm_len = 0;
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (limit > BLE_TLM_BUF_LEN) limit = BLE_TLM_BUF_LEN;
+
+    size_t frame = 2 + 4 * channels;
+    if (BLE_TLM_HDR_LEN + frame > limit) return ESP_ERR_INVALID_SIZE;
+
+    if (g_tlm_len > 0 && (g_tlm_len + frame > limit || g_tlm_buf[4] != channels ||
+                          t_ms - g_tlm_t0 >= BLE_TLM_MAX_LATENCY_MS)) {
+        tlm_flush(conns, n);
+    }
+    if (g_tlm_len == 0) {
+        g_tlm_t0 = t_ms;
+        put_u32le(g_tlm_buf, t_ms);
+        g_tlm_buf[4] = (uint8_t)channels;
+        g_tlm_len = BLE_TLM_HDR_LEN;
+    }
+    uint16_t dt = (uint16_t)(t_ms - g_tlm_t0);
+    g_tlm_buf[g_tlm_len++] = (uint8_t)dt;
+    g_tlm_buf[g_tlm_len++] = (uint8_t)(dt >> 8);
+    for (size_t ch = 0; ch < channels; ++ch) {
+        put_u32le(g_tlm_buf + g_tlm_len, (uint32_t)mg[ch]);
+        g_tlm_len += 4;
+    }
+    // a full batch goes out now instead of waiting for the next sample
+    if (g_tlm_len + frame > limit) tlm_flush(conns, n);
+    return ESP_OK;
+}
+
+void ble_telemetry_flush(void)
+{
+    ble_conn_t conns[CONFIG_BT_NIMBLE_MAX_CONNECTIONS];
+    size_t n = conn_snapshot(conns);
+    tlm_flush(conns, n);
+}
+
+uint32_t ble_telemetry_dropped(void)
+{
+    return g_tlm_dropped;
+}
+
+// export stream (0xA005): transport context is the connection handle
+static size_t export_max_chunk(void *ctx)
+{
+    uint16_t conn = (uint16_t)(uintptr_t)ctx;
+    size_t cap = 0;
+    portENTER_CRITICAL(&g_conn_lock);
+    ble_conn_t *c = conn_find(conn);
+    if (c && c->exp_notify) cap = (size_t)c->mtu - 3;
+    portEXIT_CRITICAL(&g_conn_lock);
+    return cap;
+}
+
+static esp_err_t export_send(void *ctx, const uint8_t *data, size_t len)
+{
+    uint16_t conn = (uint16_t)(uintptr_t)ctx;
+    // same reserve as telemetry: bulk data must not take the last buffers
+    if (os_msys_num_free() < BLE_TLM_MIN_FREE_MBUFS) return ESP_ERR_NO_MEM;
+    struct os_mbuf *om = ble_hs_mbuf_from_flat(data, (uint16_t)len);
+    if (!om) return ESP_ERR_NO_MEM;
+    int rc = ble_gatts_notify_custom(conn, g_exp_val_handle, om);
+    if (rc == BLE_HS_ENOMEM) return ESP_ERR_NO_MEM;
+    if (rc == BLE_HS_ENOTCONN) return ESP_ERR_INVALID_STATE;
+    return rc == 0 ? ESP_OK : ESP_FAIL;
+}
+
+const export_transport_t ble_export_transport = {
+    .name = "ble",
+    .max_chunk = export_max_chunk,
+    .send = export_send,
+};
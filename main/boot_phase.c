@@ -0,0 +1,31 @@
+#include "boot_phase.h"
+#include "trace.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <inttypes.h>
+
+static const char *TAG = "boot";
+static int64_t phase_us[BOOT_PHASE_COUNT];
+
+static const char *const PHASE_NAMES[BOOT_PHASE_COUNT] = {
+    "app_main", "nvs", "event_log", "periph", "ble", "tasks", "first_sample", "time_sync",
+};
+
+void boot_phase_mark(boot_phase_t p)
+{
+    if (p >= BOOT_PHASE_COUNT || phase_us[p]) return;
+    phase_us[p] = esp_timer_get_time();
+    TRACE(TRACE_EV_BOOT_PHASE, p, phase_us[p] / 1000);
+}
+
+int64_t boot_phase_us(boot_phase_t p)
+{
+    return p < BOOT_PHASE_COUNT ? phase_us[p] : 0;
+}
+
+void boot_phase_report(void)
+{
+    for (size_t i = 0; i < BOOT_PHASE_COUNT; ++i) {
+        if (phase_us[i]) ESP_LOGI(TAG, "%-12s %" PRId64 " ms", PHASE_NAMES[i], phase_us[i] / 1000);
+    }
+}
@@ -1,92 +1,255 @@
 #include "button.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "freertos/timers.h"
 #include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "trace.h"
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
-#include <stdio.h>
+
+// The ISR only stamps edges into a ring; a single one-shot esp_timer drains it
+// and runs debounce and gesture detection for every button. The timer is armed
+// for the nearest deadline and stays idle while all buttons are quiet. Both the
+// ISR and the callback may only pull the deadline in, never push it out: each
+// callback recomputes every pending deadline anyway.
 
 static const char *TAG = "button_mod";
-static gpio_num_t *btn_pins = NULL;
+
+#define EDGE_RING 64  // power of two; bounce bursts on several buttons at once
+
+typedef struct {
+    uint32_t t_us;
+    uint32_t idx;
+} btn_edge_t;
+
+typedef struct {
+    gpio_num_t pin;
+    bool bouncing;       // edges seen, level not settled yet
+    bool pressed;        // debounced state
+    bool long_fired;
+    bool in_chord;
+    uint8_t clicks;      // 1: released once, waiting for a second press
+    uint32_t first_edge; // first edge of the current burst = moment of the transition
+    uint32_t last_edge;
+    uint32_t press_t;
+    uint32_t release_t;
+} btn_state_t;
+
+static btn_state_t *btns = NULL;
 static size_t btn_count = 0;
-static TimerHandle_t *btn_timers = NULL;
-static TimerHandle_t *btn_long_timers = NULL;
 static button_cb_t user_cb = NULL;
-static QueueHandle_t btn_evt_queue = NULL;
-static TaskHandle_t btn_evt_task = NULL;
-static bool g_active_low = true;
+static button_config_t g_cfg;
+static esp_timer_handle_t g_timer = NULL;
+static uint32_t chord_mask;
 
-typedef struct {
-    size_t idx;
-    button_event_t ev;
-} btn_event_t;
+static btn_edge_t edges[EDGE_RING];
+static atomic_uint edge_head;   // written by the ISR
+static atomic_uint edge_tail;   // written by the timer callback
+static portMUX_TYPE timer_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool timer_armed;        // guarded by timer_lock
+static uint32_t timer_due;
+static atomic_uint edges_dropped;
+static atomic_uint edge_dirty;  // buttons with an edge that did not fit the ring
+
+#define MS(x) ((uint32_t)(x) * 1000u)
 
-// Debounce timer callback runs in timer/daemon task context
-static void btn_timer_cb(TimerHandle_t xTimer)
+static inline bool elapsed(uint32_t now, uint32_t since, uint32_t span_us)
 {
-    size_t idx = (size_t)(uintptr_t)pvTimerGetTimerID(xTimer);
-    // Read stable level after debounce interval
-    int level = gpio_get_level(btn_pins[idx]);
-    int pressed_level = g_active_low ? 0 : 1;
-    if (level == pressed_level) {
-        ESP_LOGI(TAG, "Button %u pressed (debounced), level=%d", idx, level);
-        // start long-press timer
-        if (btn_long_timers && btn_long_timers[idx]) {
-            xTimerStart(btn_long_timers[idx], 0);
-        }
-        if (btn_evt_queue) {
-            btn_event_t e = { idx, BUTTON_EVENT_PRESS };
-            xQueueSend(btn_evt_queue, &e, 0);
+    return (uint32_t)(now - since) >= span_us;
+}
+
+static void emit(size_t idx, button_event_t ev)
+{
+    if (user_cb) user_cb(idx, ev);
+}
+
+static void emit_click(size_t idx, uint8_t n)
+{
+    TRACE(TRACE_EV_BTN_CLICK, idx, n);
+    emit(idx, n == 2 ? BUTTON_EVENT_DOUBLE_CLICK : BUTTON_EVENT_CLICK);
+}
+
+static void on_press(size_t idx, uint32_t t)
+{
+    btn_state_t *b = &btns[idx];
+    b->pressed = true;
+    b->press_t = t;
+    b->long_fired = false;
+    TRACE(TRACE_EV_BTN_PRESS, idx, (uint32_t)esp_timer_get_time() - t);
+    emit(idx, BUTTON_EVENT_PRESS);
+
+    // a press after the double-click window closes the previous click
+    if (b->clicks && elapsed(t, b->release_t, MS(g_cfg.double_click_ms) + 1)) {
+        b->clicks = 0;
+        emit_click(idx, 1);
+    }
+
+    if (!g_cfg.chord_ms) return;
+    uint32_t mask = 0;
+    for (size_t i = 0; i < btn_count; ++i) {
+        btn_state_t *o = &btns[i];
+        if (i == idx || !o->pressed || o->long_fired) continue;
+        // buttons settling in the same pass may be handled out of edge order
+        int32_t d = (int32_t)(t - o->press_t);
+        if (d < 0) d = -d;
+        if (o->in_chord || (uint32_t)d <= MS(g_cfg.chord_ms)) mask |= 1u << i;
+    }
+    if (!mask) return;
+    chord_mask |= mask | (1u << idx);
+    for (size_t i = 0; i < btn_count; ++i) {
+        if (chord_mask & (1u << i)) {
+            btns[i].in_chord = true;
+            btns[i].clicks = 0;
         }
+    }
+    TRACE(TRACE_EV_BTN_CHORD, chord_mask, 0);
+    emit(chord_mask, BUTTON_EVENT_CHORD);
+}
+
+static void on_release(size_t idx, uint32_t t)
+{
+    btn_state_t *b = &btns[idx];
+    b->pressed = false;
+    TRACE(TRACE_EV_BTN_RELEASE, idx, (uint32_t)esp_timer_get_time() - t);
+    emit(idx, BUTTON_EVENT_RELEASE);
+
+    if (b->in_chord) {
+        b->in_chord = false;
+        bool held = false;
+        for (size_t i = 0; i < btn_count; ++i) held |= btns[i].in_chord;
+        if (!held) chord_mask = 0;
+        return;
+    }
+    if (b->long_fired) return;
+    if (!g_cfg.double_click_ms) {
+        emit_click(idx, 1);
+    } else if (b->clicks) {
+        b->clicks = 0;
+        emit_click(idx, 2);
     } else {
-        ESP_LOGI(TAG, "Button %u released (debounced), level=%d", idx, level);
-        // cancel long-press if running
-        if (btn_long_timers && btn_long_timers[idx]) {
-            xTimerStop(btn_long_timers[idx], 0);
-        }
-        if (btn_evt_queue) {
-            btn_event_t e = { idx, BUTTON_EVENT_RELEASE };
-            xQueueSend(btn_evt_queue, &e, 0);
-        }
+        b->clicks = 1;
+        b->release_t = t;
     }
 }
 
-// long-press timer callback
-static void btn_long_timer_cb(TimerHandle_t xTimer)
+// caller holds timer_lock
+static void IRAM_ATTR arm_locked(uint32_t now, uint32_t delay_us)
 {
-    size_t idx = (size_t)(uintptr_t)pvTimerGetTimerID(xTimer);
-    ESP_LOGI(TAG, "Button %u long-press detected", idx);
-    if (btn_evt_queue) {
-        btn_event_t e = { idx, BUTTON_EVENT_LONG_PRESS };
-        xQueueSend(btn_evt_queue, &e, 0);
+    if (delay_us < 100) delay_us = 100;
+    uint32_t due = now + delay_us;
+    if (timer_armed) {
+        if ((int32_t)(timer_due - due) <= 0) return;
+        esp_timer_stop(g_timer);
     }
+    esp_timer_start_once(g_timer, delay_us);
+    timer_armed = true;
+    timer_due = due;
 }
 
-static void btn_event_task(void *arg)
+static void btn_timer_cb(void *arg)
 {
-    btn_event_t e;
-    while (1) {
-        if (xQueueReceive(btn_evt_queue, &e, portMAX_DELAY) == pdTRUE) {
-            if (user_cb) user_cb(e.idx, e.ev);
+    TRACE_BEGIN(TRACE_SPAN_BUTTON_DISPATCH);
+    portENTER_CRITICAL(&timer_lock);
+    timer_armed = false;
+    portEXIT_CRITICAL(&timer_lock);
+
+    unsigned tail = atomic_load_explicit(&edge_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&edge_head, memory_order_acquire);
+    for (; tail != head; ++tail) {
+        const btn_edge_t *e = &edges[tail & (EDGE_RING - 1)];
+        btn_state_t *b = &btns[e->idx];
+        if (!b->bouncing) {
+            b->bouncing = true;
+            b->first_edge = e->t_us;
         }
+        b->last_edge = e->t_us;
     }
+    atomic_store_explicit(&edge_tail, tail, memory_order_release);
+
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    // a dropped edge still counts: the burst restarts now and the level is read after it
+    unsigned dirty = atomic_exchange_explicit(&edge_dirty, 0, memory_order_acquire);
+    for (size_t i = 0; dirty && i < btn_count; ++i, dirty >>= 1) {
+        if (!(dirty & 1)) continue;
+        btn_state_t *b = &btns[i];
+        if (!b->bouncing) {
+            b->bouncing = true;
+            b->first_edge = now;
+        }
+        b->last_edge = now;
+    }
+    uint32_t db = MS(g_cfg.debounce_ms);
+    int pressed_level = g_cfg.active_low ? 0 : 1;
+    uint32_t next = UINT32_MAX;
+
+    for (size_t i = 0; i < btn_count; ++i) {
+        btn_state_t *b = &btns[i];
+        if (b->bouncing) {
+            if (elapsed(now, b->last_edge, db)) {
+                b->bouncing = false;
+                bool down = gpio_get_level(b->pin) == pressed_level;
+                if (down != b->pressed) {
+                    if (down) on_press(i, b->first_edge);
+                    else on_release(i, b->first_edge);
+                }
+            } else {
+                uint32_t left = db - (now - b->last_edge);
+                if (left < next) next = left;
+            }
+        }
+        // while a release is still bouncing the settled level decides first
+        if (b->pressed && !b->bouncing && !b->long_fired && !b->in_chord && g_cfg.long_press_ms) {
+            uint32_t lp = MS(g_cfg.long_press_ms);
+            if (elapsed(now, b->press_t, lp)) {
+                b->long_fired = true;
+                b->clicks = 0;
+                TRACE(TRACE_EV_BTN_LONG, i, 0);
+                emit(i, BUTTON_EVENT_LONG_PRESS);
+            } else {
+                uint32_t left = lp - (now - b->press_t);
+                if (left < next) next = left;
+            }
+        }
+        // a second press in progress keeps the click pending until its release
+        if (b->clicks && !b->pressed && !b->bouncing) {
+            uint32_t dc = MS(g_cfg.double_click_ms);
+            if (elapsed(now, b->release_t, dc)) {
+                b->clicks = 0;
+                emit_click(i, 1);
+            } else {
+                uint32_t left = dc - (now - b->release_t);
+                if (left < next) next = left;
+            }
+        }
+    }
+
+    if (next != UINT32_MAX) {
+        portENTER_CRITICAL(&timer_lock);
+        arm_locked(now, next);
+        portEXIT_CRITICAL(&timer_lock);
+    }
+    TRACE_END(TRACE_SPAN_BUTTON_DISPATCH);
 }
 
-// ISR: restart debounce timer for the button index
 static void IRAM_ATTR isr_handler(void *arg)
 {
-    uint32_t idx = (uint32_t)(uintptr_t)arg;
-    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    if (btn_timers && idx < btn_count && btn_timers[idx]) {
-        // Try to reset the timer; if reset fails (timer not active), start it
-        if (xTimerResetFromISR(btn_timers[idx], &xHigherPriorityTaskWoken) != pdPASS) {
-            xTimerStartFromISR(btn_timers[idx], &xHigherPriorityTaskWoken);
-        }
+    TRACE_ISR_ENTER(TRACE_ISR_BUTTON);
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    unsigned head = atomic_load_explicit(&edge_head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&edge_tail, memory_order_acquire) < EDGE_RING) {
+        edges[head & (EDGE_RING - 1)] = (btn_edge_t){ now, (uint32_t)(uintptr_t)arg };
+        atomic_store_explicit(&edge_head, head + 1, memory_order_release);
+    } else {
+        atomic_fetch_or_explicit(&edge_dirty, 1u << (uintptr_t)arg, memory_order_release);
+        atomic_fetch_add_explicit(&edges_dropped, 1, memory_order_relaxed);
     }
-    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    portENTER_CRITICAL_ISR(&timer_lock);
+    arm_locked(now, MS(g_cfg.debounce_ms));
+    portEXIT_CRITICAL_ISR(&timer_lock);
+    TRACE_ISR_EXIT(TRACE_ISR_BUTTON);
 }
 
 // Default init wrapper keeps old API: active_low = true
@@ -97,100 +260,80 @@ esp_err_t button_init(const gpio_num_t *pins, size_t count, button_cb_t cb)
 
 esp_err_t button_init_ex(const gpio_num_t *pins, size_t count, button_cb_t cb, bool active_low)
 {
-    if (!pins || count == 0 || !cb) return ESP_ERR_INVALID_ARG;
-    if (btn_pins) return ESP_ERR_INVALID_STATE;
+    button_config_t cfg = BUTTON_CONFIG_DEFAULT();
+    cfg.active_low = active_low;
+    return button_init_cfg(pins, count, cb, &cfg);
+}
 
-    g_active_low = active_low;
+esp_err_t button_init_cfg(const gpio_num_t *pins, size_t count, button_cb_t cb, const button_config_t *cfg)
+{
+    if (!pins || count == 0 || count > BUTTON_MAX || !cb || !cfg) return ESP_ERR_INVALID_ARG;
+    if (btns) return ESP_ERR_INVALID_STATE;
 
-    btn_pins = malloc(sizeof(gpio_num_t) * count);
-    if (!btn_pins) return ESP_ERR_NO_MEM;
-    for (size_t i = 0; i < count; ++i) btn_pins[i] = pins[i];
+    btns = calloc(count, sizeof(btn_state_t));
+    if (!btns) return ESP_ERR_NO_MEM;
+    for (size_t i = 0; i < count; ++i) btns[i].pin = pins[i];
     btn_count = count;
     user_cb = cb;
+    g_cfg = *cfg;
+    if (g_cfg.debounce_ms == 0) g_cfg.debounce_ms = 1;
+    chord_mask = 0;
+    atomic_store(&edge_head, 0);
+    atomic_store(&edge_tail, 0);
+    atomic_store(&edge_dirty, 0);
+    timer_armed = false;
+
+    const esp_timer_create_args_t targs = {
+        .callback = btn_timer_cb,
+        .name = "btn",
+    };
+    esp_err_t err = esp_timer_create(&targs, &g_timer);
+    if (err != ESP_OK) {
+        free(btns);
+        btns = NULL;
+        return err;
+    }
 
     // configure pins
     uint64_t mask = 0;
-    for (size_t i = 0; i < count; ++i) mask |= (1ULL << btn_pins[i]);
-    // Use any-edge interrupts so we debounce and detect both press and release
-    // (previously only one edge was configured which prevented cancelling
-    // the long-press timer on release in some wiring/configs).
+    for (size_t i = 0; i < count; ++i) mask |= (1ULL << pins[i]);
+    // Any edge: the engine reads the settled level itself, so both press and release arrive here
     gpio_config_t io_conf = {
         .intr_type = GPIO_INTR_ANYEDGE,
         .mode = GPIO_MODE_INPUT,
         .pin_bit_mask = mask,
-        .pull_down_en = (g_active_low ? 0 : 1),
-        .pull_up_en = (g_active_low ? 1 : 0),
+        .pull_down_en = (g_cfg.active_low ? 0 : 1),
+        .pull_up_en = (g_cfg.active_low ? 1 : 0),
     };
     gpio_config(&io_conf);
 
-    // Create debounce timers
-    btn_timers = malloc(sizeof(TimerHandle_t) * count);
-    if (!btn_timers) return ESP_ERR_NO_MEM;
+    // a button already held at boot is reported once its level is read
+    int pressed_level = g_cfg.active_low ? 0 : 1;
     for (size_t i = 0; i < count; ++i) {
-        char name[32];
-        snprintf(name, sizeof(name), "btn_db_%zu", i);
-        btn_timers[i] = xTimerCreate(name, pdMS_TO_TICKS(50), pdFALSE, (void *)(uintptr_t)i, btn_timer_cb);
-        if (!btn_timers[i]) {
-            // cleanup previously created timers
-            for (size_t j = 0; j < i; ++j) xTimerDelete(btn_timers[j], 0);
-            free(btn_timers);
-            btn_timers = NULL;
-            return ESP_ERR_NO_MEM;
-        }
+        if (gpio_get_level(pins[i]) == pressed_level) isr_handler((void *)(uintptr_t)i);
     }
 
     gpio_install_isr_service(0);
     for (size_t i = 0; i < count; ++i) {
-        gpio_isr_handler_add(btn_pins[i], isr_handler, (void *)(uintptr_t)i);
-    }
-
-    // Create event queue and handler task
-    btn_evt_queue = xQueueCreate(count * 4, sizeof(btn_event_t));
-    if (!btn_evt_queue) return ESP_ERR_NO_MEM;
-    BaseType_t ok = xTaskCreate(btn_event_task, "btn_evt", 4096, NULL, 5, &btn_evt_task);
-    if (ok != pdPASS) {
-        vQueueDelete(btn_evt_queue);
-        btn_evt_queue = NULL;
-        return ESP_ERR_NO_MEM;
-    }
-
-    // Create long-press timers (5 seconds)
-    btn_long_timers = malloc(sizeof(TimerHandle_t) * count);
-    if (!btn_long_timers) return ESP_ERR_NO_MEM;
-    for (size_t i = 0; i < count; ++i) {
-        char lname[32];
-        snprintf(lname, sizeof(lname), "btn_long_%zu", i);
-        btn_long_timers[i] = xTimerCreate(lname, pdMS_TO_TICKS(5000), pdFALSE, (void *)(uintptr_t)i, btn_long_timer_cb);
-        if (!btn_long_timers[i]) {
-            for (size_t j = 0; j < i; ++j) xTimerDelete(btn_long_timers[j], 0);
-            free(btn_long_timers);
-            btn_long_timers = NULL;
-            return ESP_ERR_NO_MEM;
-        }
+        gpio_isr_handler_add(pins[i], isr_handler, (void *)(uintptr_t)i);
     }
 
-    ESP_LOGI(TAG, "Button module initialized (%d buttons), active_low=%d", (int)count, g_active_low);
+    ESP_LOGI(TAG, "Button module initialized (%d buttons), active_low=%d", (int)count, g_cfg.active_low);
     return ESP_OK;
 }
 
 esp_err_t button_deinit(void)
 {
-    if (!btn_pins) return ESP_ERR_INVALID_STATE;
-    for (size_t i = 0; i < btn_count; ++i) {
-        gpio_isr_handler_remove(btn_pins[i]);
-        if (btn_timers && btn_timers[i]) xTimerDelete(btn_timers[i], 0);
-        if (btn_long_timers && btn_long_timers[i]) xTimerDelete(btn_long_timers[i], 0);
-    }
-    if (btn_timers) { free(btn_timers); btn_timers = NULL; }
-    if (btn_long_timers) { free(btn_long_timers); btn_long_timers = NULL; }
-    if (btn_evt_task) {
-        vTaskDelete(btn_evt_task);
-        btn_evt_task = NULL;
-    }
-    if (btn_evt_queue) {
-        vQueueDelete(btn_evt_queue);
-        btn_evt_queue = NULL;
-    }
-    free(btn_pins); btn_pins = NULL; btn_count = 0; user_cb = NULL;
+    if (!btns) return ESP_ERR_INVALID_STATE;
+    for (size_t i = 0; i < btn_count; ++i) gpio_isr_handler_remove(btns[i].pin);
+    esp_timer_stop(g_timer);
+    esp_timer_delete(g_timer);
+    g_timer = NULL;
+    free(btns); btns = NULL; btn_count = 0; user_cb = NULL;
     return ESP_OK;
 }
+
+uint32_t button_edges_dropped(void)
+{
+    return atomic_load(&edges_dropped);
+}
@@ -0,0 +1,159 @@
+#include "clock_map.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include <string.h>
+
+#define CLOCK_MAP_VERSION 1
+
+typedef struct __attribute__((packed)) {
+    uint64_t from_ms;   // uptime the offset was learned at
+    int64_t offset_ms;  // epoch - uptime
+    uint16_t boot;
+    uint16_t reserved[3];
+} clock_seg_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t version;
+    uint16_t boot;      // id of the last boot
+    uint16_t count;
+    uint16_t reserved;
+    clock_seg_t segs[CLOCK_MAP_MAX_SEGS];
+} clock_blob_t;
+
+static const char *TAG = "clock_map";
+static clock_map_store_t st;
+static clock_blob_t blob;
+static SemaphoreHandle_t map_lock = NULL;
+
+static size_t blob_len(void)
+{
+    return offsetof(clock_blob_t, segs) + blob.count * sizeof(clock_seg_t);
+}
+
+esp_err_t clock_map_init(const clock_map_store_t *store)
+{
+    if (!store || !store->load || !store->save) return ESP_ERR_INVALID_ARG;
+    if (!map_lock) map_lock = xSemaphoreCreateMutex();
+    if (!map_lock) return ESP_ERR_NO_MEM;
+    st = *store;
+
+    memset(&blob, 0, sizeof(blob));
+    size_t len = sizeof(blob);
+    esp_err_t err = st.load(st.ctx, &blob, &len);
+    if (err == ESP_OK && (len < offsetof(clock_blob_t, segs) || blob.version != CLOCK_MAP_VERSION ||
+                          blob.count > CLOCK_MAP_MAX_SEGS || len < blob_len())) {
+        ESP_LOGW(TAG, "clock table unreadable, starting over");
+        err = ESP_ERR_NOT_FOUND;
+    }
+    if (err != ESP_OK) {
+        memset(&blob, 0, sizeof(blob));
+        blob.version = CLOCK_MAP_VERSION;
+    }
+
+    // 0 and RECORD_BOOT_EPOCH are reserved
+    blob.boot = blob.boot >= RECORD_BOOT_MAX ? 1 : blob.boot + 1;
+    // after a wrap, entries of the reused id belong to an old boot
+    size_t k = 0;
+    for (size_t i = 0; i < blob.count; ++i) {
+        if (blob.segs[i].boot != blob.boot) blob.segs[k++] = blob.segs[i];
+    }
+    blob.count = (uint16_t)k;
+    ESP_LOGI(TAG, "boot id %u, %u clock entries", blob.boot, blob.count);
+    return st.save(st.ctx, &blob, blob_len());
+}
+
+uint16_t clock_map_boot(void)
+{
+    return blob.boot;
+}
+
+// Full table: first collapse this boot's corrections to its first and last entry
+// (records in between then use the first offset), and only if that frees nothing
+// drop the oldest entry of an earlier boot. Entries are appended in time order.
+static void make_room(void)
+{
+    size_t first = blob.count, last = 0, mine = 0;
+    for (size_t i = 0; i < blob.count; ++i) {
+        if (blob.segs[i].boot != blob.boot) continue;
+        if (first == blob.count) first = i;
+        last = i;
+        mine++;
+    }
+    size_t k = 0;
+    bool dropped = false;
+    for (size_t i = 0; i < blob.count; ++i) {
+        const clock_seg_t *s = &blob.segs[i];
+        bool drop = mine > 2 ? s->boot == blob.boot && i != first && i != last : !dropped && s->boot != blob.boot;
+        dropped |= drop;
+        if (!drop) blob.segs[k++] = *s;
+    }
+    blob.count = (uint16_t)k;
+}
+
+esp_err_t clock_map_sync(uint64_t mono_ms, uint64_t epoch_ms)
+{
+    if (!map_lock) return ESP_ERR_INVALID_STATE;
+    int64_t offset = (int64_t)(epoch_ms - mono_ms);
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(map_lock, portMAX_DELAY);
+    const clock_seg_t *last = NULL;
+    for (size_t i = 0; i < blob.count; ++i) {
+        if (blob.segs[i].boot == blob.boot) last = &blob.segs[i];
+    }
+    int64_t step = last ? offset - last->offset_ms : INT64_MAX;
+    if (step >= CLOCK_MAP_MIN_STEP_MS || step <= -CLOCK_MAP_MIN_STEP_MS) {
+        if (blob.count == CLOCK_MAP_MAX_SEGS) make_room();
+        blob.segs[blob.count++] = (clock_seg_t){ .from_ms = mono_ms, .offset_ms = offset, .boot = blob.boot };
+        err = st.save(st.ctx, &blob, blob_len());
+    }
+    xSemaphoreGive(map_lock);
+    return err;
+}
+
+static bool to_epoch_locked(uint16_t boot, uint64_t mono_ms, uint64_t *epoch_ms)
+{
+    const clock_seg_t *first = NULL, *best = NULL;
+    for (size_t i = 0; i < blob.count; ++i) {
+        const clock_seg_t *s = &blob.segs[i];
+        if (s->boot != boot) continue;
+        if (!first) first = s;
+        if (s->from_ms <= mono_ms) best = s;
+    }
+    // before the first sync of that boot: its first offset applies backwards
+    if (!best) best = first;
+    if (!best) return false;
+    *epoch_ms = (uint64_t)((int64_t)mono_ms + best->offset_ms);
+    return true;
+}
+
+bool clock_map_to_epoch(uint16_t boot, uint64_t mono_ms, uint64_t *epoch_ms)
+{
+    if (!epoch_ms) return false;
+    if (boot == RECORD_BOOT_EPOCH) {
+        *epoch_ms = mono_ms;
+        return true;
+    }
+    if (!map_lock) return false;
+    xSemaphoreTake(map_lock, portMAX_DELAY);
+    bool ok = to_epoch_locked(boot, mono_ms, epoch_ms);
+    xSemaphoreGive(map_lock);
+    return ok;
+}
+
+size_t clock_map_rebase(record_t *recs, size_t n)
+{
+    if (!recs || !map_lock) return 0;
+    size_t done = 0;
+    xSemaphoreTake(map_lock, portMAX_DELAY);
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t e;
+        if (recs[i].boot == RECORD_BOOT_EPOCH) continue;
+        if (!to_epoch_locked(recs[i].boot, recs[i].ts_ms, &e)) continue;
+        recs[i].ts_ms = e;
+        recs[i].boot = RECORD_BOOT_EPOCH;
+        done++;
+    }
+    xSemaphoreGive(map_lock);
+    return done;
+}
@@ -0,0 +1,296 @@
+#include "dose_sched.h"
+#include "esp_log.h"
+#include <stddef.h>
+#include <string.h>
+
+#define DOSE_SCHED_VERSION 1
+#define DAY_MS (24ULL * 60 * DOSE_MIN_MS)
+#define NO_POS 0xFF
+
+enum { STAGE_WAIT = 0, STAGE_DUE, STAGE_LATE };
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    int16_t tz_min;
+    uint8_t reserved;
+    dose_slot_t slots[DOSE_SLOTS];
+    // due time of the last occurrence taken or missed, saved on every close so a
+    // reboot does not reopen it
+    uint64_t closed[DOSE_SLOTS];
+} dose_blob_t;
+
+typedef struct {
+    uint64_t due_ms;       // current occurrence
+    uint8_t stage;
+    uint8_t pos;           // index in heap[], NO_POS when not scheduled
+} slot_state_t;
+
+static const char *TAG = "dose_sched";
+static dose_sched_store_t st;
+static dose_blob_t blob;   // the saved table, edited by dose_sched_set/_set_tz
+// what the heap was built from; copied from blob by dose_sched_start only, so an
+// edit cannot move the deadline of a slot already in the heap
+static dose_slot_t live[DOSE_SLOTS];
+static int16_t live_tz;
+static slot_state_t state[DOSE_SLOTS];
+static uint8_t heap[DOSE_SLOTS];   // slot numbers, ordered by deadline()
+static size_t heap_len;
+
+static uint64_t deadline(uint8_t s)
+{
+    const dose_slot_t *c = &live[s];
+    const slot_state_t *x = &state[s];
+    if (x->stage == STAGE_WAIT) return x->due_ms;
+    if (x->stage == STAGE_DUE) return x->due_ms + c->on_time_min * DOSE_MIN_MS;
+    return x->due_ms + (c->on_time_min + c->late_min) * DOSE_MIN_MS;
+}
+
+static void heap_swap(size_t a, size_t b)
+{
+    uint8_t t = heap[a];
+    heap[a] = heap[b];
+    heap[b] = t;
+    state[heap[a]].pos = (uint8_t)a;
+    state[heap[b]].pos = (uint8_t)b;
+}
+
+static void heap_up(size_t i)
+{
+    while (i > 0) {
+        size_t p = (i - 1) / 2;
+        if (deadline(heap[p]) <= deadline(heap[i])) break;
+        heap_swap(i, p);
+        i = p;
+    }
+}
+
+static void heap_down(size_t i)
+{
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < heap_len && deadline(heap[l]) < deadline(heap[m])) m = l;
+        if (r < heap_len && deadline(heap[r]) < deadline(heap[m])) m = r;
+        if (m == i) break;
+        heap_swap(i, m);
+        i = m;
+    }
+}
+
+static void heap_push(uint8_t s)
+{
+    heap[heap_len] = s;
+    state[s].pos = (uint8_t)heap_len;
+    heap_up(heap_len++);
+}
+
+// the slot's deadline changed
+static void heap_fix(uint8_t s)
+{
+    heap_up(state[s].pos);
+    heap_down(state[s].pos);
+}
+
+static uint64_t window_ms(const dose_slot_t *c)
+{
+    return (c->on_time_min + c->late_min) * DOSE_MIN_MS;
+}
+
+// earliest occurrence whose window has not ended at now_ms and that comes after the
+// last closed one; 0 if the slot has no days
+static uint64_t find_due(uint8_t s, uint64_t now_ms)
+{
+    const dose_slot_t *c = &live[s];
+    if (!(c->days & 0x7F)) return 0;
+    int64_t tz = (int64_t)live_tz * (int64_t)DOSE_MIN_MS;
+    uint64_t win = window_ms(c);
+    int64_t from = (int64_t)now_ms - (int64_t)win + tz;
+    int64_t day = (from >= 0 ? from : from - (int64_t)DAY_MS + 1) / (int64_t)DAY_MS;
+    for (int k = 0; k < 9; ++k, ++day) {
+        unsigned wd = (unsigned)(((day % 7) + 7 + 3) % 7);   // 1970-01-01 was a Thursday, Monday = 0
+        if (!(c->days & (1u << wd))) continue;
+        int64_t due = day * (int64_t)DAY_MS + (int64_t)c->minute * (int64_t)DOSE_MIN_MS - tz;
+        if (due < 0) continue;
+        if ((uint64_t)due + win > now_ms && (uint64_t)due > blob.closed[s]) return (uint64_t)due;
+    }
+    return 0;
+}
+
+static void emit(dose_action_t *out, size_t *n, uint8_t type, uint8_t s)
+{
+    out[*n].type = type;
+    out[*n].comp = live[s].comp;
+    out[*n].slot = s;
+    out[*n].due_ms = state[s].due_ms;
+    (*n)++;
+}
+
+// current occurrence is over; schedule the next one or drop the slot from the heap
+static void close_occurrence(uint8_t s, uint64_t now_ms)
+{
+    slot_state_t *x = &state[s];
+    blob.closed[s] = x->due_ms;
+    esp_err_t err = st.save ? st.save(st.ctx, &blob, sizeof(blob)) : ESP_ERR_INVALID_STATE;
+    if (err != ESP_OK) ESP_LOGW(TAG, "closed dose not saved: %s", esp_err_to_name(err));
+    uint64_t due = find_due(s, now_ms);
+    if (due) {
+        x->due_ms = due;
+        x->stage = STAGE_WAIT;
+        heap_fix(s);
+        return;
+    }
+    // remove: move the last entry into our place
+    size_t i = x->pos;
+    heap_swap(i, --heap_len);
+    x->pos = NO_POS;
+    if (i < heap_len) heap_fix(heap[i]);
+}
+
+esp_err_t dose_sched_init(const dose_sched_store_t *store)
+{
+    if (!store || !store->load || !store->save) return ESP_ERR_INVALID_ARG;
+    st = *store;
+    memset(&blob, 0, sizeof(blob));
+    memset(live, 0, sizeof(live));
+    memset(state, 0, sizeof(state));
+    for (size_t i = 0; i < DOSE_SLOTS; ++i) state[i].pos = NO_POS;
+    heap_len = 0;
+
+    size_t len = sizeof(blob);
+    esp_err_t err = st.load(st.ctx, &blob, &len);
+    if (err == ESP_OK && (len != sizeof(blob) || blob.version != DOSE_SCHED_VERSION)) {
+        ESP_LOGW(TAG, "schedule unreadable, starting empty");
+        err = ESP_ERR_NOT_FOUND;
+    }
+    if (err != ESP_OK) {
+        memset(&blob, 0, sizeof(blob));
+        blob.version = DOSE_SCHED_VERSION;
+    }
+    size_t used = 0;
+    for (size_t i = 0; i < DOSE_SLOTS; ++i) {
+        if (blob.slots[i].comp > RECORD_COMPARTMENT_MASK) blob.slots[i].days = 0;
+        if (blob.slots[i].days) used++;
+    }
+    ESP_LOGI(TAG, "%d dose slots, tz %+d min", (int)used, blob.tz_min);
+    return err == ESP_ERR_NOT_FOUND ? ESP_OK : err;
+}
+
+esp_err_t dose_sched_set(size_t slot, const dose_slot_t *cfg)
+{
+    if (slot >= DOSE_SLOTS || !cfg || cfg->comp > RECORD_COMPARTMENT_MASK || cfg->minute >= 24 * 60) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    blob.slots[slot] = *cfg;
+    blob.slots[slot].days &= 0x7F;
+    return ESP_OK;
+}
+
+void dose_sched_set_tz(int16_t offset_min)
+{
+    blob.tz_min = offset_min;
+}
+
+int16_t dose_sched_tz(void)
+{
+    return blob.tz_min;
+}
+
+esp_err_t dose_sched_save(void)
+{
+    if (!st.save) return ESP_ERR_INVALID_STATE;
+    return st.save(st.ctx, &blob, sizeof(blob));
+}
+
+esp_err_t dose_sched_command(const uint8_t *data, size_t len)
+{
+    if (!data || len == 0) return ESP_ERR_INVALID_ARG;
+    esp_err_t err;
+    if (data[0] == DOSE_OP_SET) {
+        if (len != DOSE_OP_SET_LEN) return ESP_ERR_INVALID_SIZE;
+        dose_slot_t cfg = {
+            .comp = data[2],
+            .days = data[3],
+            .minute = (uint16_t)(data[4] | (data[5] << 8)),
+            .early_min = data[6],
+            .on_time_min = data[7],
+            .late_min = data[8],
+        };
+        err = dose_sched_set(data[1], &cfg);
+    } else if (data[0] == DOSE_OP_TZ) {
+        if (len != DOSE_OP_TZ_LEN) return ESP_ERR_INVALID_SIZE;
+        dose_sched_set_tz((int16_t)(data[1] | (data[2] << 8)));
+        err = ESP_OK;
+    } else {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return err == ESP_OK ? dose_sched_save() : err;
+}
+
+size_t dose_sched_start(uint64_t now_ms, dose_action_t *out, size_t max)
+{
+    size_t n = 0;
+    heap_len = 0;
+    memcpy(live, blob.slots, sizeof(live));
+    live_tz = blob.tz_min;
+    for (uint8_t s = 0; s < DOSE_SLOTS; ++s) {
+        slot_state_t *x = &state[s];
+        x->pos = NO_POS;
+        uint64_t due = find_due(s, now_ms);
+        if (!due) continue;
+        const dose_slot_t *c = &live[s];
+        x->due_ms = due;
+        if (now_ms < due) x->stage = STAGE_WAIT;
+        else if (now_ms < due + c->on_time_min * DOSE_MIN_MS) x->stage = STAGE_DUE;
+        else x->stage = STAGE_LATE;
+        if (x->stage != STAGE_WAIT && n < max) emit(out, &n, x->stage == STAGE_DUE ? DOSE_ACT_REMIND : DOSE_ACT_LATE, s);
+        heap_push(s);
+    }
+    return n;
+}
+
+size_t dose_sched_advance(uint64_t now_ms, dose_action_t *out, size_t max)
+{
+    size_t n = 0;
+    while (heap_len && n < max) {
+        uint8_t s = heap[0];
+        if (deadline(s) > now_ms) break;
+        slot_state_t *x = &state[s];
+        if (x->stage == STAGE_WAIT) {
+            x->stage = STAGE_DUE;
+            emit(out, &n, DOSE_ACT_REMIND, s);
+            heap_fix(s);
+        } else if (x->stage == STAGE_DUE) {
+            x->stage = STAGE_LATE;
+            emit(out, &n, DOSE_ACT_LATE, s);
+            heap_fix(s);
+        } else {
+            emit(out, &n, DOSE_ACT_MISSED, s);
+            close_occurrence(s, now_ms);
+        }
+    }
+    return n;
+}
+
+bool dose_sched_next(uint64_t *at_ms)
+{
+    if (!heap_len) return false;
+    if (at_ms) *at_ms = deadline(heap[0]);
+    return true;
+}
+
+uint8_t dose_sched_taken(uint8_t comp, uint64_t now_ms)
+{
+    int best = -1;
+    for (size_t i = 0; i < heap_len; ++i) {
+        uint8_t s = heap[i];
+        const dose_slot_t *c = &live[s];
+        uint64_t due = state[s].due_ms;
+        if (c->comp != comp) continue;
+        if (now_ms + c->early_min * DOSE_MIN_MS < due || now_ms >= due + window_ms(c)) continue;
+        if (best < 0 || due < state[best].due_ms) best = s;
+    }
+    if (best < 0) return RECORD_TYPE_TAKEN;
+    const dose_slot_t *c = &live[best];
+    uint8_t type = now_ms < state[best].due_ms + c->on_time_min * DOSE_MIN_MS ? RECORD_TYPE_ON_TIME : RECORD_TYPE_LATE;
+    close_occurrence((uint8_t)best, now_ms);
+    return type;
+}
@@ -0,0 +1,35 @@
+#include "dose_sched.h"
+#include "nvs.h"
+
+#define DOSE_SCHED_NVS_KEY "sched"
+
+static esp_err_t nvs_load(void *ctx, void *buf, size_t *len)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open((const char *)ctx, NVS_READONLY, &h);
+    if (err == ESP_ERR_NVS_NOT_FOUND) return ESP_ERR_NOT_FOUND;
+    if (err != ESP_OK) return err;
+    err = nvs_get_blob(h, DOSE_SCHED_NVS_KEY, buf, len);
+    nvs_close(h);
+    return err == ESP_ERR_NVS_NOT_FOUND ? ESP_ERR_NOT_FOUND : err;
+}
+
+static esp_err_t nvs_save(void *ctx, const void *buf, size_t len)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open((const char *)ctx, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_set_blob(h, DOSE_SCHED_NVS_KEY, buf, len);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+esp_err_t dose_sched_store_nvs(const char *ns, dose_sched_store_t *out)
+{
+    if (!ns || !out) return ESP_ERR_INVALID_ARG;
+    out->ctx = (void *)ns;
+    out->load = nvs_load;
+    out->save = nvs_save;
+    return ESP_OK;
+}
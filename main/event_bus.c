@@ -0,0 +1,96 @@
+#include "event_bus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "trace.h"
+#include <string.h>
+
+static const char *TAG = "event_bus";
+
+static StaticQueue_t queue_buf;
+static uint8_t queue_storage[EVENT_BUS_DEPTH * sizeof(app_event_t)];
+static StaticTask_t task_buf;
+static StackType_t task_stack[EVENT_BUS_STACK];
+static QueueHandle_t queue = NULL;
+static TaskHandle_t task = NULL;
+
+static const event_sub_t *subs;
+static size_t sub_count;
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static event_bus_stats_t stats;
+
+static void dispatcher(void *arg)
+{
+    app_event_t ev;
+    for (;;) {
+        if (xQueueReceive(queue, &ev, portMAX_DELAY) != pdTRUE) continue;
+        uint32_t lat = (uint32_t)esp_timer_get_time() - ev.t_us;
+        TRACE(TRACE_EV_BUS_EVENT, ev.type, lat);
+        TRACE_BEGIN(TRACE_SPAN_BUS_DISPATCH);
+        for (size_t i = 0; i < sub_count; ++i) {
+            if (subs[i].types & APP_EV_BIT(ev.type)) subs[i].fn(&ev);
+        }
+        TRACE_END(TRACE_SPAN_BUS_DISPATCH);
+        portENTER_CRITICAL(&stats_lock);
+        stats.delivered++;
+        stats.latency_sum_us += lat;
+        if (lat > stats.latency_max_us) stats.latency_max_us = lat;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+}
+
+esp_err_t event_bus_init(const event_sub_t *table, size_t count)
+{
+    if (!table && count) return ESP_ERR_INVALID_ARG;
+    if (queue) return ESP_ERR_INVALID_STATE;
+    subs = table;
+    sub_count = count;
+    memset(&stats, 0, sizeof(stats));
+    queue = xQueueCreateStatic(EVENT_BUS_DEPTH, sizeof(app_event_t), queue_storage, &queue_buf);
+    if (!queue) return ESP_FAIL;
+    task = xTaskCreateStatic(dispatcher, "evt_bus", EVENT_BUS_STACK, NULL, EVENT_BUS_PRIO, task_stack, &task_buf);
+    if (!task) return ESP_FAIL;
+    ESP_LOGI(TAG, "%d subscribers, depth %d", (int)count, EVENT_BUS_DEPTH);
+    return ESP_OK;
+}
+
+static esp_err_t post(app_event_t *ev, TickType_t wait)
+{
+    if (!ev || ev->type >= APP_EV_COUNT) return ESP_ERR_INVALID_ARG;
+    if (!queue) return ESP_ERR_INVALID_STATE;
+    ev->t_us = (uint32_t)esp_timer_get_time();
+    bool ok = xQueueSend(queue, ev, wait) == pdTRUE;
+    UBaseType_t depth = uxQueueMessagesWaiting(queue);
+    portENTER_CRITICAL(&stats_lock);
+    stats.posted++;
+    uint32_t dropped = ok ? stats.dropped : ++stats.dropped;
+    if (depth > stats.depth_max) stats.depth_max = depth;
+    portEXIT_CRITICAL(&stats_lock);
+    if (!ok) {
+        TRACE(TRACE_EV_BUS_DROP, ev->type, dropped);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+esp_err_t event_bus_post(app_event_t *ev)
+{
+    return post(ev, 0);
+}
+
+esp_err_t event_bus_post_wait(app_event_t *ev, uint32_t timeout_ms)
+{
+    if (xTaskGetCurrentTaskHandle() == task) return ESP_ERR_INVALID_STATE;
+    return post(ev, pdMS_TO_TICKS(timeout_ms));
+}
+
+void event_bus_stats(event_bus_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+    out->stack_free_min = task ? uxTaskGetStackHighWaterMark(task) : 0;
+}
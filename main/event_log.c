@@ -0,0 +1,385 @@
+#include "event_log.h"
+#include "crc16.h"
+#include "record_codec.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include <string.h>
+#include <stdbool.h>
+
+// Layout: the partition is a ring of sectors, each a header followed by entries
+// programmed back to back, one per record, so a pill event costs a few bytes and
+// not a block. Entries are self-delimiting and carry their own check byte; erased
+// flash (0xFF) ends the sector. Sector headers locate the write head sector, and
+// only that sector is scanned on mount. Sectors are reused round-robin (oldest
+// first), which spreads erases evenly.
+//
+// Entry: [tag][payload][check], check = low byte of the CRC-16 of tag and payload.
+//   tag = val << 4 | kind
+//   kind 1..6:  payload is varint(zigzag(ts_ms - previous ts_ms)) of `kind` bytes
+//   kind 0xE:   payload is [boot u16 LE][varint ts_ms]; starts each sector and boot
+//   tag 0x00:   one byte of padding over a torn entry, skipped
+#define EVENT_LOG_MAGIC 0x31474C45  // "ELG1"
+#define EVENT_LOG_MAX_SECTORS 32
+#define EVENT_LOG_ENTRY_PAD 0x00
+#define EVENT_LOG_ENTRY_ERASED 0xFF
+#define EVENT_LOG_KIND_BASE 0xE
+#define EVENT_LOG_DELTA_MAX 6       // varint bytes of a delta between RECORD_TS_BITS timestamps
+#define EVENT_LOG_ENTRY_MAX (1 + 2 + EVENT_LOG_DELTA_MAX + 1)
+// records kept in RAM while programming fails
+#define EVENT_LOG_PENDING_MAX 16
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t sector_seq;    // increases by one on every rotation
+    uint32_t first_seq;     // seq of the first record written to this sector
+    uint16_t crc;
+    uint16_t reserved;
+} sector_hdr_t;
+
+// walks the entries of one sector through a small read window
+typedef struct {
+    size_t sector;
+    size_t off;             // next entry, from the sector start
+    size_t end;
+    uint32_t seq;
+    bool based;             // a base entry has been seen: deltas can be decoded
+    uint16_t boot;
+    uint64_t ts_ms;
+    size_t win_off;
+    size_t win_len;
+    uint8_t win[64];
+} scan_t;
+
+static const char *TAG = "event_log";
+static event_log_flash_t fl;
+static SemaphoreHandle_t log_lock = NULL;
+static size_t n_sectors = 0;
+static bool sec_valid[EVENT_LOG_MAX_SECTORS];
+static uint32_t sec_seq[EVENT_LOG_MAX_SECTORS];
+static uint32_t sec_first[EVENT_LOG_MAX_SECTORS];
+static size_t head_sector = 0;
+static size_t head_off = 0;         // next byte to program in head_sector
+static bool head_based = false;     // the head sector has a base for deltas
+static uint16_t head_boot = 0;
+static uint64_t head_ts = 0;
+static uint32_t next_seq = 1;
+static record_t pending[EVENT_LOG_PENDING_MAX];
+static size_t pending_count = 0;
+
+static uint16_t sector_hdr_crc(const sector_hdr_t *h)
+{
+    return crc16_ccitt(CRC16_INIT, h, offsetof(sector_hdr_t, crc));
+}
+
+static uint8_t entry_check(const uint8_t *e, size_t len)
+{
+    return (uint8_t)crc16_ccitt(CRC16_INIT, e, len);
+}
+
+static void scan_begin(scan_t *s, size_t sector, size_t end)
+{
+    *s = (scan_t){ .sector = sector, .off = sizeof(sector_hdr_t), .end = end, .seq = sec_first[sector] };
+}
+
+// Returns false at erased flash, the end, or the first entry that does not check out.
+static bool scan_next(scan_t *s, record_t *out)
+{
+    while (s->off < s->end) {
+        size_t want = s->end - s->off < EVENT_LOG_ENTRY_MAX ? s->end - s->off : EVENT_LOG_ENTRY_MAX;
+        if (s->off < s->win_off || s->off + want > s->win_off + s->win_len) {
+            size_t len = s->end - s->off < sizeof(s->win) ? s->end - s->off : sizeof(s->win);
+            if (fl.read(fl.ctx, s->sector * fl.sector_size + s->off, s->win, len) != ESP_OK) return false;
+            s->win_off = s->off;
+            s->win_len = len;
+        }
+        const uint8_t *p = s->win + (s->off - s->win_off);
+        if (p[0] == EVENT_LOG_ENTRY_PAD) {
+            s->off++;
+            continue;
+        }
+        if (p[0] == EVENT_LOG_ENTRY_ERASED) return false;
+
+        uint8_t kind = p[0] & 0xF;
+        uint64_t v;
+        size_t len;
+        if (kind == EVENT_LOG_KIND_BASE) {
+            if (want < 4) return false;
+            size_t k = record_codec_varint_get(p + 3, want - 4, &v);
+            if (k == 0 || v >> RECORD_TS_BITS) return false;
+            len = 3 + k + 1;
+        } else if (kind >= 1 && kind <= EVENT_LOG_DELTA_MAX && s->based) {
+            len = 1 + kind + 1;
+            if (len > want || record_codec_varint_get(p + 1, kind, &v) != kind) return false;
+        } else {
+            return false;
+        }
+        if (p[len - 1] != entry_check(p, len - 1)) return false;
+
+        uint16_t boot = s->boot;
+        uint64_t ts = v;
+        if (kind == EVENT_LOG_KIND_BASE) {
+            boot = (uint16_t)(p[1] | (p[2] << 8));
+            if (boot > RECORD_BOOT_EPOCH) return false;
+        } else {
+            ts = (s->ts_ms + (uint64_t)record_codec_unzigzag(v)) & ((1ULL << RECORD_TS_BITS) - 1);
+        }
+        s->based = true;
+        s->boot = boot;
+        s->ts_ms = ts;
+        s->off += len;
+        out->seq = s->seq++;
+        out->ts_ms = ts;
+        out->boot = boot;
+        out->val = p[0] >> 4;
+        return true;
+    }
+    return false;
+}
+
+// A base entry where the head has none or the boot changes, else a delta. Returns the length.
+static size_t entry_encode(const record_t *r, uint8_t *e)
+{
+    size_t len;
+    if (!head_based || r->boot != head_boot) {
+        e[0] = (uint8_t)(r->val << 4 | EVENT_LOG_KIND_BASE);
+        e[1] = (uint8_t)r->boot;
+        e[2] = (uint8_t)(r->boot >> 8);
+        len = 3 + record_codec_varint_put(e + 3, EVENT_LOG_DELTA_MAX, r->ts_ms);
+    } else {
+        size_t k = record_codec_varint_put(e + 1, EVENT_LOG_DELTA_MAX,
+                                           record_codec_zigzag((int64_t)(r->ts_ms - head_ts)));
+        e[0] = (uint8_t)(r->val << 4 | k);
+        len = 1 + k;
+    }
+    e[len] = entry_check(e, len);
+    return len + 1;
+}
+
+// Program zeros over [from, to) of the head sector. Whatever a cut-short program
+// left there turns into padding, so the entries after it stay reachable.
+static esp_err_t pad(size_t from, size_t to)
+{
+    static const uint8_t zeros[EVENT_LOG_ENTRY_MAX];
+    while (from < to) {
+        size_t n = to - from < sizeof(zeros) ? to - from : sizeof(zeros);
+        esp_err_t err = fl.write(fl.ctx, head_sector * fl.sector_size + from, zeros, n);
+        if (err != ESP_OK) return err;
+        from += n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t sector_start(size_t sector, uint32_t seq, uint32_t first_seq)
+{
+    esp_err_t err = fl.erase_sector(fl.ctx, sector * fl.sector_size);
+    sec_valid[sector] = false;  // whatever it held is gone now
+    if (err != ESP_OK) return err;
+
+    sector_hdr_t h = {
+        .magic = EVENT_LOG_MAGIC,
+        .sector_seq = seq,
+        .first_seq = first_seq,
+        .reserved = 0xFFFF,
+    };
+    h.crc = sector_hdr_crc(&h);
+    err = fl.write(fl.ctx, sector * fl.sector_size, &h, sizeof(h));
+    if (err != ESP_OK) return err;
+
+    sec_valid[sector] = true;
+    sec_seq[sector] = seq;
+    sec_first[sector] = first_seq;
+    head_sector = sector;
+    head_off = sizeof(sector_hdr_t);
+    head_based = false;
+    return ESP_OK;
+}
+
+// offset after the last programmed byte of the head sector at or after `from`
+static size_t programmed_end(size_t from)
+{
+    uint8_t buf[64];
+    size_t end = from;
+    for (size_t off = from; off < fl.sector_size; off += sizeof(buf)) {
+        size_t n = fl.sector_size - off < sizeof(buf) ? fl.sector_size - off : sizeof(buf);
+        if (fl.read(fl.ctx, head_sector * fl.sector_size + off, buf, n) != ESP_OK) return fl.sector_size;
+        for (size_t i = 0; i < n; ++i) {
+            if (buf[i] != 0xFF) end = off + i + 1;
+        }
+    }
+    return end;
+}
+
+static esp_err_t recover(void)
+{
+    int best = -1;
+    for (size_t s = 0; s < n_sectors; ++s) {
+        sector_hdr_t h;
+        sec_valid[s] = false;
+        if (fl.read(fl.ctx, s * fl.sector_size, &h, sizeof(h)) != ESP_OK) continue;
+        if (h.magic != EVENT_LOG_MAGIC || h.crc != sector_hdr_crc(&h)) continue;
+        sec_valid[s] = true;
+        sec_seq[s] = h.sector_seq;
+        sec_first[s] = h.first_seq;
+        if (best < 0 || h.sector_seq > sec_seq[best]) best = (int)s;
+    }
+
+    if (best < 0) {
+        ESP_LOGI(TAG, "no valid sector, formatting");
+        next_seq = 1;
+        return sector_start(0, 1, next_seq);
+    }
+
+    // the head sector's entries up to the first one that does not check out
+    head_sector = (size_t)best;
+    scan_t s;
+    record_t r;
+    scan_begin(&s, head_sector, fl.sector_size);
+    while (scan_next(&s, &r)) {}
+    next_seq = s.seq;
+    head_based = s.based;
+    head_boot = s.boot;
+    head_ts = s.ts_ms;
+
+    // an entry torn by a power cut, head or tail first, was never acknowledged
+    head_off = programmed_end(s.off);
+    if (head_off > s.off) {
+        ESP_LOGW(TAG, "torn entry at %d:%d, padding %d bytes", (int)head_sector, (int)s.off, (int)(head_off - s.off));
+        if (pad(s.off, head_off) != ESP_OK) head_off = fl.sector_size;   // rotate before the next append
+    }
+    ESP_LOGI(TAG, "recovered: sector %d offset %d, next seq %lu",
+             (int)head_sector, (int)head_off, (unsigned long)next_seq);
+    return ESP_OK;
+}
+
+esp_err_t event_log_init(const event_log_flash_t *flash)
+{
+    if (!flash || !flash->read || !flash->write || !flash->erase_sector) return ESP_ERR_INVALID_ARG;
+    if (flash->sector_size < sizeof(sector_hdr_t) + 2 * EVENT_LOG_ENTRY_MAX) return ESP_ERR_INVALID_SIZE;
+    size_t sectors = flash->size / flash->sector_size;
+    if (sectors < 2) return ESP_ERR_INVALID_SIZE;
+    if (sectors > EVENT_LOG_MAX_SECTORS) sectors = EVENT_LOG_MAX_SECTORS;
+    if (log_lock) return ESP_ERR_INVALID_STATE;
+
+    log_lock = xSemaphoreCreateMutex();
+    if (!log_lock) return ESP_ERR_NO_MEM;
+    fl = *flash;
+    n_sectors = sectors;
+    pending_count = 0;
+    return recover();
+}
+
+// Program the entry of the first pending record. Caller holds log_lock.
+static esp_err_t write_entry_locked(void)
+{
+    if (head_off + EVENT_LOG_ENTRY_MAX > fl.sector_size) {
+        size_t next = (head_sector + 1) % n_sectors;
+        esp_err_t err = sector_start(next, sec_seq[head_sector] + 1, pending[0].seq);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "sector rotation failed: %s", esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    uint8_t e[EVENT_LOG_ENTRY_MAX];
+    size_t len = entry_encode(&pending[0], e);
+    esp_err_t err = fl.write(fl.ctx, head_sector * fl.sector_size + head_off, e, len);
+    if (err != ESP_OK) {
+        // a failed program may leave the entry half-written: pad it, or leave the sector
+        ESP_LOGE(TAG, "entry write failed: %s", esp_err_to_name(err));
+        head_off = pad(head_off, head_off + len) == ESP_OK ? head_off + len : fl.sector_size;
+        return err;
+    }
+    head_off += len;
+    head_based = true;
+    head_boot = pending[0].boot;
+    head_ts = pending[0].ts_ms;
+    pending_count--;
+    memmove(pending, pending + 1, pending_count * sizeof(record_t));
+    return ESP_OK;
+}
+
+static esp_err_t flush_locked(void)
+{
+    while (pending_count) {
+        esp_err_t err = write_entry_locked();
+        if (err != ESP_OK) return err;
+    }
+    return ESP_OK;
+}
+
+esp_err_t event_log_append(record_t *rec)
+{
+    if (!rec) return ESP_ERR_INVALID_ARG;
+    if (!log_lock) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    if (pending_count == EVENT_LOG_PENDING_MAX) err = flush_locked();
+    if (pending_count < EVENT_LOG_PENDING_MAX) {
+        rec->seq = next_seq++;
+        pending[pending_count++] = *rec;
+        err = flush_locked();
+    }
+    xSemaphoreGive(log_lock);
+    return err;
+}
+
+esp_err_t event_log_flush(void)
+{
+    if (!log_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    esp_err_t err = flush_locked();
+    xSemaphoreGive(log_lock);
+    return err;
+}
+
+size_t event_log_read(uint32_t from_seq, record_t *out, size_t max)
+{
+    if (!out || max == 0 || !log_lock) return 0;
+    size_t n = 0;
+    scan_t s;
+    record_t r;
+
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    // ring order starting after the head is oldest first
+    for (size_t k = 1; k <= n_sectors && n < max; ++k) {
+        size_t sec = (head_sector + k) % n_sectors;
+        if (!sec_valid[sec]) continue;
+        if (sec != head_sector) {
+            // skip whole sectors that end before from_seq
+            size_t nx = (sec + 1) % n_sectors;
+            if (sec_valid[nx] && sec_seq[nx] == sec_seq[sec] + 1 && sec_first[nx] <= from_seq) continue;
+        }
+        scan_begin(&s, sec, sec == head_sector ? head_off : fl.sector_size);
+        while (n < max && scan_next(&s, &r)) {
+            if (r.seq >= from_seq) out[n++] = r;
+        }
+    }
+    for (size_t i = 0; i < pending_count && n < max; ++i) {
+        if (pending[i].seq >= from_seq) out[n++] = pending[i];
+    }
+    xSemaphoreGive(log_lock);
+    return n;
+}
+
+uint32_t event_log_first_seq(void)
+{
+    uint32_t first = next_seq;
+    if (!log_lock) return first;
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    for (size_t k = 1; k <= n_sectors; ++k) {
+        size_t s = (head_sector + k) % n_sectors;
+        if (sec_valid[s]) {
+            first = sec_first[s];
+            break;
+        }
+    }
+    xSemaphoreGive(log_lock);
+    return first;
+}
+
+uint32_t event_log_next_seq(void)
+{
+    return next_seq;
+}
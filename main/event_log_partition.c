@@ -0,0 +1,32 @@
+#include "event_log.h"
+#include "esp_partition.h"
+
+static esp_err_t part_read(void *ctx, size_t off, void *dst, size_t len)
+{
+    return esp_partition_read((const esp_partition_t *)ctx, off, dst, len);
+}
+
+static esp_err_t part_write(void *ctx, size_t off, const void *src, size_t len)
+{
+    return esp_partition_write((const esp_partition_t *)ctx, off, src, len);
+}
+
+static esp_err_t part_erase_sector(void *ctx, size_t off)
+{
+    const esp_partition_t *p = ctx;
+    return esp_partition_erase_range(p, off, p->erase_size);
+}
+
+esp_err_t event_log_flash_partition(const char *label, event_log_flash_t *out)
+{
+    if (!label || !out) return ESP_ERR_INVALID_ARG;
+    const esp_partition_t *p = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!p) return ESP_ERR_NOT_FOUND;
+    out->ctx = (void *)p;
+    out->size = p->size;
+    out->sector_size = p->erase_size;
+    out->read = part_read;
+    out->write = part_write;
+    out->erase_sector = part_erase_sector;
+    return ESP_OK;
+}
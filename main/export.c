@@ -0,0 +1,162 @@
+#include "export.h"
+#include "record_codec.h"
+#include "crc16.h"
+#include <string.h>
+
+static void put_u16le(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static uint16_t get_u16le(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+esp_err_t export_init(export_t *x, const export_transport_t *tp, void *tp_ctx, export_read_fn read)
+{
+    if (!x || !tp || !tp->send || !tp->max_chunk || !read) return ESP_ERR_INVALID_ARG;
+    memset(x, 0, sizeof(*x));
+    x->tp = tp;
+    x->tp_ctx = tp_ctx;
+    x->read = read;
+    return ESP_OK;
+}
+
+esp_err_t export_start(export_t *x, uint32_t from_seq, uint32_t end_seq)
+{
+    if (!x || !x->read) return ESP_ERR_INVALID_STATE;
+    x->active = from_seq < end_seq;
+    x->xfer++;
+    x->chunk = 0;
+    x->acked = from_seq;
+    x->next = from_seq;
+    x->end = end_seq;
+    x->inflight = 0;
+    return ESP_OK;
+}
+
+static void rewind_to_ack(export_t *x)
+{
+    // chunk numbers are reused, so the receiver sees the resent chunks in order
+    x->stats.resent += x->inflight;
+    x->chunk -= (uint16_t)x->inflight;
+    x->next = x->acked;
+    x->inflight = 0;
+}
+
+void export_set_link(export_t *x, void *tp_ctx)
+{
+    if (x) x->tp_ctx = tp_ctx;
+}
+
+void export_ack(export_t *x, uint32_t next_seq, uint32_t now_ms)
+{
+    if (!x || !x->active || next_seq <= x->acked) return;
+    if (next_seq > x->end) next_seq = x->end;
+    x->acked = next_seq;
+    x->last_progress_ms = now_ms;
+    // drop the chunks fully covered by the ack
+    size_t k = 0;
+    while (k < x->inflight && x->inflight_end[k] <= next_seq) ++k;
+    memmove(x->inflight_end, x->inflight_end + k, (x->inflight - k) * sizeof(x->inflight_end[0]));
+    x->inflight -= k;
+    if (x->next < next_seq) x->next = next_seq;
+    if (x->acked >= x->end) x->active = false;
+}
+
+void export_stop(export_t *x)
+{
+    if (x) x->active = false;
+}
+
+bool export_done(const export_t *x)
+{
+    return !x || !x->active;
+}
+
+// build one chunk starting at x->next; *len = 0 when the log has nothing more
+static esp_err_t build_chunk(export_t *x, size_t cap, size_t *len, uint32_t *chunk_end)
+{
+    *len = 0;
+    if (cap > EXPORT_CHUNK_MAX) cap = EXPORT_CHUNK_MAX;
+    if (cap < EXPORT_OVERHEAD + RECORD_CODEC_HDR_MAX + 2) return ESP_ERR_INVALID_SIZE;
+    size_t want = x->end - x->next;
+    if (want > EXPORT_BATCH_RECORDS) want = EXPORT_BATCH_RECORDS;
+    size_t n = x->read(x->next, x->batch, want);
+    if (n == 0) return ESP_OK;
+    // records before batch[0] were overwritten in the log; the receiver sees the seq gap
+    if (x->batch[0].seq >= x->end) return ESP_OK;
+
+    size_t used;
+    size_t cnt = record_codec_encode(x->batch, n, x->frame + EXPORT_HDR_LEN, cap - EXPORT_OVERHEAD, &used);
+    if (cnt == 0) return ESP_ERR_INVALID_SIZE;
+    *chunk_end = x->batch[cnt - 1].seq + 1;
+
+    uint8_t *f = x->frame;
+    f[0] = EXPORT_MAGIC;
+    f[1] = *chunk_end >= x->end ? EXPORT_FLAG_LAST : 0;
+    put_u16le(f + 2, x->xfer);
+    put_u16le(f + 4, x->chunk);
+    put_u16le(f + 6, (uint16_t)used);
+    put_u16le(f + EXPORT_HDR_LEN + used, crc16_ccitt(CRC16_INIT, f, EXPORT_HDR_LEN + used));
+    *len = EXPORT_OVERHEAD + used;
+    return ESP_OK;
+}
+
+esp_err_t export_pump(export_t *x, uint32_t now_ms)
+{
+    if (!x || !x->active) return ESP_ERR_NOT_FOUND;
+
+    if (x->inflight > 0 && now_ms - x->last_progress_ms >= EXPORT_ACK_TIMEOUT_MS) {
+        rewind_to_ack(x);
+    }
+    if (x->inflight == 0) x->last_progress_ms = now_ms;
+
+    while (x->inflight < EXPORT_WINDOW && x->next < x->end) {
+        size_t cap = x->tp->max_chunk(x->tp_ctx);
+        if (cap == 0) return ESP_ERR_INVALID_STATE;
+        uint32_t chunk_end;
+        size_t len;
+        esp_err_t err = build_chunk(x, cap, &len, &chunk_end);
+        if (err != ESP_OK) return err;
+        if (len == 0) {
+            // nothing left below end: finish once the chunks in flight are acked
+            x->end = x->next;
+            break;
+        }
+        err = x->tp->send(x->tp_ctx, x->frame, len);
+        if (err == ESP_ERR_NO_MEM) {
+            x->stats.busy++;
+            return ESP_OK;
+        }
+        if (err != ESP_OK) {
+            rewind_to_ack(x);
+            return err;
+        }
+        x->stats.chunks++;
+        x->stats.bytes += len;
+        x->chunk++;
+        x->inflight_end[x->inflight++] = chunk_end;
+        x->next = chunk_end;
+    }
+    if (x->inflight == 0 && x->next >= x->end) x->active = false;
+    return ESP_OK;
+}
+
+esp_err_t export_parse_chunk(const uint8_t *data, size_t len, export_chunk_t *out)
+{
+    if (!data || !out || len < EXPORT_OVERHEAD || data[0] != EXPORT_MAGIC) return ESP_ERR_INVALID_ARG;
+    size_t plen = get_u16le(data + 6);
+    if (EXPORT_OVERHEAD + plen != len) return ESP_ERR_INVALID_SIZE;
+    if (crc16_ccitt(CRC16_INIT, data, EXPORT_HDR_LEN + plen) != get_u16le(data + EXPORT_HDR_LEN + plen)) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    out->flags = data[1];
+    out->xfer = get_u16le(data + 2);
+    out->chunk = get_u16le(data + 4);
+    out->payload = data + EXPORT_HDR_LEN;
+    out->len = plen;
+    return ESP_OK;
+}
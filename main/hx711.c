@@ -1,69 +1,231 @@
 #include "hx711.h"
+#include "hx711_backend.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
+
+#define HX711_READY_TIMEOUT_US 20000
+// in IRQ mode the reader sleeps, so it can afford to wait a full 10 SPS period
+#define HX711_IRQ_TIMEOUT_MS 150
+// |factor| below this would overflow the integer part of the mg-per-count scale
+#define HX711_MIN_CAL_FACTOR 0.031f
 
 static gpio_num_t *dt_pins = NULL;
 static gpio_num_t *sck_pins = NULL;
 static int32_t *offsets = NULL;
-static float *cal_factors = NULL;
+static int64_t *scale_q32 = NULL;   // milligrams per count, Q32
+static float *cal_factors = NULL;   // counts per gram, for the float API
 static size_t hx_count = 0;
+static const hx711_backend_t *backend = NULL;
+static int gain_pulses = HX711_GAIN_A_128;
 static const char *TAG = "hx711_mod";
 
+// Data-ready interrupt mode: a falling edge on DOUT notifies the waiting reader.
+// The edge interrupt is only armed while a reader waits, since DOUT toggles while clocking.
+static bool ready_irq = false;
+static volatile TaskHandle_t ready_waiter = NULL;
+
+static inline int32_t hx711_sign_extend(uint32_t data)
+{
+    return (data & 0x800000) ? (int32_t)(data | 0xFF000000) : (int32_t)data;
+}
+
 esp_err_t hx711_init(const gpio_num_t *dt, const gpio_num_t *sck, size_t count)
 {
-    if (!dt || !sck || count == 0) return ESP_ERR_INVALID_ARG;
+    return hx711_init_with_backend(dt, sck, count, &hx711_backend_gpio);
+}
+
+esp_err_t hx711_init_with_backend(const gpio_num_t *dt, const gpio_num_t *sck, size_t count,
+                                  const hx711_backend_t *be)
+{
+    if (!dt || !sck || !be || count == 0 || count > HX711_MAX_SENSORS) return ESP_ERR_INVALID_ARG;
     if (dt_pins) return ESP_ERR_INVALID_STATE;
 
     dt_pins = malloc(sizeof(gpio_num_t) * count);
     sck_pins = malloc(sizeof(gpio_num_t) * count);
     offsets = malloc(sizeof(int32_t) * count);
+    scale_q32 = malloc(sizeof(int64_t) * count);
     cal_factors = malloc(sizeof(float) * count);
-    if (!dt_pins || !sck_pins || !offsets || !cal_factors) return ESP_ERR_NO_MEM;
+    if (!dt_pins || !sck_pins || !offsets || !scale_q32 || !cal_factors) return ESP_ERR_NO_MEM;
 
     for (size_t i = 0; i < count; ++i) {
         dt_pins[i] = dt[i];
         sck_pins[i] = sck[i];
         offsets[i] = 0;
+        scale_q32[i] = 1000LL << 32;   // factor 1.0
         cal_factors[i] = 1.0f;
-        gpio_set_direction(dt_pins[i], GPIO_MODE_INPUT);
-        gpio_set_direction(sck_pins[i], GPIO_MODE_OUTPUT);
-        gpio_set_level(sck_pins[i], 0);
     }
+    esp_err_t err = be->init(dt_pins, sck_pins, count);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "backend %s init failed: %s", be->name, esp_err_to_name(err));
+        return err;
+    }
+    backend = be;
     hx_count = count;
-    ESP_LOGI(TAG, "HX711 module initialized (%d sensors)", (int)count);
+    ESP_LOGI(TAG, "HX711 module initialized (%d sensors, %s backend)", (int)count, be->name);
     return ESP_OK;
 }
 
-static int32_t hx711_read_raw_pin(gpio_num_t dt_pin, gpio_num_t sck_pin)
+// Not IRAM_ATTR: gpio_intr_disable() lives in flash unless CONFIG_GPIO_CTRL_FUNC_IN_IRAM is set
+static void hx711_ready_isr(void *arg)
+{
+    TRACE_ISR_ENTER(TRACE_ISR_HX711_READY);
+    gpio_num_t pin = (gpio_num_t)(uintptr_t)arg;
+    gpio_intr_disable(pin);
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    TaskHandle_t waiter = ready_waiter;
+    if (waiter) vTaskNotifyGiveFromISR(waiter, &xHigherPriorityTaskWoken);
+    TRACE_ISR_EXIT(TRACE_ISR_HX711_READY);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+// Sleep until DOUT of channel idx falls. Returns false on timeout.
+static bool hx711_wait_ready_irq(size_t idx)
 {
-    // wait for ready (DOUT low) with short timeout
-    TickType_t start = xTaskGetTickCount();
-    while (gpio_get_level(dt_pin) == 1) {
-        if ((xTaskGetTickCount() - start) > pdMS_TO_TICKS(20)) return 0x7FFFFFFF;
+    gpio_num_t dt_pin = dt_pins[idx];
+    ready_waiter = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0);  // drop a stale notification
+    gpio_intr_enable(dt_pin);
+    // the edge may have happened before the interrupt was armed
+    if (gpio_get_level(dt_pin) == 1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(HX711_IRQ_TIMEOUT_MS));
     }
+    gpio_intr_disable(dt_pin);
+    ready_waiter = NULL;
+    return gpio_get_level(dt_pin) == 0;
+}
 
-    uint32_t data = 0;
-    for (int i = 0; i < 24; ++i) {
-        gpio_set_level(sck_pin, 1);
-        gpio_set_level(sck_pin, 0);
-        data <<= 1;
-        if (gpio_get_level(dt_pin)) data |= 1;
+// Wait until every channel in `mask` is ready or the timeout expires; returns the ready subset.
+static uint32_t hx711_wait_ready(uint32_t mask)
+{
+    uint32_t ready = backend->ready() & mask;
+    if (ready == mask) {
+        // the common case reads no clock
+        metrics_observe(METRIC_HX711_READY_US, 0);
+        return ready;
     }
-    // one extra pulse to set gain/channel
-    gpio_set_level(sck_pin, 1);
-    gpio_set_level(sck_pin, 0);
 
-    return (data & 0x800000) ? (int32_t)(data | 0xFF000000) : (int32_t)data;
+    TRACE_BEGIN(TRACE_SPAN_HX711_WAIT);
+    int64_t start = esp_timer_get_time();
+    if (ready_irq) {
+        for (size_t i = 0; i < hx_count; ++i) {
+            if ((mask & ~ready) & (1UL << i)) hx711_wait_ready_irq(i);
+        }
+        ready = backend->ready() & mask;
+    } else {
+        while (ready != mask && (esp_timer_get_time() - start) < HX711_READY_TIMEOUT_US) {
+            ready = backend->ready() & mask;
+        }
+    }
+    metrics_observe(METRIC_HX711_READY_US, (uint32_t)(esp_timer_get_time() - start));
+    TRACE_END(TRACE_SPAN_HX711_WAIT);
+    return ready;
+}
+
+esp_err_t hx711_set_ready_irq(bool enable)
+{
+    if (hx_count == 0) return ESP_ERR_INVALID_STATE;
+    if (enable == ready_irq) return ESP_OK;
+    if (enable && !backend->has_ready_irq) return ESP_ERR_NOT_SUPPORTED;
+
+    if (enable) {
+        esp_err_t err = gpio_install_isr_service(0);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return err;  // already installed by button module
+        for (size_t i = 0; i < hx_count; ++i) {
+            gpio_set_intr_type(dt_pins[i], GPIO_INTR_NEGEDGE);
+            gpio_intr_disable(dt_pins[i]);
+            err = gpio_isr_handler_add(dt_pins[i], hx711_ready_isr, (void *)(uintptr_t)dt_pins[i]);
+            if (err != ESP_OK) {
+                for (size_t j = 0; j < i; ++j) gpio_isr_handler_remove(dt_pins[j]);
+                return err;
+            }
+        }
+    } else {
+        for (size_t i = 0; i < hx_count; ++i) {
+            gpio_isr_handler_remove(dt_pins[i]);
+            gpio_set_intr_type(dt_pins[i], GPIO_INTR_DISABLE);
+        }
+    }
+    ready_irq = enable;
+    ESP_LOGI(TAG, "data-ready IRQ mode %s", enable ? "enabled" : "disabled");
+    return ESP_OK;
+}
+
+esp_err_t hx711_set_gain(hx711_gain_t gain)
+{
+    if (gain != HX711_GAIN_A_128 && gain != HX711_GAIN_B_32 && gain != HX711_GAIN_A_64) return ESP_ERR_INVALID_ARG;
+    gain_pulses = gain;
+    return ESP_OK;
 }
 
 int32_t hx711_read_raw(size_t idx)
 {
     if (idx >= hx_count) return 0x7FFFFFFE;
-    return hx711_read_raw_pin(dt_pins[idx], sck_pins[idx]);
+    uint32_t bit = 1UL << idx;
+    uint32_t data[HX711_MAX_SENSORS];
+    esp_err_t err = ESP_ERR_TIMEOUT;
+    if (hx711_wait_ready(bit)) {
+        TRACE_BEGIN(TRACE_SPAN_HX711_READ);
+        err = backend->read(bit, gain_pulses, data);
+        TRACE_END(TRACE_SPAN_HX711_READ);
+    }
+    if (err != ESP_OK) {
+        metrics_inc(METRIC_HX711_TIMEOUTS);
+        return HX711_RAW_INVALID;
+    }
+    return hx711_sign_extend(data[idx]);
+}
+
+esp_err_t hx711_read_frame(int32_t *out)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+    if (hx_count == 0) return ESP_ERR_INVALID_STATE;
+
+    // channels still converting at the deadline are skipped
+    uint32_t all = (1UL << hx_count) - 1;
+    uint32_t ready = hx711_wait_ready(all);
+
+    uint32_t data[HX711_MAX_SENSORS];
+    if (ready) {
+        TRACE_BEGIN(TRACE_SPAN_HX711_READ);
+        if (backend->read(ready, gain_pulses, data) != ESP_OK) ready = 0;
+        TRACE_END(TRACE_SPAN_HX711_READ);
+    }
+    metrics_inc(METRIC_HX711_FRAMES);
+
+    esp_err_t err = ESP_OK;
+    for (size_t i = 0; i < hx_count; ++i) {
+        if (ready & (1UL << i)) {
+            out[i] = hx711_sign_extend(data[i]);
+        } else {
+            out[i] = HX711_RAW_INVALID;
+            metrics_inc(METRIC_HX711_TIMEOUTS);
+            err = ESP_ERR_TIMEOUT;
+        }
+    }
+    return err;
+}
+
+esp_err_t hx711_power_down(void)
+{
+    if (hx_count == 0) return ESP_ERR_INVALID_STATE;
+    backend->power(false);
+    return ESP_OK;
+}
+
+esp_err_t hx711_power_up(void)
+{
+    if (hx_count == 0) return ESP_ERR_INVALID_STATE;
+    // the chip wakes on channel A, gain 128; the configured gain applies from the next read on
+    backend->power(true);
+    return ESP_OK;
 }
 
 esp_err_t hx711_tare(size_t idx, int samples)
@@ -73,7 +235,7 @@ esp_err_t hx711_tare(size_t idx, int samples)
     int got = 0;
     for (int i = 0; i < samples; ++i) {
         int32_t v = hx711_read_raw(idx);
-        if (v == 0x7FFFFFFF) continue;
+        if (v == HX711_RAW_INVALID) continue;
         sum += v;
         ++got;
         vTaskDelay(pdMS_TO_TICKS(5));
@@ -83,20 +245,79 @@ esp_err_t hx711_tare(size_t idx, int samples)
     return ESP_OK;
 }
 
+esp_err_t hx711_tare_all(int samples)
+{
+    if (samples <= 0 || hx_count == 0) return ESP_ERR_INVALID_ARG;
+    // all channels convert in parallel, so this takes as long as one hx711_tare()
+    int64_t sum[HX711_MAX_SENSORS] = { 0 };
+    int got[HX711_MAX_SENSORS] = { 0 };
+    int32_t raw[HX711_MAX_SENSORS];
+    for (int i = 0; i < samples; ++i) {
+        hx711_read_frame(raw);
+        for (size_t k = 0; k < hx_count; ++k) {
+            if (raw[k] == HX711_RAW_INVALID) continue;
+            sum[k] += raw[k];
+            ++got[k];
+        }
+    }
+    esp_err_t ret = ESP_OK;
+    for (size_t k = 0; k < hx_count; ++k) {
+        if (got[k]) offsets[k] = (int32_t)(sum[k] / got[k]);
+        else ret = ESP_FAIL;
+    }
+    return ret;
+}
+
 esp_err_t hx711_set_calibration(size_t idx, float factor)
 {
-    if (idx >= hx_count || factor == 0.0f) return ESP_ERR_INVALID_ARG;
+    if (idx >= hx_count) return ESP_ERR_INVALID_ARG;
+    if (factor < HX711_MIN_CAL_FACTOR && factor > -HX711_MIN_CAL_FACTOR) return ESP_ERR_INVALID_ARG;
+    // the only division: done once here, conversions then multiply and shift
+    double scale = 1000.0 * 4294967296.0 / (double)factor;
+    scale_q32[idx] = (int64_t)(scale < 0 ? scale - 0.5 : scale + 0.5);
     cal_factors[idx] = factor;
     return ESP_OK;
 }
 
+// Two 32x32 multiplies: the Q16 part of the scale, plus its next 16 fraction
+// bits so the rounding error stays far below a count over the full 24-bit range.
+// Small factors reach past int32 mg (0.031 counts/g: ~2.7e11 mg at the rail).
+static inline int32_t hx711_mg(size_t idx, int32_t raw)
+{
+    int64_t net = (int64_t)raw - offsets[idx];
+    int64_t hi = scale_q32[idx] >> 16;
+    int64_t lo = scale_q32[idx] & 0xFFFF;
+    int64_t mg = (net * hi + ((net * lo) >> 16) + (1 << 15)) >> 16;
+    if (mg > HX711_MG_MAX) return HX711_MG_MAX;
+    if (mg < HX711_MG_MIN) return HX711_MG_MIN;
+    return (int32_t)mg;
+}
+
+int32_t hx711_raw_to_mg(size_t idx, int32_t raw)
+{
+    if (idx >= hx_count || raw == HX711_RAW_INVALID) return HX711_MG_INVALID;
+    return hx711_mg(idx, raw);
+}
+
+esp_err_t hx711_frame_to_mg(const int32_t *raw, int32_t *mg, size_t count)
+{
+    if (!raw || !mg || count > hx_count) return ESP_ERR_INVALID_ARG;
+    for (size_t i = 0; i < count; ++i) {
+        mg[i] = (raw[i] == HX711_RAW_INVALID) ? HX711_MG_INVALID : hx711_mg(i, raw[i]);
+    }
+    return ESP_OK;
+}
+
+float hx711_raw_to_weight(size_t idx, int32_t raw)
+{
+    if (idx >= hx_count || raw == HX711_RAW_INVALID) return 0.0f;
+    return (float)(raw - offsets[idx]) / cal_factors[idx];
+}
+
 float hx711_get_weight(size_t idx)
 {
     if (idx >= hx_count) return 0.0f;
-    int32_t raw = hx711_read_raw(idx);
-    if (raw == 0x7FFFFFFF) return 0.0f;
-    int32_t net = raw - offsets[idx];
-    return (float)net / cal_factors[idx];
+    return hx711_raw_to_weight(idx, hx711_read_raw(idx));
 }
 
 size_t hx711_count(void)
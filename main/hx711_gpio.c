@@ -0,0 +1,124 @@
+#include "hx711_backend.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_rom_sys.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+static gpio_num_t dt_pins[HX711_MAX_SENSORS];
+static gpio_num_t sck_pins[HX711_MAX_SENSORS];
+static size_t pin_count = 0;
+
+// Lock-step frame reads drive every SCK through one W1TS/W1TC write and sample
+// every DT through one GPIO_IN read. Only possible when all pins are in bank 0.
+static bool frame_capable = false;
+static portMUX_TYPE gpio_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_err_t gpio_backend_init(const gpio_num_t *dt, const gpio_num_t *sck, size_t count)
+{
+    frame_capable = true;
+    for (size_t i = 0; i < count; ++i) {
+        dt_pins[i] = dt[i];
+        sck_pins[i] = sck[i];
+        gpio_set_direction(dt_pins[i], GPIO_MODE_INPUT);
+        gpio_set_direction(sck_pins[i], GPIO_MODE_OUTPUT);
+        gpio_set_level(sck_pins[i], 0);
+        if (dt_pins[i] >= 32 || sck_pins[i] >= 32) frame_capable = false;
+    }
+    pin_count = count;
+    return ESP_OK;
+}
+
+static void gpio_backend_deinit(void)
+{
+    pin_count = 0;
+}
+
+static uint32_t gpio_backend_ready(void)
+{
+    uint32_t ready = 0;
+    if (frame_capable) {
+        uint32_t in = REG_READ(GPIO_IN_REG);
+        for (size_t i = 0; i < pin_count; ++i) {
+            if (!(in & (1UL << dt_pins[i]))) ready |= (1UL << i);
+        }
+    } else {
+        for (size_t i = 0; i < pin_count; ++i) {
+            if (gpio_get_level(dt_pins[i]) == 0) ready |= (1UL << i);
+        }
+    }
+    return ready;
+}
+
+// SCK high > 60 us powers the chip down, so each burst runs with interrupts off (~55 us)
+static esp_err_t gpio_backend_read(uint32_t mask, int pulses, uint32_t *data)
+{
+    if (!frame_capable) {
+        for (size_t i = 0; i < pin_count; ++i) {
+            if (!(mask & (1UL << i))) continue;
+            uint32_t v = 0;
+            portENTER_CRITICAL(&gpio_spinlock);
+            for (int b = 0; b < pulses; ++b) {
+                gpio_set_level(sck_pins[i], 1);
+                gpio_set_level(sck_pins[i], 0);
+                if (b < HX711_DATA_BITS) v = (v << 1) | (gpio_get_level(dt_pins[i]) ? 1 : 0);
+            }
+            portEXIT_CRITICAL(&gpio_spinlock);
+            data[i] = v;
+        }
+        return ESP_OK;
+    }
+
+    uint32_t clk = 0;
+    for (size_t i = 0; i < pin_count; ++i) {
+        if (mask & (1UL << i)) clk |= (1UL << sck_pins[i]);
+    }
+    if (!clk) return ESP_OK;
+
+    uint32_t planes[HX711_DATA_BITS];
+    portENTER_CRITICAL(&gpio_spinlock);
+    for (int b = 0; b < HX711_DATA_BITS; ++b) {
+        REG_WRITE(GPIO_OUT_W1TS_REG, clk);
+        esp_rom_delay_us(1);
+        REG_WRITE(GPIO_OUT_W1TC_REG, clk);
+        esp_rom_delay_us(1);
+        planes[b] = REG_READ(GPIO_IN_REG);
+    }
+    // extra pulses select gain/channel for the next conversion
+    for (int b = HX711_DATA_BITS; b < pulses; ++b) {
+        REG_WRITE(GPIO_OUT_W1TS_REG, clk);
+        esp_rom_delay_us(1);
+        REG_WRITE(GPIO_OUT_W1TC_REG, clk);
+        esp_rom_delay_us(1);
+    }
+    portEXIT_CRITICAL(&gpio_spinlock);
+
+    for (size_t i = 0; i < pin_count; ++i) {
+        if (!(mask & (1UL << i))) continue;
+        uint32_t v = 0;
+        for (int b = 0; b < HX711_DATA_BITS; ++b) {
+            v = (v << 1) | ((planes[b] >> dt_pins[i]) & 1);
+        }
+        data[i] = v;
+    }
+    return ESP_OK;
+}
+
+// SCK held high for more than 60 us puts the HX711 into power-down
+static void gpio_backend_power(bool on)
+{
+    for (size_t i = 0; i < pin_count; ++i) gpio_set_level(sck_pins[i], on ? 0 : 1);
+    if (!on) esp_rom_delay_us(80);
+}
+
+const hx711_backend_t hx711_backend_gpio = {
+    .name = "gpio",
+    .init = gpio_backend_init,
+    .deinit = gpio_backend_deinit,
+    .ready = gpio_backend_ready,
+    .read = gpio_backend_read,
+    .power = gpio_backend_power,
+    .has_ready_irq = true,
+};
@@ -0,0 +1,102 @@
+#include "hx711_backend.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Software HX711: holds one pending conversion per channel and models the
+// gain selected by the extra pulses of the previous read, 24-bit saturation
+// and the two's complement output word.
+typedef struct {
+    int32_t raw;        // input at gain 128, channel A
+    bool ready;
+    bool powered;
+    int next_pulses;    // pulses of the last read select the next conversion
+    uint32_t conversions;
+} sim_channel_t;
+
+static sim_channel_t sim[HX711_MAX_SENSORS];
+static size_t sim_count = 0;
+
+static esp_err_t sim_backend_init(const gpio_num_t *dt, const gpio_num_t *sck, size_t count)
+{
+    (void)dt;
+    (void)sck;
+    for (size_t i = 0; i < count; ++i) {
+        sim[i].raw = 0;
+        sim[i].ready = true;
+        sim[i].powered = true;
+        sim[i].next_pulses = 25;
+        sim[i].conversions = 0;
+    }
+    sim_count = count;
+    return ESP_OK;
+}
+
+static void sim_backend_deinit(void)
+{
+    sim_count = 0;
+}
+
+static uint32_t sim_backend_ready(void)
+{
+    uint32_t ready = 0;
+    for (size_t i = 0; i < sim_count; ++i) {
+        if (sim[i].ready && sim[i].powered) ready |= (1UL << i);
+    }
+    return ready;
+}
+
+static uint32_t sim_convert(const sim_channel_t *ch)
+{
+    int32_t v = ch->raw;
+    if (ch->next_pulses == 26) v /= 4;       // channel B, gain 32
+    else if (ch->next_pulses == 27) v /= 2;  // channel A, gain 64
+    if (v > 0x7FFFFF) v = 0x7FFFFF;
+    if (v < -0x800000) v = -0x800000;
+    return (uint32_t)v & 0xFFFFFF;
+}
+
+static esp_err_t sim_backend_read(uint32_t mask, int pulses, uint32_t *data)
+{
+    for (size_t i = 0; i < sim_count; ++i) {
+        if (!(mask & (1UL << i))) continue;
+        // clocking a channel that is not ready shifts out all ones
+        data[i] = (sim[i].ready && sim[i].powered) ? sim_convert(&sim[i]) : 0xFFFFFF;
+        sim[i].next_pulses = pulses;
+        sim[i].conversions++;
+    }
+    return ESP_OK;
+}
+
+// power-down resets the chip to channel A, gain 128
+static void sim_backend_power(bool on)
+{
+    for (size_t i = 0; i < sim_count; ++i) {
+        if (!on) sim[i].next_pulses = 25;
+        sim[i].powered = on;
+    }
+}
+
+void hx711_sim_set_raw(size_t idx, int32_t raw)
+{
+    if (idx < HX711_MAX_SENSORS) sim[idx].raw = raw;
+}
+
+void hx711_sim_set_ready(size_t idx, bool ready)
+{
+    if (idx < HX711_MAX_SENSORS) sim[idx].ready = ready;
+}
+
+uint32_t hx711_sim_conversions(size_t idx)
+{
+    return idx < HX711_MAX_SENSORS ? sim[idx].conversions : 0;
+}
+
+const hx711_backend_t hx711_backend_sim = {
+    .name = "sim",
+    .init = sim_backend_init,
+    .deinit = sim_backend_deinit,
+    .ready = sim_backend_ready,
+    .read = sim_backend_read,
+    .power = sim_backend_power,
+    .has_ready_irq = false,
+};
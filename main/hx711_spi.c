@@ -0,0 +1,153 @@
+#include "hx711_backend.h"
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include "esp_rom_gpio.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "soc/spi_periph.h"
+#include "soc/gpio_sig_map.h"
+#include <string.h>
+
+// The SPI host is not wired to fixed pins: before each transfer the GPIO matrix
+// routes MOSI to the channel's SCK pad and the channel's DOUT pad to MISO.
+// Every SCK pulse is two SPI bits, '1' (SCK high) then '0' (SCK low). DOUT is
+// sampled in the middle of the low bit, so the timing comes from the peripheral
+// and cannot be stretched by preemption.
+#define HX711_SPI_HOST SPI2_HOST
+#define HX711_SPI_CLOCK_HZ 500000   // 2 us high + 2 us low per SCK pulse
+#define HX711_SPI_MAX_BYTES 8       // 27 pulses = 54 bits
+
+static const char *TAG = "hx711_spi";
+static gpio_num_t dt_pins[HX711_MAX_SENSORS];
+static gpio_num_t sck_pins[HX711_MAX_SENSORS];
+static size_t pin_count = 0;
+static spi_device_handle_t spi_dev = NULL;
+static uint8_t *tx_buf = NULL;
+static uint8_t *rx_buf = NULL;
+
+static void spi_backend_route(size_t idx, bool to_spi)
+{
+    if (to_spi) {
+        esp_rom_gpio_connect_out_signal(sck_pins[idx], spi_periph_signal[HX711_SPI_HOST].spid_out, false, false);
+        esp_rom_gpio_connect_in_signal(dt_pins[idx], spi_periph_signal[HX711_SPI_HOST].spiq_in, false);
+    } else {
+        esp_rom_gpio_connect_out_signal(sck_pins[idx], SIG_GPIO_OUT_IDX, false, false);
+        gpio_set_level(sck_pins[idx], 0);
+    }
+}
+
+static void spi_backend_deinit(void)
+{
+    if (spi_dev) {
+        spi_bus_remove_device(spi_dev);
+        spi_bus_free(HX711_SPI_HOST);
+        spi_dev = NULL;
+    }
+    if (tx_buf) { heap_caps_free(tx_buf); tx_buf = NULL; }
+    if (rx_buf) { heap_caps_free(rx_buf); rx_buf = NULL; }
+    pin_count = 0;
+}
+
+static esp_err_t spi_backend_init(const gpio_num_t *dt, const gpio_num_t *sck, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        dt_pins[i] = dt[i];
+        sck_pins[i] = sck[i];
+        gpio_set_direction(dt_pins[i], GPIO_MODE_INPUT);
+        gpio_set_direction(sck_pins[i], GPIO_MODE_OUTPUT);
+        gpio_set_level(sck_pins[i], 0);
+    }
+    pin_count = count;
+
+    tx_buf = heap_caps_malloc(HX711_SPI_MAX_BYTES, MALLOC_CAP_DMA);
+    rx_buf = heap_caps_malloc(HX711_SPI_MAX_BYTES, MALLOC_CAP_DMA);
+    if (!tx_buf || !rx_buf) {
+        spi_backend_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+    memset(tx_buf, 0xAA, HX711_SPI_MAX_BYTES);
+
+    spi_bus_config_t bus_cfg = {
+        .mosi_io_num = -1,
+        .miso_io_num = -1,
+        .sclk_io_num = -1,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = HX711_SPI_MAX_BYTES,
+    };
+    esp_err_t err = spi_bus_initialize(HX711_SPI_HOST, &bus_cfg, SPI_DMA_CH_AUTO);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "spi_bus_initialize failed: %s", esp_err_to_name(err));
+        spi_backend_deinit();
+        return err;
+    }
+    spi_device_interface_config_t dev_cfg = {
+        .clock_speed_hz = HX711_SPI_CLOCK_HZ,
+        .mode = 0,
+        .spics_io_num = -1,
+        .queue_size = 1,
+    };
+    err = spi_bus_add_device(HX711_SPI_HOST, &dev_cfg, &spi_dev);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "spi_bus_add_device failed: %s", esp_err_to_name(err));
+        spi_bus_free(HX711_SPI_HOST);
+        spi_backend_deinit();
+        return err;
+    }
+    return ESP_OK;
+}
+
+static uint32_t spi_backend_ready(void)
+{
+    uint32_t ready = 0;
+    for (size_t i = 0; i < pin_count; ++i) {
+        if (gpio_get_level(dt_pins[i]) == 0) ready |= (1UL << i);
+    }
+    return ready;
+}
+
+static esp_err_t spi_backend_read(uint32_t mask, int pulses, uint32_t *data)
+{
+    if (!spi_dev) return ESP_ERR_INVALID_STATE;
+    for (size_t i = 0; i < pin_count; ++i) {
+        if (!(mask & (1UL << i))) continue;
+
+        spi_transaction_t t = {
+            .length = (size_t)pulses * 2,
+            .rxlength = (size_t)pulses * 2,
+            .tx_buffer = tx_buf,
+            .rx_buffer = rx_buf,
+        };
+        spi_backend_route(i, true);
+        // the task blocks while DMA runs the burst
+        esp_err_t err = spi_device_transmit(spi_dev, &t);
+        spi_backend_route(i, false);
+        if (err != ESP_OK) return err;
+
+        uint32_t v = 0;
+        for (int b = 0; b < HX711_DATA_BITS; ++b) {
+            int bit = 2 * b + 1;
+            v = (v << 1) | ((rx_buf[bit / 8] >> (7 - bit % 8)) & 1);
+        }
+        data[i] = v;
+    }
+    return ESP_OK;
+}
+
+// between transfers SCK pads are plain GPIO outputs
+static void spi_backend_power(bool on)
+{
+    for (size_t i = 0; i < pin_count; ++i) gpio_set_level(sck_pins[i], on ? 0 : 1);
+    if (!on) esp_rom_delay_us(80);
+}
+
+const hx711_backend_t hx711_backend_spi = {
+    .name = "spi",
+    .init = spi_backend_init,
+    .deinit = spi_backend_deinit,
+    .ready = spi_backend_ready,
+    .read = spi_backend_read,
+    .power = spi_backend_power,
+    .has_ready_irq = true,
+};
@@ -1,8 +1,29 @@
 #pragma once
 #include "esp_err.h"
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "export.h"
 
-typedef size_t (*ble_read_cb_t)(uint8_t *buf, size_t maxlen);
+// data characteristic read: value for connection conn, appended to the response as is.
+// Must stay unchanged across Read Blob continuations of the same value.
+typedef const uint8_t *(*ble_read_cb_t)(uint16_t conn, uint16_t mtu, size_t *len);
+// control characteristic write
+typedef esp_err_t (*ble_write_cb_t)(uint16_t conn, const uint8_t *data, size_t len);
+// connection opened / closed
+typedef void (*ble_conn_cb_t)(uint16_t conn, bool connected);
 
-esp_err_t ble_init(ble_read_cb_t read_cb);
+esp_err_t ble_init(ble_read_cb_t read_cb, ble_write_cb_t write_cb, ble_conn_cb_t conn_cb);
 esp_err_t ble_start_advertising(void);
+
+// push an encoded record to clients subscribed to the event characteristic (0xA003)
+esp_err_t ble_notify_event(const uint8_t *data, size_t len);
+// filtered weight stream (0xA004): samples are batched up to the MTU and sent as notifications,
+// batches are dropped while the mbuf pool is low. Called from one task.
+bool ble_telemetry_active(void);
+esp_err_t ble_telemetry_push(uint32_t t_ms, const int32_t *mg, size_t channels);
+void ble_telemetry_flush(void);
+uint32_t ble_telemetry_dropped(void);
+
+// bulk export (0xA005, notify); ctx is the connection handle cast to void *
+extern const export_transport_t ble_export_transport;
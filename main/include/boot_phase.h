@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+
+// Boot milestones, µs since esp_timer start. Each is recorded once and traced.
+typedef enum {
+    BOOT_PHASE_APP_MAIN = 0,
+    BOOT_PHASE_NVS,
+    BOOT_PHASE_EVENT_LOG,
+    BOOT_PHASE_PERIPH,
+    BOOT_PHASE_BLE,
+    BOOT_PHASE_TASKS,
+    BOOT_PHASE_FIRST_SAMPLE,
+    BOOT_PHASE_TIME_SYNC,
+    BOOT_PHASE_COUNT,
+} boot_phase_t;
+
+void boot_phase_mark(boot_phase_t p);
+// 0 if not reached yet
+int64_t boot_phase_us(boot_phase_t p);
+// log all phases reached so far
+void boot_phase_report(void);
@@ -1,19 +1,45 @@
 #pragma once
 #include "driver/gpio.h"
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
 
+#define BUTTON_MAX 8
+
 typedef enum {
 	BUTTON_EVENT_PRESS = 0,
 	BUTTON_EVENT_RELEASE = 1,
 	BUTTON_EVENT_LONG_PRESS = 2,
+	BUTTON_EVENT_CLICK = 3,          // short press, reported once the double-click window has passed
+	BUTTON_EVENT_DOUBLE_CLICK = 4,
+	BUTTON_EVENT_CHORD = 5,          // index is the bitmask of the buttons held together
 } button_event_t;
 
+// Callbacks run in the esp_timer task: keep them short and non-blocking.
 typedef void (*button_cb_t)(size_t index, button_event_t event);
 
+// All times are measured from the first edge of a bounce burst, so debounce only
+// delays delivery and does not stretch the gesture windows.
+typedef struct {
+	uint16_t debounce_ms;      // quiet time after the last edge before the level is trusted
+	uint16_t double_click_ms;  // 0: CLICK right on release, no DOUBLE_CLICK
+	uint16_t chord_ms;         // presses this close together form a chord; 0 disables chords
+	uint32_t long_press_ms;    // 0 disables LONG_PRESS
+	bool active_low;
+} button_config_t;
+
+#define BUTTON_CONFIG_DEFAULT() { \
+	.debounce_ms = 20, .double_click_ms = 300, .chord_ms = 80, .long_press_ms = 5000, .active_low = true }
+
 // Initialize buttons. Default behavior (button_init) assumes active-low wiring (pressed = 0).
-// Use `button_init_ex` to specify `active_low = false` for active-high buttons.
-#include <stdbool.h>
+// Use `button_init_ex` to specify `active_low = false` for active-high buttons,
+// `button_init_cfg` to tune the gesture timings.
+esp_err_t button_init_cfg(const gpio_num_t *pins, size_t count, button_cb_t cb, const button_config_t *cfg);
 esp_err_t button_init_ex(const gpio_num_t *pins, size_t count, button_cb_t cb, bool active_low);
 esp_err_t button_init(const gpio_num_t *pins, size_t count, button_cb_t cb);
 esp_err_t button_deinit(void);
+
+// Edges that did not fit the ISR buffer. The button is marked instead, so its
+// burst restarts when the buffer is drained and the level is still read after debounce.
+uint32_t button_edges_dropped(void);
@@ -0,0 +1,36 @@
+#pragma once
+#include "record.h"
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Records carry (boot id, ms since that boot). Whenever wall time becomes known the
+// offset epoch - uptime is added to a small table, per boot and from the uptime it
+// was learned at. Export converts records lazily through the table; stored records
+// are never rewritten. Records taken before the first sync of a boot use that boot's
+// first offset, later corrections apply from the moment they were made.
+// A full table first collapses the current boot's corrections to its first and last
+// entry, and only then drops the oldest entry of an earlier boot.
+#define CLOCK_MAP_MAX_SEGS 32
+// corrections smaller than this do not add an entry (and a flash write)
+#define CLOCK_MAP_MIN_STEP_MS 1000
+
+// Persistence for the table and the boot counter. load sets *len to the bytes read
+// and returns ESP_ERR_NOT_FOUND on first use.
+typedef struct {
+    void *ctx;
+    esp_err_t (*load)(void *ctx, void *buf, size_t *len);
+    esp_err_t (*save)(void *ctx, const void *buf, size_t len);
+} clock_map_store_t;
+
+esp_err_t clock_map_store_nvs(const char *ns, clock_map_store_t *out);
+
+// Load the table and start a new boot id.
+esp_err_t clock_map_init(const clock_map_store_t *store);
+uint16_t clock_map_boot(void);
+// Wall time epoch_ms was valid at uptime mono_ms of the current boot.
+esp_err_t clock_map_sync(uint64_t mono_ms, uint64_t epoch_ms);
+bool clock_map_to_epoch(uint16_t boot, uint64_t mono_ms, uint64_t *epoch_ms);
+// Convert records in place to RECORD_BOOT_EPOCH where possible; returns how many were converted.
+size_t clock_map_rebase(record_t *recs, size_t n);
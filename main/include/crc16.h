@@ -0,0 +1,8 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define CRC16_INIT 0xFFFF
+
+// CRC-16/CCITT-FALSE (poly 0x1021); chain calls by passing the previous result
+uint16_t crc16_ccitt(uint16_t crc, const void *data, size_t len);
@@ -0,0 +1,83 @@
+#pragma once
+#include "record.h"
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Recurring dose windows per compartment. Pure logic on wall-clock milliseconds:
+// the caller passes `now`, serializes calls and arms one timer for
+// dose_sched_next(). Every slot has exactly one pending deadline (remind, late,
+// missed) in a min-heap, so advancing costs O(log n) per transition.
+//
+// Window of one occurrence, relative to the due time:
+//   [-early, 0)        taking counts as on time, no reminder yet
+//   [0, on_time)       reminder, taking counts as on time
+//   [on_time, +late)   late reminder, taking counts as late
+//   after that         missed, the slot moves to its next occurrence
+#define DOSE_SLOTS 16
+#define DOSE_MIN_MS 60000ULL
+
+// Control characteristic commands (written next to the SYNC_OP_* ones):
+//   [DOSE_OP_SET][slot][comp][days][minute:u16 LE][early][on_time][late]   days = 0 clears
+//   [DOSE_OP_TZ][offset_min:i16 LE]                                          local = UTC + offset
+#define DOSE_OP_SET 0x10
+#define DOSE_OP_TZ 0x11
+#define DOSE_OP_SET_LEN 9
+#define DOSE_OP_TZ_LEN 3
+
+typedef struct __attribute__((packed)) {
+    uint8_t comp;          // compartment, 0..RECORD_COMPARTMENT_MASK
+    uint8_t days;          // bit 0 = Monday .. bit 6 = Sunday; 0 = unused slot
+    uint16_t minute;       // due time, minutes after local midnight
+    uint8_t early_min;
+    uint8_t on_time_min;
+    uint8_t late_min;
+} dose_slot_t;
+
+typedef enum {
+    DOSE_ACT_REMIND = 0,   // window reached its due time
+    DOSE_ACT_LATE,         // on-time part over, not taken yet
+    DOSE_ACT_MISSED,       // window closed without a matching weight event
+} dose_act_type_t;
+
+typedef struct {
+    uint8_t type;          // dose_act_type_t
+    uint8_t comp;
+    uint8_t slot;
+    uint64_t due_ms;
+} dose_action_t;
+
+// Persistence for the slot table; same contract as clock_map_store_t.
+typedef struct {
+    void *ctx;
+    esp_err_t (*load)(void *ctx, void *buf, size_t *len);
+    esp_err_t (*save)(void *ctx, const void *buf, size_t len);
+} dose_sched_store_t;
+
+esp_err_t dose_sched_store_nvs(const char *ns, dose_sched_store_t *out);
+
+// Load the table (empty on first use). The engine stays idle until dose_sched_start;
+// table changes take effect at the next dose_sched_start. The due time of the last
+// closed occurrence of every slot is saved with the table when it closes.
+esp_err_t dose_sched_init(const dose_sched_store_t *store);
+esp_err_t dose_sched_set(size_t slot, const dose_slot_t *cfg);
+void dose_sched_set_tz(int16_t offset_min);
+int16_t dose_sched_tz(void);   // offset of the saved table
+esp_err_t dose_sched_save(void);
+// Parse a DOSE_OP_* command; ESP_ERR_NOT_SUPPORTED if data is not one. Saves on success.
+esp_err_t dose_sched_command(const uint8_t *data, size_t len);
+
+// (Re)build all deadlines for wall time now_ms, e.g. after time sync or a table change.
+// Windows already open are reported as REMIND / LATE actions. Occurrences closed
+// before (taken or missed) are not reopened.
+size_t dose_sched_start(uint64_t now_ms, dose_action_t *out, size_t max);
+// Process every deadline <= now_ms; returns the number of actions written. When the
+// result equals max, call again for the rest.
+size_t dose_sched_advance(uint64_t now_ms, dose_action_t *out, size_t max);
+// Earliest pending deadline; false when idle or nothing is scheduled.
+bool dose_sched_next(uint64_t *at_ms);
+// A dose left compartment comp at now_ms. Closes the earliest open window of that
+// compartment and returns RECORD_TYPE_ON_TIME / _LATE, or RECORD_TYPE_TAKEN when
+// no window is open.
+uint8_t dose_sched_taken(uint8_t comp, uint64_t now_ms);
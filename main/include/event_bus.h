@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Application event bus: producers post small typed events, one dispatcher task
+// delivers them to a const subscriber table. Queue, task stack and TCB are static.
+
+#define EVENT_BUS_DEPTH 16
+#define EVENT_BUS_STACK 3072
+#define EVENT_BUS_PRIO 5
+
+typedef enum {
+    APP_EV_BUTTON = 0,
+    APP_EV_PILL,
+    APP_EV_BLE_CONN,
+    APP_EV_TIME_SYNC,
+    APP_EV_DOSE,       // dose schedule deadline reached or table changed (no payload)
+    APP_EV_COUNT,
+} app_ev_type_t;
+
+#define APP_EV_BIT(t) (1u << (t))
+
+typedef struct {
+    uint8_t type;      // app_ev_type_t
+    uint32_t t_us;     // stamped by event_bus_post, used for dispatch latency
+    union {
+        struct { uint16_t index; uint8_t gesture; } button;   // button_event_t; index is a mask for CHORD
+        struct { uint8_t sensor; bool removed; uint8_t count; int32_t delta_mg; uint32_t moved_ms; } pill;   // moved_ms: uptime, ms
+        struct { uint16_t conn; bool up; } ble;
+        struct { uint8_t src; } time;                          // time_src_t
+    };
+} app_event_t;
+
+typedef struct {
+    uint32_t types;                            // APP_EV_BIT mask
+    void (*fn)(const app_event_t *ev);         // runs in the dispatcher task
+} event_sub_t;
+
+typedef struct {
+    uint32_t posted;
+    uint32_t dropped;          // queue full
+    uint32_t delivered;
+    uint16_t depth_max;        // queue high-water mark
+    uint32_t latency_max_us;   // post to start of delivery
+    uint64_t latency_sum_us;
+    uint32_t stack_free_min;   // dispatcher stack never used, bytes
+} event_bus_stats_t;
+
+// subs must stay valid for the lifetime of the bus (normally a static const table)
+esp_err_t event_bus_init(const event_sub_t *subs, size_t count);
+// Non-blocking; ESP_ERR_TIMEOUT when the queue is full, ESP_ERR_INVALID_STATE before init.
+esp_err_t event_bus_post(app_event_t *ev);
+// Waits up to timeout_ms for room in the queue, for events that must not be lost.
+// Task context only, never from a subscriber (the dispatcher would wait on itself).
+esp_err_t event_bus_post_wait(app_event_t *ev, uint32_t timeout_ms);
+void event_bus_stats(event_bus_stats_t *out);
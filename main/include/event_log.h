@@ -0,0 +1,35 @@
+#pragma once
+#include "record.h"
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Every append programs the record's own entry, a delta from the previous one with
+// its own check byte, right after it in the current sector before it returns, so a
+// reset never loses an acknowledged record. Records stay queued in RAM only when
+// programming failed.
+
+// Flash access used by the log. event_log_flash_partition() binds it to a data
+// partition; a file- or RAM-backed implementation can be supplied instead.
+typedef struct {
+    void *ctx;
+    size_t size;            // multiple of sector_size
+    size_t sector_size;
+    esp_err_t (*read)(void *ctx, size_t off, void *dst, size_t len);
+    esp_err_t (*write)(void *ctx, size_t off, const void *src, size_t len);
+    esp_err_t (*erase_sector)(void *ctx, size_t off);
+} event_log_flash_t;
+
+esp_err_t event_log_flash_partition(const char *label, event_log_flash_t *out);
+
+// Mount the log, recovering the write head after a power cut. Formats blank flash.
+esp_err_t event_log_init(const event_log_flash_t *flash);
+// Append a record and program it; its seq field is assigned here. On error the
+// record stays queued and is retried by the next append or flush.
+esp_err_t event_log_append(record_t *rec);
+// Retry queued records, if any.
+esp_err_t event_log_flush(void);
+// Copy up to `max` records with seq >= from_seq, oldest first. Includes unflushed records.
+size_t event_log_read(uint32_t from_seq, record_t *out, size_t max);
+uint32_t event_log_first_seq(void);
+uint32_t event_log_next_seq(void);
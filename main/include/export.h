@@ -0,0 +1,81 @@
+#pragma once
+#include "record.h"
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Bulk export of the record log over a byte-chunk transport.
+// Every chunk is self-contained and CRC-protected:
+//   [0xEC][flags][xfer:u16][chunk:u16][len:u16][payload: record_codec, len bytes][crc16:u16]
+// all little-endian, crc16_ccitt over everything before it. The receiver acknowledges
+// with the seq after the last record it stored; unacknowledged chunks are resent from
+// there (go-back-N, chunks are taken in order only), and a new transfer started at that seq resumes after a disconnect.
+#define EXPORT_MAGIC 0xEC
+#define EXPORT_FLAG_LAST 0x01  // last chunk of the transfer
+#define EXPORT_HDR_LEN 8
+#define EXPORT_OVERHEAD (EXPORT_HDR_LEN + 2)
+#define EXPORT_CHUNK_MAX 512
+#define EXPORT_WINDOW 4        // chunks in flight before waiting for an ack
+#define EXPORT_BATCH_RECORDS 128
+#define EXPORT_ACK_TIMEOUT_MS 3000
+
+typedef struct export_transport_t {
+    const char *name;
+    // largest chunk the link carries in one write, 0 when not connected
+    size_t (*max_chunk)(void *ctx);
+    // ESP_ERR_NO_MEM: link busy, the same chunk is offered again later;
+    // any other error: link lost, unacknowledged chunks are resent
+    esp_err_t (*send)(void *ctx, const uint8_t *data, size_t len);
+} export_transport_t;
+
+typedef size_t (*export_read_fn)(uint32_t from_seq, record_t *out, size_t max);
+
+typedef struct {
+    uint32_t chunks;
+    uint32_t bytes;
+    uint32_t resent;     // chunks sent again after a timeout or link loss
+    uint32_t busy;       // send attempts refused by back-pressure
+} export_stats_t;
+
+typedef struct {
+    const export_transport_t *tp;
+    void *tp_ctx;
+    export_read_fn read;
+    bool active;
+    uint16_t xfer;
+    uint16_t chunk;
+    uint32_t acked;      // receiver stored everything below
+    uint32_t next;       // first seq of the next chunk
+    uint32_t end;        // transfer covers seqs below this
+    uint32_t inflight_end[EXPORT_WINDOW];
+    size_t inflight;
+    uint32_t last_progress_ms;
+    export_stats_t stats;
+    record_t batch[EXPORT_BATCH_RECORDS];
+    uint8_t frame[EXPORT_CHUNK_MAX];
+} export_t;
+
+typedef struct {
+    uint8_t flags;
+    uint16_t xfer;
+    uint16_t chunk;
+    const uint8_t *payload;  // record_codec data
+    size_t len;
+} export_chunk_t;
+
+// Once per exporter: transfer ids and statistics run on across transfers.
+esp_err_t export_init(export_t *x, const export_transport_t *tp, void *tp_ctx, export_read_fn read);
+// Point the transport at another link (a new connection) for the next export_start().
+void export_set_link(export_t *x, void *tp_ctx);
+// Start a transfer of seqs from_seq .. current end of log. Restarting at the last acked seq resumes.
+esp_err_t export_start(export_t *x, uint32_t from_seq, uint32_t end_seq);
+// Send chunks while the window allows. ESP_OK: progress or waiting for acks;
+// ESP_ERR_NOT_FOUND: no active transfer.
+esp_err_t export_pump(export_t *x, uint32_t now_ms);
+void export_ack(export_t *x, uint32_t next_seq, uint32_t now_ms);
+void export_stop(export_t *x);
+bool export_done(const export_t *x);
+
+// Receiver side: validate framing and CRC.
+esp_err_t export_parse_chunk(const uint8_t *data, size_t len, export_chunk_t *out);
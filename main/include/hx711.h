@@ -2,10 +2,52 @@
 #include "driver/gpio.h"
 #include "esp_err.h"
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// returned by the read functions when DOUT never went low (conversion not ready)
+#define HX711_RAW_INVALID ((int32_t)0x7FFFFFFF)
+// weight of an invalid sample in the milligram API
+#define HX711_MG_INVALID INT32_MIN
+// conversions beyond the int32 range saturate here, clear of HX711_MG_INVALID
+#define HX711_MG_MAX (INT32_MAX - 1)
+#define HX711_MG_MIN (INT32_MIN + 1)
+
+// total SCK pulses per read; the extra ones select input and gain of the next conversion
+typedef enum {
+    HX711_GAIN_A_128 = 25,
+    HX711_GAIN_B_32 = 26,
+    HX711_GAIN_A_64 = 27,
+} hx711_gain_t;
+
+typedef struct hx711_backend_t hx711_backend_t;
 
 esp_err_t hx711_init(const gpio_num_t *dt_pins, const gpio_num_t *sck_pins, size_t count);
+// Same as hx711_init, with an explicit acquisition backend (see hx711_backend.h).
+esp_err_t hx711_init_with_backend(const gpio_num_t *dt_pins, const gpio_num_t *sck_pins, size_t count,
+                                  const hx711_backend_t *backend);
+esp_err_t hx711_set_gain(hx711_gain_t gain);
 int32_t hx711_read_raw(size_t idx);
+// Block on a DOUT falling-edge interrupt instead of busy-polling for data ready.
+// Reads must then come from a single task (the one that gets notified).
+esp_err_t hx711_set_ready_irq(bool enable);
+// Read one time-aligned sample from every sensor; `out` must hold hx711_count() values.
+// Channels that were not ready get HX711_RAW_INVALID and the call returns ESP_ERR_TIMEOUT.
+esp_err_t hx711_read_frame(int32_t *out);
+// Power-down holds SCK high. After power-up the first conversion needs ~400 ms to settle (10 SPS).
+esp_err_t hx711_power_down(void);
+esp_err_t hx711_power_up(void);
 esp_err_t hx711_tare(size_t idx, int samples);
+// tare every channel from `samples` frames; ESP_FAIL if a channel never answered
+esp_err_t hx711_tare_all(int samples);
+// factor = counts per gram
 esp_err_t hx711_set_calibration(size_t idx, float factor);
+// Integer conversion with a precomputed Q32 mg-per-count scale, saturating at HX711_MG_MIN/MAX
+int32_t hx711_raw_to_mg(size_t idx, int32_t raw);
+// Convert a frame (raw[i] from sensor i) to milligrams in one call
+esp_err_t hx711_frame_to_mg(const int32_t *raw, int32_t *mg, size_t count);
+// Float API in grams: (raw - offset) / factor, as before the milligram API;
+// agrees with it to within one count (or 1 mg, whichever is larger)
+float hx711_raw_to_weight(size_t idx, int32_t raw);
 float hx711_get_weight(size_t idx);
 size_t hx711_count(void);
@@ -0,0 +1,39 @@
+#pragma once
+#include "hx711.h"
+#include "driver/gpio.h"
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HX711_MAX_SENSORS 8
+#define HX711_DATA_BITS 24
+
+// Acquisition backend: generates the SCK pulses and captures DOUT bits.
+// Channel sets are bitmasks of sensor indices (bit i = sensor i).
+typedef struct hx711_backend_t {
+    const char *name;
+    esp_err_t (*init)(const gpio_num_t *dt, const gpio_num_t *sck, size_t count);
+    void (*deinit)(void);
+    // channels whose DOUT is low (conversion ready)
+    uint32_t (*ready)(void);
+    // clock `pulses` (25..27) SCK pulses on every channel in `mask`;
+    // the 24 data bits of channel i land in data[i]
+    esp_err_t (*read)(uint32_t mask, int pulses, uint32_t *data);
+    // hold SCK high (power down) or release it (power up) on all channels
+    void (*power)(bool on);
+    // DOUT is a real pad, so the data-ready edge interrupt can be used
+    bool has_ready_irq;
+} hx711_backend_t;
+
+// Bit-banged GPIO: lock-step register writes when all pins are in bank 0
+extern const hx711_backend_t hx711_backend_gpio;
+// SPI peripheral clocks SCK (via MOSI) and shifts in DOUT (via MISO) by DMA
+extern const hx711_backend_t hx711_backend_spi;
+// Software HX711 model, no hardware access
+extern const hx711_backend_t hx711_backend_sim;
+
+// Simulation backend controls. `raw` is the 24-bit conversion at gain 128 (channel A).
+void hx711_sim_set_raw(size_t idx, int32_t raw);
+void hx711_sim_set_ready(size_t idx, bool ready);
+uint32_t hx711_sim_conversions(size_t idx);
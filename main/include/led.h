@@ -3,9 +3,29 @@
 #include <stddef.h>
 #include "esp_err.h"
 
+#define LED_MAX 8
+#define LED_FX_TICK_MS 20
+
+// Patterns are phase-locked to the led_play() call. Blink patterns are driven
+// by one periodic timer that updates all LEDs with one masked write per GPIO
+// bank; BREATHE runs the pin from an LEDC channel.
+typedef enum {
+    LED_PATTERN_OFF = 0,
+    LED_PATTERN_ON,
+    LED_PATTERN_BLINK,          // 500 ms on / 500 ms off
+    LED_PATTERN_BLINK_FAST,     // 100 ms on / 100 ms off
+    LED_PATTERN_DOUBLE_BLINK,   // two 100 ms flashes per second
+    LED_PATTERN_BREATHE,        // 2 s PWM fade in and out
+    LED_PATTERN_COUNT,
+} led_pattern_t;
+
 esp_err_t led_init(const gpio_num_t *pins, size_t count);
+// Steady level; stops any pattern on that LED.
 esp_err_t led_set(size_t idx, int level);
 esp_err_t led_toggle(size_t idx);
 esp_err_t led_get_level(size_t idx, int *out_level);
+// Replaying the pattern that is already running keeps its phase.
+esp_err_t led_play(size_t idx, led_pattern_t pattern);
+esp_err_t led_stop(size_t idx);
 void led_dump(void);
 void led_set_active_low(bool active_low);
@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Runtime metrics: counters, gauges and fixed-bucket histograms in static storage,
+// updated with relaxed atomics from tasks and ISRs. metrics_encode() packs all of
+// them into one binary value, read over BLE (0xA006); tools/metrics_decode.py turns
+// it back into text and reads the names from the METRIC_* defines below.
+//
+// Wire format, little-endian:
+//   [version u8][count u8][uptime_ms u32], then per metric [id u8][kind u8] and
+//   counter: u32 | gauge: i32 | histogram: [base u32][buckets u8][count u32 x buckets]
+// Histogram bucket 0 holds values below base, bucket k values below base << k, the
+// last bucket everything above.
+#define METRICS_VERSION 1
+#define METRICS_HIST_BUCKETS 10
+#define METRICS_ENCODED_MAX 256
+
+#define METRIC_KIND_COUNTER 0
+#define METRIC_KIND_GAUGE 1
+#define METRIC_KIND_HISTOGRAM 2
+
+#define METRIC_HX711_FRAMES 0x00          // counter: frames read
+#define METRIC_HX711_TIMEOUTS 0x01        // counter: channels returned HX711_RAW_INVALID
+#define METRIC_HX711_READY_US 0x02        // histogram: data-ready wait of a read, us
+#define METRIC_SENSOR_PERIOD_MS 0x03      // histogram: sensor loop period, ms
+#define METRIC_BLE_CONNECTS 0x04          // counter
+#define METRIC_BLE_CONNS 0x05             // gauge: open connections
+#define METRIC_BLE_TLM_DROPPED 0x06       // counter: telemetry batches dropped (sampled)
+#define METRIC_BUS_DROPPED 0x07           // counter: events lost to a full bus queue (sampled)
+#define METRIC_BUS_DEPTH_MAX 0x08         // gauge: bus queue high-water mark (sampled)
+#define METRIC_BTN_EDGES_DROPPED 0x09     // counter: button edges lost before the engine (sampled)
+#define METRIC_HEAP_FREE_MIN 0x0A         // gauge: minimum free heap since boot, bytes (sampled)
+#define METRIC_STACK_FREE_SENSOR 0x0B     // gauge: sensor_task stack never used, bytes (sampled)
+#define METRIC_STACK_FREE_EXPORT 0x0C     // gauge: export_task stack never used, bytes (sampled)
+#define METRIC_STACK_FREE_BUS 0x0D        // gauge: event bus task stack never used, bytes (sampled)
+#define METRIC_SCHED_MODE 0x0E            // gauge: sample_mode_t of the sensor loop (sampled)
+#define METRIC_SCHED_BURSTS 0x0F          // counter: idle -> burst transitions (sampled)
+#define METRIC_SCHED_POWER_UPS 0x10       // counter: HX711 power-ups after an idle sleep (sampled)
+#define METRIC_SCHED_IDLE_S 0x11          // counter: seconds in idle mode, for the duty cycle (sampled)
+#define METRIC_SCHED_BURST_S 0x12         // counter: seconds in burst mode (sampled)
+#define METRIC_COUNT 0x13
+
+// Safe from tasks and ISRs. Calls with an id of the wrong kind are ignored.
+void metrics_inc(uint8_t id);
+void metrics_add(uint8_t id, int32_t delta);
+void metrics_set(uint8_t id, int32_t value);
+// gauge high-water mark: keeps the larger value
+void metrics_max(uint8_t id, int32_t value);
+void metrics_observe(uint8_t id, uint32_t value);
+int32_t metrics_get(uint8_t id);
+
+// Called at the start of every metrics_encode() to refresh the sampled metrics
+// (heap, stacks, other modules' statistics); may be NULL.
+void metrics_set_sampler(void (*fn)(void));
+// Returns the encoded length, 0 when it does not fit `len`.
+size_t metrics_encode(uint8_t *buf, size_t len);
+
+// Value of 0xA006 for one connection. The first read encodes it, every later read
+// returns the same bytes, so the Read Blob parts of a long read fit together even
+// when a read is abandoned halfway or the MTU changes in between. A write to 0xA006
+// (metrics_snap_refresh) or a new connection makes the next read encode again.
+typedef struct {
+    uint8_t buf[METRICS_ENCODED_MAX];
+    uint16_t len;
+    bool valid;
+} metrics_snap_t;
+
+const uint8_t *metrics_snap_read(metrics_snap_t *snap, size_t *len);
+void metrics_snap_refresh(metrics_snap_t *snap);
@@ -0,0 +1,54 @@
+#pragma once
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    PILL_DET_IDLE = 0,      // no stable reference yet
+    PILL_DET_STABLE,        // weight at reference, slow drift is tracked
+    PILL_DET_DISTURBED,     // weight left the reference band (lid pressed, hand in the box)
+    PILL_DET_SETTLING,      // samples agree again, waiting for enough of them
+} pill_det_state_t;
+
+typedef enum {
+    PILL_EVENT_REMOVED = 0,
+    PILL_EVENT_ADDED,
+} pill_event_type_t;
+
+typedef struct {
+    int32_t disturb_mg;         // |w - ref| above this starts a disturbance
+    int32_t settle_band_mg;     // samples within this of the window mean, and of each other, count as settled
+    uint8_t settle_samples;     // settled samples needed to accept a new level (4x for a heavier one)
+    int32_t min_change_mg;      // smaller settled changes are treated as drift
+    int32_t pill_mg;            // per-pill mass, 0 = learn it from the first removal
+} pill_detector_cfg_t;
+
+typedef struct {
+    pill_event_type_t type;
+    uint8_t count;              // number of pills, from the learned per-pill mass
+    int32_t delta_mg;           // settled weight change, positive
+    uint32_t disturbed_ms;      // when the weight first left the reference
+    uint32_t settled_ms;        // when the new level was accepted
+} pill_event_t;
+
+typedef struct {
+    pill_detector_cfg_t cfg;
+    pill_det_state_t state;
+    int32_t ref_mg;
+    int32_t pill_mg;
+    int64_t win_sum;
+    int32_t win_mean;
+    int32_t win_min;
+    int32_t win_max;
+    uint16_t win_count;
+    uint32_t disturbed_ms;
+} pill_detector_t;
+
+esp_err_t pill_detector_init(pill_detector_t *d, const pill_detector_cfg_t *cfg);
+// Feed one filtered weight sample taken at t_ms. Returns true and fills *ev
+// on the sample where a removal/addition settles.
+bool pill_detector_push(pill_detector_t *d, int32_t mg, uint32_t t_ms, pill_event_t *ev);
+int32_t pill_detector_pill_mg(const pill_detector_t *d);
+pill_det_state_t pill_detector_state(const pill_detector_t *d);
+// settled reference weight, valid once the state has left PILL_DET_IDLE
+int32_t pill_detector_ref_mg(const pill_detector_t *d);
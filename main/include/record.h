@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+
+// record_t.val: compartment in bits 0-1, event type in bits 2-3
+#define RECORD_COMPARTMENT_MASK 0x3
+#define RECORD_TYPE_SHIFT 2
+#define RECORD_TYPE_MASK (0x3 << RECORD_TYPE_SHIFT)
+#define RECORD_VAL_MASK (RECORD_COMPARTMENT_MASK | RECORD_TYPE_MASK)
+
+#define RECORD_TYPE_TAKEN 0      // no dose window open (or no schedule)
+#define RECORD_TYPE_ON_TIME 1    // matched a dose window in its on-time part
+#define RECORD_TYPE_LATE 2       // matched a dose window after its on-time part
+#define RECORD_TYPE_MISSED 3     // window closed without a dose; ts is the close time
+
+// record_t.boot: ts_ms is milliseconds since that boot (esp_timer), converted to
+// epoch on export through the clock_map offset table. Boot ids start at 1, 0 is
+// never assigned (the wire format spends it on RECORD_BOOT_EPOCH).
+#define RECORD_BOOT_EPOCH 0x7FFF   // already converted, ts_ms is epoch ms
+#define RECORD_BOOT_MAX 0x7FFE
+#define RECORD_TS_BITS 41          // ~69 years of ms, epoch ms fit until 2039
+
+// 12 bytes instead of 24 for a naturally aligned uint64_t + uint32_t + uint8_t
+typedef struct __attribute__((packed, aligned(4))) {
+    uint32_t seq;           // assigned by the event log, increases across reboots
+    uint64_t ts_ms : RECORD_TS_BITS;
+    uint64_t boot : 15;
+    uint64_t val : 8;
+} record_t;
@@ -0,0 +1,36 @@
+#pragma once
+#include "record.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Wire format (BLE export):
+//   [0xFE][version][varint base_seq][varint boot, 0 = RECORD_BOOT_EPOCH][body]
+// Body:
+//   [varint base_tick] then per record varint(zigzag(dticks) << 4 | val)
+// Timestamps are floor(ts_ms / tick_ms) on an absolute grid, so the error
+// stays below one tick and does not accumulate. Records are consecutive in seq
+// and share one boot id; the count is implied by the payload length.
+#define RECORD_CODEC_MAGIC 0xFE
+#define RECORD_CODEC_VERSION 1
+#define RECORD_CODEC_TICK_MS 1000
+#define RECORD_CODEC_HDR_MAX 10
+
+// Encode records[0..n) until the output is full, seq is not consecutive or boot changes.
+// Returns how many records were encoded; *used gets the byte count.
+size_t record_codec_encode_body(const record_t *recs, size_t n, uint32_t tick_ms,
+                                uint8_t *out, size_t cap, size_t *used);
+// Decode up to `max` records starting at first_seq. Returns records decoded; a
+// truncated final varint is dropped.
+size_t record_codec_decode_body(const uint8_t *in, size_t len, uint32_t first_seq, uint16_t boot,
+                                uint32_t tick_ms, record_t *out, size_t max);
+
+// LEB128 varints and zigzag for signed deltas, shared with the flash log's entries.
+// varint_put returns 0 when `cap` is too small, varint_get 0 on truncated input.
+size_t record_codec_varint_put(uint8_t *out, size_t cap, uint64_t v);
+size_t record_codec_varint_get(const uint8_t *in, size_t len, uint64_t *v);
+uint64_t record_codec_zigzag(int64_t v);
+int64_t record_codec_unzigzag(uint64_t v);
+
+size_t record_codec_encode(const record_t *recs, size_t n, uint8_t *out, size_t cap, size_t *used);
+// Returns the number of records, or -1 if the payload is not in this format.
+int record_codec_decode(const uint8_t *in, size_t len, record_t *out, size_t max);
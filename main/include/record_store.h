@@ -0,0 +1,21 @@
+#pragma once
+#include "record.h"
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// RAM copy of the newest records, in front of event_log so readers never wait for flash.
+// One producer pushes; any number of readers copy without locks. Each slot carries a
+// version (odd while being written) and the record's own seq, so a reader detects torn
+// or overwritten slots and stops there instead of blocking the producer.
+#define RECORD_STORE_CAPACITY 256  // power of two
+
+// next_seq: seq the first pushed record is expected to have
+void record_store_init(uint32_t next_seq);
+// Producer only. Records must come with increasing seq; a gap restarts the ring.
+esp_err_t record_store_push(const record_t *rec);
+// Copy up to `max` consecutive records starting at from_seq, oldest first. Returns 0 when
+// from_seq is older than the ring (read event_log instead) or nothing newer exists.
+size_t record_store_read(uint32_t from_seq, record_t *out, size_t max);
+uint32_t record_store_first_seq(void);
+uint32_t record_store_next_seq(void);
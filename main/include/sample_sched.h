@@ -0,0 +1,36 @@
+#pragma once
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    SAMPLE_MODE_IDLE = 0,   // one frame per idle period, converters powered down in between
+    SAMPLE_MODE_BURST,      // back-to-back frames at the converter rate
+} sample_mode_t;
+
+typedef struct {
+    uint32_t idle_period_ms;    // time between frames in idle mode
+    uint32_t wake_settle_ms;    // HX711 settling time after power-up
+    uint32_t burst_period_ms;   // extra delay between burst frames, 0 = full converter rate
+    uint32_t quiet_timeout_ms;  // burst falls back to idle after this long without change
+} sample_sched_cfg_t;
+
+typedef struct {
+    sample_mode_t mode;
+    uint32_t power_downs;
+    uint32_t power_ups;
+    uint32_t bursts;            // idle -> burst transitions
+    uint64_t idle_ms;           // time spent in each mode, for the duty cycle
+    uint64_t burst_ms;
+} sample_sched_stats_t;
+
+esp_err_t sample_sched_init(const sample_sched_cfg_t *cfg);
+// Called by the sampling task before each frame: in idle mode powers the
+// converters down, sleeps until the next idle frame or a kick, then powers up.
+void sample_sched_wait(void);
+// Called by the sampling task after each frame; `changed` keeps/enters burst mode.
+void sample_sched_report(bool changed);
+// Request burst mode from any task (button press, BLE connect).
+void sample_sched_kick(void);
+sample_mode_t sample_sched_mode(void);
+void sample_sched_get_stats(sample_sched_stats_t *out);
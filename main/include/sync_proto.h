@@ -0,0 +1,39 @@
+#pragma once
+#include "record.h"
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Incremental sync over the data (0xA001) and control (0xA002) characteristics.
+// Each connection has a cursor: reads return records with seq >= cursor, oldest
+// first, in the record_codec wire format (empty when up to date). Reads do not
+// move the cursor. The payload is encoded once into a per-connection snapshot;
+// a snapshot longer than one Read Response (MTU-1) stays pinned until the next
+// control write, so Read Blob continuations never mix old and new records.
+// Control writes:
+//   [SYNC_OP_FROM][seq:u32 LE]  restart from seq
+//   [SYNC_OP_ACK][seq:u32 LE]   client stored everything below seq; cursor moves there
+//   [SYNC_OP_EXPORT][seq:u32 LE] like FROM, and stream from seq as export chunks (0xA005)
+// The last acknowledged position is kept across connections (and reboots via on_ack).
+#define SYNC_OP_FROM 0x01
+#define SYNC_OP_ACK 0x02
+#define SYNC_OP_EXPORT 0x03
+#define SYNC_MAX_SESSIONS 4
+#define SYNC_PAYLOAD_MAX 512  // ATT attribute value limit
+
+typedef struct {
+    // copy up to max records with seq >= from_seq, oldest first
+    size_t (*read)(uint32_t from_seq, record_t *out, size_t max);
+    // persist the acknowledged position; may be NULL
+    void (*on_ack)(uint32_t next_seq);
+} sync_store_t;
+
+esp_err_t sync_proto_init(const sync_store_t *store, uint32_t acked);
+esp_err_t sync_proto_open(uint16_t conn);
+void sync_proto_close(uint16_t conn);
+esp_err_t sync_proto_write(uint16_t conn, const uint8_t *data, size_t len);
+// payload for conn, valid until the next call; mtu is the connection's ATT_MTU
+const uint8_t *sync_proto_read(uint16_t conn, uint16_t mtu, size_t *len);
+uint32_t sync_proto_cursor(uint16_t conn);
+uint32_t sync_proto_acked(void);
@@ -0,0 +1,31 @@
+#pragma once
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Wall-clock state. Time arrives in the background (SNTP, or the phone writing the
+// Current Time characteristic); nothing waits for it.
+typedef enum {
+    TIME_SRC_NONE = 0,
+    TIME_SRC_SNTP = 1,
+    TIME_SRC_BLE = 2,
+} time_src_t;
+
+#define TIME_CTS_LEN 10  // Current Time characteristic (0x2A2B) value
+
+// Set the system clock and mark it valid.
+esp_err_t time_sync_set(uint64_t epoch_ms, time_src_t src);
+// The clock was already set by someone else (SNTP callback).
+void time_sync_note(time_src_t src);
+bool time_sync_valid(void);
+time_src_t time_sync_source(void);
+uint64_t time_sync_epoch_ms(void);
+// Local offset from UTC in minutes (DOSE_OP_TZ). If the clock came from a CTS
+// write converted with another offset, it is corrected by the difference.
+void time_sync_set_tz(int16_t offset_min);
+
+// Current Time characteristic: exact time 256 + adjust reason, local time per
+// time_sync_set_tz. Dates that do not exist (31 February) are rejected.
+esp_err_t time_sync_from_cts(const uint8_t *data, size_t len);
+size_t time_sync_to_cts(uint8_t *out, size_t cap);
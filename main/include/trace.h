@@ -0,0 +1,132 @@
+#pragma once
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Binary trace: fixed 16-byte records (event id, µs timestamp, two int32 args) in a RAM
+// ring, no formatting on the device. trace_dump() prints the ring as hex lines that
+// tools/trace_decode.py turns back into text or a Chrome/Perfetto timeline. Ids are
+// category << 8 | event; the decoder reads the names from the TRACE_* defines below.
+
+// Timeline: task switches (FreeRTOS trace hook, see trace_hooks.h), ISR entry/exit and
+// begin/end spans. Off by default, it fills the ring within seconds; enable with
+// idf.py -DTRACE_TIMELINE=1 build, which also enlarges the ring.
+#ifndef TRACE_TIMELINE
+#define TRACE_TIMELINE 0
+#endif
+
+#ifndef TRACE_RING_LEN
+#define TRACE_RING_LEN (TRACE_TIMELINE ? 2048 : 256)  // power of two
+#endif
+
+#define TRACE_CAT_SYS 0x01
+#define TRACE_CAT_SENSOR 0x02
+#define TRACE_CAT_LED 0x03
+#define TRACE_CAT_BUTTON 0x04
+#define TRACE_CAT_SCHED 0x05
+#define TRACE_CAT_BLE 0x06
+#define TRACE_CAT_TIMELINE 0x07
+
+// Categories compiled in; trace points of other categories compile to nothing.
+// Override with -DTRACE_ENABLED_MASK=... (0 removes tracing entirely).
+#ifndef TRACE_ENABLED_MASK
+#define TRACE_ENABLED_MASK ((1u << TRACE_CAT_SYS) | (1u << TRACE_CAT_SENSOR) | (1u << TRACE_CAT_LED) | \
+                            (1u << TRACE_CAT_BUTTON) | (1u << TRACE_CAT_SCHED) | (1u << TRACE_CAT_BLE) | \
+                            (TRACE_TIMELINE ? (1u << TRACE_CAT_TIMELINE) : 0))
+#endif
+
+#define TRACE_EV_BOOT 0x0101              // a0 = reset reason
+#define TRACE_EV_BOOT_PHASE 0x0102        // a0 = boot_phase_t, a1 = ms since start
+#define TRACE_EV_TIME_SYNC 0x0103         // a0 = time_src_t
+#define TRACE_EV_BUS_EVENT 0x0104         // a0 = app_ev_type_t, a1 = post-to-dispatch us
+#define TRACE_EV_BUS_DROP 0x0105          // a0 = app_ev_type_t, a1 = dropped so far
+#define TRACE_EV_SENSOR_MG 0x0201         // a0 = sensor, a1 = filtered mg
+#define TRACE_EV_SENSOR_TIMEOUT 0x0202    // a0 = mask of timed-out sensors
+#define TRACE_EV_PILL_REMOVED 0x0203      // a0 = sensor, a1 = delta mg
+#define TRACE_EV_PILL_ADDED 0x0204        // a0 = sensor, a1 = delta mg
+#define TRACE_EV_LED_SET 0x0301           // a0 = led, a1 = physical level
+#define TRACE_EV_LED_PLAY 0x0302          // a0 = led, a1 = led_pattern_t
+#define TRACE_EV_BTN_PRESS 0x0401         // a0 = button, a1 = edge-to-callback us
+#define TRACE_EV_BTN_RELEASE 0x0402       // a0 = button, a1 = edge-to-callback us
+#define TRACE_EV_BTN_LONG 0x0403          // a0 = button
+#define TRACE_EV_BTN_CLICK 0x0404         // a0 = button, a1 = 1 click / 2 double click
+#define TRACE_EV_BTN_CHORD 0x0405         // a0 = mask of buttons
+#define TRACE_EV_SCHED_MODE 0x0501        // a0 = sample_mode_t
+#define TRACE_EV_BLE_CONN 0x0601          // a0 = conn handle, a1 = 1 connect / 0 disconnect
+#define TRACE_EV_BLE_TLM_DROP 0x0602      // a0 = dropped batches so far
+#define TRACE_EV_TASK_IN 0x0701           // a0 = task handle, a1 = core
+#define TRACE_EV_ISR_ENTER 0x0702         // a0 = TRACE_ISR_*, a1 = core
+#define TRACE_EV_ISR_EXIT 0x0703          // a0 = TRACE_ISR_*, a1 = core
+#define TRACE_EV_SPAN_BEGIN 0x0704        // a0 = TRACE_SPAN_*, a1 = core
+#define TRACE_EV_SPAN_END 0x0705          // a0 = TRACE_SPAN_*, a1 = core
+
+#define TRACE_ISR_BUTTON 0x01             // button edge
+#define TRACE_ISR_HX711_READY 0x02        // HX711 DOUT falling edge
+
+#define TRACE_SPAN_HX711_WAIT 0x01        // waiting for data-ready
+#define TRACE_SPAN_HX711_READ 0x02        // clocking the conversion out
+#define TRACE_SPAN_RECORD_EVENT 0x03      // log append, store push, notification
+#define TRACE_SPAN_GATT_ACCESS 0x04       // 0xA001 read
+#define TRACE_SPAN_BUTTON_DISPATCH 0x05   // button engine timer callback
+#define TRACE_SPAN_BUS_DISPATCH 0x06      // event bus delivering one event
+
+typedef struct {
+    uint32_t ts_us;   // low 32 bits of esp_timer_get_time()
+    uint16_t id;
+    uint16_t seq;     // low bits of the ring index, written last
+    int32_t a0;
+    int32_t a1;
+} trace_rec_t;
+
+#define TRACE_ON(id) (((TRACE_ENABLED_MASK) >> (((id) >> 8) & 0x1F)) & 1u)
+
+#define TRACE(id, a0, a1) do { \
+        if (TRACE_ON(id)) trace_emit((id), (int32_t)(a0), (int32_t)(a1)); \
+    } while (0)
+
+// timeline points: a1 is the core they run on
+#define TRACE_CORE(id, a0) do { \
+        if (TRACE_ON(id)) trace_emit_core((id), (int32_t)(a0)); \
+    } while (0)
+#define TRACE_BEGIN(span) TRACE_CORE(TRACE_EV_SPAN_BEGIN, span)
+#define TRACE_END(span) TRACE_CORE(TRACE_EV_SPAN_END, span)
+#define TRACE_ISR_ENTER(isr) TRACE_CORE(TRACE_EV_ISR_ENTER, isr)
+#define TRACE_ISR_EXIT(isr) TRACE_CORE(TRACE_EV_ISR_EXIT, isr)
+
+// Safe from tasks and ISRs; the oldest record is overwritten when the ring is full.
+// Records are dropped while the ring is frozen.
+void trace_emit(uint16_t id, int32_t a0, int32_t a1);
+void trace_emit_core(uint16_t id, int32_t a0);
+// Called by the scheduler with the incoming task current (traceTASK_SWITCHED_IN).
+// Emits TRACE_EV_TASK_IN and remembers the task's name for the dump.
+void trace_task_switched_in(void);
+
+// Copy up to max records, oldest first; torn records (being written) are skipped.
+size_t trace_snapshot(trace_rec_t *out, size_t max);
+// Stop (or resume) recording so a dump reads a stable ring.
+void trace_freeze(bool frozen);
+// Records in the ring, and a copy starting `first` records after the oldest;
+// indices stay valid while the ring is frozen.
+size_t trace_count(void);
+size_t trace_read(size_t first, trace_rec_t *out, size_t max);
+// Print the ring to the console for tools/trace_decode.py; recording pauses meanwhile.
+// 38 console bytes per record take seconds at 115200 baud, so call it from a low-priority task (the
+// console task in main.c), not from the event bus or a timer.
+void trace_dump(void);
+
+// Dump over BLE (0xA007). Writing [first u16 LE] freezes the ring and selects what the
+// following reads return: [total u16][first u16] and up to TRACE_WINDOW_RECORDS records
+// from `first` on, or with TRACE_WINDOW_NAMES the task names, [count u8] then
+// [handle u32][name, TRACE_TASK_NAME_LEN bytes] per task. TRACE_WINDOW_DONE resumes
+// recording. Windows are stable across Read Blob continuations while frozen.
+#define TRACE_WINDOW_RECORDS 31
+#define TRACE_WINDOW_MAX (4 + TRACE_WINDOW_RECORDS * 16)
+#define TRACE_WINDOW_NAMES 0xFFFE
+#define TRACE_WINDOW_DONE 0xFFFF
+#define TRACE_TASKS_MAX 24
+#define TRACE_TASK_NAME_LEN 16
+
+esp_err_t trace_window_select(const uint8_t *data, size_t len);
+// Returns the value length, 0 when `len` is below TRACE_WINDOW_MAX.
+size_t trace_window_read(uint8_t *buf, size_t len);
@@ -0,0 +1,6 @@
+#pragma once
+
+// Force-included into the FreeRTOS kernel sources when TRACE_TIMELINE is set
+// (main/CMakeLists.txt); FreeRTOS.h only defines the hooks left undefined here.
+void trace_task_switched_in(void);
+#define traceTASK_SWITCHED_IN() trace_task_switched_in()
@@ -0,0 +1,44 @@
+#pragma once
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define WEIGHT_FILTER_MEDIAN_MAX 7
+#define WEIGHT_FILTER_AVG_MAX 16
+#define WEIGHT_FILTER_IIR_SHIFT_MAX 7
+
+typedef enum {
+    WEIGHT_FILTER_SMOOTH_NONE = 0,
+    WEIGHT_FILTER_SMOOTH_AVG,   // moving average over avg_len samples
+    WEIGHT_FILTER_SMOOTH_IIR,   // y += (x - y) / 2^iir_shift
+} weight_filter_smooth_t;
+
+// Chain: median-of-N spike rejector -> smoothing stage -> decimator.
+typedef struct {
+    uint8_t median_len;         // odd, 1 disables the stage
+    weight_filter_smooth_t smooth;
+    uint8_t avg_len;
+    uint8_t iir_shift;
+    uint8_t decimate;           // emit every Nth sample, 1 emits all
+} weight_filter_cfg_t;
+
+// All state is inline so filters can live in static storage; no heap per sample.
+typedef struct {
+    weight_filter_cfg_t cfg;
+    int32_t med_buf[WEIGHT_FILTER_MEDIAN_MAX];
+    uint8_t med_pos;
+    uint8_t med_fill;
+    int32_t avg_buf[WEIGHT_FILTER_AVG_MAX];
+    int64_t avg_sum;
+    uint8_t avg_pos;
+    uint8_t avg_fill;
+    int32_t iir_acc;            // output scaled by 2^iir_shift
+    bool iir_primed;
+    uint8_t dec_count;
+} weight_filter_t;
+
+esp_err_t weight_filter_init(weight_filter_t *f, const weight_filter_cfg_t *cfg);
+void weight_filter_reset(weight_filter_t *f);
+// Feed one raw sample. Returns true and writes *out when the chain emits a value.
+bool weight_filter_push(weight_filter_t *f, int32_t in, int32_t *out);
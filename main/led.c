@@ -1,85 +1,296 @@
 #include "led.h"
 #include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_rom_gpio.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "soc/gpio_sig_map.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "trace.h"
 #include <stdlib.h>
 
-static gpio_num_t *led_pins = NULL;
+// Effects engine: one periodic esp_timer runs while any LED animates. Each tick
+// evaluates every playing pattern and writes all GPIO-driven LEDs through one
+// W1TS/W1TC pair per bank (pins 32+ live in the OUT1 registers). BREATHE hands
+// the pin to an LEDC channel and only the duty is updated per tick.
+
+#define LED_LEDC_MODE LEDC_LOW_SPEED_MODE
+#define LED_LEDC_TIMER LEDC_TIMER_1
+#define LED_LEDC_FREQ_HZ 5000
+
+typedef struct {
+    uint16_t ms[4];   // alternating on/off durations, starting with on
+    uint8_t steps;
+    bool pwm;         // ms[0] is the breathing period
+} led_pattern_def_t;
+
+static const led_pattern_def_t PATTERNS[LED_PATTERN_COUNT] = {
+    [LED_PATTERN_BLINK] = { .ms = { 500, 500 }, .steps = 2 },
+    [LED_PATTERN_BLINK_FAST] = { .ms = { 100, 100 }, .steps = 2 },
+    [LED_PATTERN_DOUBLE_BLINK] = { .ms = { 100, 150, 100, 650 }, .steps = 4 },
+    [LED_PATTERN_BREATHE] = { .ms = { 2000 }, .steps = 1, .pwm = true },
+};
+
+typedef struct {
+    gpio_num_t pin;
+    uint8_t pattern;     // led_pattern_t
+    bool on_ledc;
+    uint32_t start_ms;
+} led_slot_t;
+
+static led_slot_t *leds = NULL;
 static size_t led_count = 0;
 static const char *TAG = "led_mod";
 static bool led_active_low = false;
+static bool ledc_ready = false;
+static uint32_t led_on;           // logical level of GPIO-driven LEDs, bit per LED
+static SemaphoreHandle_t led_lock = NULL;
+static esp_timer_handle_t fx_timer = NULL;
+static bool fx_running = false;
+
+static inline bool animated(uint8_t pattern)
+{
+    return pattern != LED_PATTERN_OFF && pattern != LED_PATTERN_ON;
+}
+
+static inline uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// 0..255; blink steps are 0 or 255, breathing is a triangle squared for a softer low end
+static uint8_t pattern_level(const led_pattern_def_t *p, uint32_t t)
+{
+    if (p->pwm) {
+        uint32_t period = p->ms[0], half = period / 2;
+        uint32_t ph = t % period;
+        uint32_t tri = ph < half ? ph * 255 / half : (period - ph) * 255 / half;
+        return (uint8_t)(tri * tri / 255);
+    }
+    uint32_t period = 0;
+    for (uint8_t i = 0; i < p->steps; ++i) period += p->ms[i];
+    uint32_t ph = t % period;
+    for (uint8_t i = 0; i < p->steps; ++i) {
+        if (ph < p->ms[i]) return (i & 1) ? 0 : 255;
+        ph -= p->ms[i];
+    }
+    return 0;
+}
+
+// caller holds led_lock; writes only the LEDs in `mask` whose level changes
+static void led_write(uint32_t on, uint32_t mask, bool force)
+{
+    if (!force) mask &= on ^ led_on;
+    if (!mask) return;
+    uint32_t set0 = 0, clr0 = 0, set1 = 0, clr1 = 0;
+    for (size_t i = 0; i < led_count; ++i) {
+        if (!(mask & (1u << i))) continue;
+        bool phys = ((on >> i) & 1) != led_active_low;
+        uint32_t pin = (uint32_t)leds[i].pin;
+        if (pin < 32) *(phys ? &set0 : &clr0) |= 1u << pin;
+        else *(phys ? &set1 : &clr1) |= 1u << (pin - 32);
+        TRACE(TRACE_EV_LED_SET, i, phys);
+    }
+    if (set0) REG_WRITE(GPIO_OUT_W1TS_REG, set0);
+    if (clr0) REG_WRITE(GPIO_OUT_W1TC_REG, clr0);
+    if (set1) REG_WRITE(GPIO_OUT1_W1TS_REG, set1);
+    if (clr1) REG_WRITE(GPIO_OUT1_W1TC_REG, clr1);
+    led_on = (led_on & ~mask) | (on & mask);
+}
+
+static esp_err_t ledc_attach(size_t idx)
+{
+    if (!ledc_ready) {
+        ledc_timer_config_t tcfg = {
+            .speed_mode = LED_LEDC_MODE,
+            .duty_resolution = LEDC_TIMER_8_BIT,
+            .timer_num = LED_LEDC_TIMER,
+            .freq_hz = LED_LEDC_FREQ_HZ,
+            .clk_cfg = LEDC_AUTO_CLK,
+        };
+        esp_err_t err = ledc_timer_config(&tcfg);
+        if (err != ESP_OK) return err;
+        ledc_ready = true;
+    }
+    ledc_channel_config_t ccfg = {
+        .gpio_num = leds[idx].pin,
+        .speed_mode = LED_LEDC_MODE,
+        .channel = (ledc_channel_t)idx,
+        .timer_sel = LED_LEDC_TIMER,
+        .duty = 0,
+        .hpoint = 0,
+        .flags.output_invert = led_active_low,
+    };
+    esp_err_t err = ledc_channel_config(&ccfg);
+    if (err == ESP_OK) leds[idx].on_ledc = true;
+    return err;
+}
+
+// back to the plain GPIO output; the caller rewrites the level
+static void ledc_detach(size_t idx)
+{
+    ledc_stop(LED_LEDC_MODE, (ledc_channel_t)idx, led_active_low ? 1 : 0);
+    esp_rom_gpio_connect_out_signal(leds[idx].pin, SIG_GPIO_OUT_IDX, false, false);
+    leds[idx].on_ledc = false;
+}
+
+// caller holds led_lock; starts or stops the tick timer to match the playing patterns
+static void fx_timer_update(void)
+{
+    bool need = false;
+    for (size_t i = 0; i < led_count; ++i) need |= animated(leds[i].pattern);
+    if (need && !fx_running) {
+        esp_timer_start_periodic(fx_timer, LED_FX_TICK_MS * 1000);
+    } else if (!need && fx_running) {
+        esp_timer_stop(fx_timer);
+    }
+    fx_running = need;
+}
+
+static void fx_tick(void *arg)
+{
+    xSemaphoreTake(led_lock, portMAX_DELAY);
+    uint32_t now = now_ms();
+    uint32_t on = 0, mask = 0;
+    for (size_t i = 0; i < led_count; ++i) {
+        led_slot_t *l = &leds[i];
+        if (!animated(l->pattern)) continue;
+        uint8_t lvl = pattern_level(&PATTERNS[l->pattern], now - l->start_ms);
+        if (l->on_ledc) {
+            ledc_set_duty(LED_LEDC_MODE, (ledc_channel_t)i, lvl);
+            ledc_update_duty(LED_LEDC_MODE, (ledc_channel_t)i);
+        } else {
+            mask |= 1u << i;
+            if (lvl) on |= 1u << i;
+        }
+    }
+    led_write(on, mask, false);
+    xSemaphoreGive(led_lock);
+}
 
 esp_err_t led_init(const gpio_num_t *pins, size_t count)
 {
-    if (!pins || count == 0) return ESP_ERR_INVALID_ARG;
-    if (led_pins) return ESP_ERR_INVALID_STATE;
+    if (!pins || count == 0 || count > LED_MAX) return ESP_ERR_INVALID_ARG;
+    if (leds) return ESP_ERR_INVALID_STATE;
 
-    led_pins = malloc(sizeof(gpio_num_t) * count);
-    if (!led_pins) return ESP_ERR_NO_MEM;
+    leds = calloc(count, sizeof(led_slot_t));
+    led_lock = xSemaphoreCreateMutex();
+    const esp_timer_create_args_t targs = {
+        .callback = fx_tick,
+        .name = "led_fx",
+    };
+    if (!leds || !led_lock || esp_timer_create(&targs, &fx_timer) != ESP_OK) {
+        free(leds);
+        leds = NULL;
+        if (led_lock) vSemaphoreDelete(led_lock);
+        led_lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
     for (size_t i = 0; i < count; ++i) {
-        led_pins[i] = pins[i];
-        gpio_reset_pin(led_pins[i]);
-        gpio_set_direction(led_pins[i], GPIO_MODE_OUTPUT);
-        gpio_set_level(led_pins[i], 0);
+        leds[i].pin = pins[i];
+        gpio_reset_pin(leds[i].pin);
+        gpio_set_direction(leds[i].pin, GPIO_MODE_OUTPUT);
+        gpio_set_level(leds[i].pin, 0);
     }
     led_count = count;
+    led_on = 0;
     ESP_LOGI(TAG, "LED module initialized (%d LEDs)", (int)count);
     {
         char buf[128];
         int off = 0;
         off += snprintf(buf + off, sizeof(buf) - off, "pins=");
         for (size_t i = 0; i < count && off < (int)sizeof(buf); ++i) {
-            off += snprintf(buf + off, sizeof(buf) - off, "%d%s", (int)led_pins[i], (i + 1 < count) ? "," : "");
+            off += snprintf(buf + off, sizeof(buf) - off, "%d%s", (int)leds[i].pin, (i + 1 < count) ? "," : "");
         }
         ESP_LOGI(TAG, "%s", buf);
     }
     return ESP_OK;
 }
 
+esp_err_t led_play(size_t idx, led_pattern_t pattern)
+{
+    if (!leds || idx >= led_count || pattern >= LED_PATTERN_COUNT) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(led_lock, portMAX_DELAY);
+    led_slot_t *l = &leds[idx];
+    if (l->pattern != pattern || !animated(pattern)) {
+        if (l->pattern != pattern) TRACE(TRACE_EV_LED_PLAY, idx, pattern);
+        bool pwm = animated(pattern) && PATTERNS[pattern].pwm;
+        bool detached = false;
+        if (l->on_ledc && !pwm) {
+            ledc_detach(idx);
+            detached = true;
+        }
+        if (pwm && !l->on_ledc) err = ledc_attach(idx);
+        // no PWM channel: fall back to a slow blink so the reminder still shows
+        l->pattern = err == ESP_OK ? pattern : LED_PATTERN_BLINK;
+        l->start_ms = now_ms();
+        if (!l->on_ledc) {
+            bool lit = l->pattern == LED_PATTERN_ON ||
+                       (animated(l->pattern) && pattern_level(&PATTERNS[l->pattern], 0));
+            led_write(lit ? 1u << idx : 0, 1u << idx, detached);
+        }
+        fx_timer_update();
+    }
+    xSemaphoreGive(led_lock);
+    return err;
+}
+
+esp_err_t led_stop(size_t idx)
+{
+    return led_play(idx, LED_PATTERN_OFF);
+}
+
 esp_err_t led_set(size_t idx, int level)
 {
-    if (!led_pins || idx >= led_count) return ESP_ERR_INVALID_ARG;
-    int phys = (level ? 1 : 0);
-    if (led_active_low) phys = !phys;
-    gpio_set_level(led_pins[idx], phys);
-    int read_back = gpio_get_level(led_pins[idx]);
-    ESP_LOGI(TAG, "led_set idx=%d req=%d phys=%d read=%d gpio=%d", (int)idx, level ? 1 : 0, phys, read_back, (int)led_pins[idx]);
-    return ESP_OK;
+    return led_play(idx, level ? LED_PATTERN_ON : LED_PATTERN_OFF);
 }
 
 esp_err_t led_toggle(size_t idx)
 {
-    if (!led_pins || idx >= led_count) return ESP_ERR_INVALID_ARG;
-    int cur = gpio_get_level(led_pins[idx]);
-    int newv = !cur;
-    gpio_set_level(led_pins[idx], newv);
-    int read_back = gpio_get_level(led_pins[idx]);
-    ESP_LOGI(TAG, "led_toggle idx=%d gpio=%d from=%d to=%d read=%d", (int)idx, (int)led_pins[idx], cur, newv, read_back);
-    return ESP_OK;
+    if (!leds || idx >= led_count) return ESP_ERR_INVALID_ARG;
+    // whatever is visible now becomes the opposite steady level
+    return led_set(idx, !((led_on >> idx) & 1));
 }
 
 esp_err_t led_get_level(size_t idx, int *out_level)
 {
-    if (!led_pins || idx >= led_count || !out_level) return ESP_ERR_INVALID_ARG;
-    *out_level = gpio_get_level(led_pins[idx]);
+    if (!leds || idx >= led_count || !out_level) return ESP_ERR_INVALID_ARG;
+    *out_level = (int)(((led_on >> idx) & 1) != led_active_low);
     return ESP_OK;
 }
 
 void led_dump(void)
 {
-    if (!led_pins) {
+    if (!leds) {
         ESP_LOGI(TAG, "led_dump: not initialized");
         return;
     }
     for (size_t i = 0; i < led_count; ++i) {
-        int lvl = gpio_get_level(led_pins[i]);
+        int lvl = gpio_get_level(leds[i].pin);
         int logical = led_active_low ? !lvl : lvl;
-        ESP_LOGI(TAG, "led[%d] gpio=%d phys=%d logical=%d", (int)i, (int)led_pins[i], lvl, logical);
+        ESP_LOGI(TAG, "led[%d] gpio=%d phys=%d logical=%d pattern=%d%s", (int)i, (int)leds[i].pin, lvl, logical,
+                 leds[i].pattern, leds[i].on_ledc ? " (ledc)" : "");
     }
 }
 
 void led_set_active_low(bool active_low)
 {
     led_active_low = active_low;
+    if (leds) {
+        // rewrite every GPIO-driven LED with the new polarity
+        xSemaphoreTake(led_lock, portMAX_DELAY);
+        uint32_t mask = 0;
+        for (size_t i = 0; i < led_count; ++i) {
+            if (leds[i].on_ledc) ledc_attach(i);
+            else mask |= 1u << i;
+        }
+        led_write(led_on, mask, true);
+        xSemaphoreGive(led_lock);
+    }
     ESP_LOGI(TAG, "led_set_active_low=%d", (int)led_active_low);
 }
@@ -1,22 +1,48 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "driver/gpio.h"
+#include "driver/uart.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "esp_err.h"
 #include "esp_sntp.h"
-#include <sys/time.h>
 
 
 #include "led.h"
 #include "button.h"
 #include "hx711.h"
 #include "ble.h"
+#include "weight_filter.h"
+#include "pill_detector.h"
+#include "sample_sched.h"
+#include "event_log.h"
+#include "sync_proto.h"
+#include "record_store.h"
+#include "export.h"
+#include "trace.h"
+#include "esp_system.h"
+#include "time_sync.h"
+#include "boot_phase.h"
+#include "clock_map.h"
+#include "record_codec.h"
+#include "event_bus.h"
+#include "dose_sched.h"
+#include "metrics.h"
+#include "freertos/semphr.h"
 #include "esp_timer.h"
+#include <stdatomic.h>
 #include <string.h>
+#include <inttypes.h>
 
 
-#define WEIGHT_DECREASE_THRESHOLD 2.0f 
+#define WEIGHT_DECREASE_THRESHOLD_MG 2000
+#define PILL_POST_WAIT_MS 1000   // повтор с предупреждением, пока шина стоит
+#define IDLE_SEEN_MAX_MS 1000    // задержка фильтра после пробуждения: медиана и среднее по 10 Гц
+#define DOSE_RETRY_MS 100        // повтор события расписания при переполненной шине
+#define CONSOLE_UART UART_NUM_0
+#define CONSOLE_LINE_MAX 32
 
 static const gpio_num_t LED_PINS[4] = { GPIO_NUM_32, GPIO_NUM_33, GPIO_NUM_16, GPIO_NUM_17 };
 static const gpio_num_t BUTTON_PINS[4] = { GPIO_NUM_13, GPIO_NUM_12, GPIO_NUM_14, GPIO_NUM_27 };
@@ -25,127 +51,467 @@ static const gpio_num_t HX711_SCK[4] = { GPIO_NUM_4, GPIO_NUM_23, GPIO_NUM_22, G
 
 static const char *TAG = "app";
 
+// Медиана по 5 отсчетам отсекает одиночные выбросы, скользящее среднее снижает шум перед детектором.
+static const weight_filter_cfg_t WEIGHT_FILTER_CFG = {
+    .median_len = 5,
+    .smooth = WEIGHT_FILTER_SMOOTH_AVG,
+    .avg_len = 4,
+    .decimate = 1,
+};
+static weight_filter_t weight_filters[4];
+
+// Событие фиксируется, когда вес снова устоялся (5 близких отсчетов), а не по таймеру опроса.
+// Масса одной таблетки выучивается по первому изъятию.
+static const pill_detector_cfg_t PILL_DETECTOR_CFG = {
+    .disturb_mg = 1000,
+    .settle_band_mg = 400,
+    .settle_samples = 5,
+    .min_change_mg = WEIGHT_DECREASE_THRESHOLD_MG,
+    .pill_mg = 0,
+};
+static pill_detector_t pill_detectors[4];
+
+// В покое - один кадр раз в 1.4 с (1 с сна и 400 мс установления HX711), АЦП между кадрами выключены.
+// Изменение веса или нажатие кнопки включает опрос на полной частоте АЦП до 10 с тишины.
+static const sample_sched_cfg_t SAMPLE_SCHED_CFG = {
+    .idle_period_ms = 1000,
+    .wake_settle_ms = 400,
+    .burst_period_ms = 0,
+    .quiet_timeout_ms = 10000,
+};
+
+static void on_sntp_sync(struct timeval *tv)
+{
+    time_sync_note(TIME_SRC_SNTP);
+}
+
+// SNTP работает в фоне и ничего не блокирует; время может прийти и по BLE (Current Time)
 void initialize_sntp(void)
 {
     ESP_LOGI(TAG, "Initializing SNTP");
+    sntp_set_time_sync_notification_cb(on_sntp_sync);
     esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
     esp_sntp_setservername(0, "pool.ntp.org");
     esp_sntp_init();
 }
 
-uint64_t get_epoch_ms(void)
+static void record_event_at(uint8_t val, uint64_t ts_ms)
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (uint64_t)tv.tv_sec * 1000ULL + (uint64_t)(tv.tv_usec / 1000ULL);
-}
-
-typedef struct {
-    uint64_t ts_ms;
-    uint8_t val;
-} record_t;
+    // время от запуска и номер загрузки; в эпоху переводится при выгрузке (clock_map)
+    TRACE_BEGIN(TRACE_SPAN_RECORD_EVENT);
+    record_t rec = { 0 };
+    rec.ts_ms = ts_ms;
+    rec.boot = clock_map_boot();
+    rec.val = val & RECORD_VAL_MASK;
+    esp_err_t err = event_log_append(&rec);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "event_log_append failed: %s", esp_err_to_name(err));
+        TRACE_END(TRACE_SPAN_RECORD_EVENT);
+        return;
+    }
+    record_store_push(&rec);
 
-static record_t records[64];
-static size_t records_head = 0;
+    // сразу отправляем подписанным клиентам, в том же формате, что и при синхронизации
+    clock_map_rebase(&rec, 1);
+    uint8_t buf[RECORD_CODEC_HDR_MAX + 16];
+    size_t used;
+    if (record_codec_encode(&rec, 1, buf, sizeof(buf), &used) == 1) ble_notify_event(buf, used);
+    TRACE_END(TRACE_SPAN_RECORD_EVENT);
+}
 
 static void record_event(uint8_t val)
 {
-    uint64_t ts;
-    if (esp_sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED) {
-        ts = get_epoch_ms();
-    } else {
-        ts = (uint64_t)(esp_timer_get_time() / 1000);
-    }
-    records[records_head].ts_ms = ts;
-    records[records_head].val = val & 0x3;
-    records_head = (records_head + 1) % (sizeof(records)/sizeof(records[0]));
+    record_event_at(val, (uint64_t)(esp_timer_get_time() / 1000));
 }
 
+// кнопки, датчики, BLE и часы только публикуют события; обработка - в задаче шины
 static void on_button_event(size_t idx, button_event_t event)
 {
-    if (event == BUTTON_EVENT_PRESS) {
+    app_event_t ev = { .type = APP_EV_BUTTON, .button = { .index = (uint16_t)idx, .gesture = (uint8_t)event } };
+    event_bus_post(&ev);
+}
+
+static void app_on_button(const app_event_t *ev)
+{
+    size_t idx = ev->button.index;
+    if (ev->button.gesture == BUTTON_EVENT_PRESS) {
+        sample_sched_kick();
         ESP_LOGI(TAG, "Button %d press -> turn LED%d OFF", (int)idx, (int)idx);
         led_set(idx, 0);
-    } else if (event == BUTTON_EVENT_LONG_PRESS) {
+    } else if (ev->button.gesture == BUTTON_EVENT_LONG_PRESS) {
         ESP_LOGI(TAG, "Button %d long-press -> start pairing", (int)idx);
         ble_start_advertising();
     }
 }
 
-// BLE read callback: fill buffer with [count:uint8][records...]
-static size_t ble_record_read_cb(uint8_t *buf, size_t maxlen)
-{
-    if (!buf || maxlen < 1) return 0;
-    size_t count = sizeof(records)/sizeof(records[0]);
-    size_t pos = 1; // leave space for count
-    uint8_t send_count = 0;
-    for (size_t i = 0; i < count; ++i) {
-        record_t *r = &records[i];
-        if (r->ts_ms == 0) continue;
-        // each record: 8 bytes timestamp (little-endian) + 1 byte value
-        if (pos + 9 > maxlen) break;
-        uint64_t t = r->ts_ms;
-        buf[pos++] = (uint8_t)(t & 0xFF);
-        buf[pos++] = (uint8_t)((t >> 8) & 0xFF);
-        buf[pos++] = (uint8_t)((t >> 16) & 0xFF);
-        buf[pos++] = (uint8_t)((t >> 24) & 0xFF);
-        buf[pos++] = (uint8_t)((t >> 32) & 0xFF);
-        buf[pos++] = (uint8_t)((t >> 40) & 0xFF);
-        buf[pos++] = (uint8_t)((t >> 48) & 0xFF);
-        buf[pos++] = (uint8_t)((t >> 56) & 0xFF);
-        buf[pos++] = r->val;
-        send_count++;
-    }
-    if (send_count == 0) return 0;
-    buf[0] = send_count;
-    return pos;
+// расписание приёма: движок вызывается под dose_lock, светодиоды и записи - снаружи
+static SemaphoreHandle_t dose_lock;
+static esp_timer_handle_t dose_timer;
+static esp_timer_handle_t dose_retry_timer;
+static atomic_bool dose_rebuild;
+
+// таймер перевзводится только в dose_run: потерянное событие остановило бы расписание,
+// поэтому при полной шине событие повторяется отдельным таймером
+static void dose_post(void)
+{
+    app_event_t ev = { .type = APP_EV_DOSE };
+    if (event_bus_post(&ev) != ESP_OK) esp_timer_start_once(dose_retry_timer, DOSE_RETRY_MS * 1000);
+}
+
+static void dose_timer_cb(void *arg)
+{
+    dose_post();
+}
+
+static void dose_apply(const dose_action_t *a, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        if (a[i].type == DOSE_ACT_REMIND) {
+            led_play(a[i].comp, LED_PATTERN_BREATHE);
+        } else if (a[i].type == DOSE_ACT_LATE) {
+            led_play(a[i].comp, LED_PATTERN_BLINK_FAST);
+        } else {
+            // пропуск горит до нажатия кнопки
+            ESP_LOGW(TAG, "compartment %d: dose missed", a[i].comp);
+            led_play(a[i].comp, LED_PATTERN_DOUBLE_BLINK);
+            record_event(a[i].comp | (RECORD_TYPE_MISSED << RECORD_TYPE_SHIFT));
+        }
+    }
+}
+
+// без реального времени расписание не работает; таймер всегда взведён на ближайший срок
+static void dose_run(bool rebuild)
+{
+    if (!time_sync_valid()) return;
+    dose_action_t acts[DOSE_SLOTS];
+    size_t n;
+    uint64_t at, now;
+    bool pending;
+    do {
+        xSemaphoreTake(dose_lock, portMAX_DELAY);
+        now = time_sync_epoch_ms();
+        n = rebuild ? dose_sched_start(now, acts, DOSE_SLOTS) : dose_sched_advance(now, acts, DOSE_SLOTS);
+        pending = dose_sched_next(&at);
+        xSemaphoreGive(dose_lock);
+        dose_apply(acts, n);
+        rebuild = false;
+    } while (n == DOSE_SLOTS);
+    esp_timer_stop(dose_timer);
+    if (pending) esp_timer_start_once(dose_timer, at > now ? (at - now) * 1000 : 1000);
+}
+
+static void app_on_dose(const app_event_t *ev)
+{
+    bool rebuild = atomic_exchange(&dose_rebuild, false);
+    dose_run(ev->type == APP_EV_TIME_SYNC || rebuild);
+}
+
+static void app_on_pill(const app_event_t *ev)
+{
+    if (!ev->pill.removed) return;
+    uint8_t comp = ev->pill.sensor;
+    uint8_t type = RECORD_TYPE_TAKEN;
+    // приём отмечается моментом, когда крышку тронули, а не когда вес устоялся
+    uint64_t now_ms = (uint64_t)(esp_timer_get_time() / 1000);
+    uint64_t ago_ms = (uint32_t)((uint32_t)now_ms - ev->pill.moved_ms);
+    if (ago_ms > now_ms) ago_ms = now_ms;
+    if (time_sync_valid()) {
+        xSemaphoreTake(dose_lock, portMAX_DELAY);
+        type = dose_sched_taken(comp, time_sync_epoch_ms() - ago_ms);
+        xSemaphoreGive(dose_lock);
+    }
+    led_set(comp, 1);
+    record_event_at(comp | (type << RECORD_TYPE_SHIFT), now_ms - ago_ms);
+    // окно закрыто - таймер переводится на следующий срок этого слота
+    if (type != RECORD_TYPE_TAKEN) dose_run(false);
+}
+
+static void app_on_link(const app_event_t *ev)
+{
+    if (ev->type == APP_EV_BLE_CONN) {
+        ESP_LOGI(TAG, "BLE conn %d %s", ev->ble.conn, ev->ble.up ? "up" : "down");
+    } else {
+        ESP_LOGI(TAG, "time synced (source %d)", ev->time.src);
+    }
+}
+
+static const event_sub_t APP_SUBSCRIBERS[] = {
+    { APP_EV_BIT(APP_EV_BUTTON), app_on_button },
+    { APP_EV_BIT(APP_EV_PILL), app_on_pill },
+    { APP_EV_BIT(APP_EV_BLE_CONN) | APP_EV_BIT(APP_EV_TIME_SYNC), app_on_link },
+    { APP_EV_BIT(APP_EV_DOSE) | APP_EV_BIT(APP_EV_TIME_SYNC), app_on_dose },
+};
+
+// свежие записи отдаются из RAM без ожидания flash, более старые - из журнала
+static size_t sync_store_read(uint32_t from_seq, record_t *out, size_t max)
+{
+    size_t n = record_store_read(from_seq, out, max);
+    if (n == 0 && from_seq < record_store_next_seq()) n = event_log_read(from_seq, out, max);
+    clock_map_rebase(out, n);
+    return n;
+}
+
+// после перезагрузки заполняем RAM-копию последними записями журнала
+static void record_store_preload(void)
+{
+    record_t batch[64];
+    uint32_t next = event_log_next_seq();
+    uint32_t from = next > RECORD_STORE_CAPACITY ? next - RECORD_STORE_CAPACITY : 0;
+    record_store_init(from);
+    size_t n;
+    while ((n = event_log_read(from, batch, sizeof(batch)/sizeof(batch[0]))) > 0) {
+        for (size_t i = 0; i < n; ++i) record_store_push(&batch[i]);
+        from = batch[n - 1].seq + 1;
+    }
+}
+
+// синхронизация: позиция подтверждённых клиентом записей хранится в NVS
+static void sync_store_ack(uint32_t next_seq)
+{
+    nvs_handle_t h;
+    if (nvs_open("sync", NVS_READWRITE, &h) != ESP_OK) return;
+    nvs_set_u32(h, "acked", next_seq);
+    nvs_commit(h);
+    nvs_close(h);
+}
+
+static uint32_t sync_load_ack(void)
+{
+    nvs_handle_t h;
+    uint32_t acked = 0;
+    if (nvs_open("sync", NVS_READONLY, &h) == ESP_OK) {
+        nvs_get_u32(h, "acked", &acked);
+        nvs_close(h);
+    }
+    return acked;
+}
+
+// выгрузка журнала потоком: команды из BLE обрабатывает отдельная задача
+#define EXPORT_CMD_CLOSE 0
+#define EXPORT_POLL_MS 50
+
+typedef struct {
+    uint8_t op;
+    uint16_t conn;
+    uint32_t seq;
+} export_cmd_t;
+
+static QueueHandle_t export_queue;
+static export_t ble_export;
+static uint16_t export_conn;
+
+static void export_post(uint8_t op, uint16_t conn, uint32_t seq)
+{
+    export_cmd_t cmd = { .op = op, .conn = conn, .seq = seq };
+    if (export_queue && xQueueSend(export_queue, &cmd, 0) != pdTRUE) ESP_LOGW(TAG, "export queue full");
+}
+
+static void export_task(void *arg)
+{
+    export_cmd_t cmd;
+    for (;;) {
+        TickType_t wait = export_done(&ble_export) ? portMAX_DELAY : pdMS_TO_TICKS(EXPORT_POLL_MS);
+        bool got = xQueueReceive(export_queue, &cmd, wait) == pdTRUE;
+        uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+        if (got && cmd.op == SYNC_OP_EXPORT) {
+            // номер передачи растёт: клиент отличает новую передачу от продолжения
+            export_conn = cmd.conn;
+            export_set_link(&ble_export, (void *)(uintptr_t)cmd.conn);
+            export_start(&ble_export, cmd.seq, record_store_next_seq());
+            ESP_LOGI(TAG, "export to conn %d from seq %" PRIu32, cmd.conn, cmd.seq);
+        } else if (got && cmd.conn == export_conn && cmd.op == SYNC_OP_ACK) {
+            export_ack(&ble_export, cmd.seq, now_ms);
+        } else if (got && cmd.conn == export_conn && cmd.op == EXPORT_CMD_CLOSE) {
+            // клиент продолжит с подтверждённой позиции после переподключения
+            export_stop(&ble_export);
+        }
+        export_pump(&ble_export, now_ms);
+    }
+}
+
+static esp_err_t ble_ctrl_write(uint16_t conn, const uint8_t *data, size_t len)
+{
+    if (len && (data[0] == DOSE_OP_SET || data[0] == DOSE_OP_TZ)) {
+        xSemaphoreTake(dose_lock, portMAX_DELAY);
+        esp_err_t err = dose_sched_command(data, len);
+        int16_t tz = dose_sched_tz();
+        xSemaphoreGive(dose_lock);
+        if (err == ESP_OK) {
+            // Current Time телефон пишет в местном времени
+            time_sync_set_tz(tz);
+            atomic_store(&dose_rebuild, true);
+            dose_post();
+        }
+        return err;
+    }
+    esp_err_t err = sync_proto_write(conn, data, len);
+    if (err == ESP_OK && (data[0] == SYNC_OP_EXPORT || data[0] == SYNC_OP_ACK)) {
+        export_post(data[0], conn, sync_proto_cursor(conn));
+    }
+    return err;
+}
+
+static void ble_conn_cb(uint16_t conn, bool connected)
+{
+    metrics_add(METRIC_BLE_CONNS, connected ? 1 : -1);
+    if (connected) {
+        metrics_inc(METRIC_BLE_CONNECTS);
+        if (sync_proto_open(conn) != ESP_OK) ESP_LOGW(TAG, "no sync session for conn %d", conn);
+    } else {
+        sync_proto_close(conn);
+        export_post(EXPORT_CMD_CLOSE, conn, 0);
+    }
+    app_event_t ev = { .type = APP_EV_BLE_CONN, .ble = { .conn = conn, .up = connected } };
+    event_bus_post(&ev);
+}
+
+// метрики, которые дешевле снять при чтении, чем обновлять на каждом событии
+static TaskHandle_t sensor_task_handle;
+static TaskHandle_t export_task_handle;
+
+static void metrics_sample(void)
+{
+    event_bus_stats_t bus;
+    event_bus_stats(&bus);
+    metrics_set(METRIC_BUS_DROPPED, (int32_t)bus.dropped);
+    metrics_set(METRIC_BUS_DEPTH_MAX, bus.depth_max);
+    metrics_set(METRIC_STACK_FREE_BUS, (int32_t)bus.stack_free_min);
+    metrics_set(METRIC_BTN_EDGES_DROPPED, (int32_t)button_edges_dropped());
+    metrics_set(METRIC_BLE_TLM_DROPPED, (int32_t)ble_telemetry_dropped());
+    sample_sched_stats_t ss;
+    sample_sched_get_stats(&ss);
+    metrics_set(METRIC_SCHED_MODE, ss.mode);
+    metrics_set(METRIC_SCHED_BURSTS, (int32_t)ss.bursts);
+    metrics_set(METRIC_SCHED_POWER_UPS, (int32_t)ss.power_ups);
+    metrics_set(METRIC_SCHED_IDLE_S, (int32_t)(ss.idle_ms / 1000));
+    metrics_set(METRIC_SCHED_BURST_S, (int32_t)(ss.burst_ms / 1000));
+    metrics_set(METRIC_HEAP_FREE_MIN, (int32_t)esp_get_minimum_free_heap_size());
+    if (sensor_task_handle) metrics_set(METRIC_STACK_FREE_SENSOR, (int32_t)uxTaskGetStackHighWaterMark(sensor_task_handle));
+    if (export_task_handle) metrics_set(METRIC_STACK_FREE_EXPORT, (int32_t)uxTaskGetStackHighWaterMark(export_task_handle));
+}
+
+// консоль UART: команда "trace" выводит буфер трассировки. Вывод занимает секунды,
+// поэтому он идёт в отдельной задаче с низшим приоритетом, а не в задаче шины событий
+static void console_task(void *arg)
+{
+    char line[CONSOLE_LINE_MAX];
+    size_t len = 0;
+    while (1) {
+        char c;
+        if (uart_read_bytes(CONSOLE_UART, &c, 1, portMAX_DELAY) != 1) continue;
+        if (c != '\r' && c != '\n') {
+            if (len < sizeof(line) - 1) line[len++] = c;
+            continue;
+        }
+        line[len] = '\0';
+        len = 0;
+        if (!strcmp(line, "trace")) trace_dump();
+        else if (line[0]) ESP_LOGW(TAG, "unknown command '%s', try 'trace'", line);
+    }
 }
 
 static void sensor_task(void *arg)
 {
     ESP_LOGI(TAG, "Sensor task started");
 
-    // Выполняем тарировку (обнуление)
+    // Выполняем тарировку (обнуление) всех датчиков сразу: 20 кадров для усреднения
+    ESP_LOGI(TAG, "Taring sensors...");
+    if (hx711_tare_all(20) != ESP_OK) ESP_LOGW(TAG, "tare incomplete: some sensors did not answer");
+
+    int32_t raw[4];
+    int32_t filtered[4];
+    int32_t mg[4];
+    int64_t last_frame_us = 0;
+    uint32_t idle_seen_ms[4] = { 0 };   // кадр покоя, в котором вес сдвинулся
+
     for (size_t i = 0; i < hx711_count(); ++i) {
-        ESP_LOGI(TAG, "Taring sensor %d...", (int)i);
-        hx711_tare(i, 20);  // 20 измерений для усреднения
+        weight_filter_init(&weight_filters[i], &WEIGHT_FILTER_CFG);
+        pill_detector_init(&pill_detectors[i], &PILL_DETECTOR_CFG);
     }
 
-    float prev_weights[4] = {0};
-
     while (1) {
+        sample_sched_wait();
+        event_log_flush();
+        // один синхронный кадр со всех датчиков; чтение блокируется до готовности АЦП (10 Гц)
+        if (hx711_read_frame(raw) != ESP_OK) {
+            uint32_t lost = 0;
+            for (size_t i = 0; i < hx711_count(); ++i) {
+                if (raw[i] == HX711_RAW_INVALID) lost |= 1u << i;
+            }
+            TRACE(TRACE_EV_SENSOR_TIMEOUT, lost, 0);
+            vTaskDelay(pdMS_TO_TICKS(10));  // не занимать ядро, если датчик не отвечает
+        } else if (!boot_phase_us(BOOT_PHASE_FIRST_SAMPLE)) {
+            boot_phase_mark(BOOT_PHASE_FIRST_SAMPLE);
+            boot_phase_report();
+        }
+        int64_t frame_us = esp_timer_get_time();
+        if (last_frame_us) metrics_observe(METRIC_SENSOR_PERIOD_MS, (uint32_t)((frame_us - last_frame_us) / 1000));
+        last_frame_us = frame_us;
+        uint32_t now_ms = (uint32_t)(frame_us / 1000);
+        bool changed = false;
+
+        // в режиме покоя фильтр видит редкие кадры и запаздывает - сравниваем сырой вес с опорным
+        if (sample_sched_mode() == SAMPLE_MODE_IDLE) {
+            for (size_t i = 0; i < hx711_count(); ++i) {
+                int32_t w = hx711_raw_to_mg(i, raw[i]);
+                if (w == HX711_MG_INVALID || pill_detector_state(&pill_detectors[i]) != PILL_DET_STABLE) continue;
+                int32_t d = w - pill_detector_ref_mg(&pill_detectors[i]);
+                if (d > PILL_DETECTOR_CFG.disturb_mg || d < -PILL_DETECTOR_CFG.disturb_mg) {
+                    changed = true;
+                    idle_seen_ms[i] = now_ms;
+                }
+            }
+        }
+        for (size_t i = 0; i < hx711_count(); ++i) {
+            // таймаут или фильтр еще не выдал отсчет
+            if (raw[i] == HX711_RAW_INVALID || !weight_filter_push(&weight_filters[i], raw[i], &filtered[i])) {
+                filtered[i] = HX711_RAW_INVALID;
+            }
+        }
+        hx711_frame_to_mg(filtered, mg, hx711_count());
+        if (ble_telemetry_active()) {
+            ble_telemetry_push(now_ms, mg, hx711_count());
+            // в покое следующий кадр будет только через несколько секунд - не держим пакет
+            if (sample_sched_mode() == SAMPLE_MODE_IDLE) ble_telemetry_flush();
+        }
+
         for (size_t i = 0; i < hx711_count(); ++i) {
-            float weight = hx711_get_weight(i);  // вес в калиброванных единицах 
+            if (mg[i] == HX711_MG_INVALID) continue;
+            TRACE(TRACE_EV_SENSOR_MG, i, mg[i]);
 
-            if (prev_weights[i] - weight >= WEIGHT_DECREASE_THRESHOLD) {
-                ESP_LOGI(TAG, "Sensor %d: weight decreased from %.2f to %.2f (Δ = %.2f) → LED ON", 
-                         (int)i, prev_weights[i], weight, prev_weights[i] - weight);
+            pill_event_t ev;
+            bool fired = pill_detector_push(&pill_detectors[i], mg[i], now_ms, &ev);
+            if (pill_detector_state(&pill_detectors[i]) != PILL_DET_STABLE) changed = true;
+            if (!fired) continue;
 
-                led_set(i, 1); 
-                record_event((uint8_t)i);
-                ESP_LOGI(TAG, "LED %d turned ON due to weight decrease on sensor %d", (int)i, (int)i);
+            // фильтр догоняет кадр покоя за несколько отсчетов - момент касания берем из него
+            uint32_t moved_ms = ev.disturbed_ms;
+            if (idle_seen_ms[i] && ev.disturbed_ms - idle_seen_ms[i] <= IDLE_SEEN_MAX_MS) moved_ms = idle_seen_ms[i];
+            idle_seen_ms[i] = 0;
+            app_event_t pill = { .type = APP_EV_PILL, .pill = {
+                .sensor = (uint8_t)i, .removed = ev.type == PILL_EVENT_REMOVED,
+                .count = ev.count, .delta_mg = ev.delta_mg, .moved_ms = moved_ms } };
+            if (pill.pill.removed) {
+                ESP_LOGI(TAG, "Sensor %d: %d pill(s) removed (Δ = %" PRId32 " mg, settled in %" PRIu32 " ms) → LED ON",
+                         (int)i, ev.count, ev.delta_mg, ev.settled_ms - ev.disturbed_ms);
+                TRACE(TRACE_EV_PILL_REMOVED, i, ev.delta_mg);
+                // приём нельзя потерять: ждём место в очереди, запись делает только задача шины
+                while (event_bus_post_wait(&pill, PILL_POST_WAIT_MS) == ESP_ERR_TIMEOUT) {
+                    ESP_LOGW(TAG, "event bus stalled, sensor %d pill event held", (int)i);
+                }
+            } else {
+                TRACE(TRACE_EV_PILL_ADDED, i, ev.delta_mg);
+                ESP_LOGI(TAG, "Sensor %d: %d pill(s) added (Δ = %" PRId32 " mg)", (int)i, ev.count, ev.delta_mg);
+                event_bus_post(&pill);
             }
-            prev_weights[i] = weight;
-            ESP_LOGI(TAG, "Sensor %d: %.2f g", (int)i, weight);
         }
-
-        vTaskDelay(pdMS_TO_TICKS(500));
+        sample_sched_report(changed);
     }
 }
 
 void app_main(void) {
-
-    // initialize epoche time
-    initialize_sntp();
-    int retry = 0;
-    const int retry_count = 10;
-    while (esp_sntp_get_sync_status() != SNTP_SYNC_STATUS_COMPLETED && ++retry < retry_count) {
-        ESP_LOGI(TAG, "Waiting for SNTP sync...");
-        vTaskDelay(pdMS_TO_TICKS(1000));
-    }
-    if (esp_sntp_get_sync_status() != SNTP_SYNC_STATUS_COMPLETED) {
-        ESP_LOGW(TAG, "SNTP sync failed - time not set");
-    }
+    TRACE(TRACE_EV_BOOT, esp_reset_reason(), 0);
+    boot_phase_mark(BOOT_PHASE_APP_MAIN);
 
     // initialize NVS (required before starting BT/WiFi)
     esp_err_t ret = nvs_flash_init();
@@ -154,19 +520,67 @@ void app_main(void) {
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    clock_map_store_t clock_store;
+    clock_map_store_nvs("clock", &clock_store);
+    ret = clock_map_init(&clock_store);
+    if (ret != ESP_OK) ESP_LOGW(TAG, "clock table not saved: %s", esp_err_to_name(ret));
+    dose_sched_store_t dose_store;
+    dose_sched_store_nvs("dose", &dose_store);
+    ret = dose_sched_init(&dose_store);
+    if (ret != ESP_OK) ESP_LOGW(TAG, "dose schedule not loaded: %s", esp_err_to_name(ret));
+    time_sync_set_tz(dose_sched_tz());
+    dose_lock = xSemaphoreCreateMutex();
+    const esp_timer_create_args_t dose_timer_args = { .callback = dose_timer_cb, .name = "dose" };
+    ESP_ERROR_CHECK(esp_timer_create(&dose_timer_args, &dose_timer));
+    const esp_timer_create_args_t dose_retry_args = { .callback = dose_timer_cb, .name = "dose_retry" };
+    ESP_ERROR_CHECK(esp_timer_create(&dose_retry_args, &dose_retry_timer));
+    boot_phase_mark(BOOT_PHASE_NVS);
+
+    // журнал событий в отдельном разделе flash, переживает перезагрузку
+    event_log_flash_t evlog_flash;
+    ret = event_log_flash_partition("evlog", &evlog_flash);
+    if (ret == ESP_OK) ret = event_log_init(&evlog_flash);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "event log unavailable: %s", esp_err_to_name(ret));
+    }
+    boot_phase_mark(BOOT_PHASE_EVENT_LOG);
+
+    ret = event_bus_init(APP_SUBSCRIBERS, sizeof(APP_SUBSCRIBERS) / sizeof(APP_SUBSCRIBERS[0]));
+    if (ret != ESP_OK) ESP_LOGE(TAG, "event bus: %s", esp_err_to_name(ret));
 
     // init modules
     led_init(LED_PINS, 4);
     led_set_active_low(false);
     button_init(BUTTON_PINS, 4, on_button_event);
     hx711_init(HX711_DT, HX711_SCK, 4);
-    ble_init(ble_record_read_cb);
+    hx711_set_ready_irq(true);
+    boot_phase_mark(BOOT_PHASE_PERIPH);
+    record_store_preload();
+    static const sync_store_t sync_store = { .read = sync_store_read, .on_ack = sync_store_ack };
+    sync_proto_init(&sync_store, sync_load_ack());
+    export_queue = xQueueCreate(8, sizeof(export_cmd_t));
+    export_init(&ble_export, &ble_export_transport, NULL, sync_store_read);
+    ble_init(sync_proto_read, ble_ctrl_write, ble_conn_cb);
+    boot_phase_mark(BOOT_PHASE_BLE);
 
     // set example calibration factors (adjust after calibration)
     for (size_t i = 0; i < hx711_count(); ++i) hx711_set_calibration(i, 420.0f);
 
+    sample_sched_init(&SAMPLE_SCHED_CFG);
+
     // start sensor reader
-    xTaskCreate(sensor_task, "sensor_task", 4096, NULL, 5, NULL);
-    
+    metrics_set_sampler(metrics_sample);
+    xTaskCreate(sensor_task, "sensor_task", 4096, NULL, 5, &sensor_task_handle);
+    xTaskCreate(export_task, "export_task", 3072, NULL, 4, &export_task_handle);
+    if (uart_driver_install(CONSOLE_UART, 256, 0, 0, NULL, 0) == ESP_OK) {
+        xTaskCreate(console_task, "console_task", 3072, NULL, 1, NULL);
+    } else {
+        ESP_LOGW(TAG, "console input unavailable");
+    }
+    boot_phase_mark(BOOT_PHASE_TASKS);
+
+    // время суток не нужно для обнаружения - получаем его в фоне
+    initialize_sntp();
+
     ESP_LOGI(TAG, "Application initialized");
 }
@@ -0,0 +1,143 @@
+#include "metrics.h"
+#include "esp_timer.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define HIST_COUNT 2
+
+typedef struct {
+    uint8_t kind;
+    uint8_t hist;    // slot in hist[] for histograms
+    uint32_t base;   // upper bound of bucket 0
+} metric_desc_t;
+
+static const metric_desc_t DESC[METRIC_COUNT] = {
+    [METRIC_HX711_FRAMES] = { METRIC_KIND_COUNTER },
+    [METRIC_HX711_TIMEOUTS] = { METRIC_KIND_COUNTER },
+    // polling gives up after 20 ms, IRQ mode after 150 ms: the last bucket is >= 128 ms
+    [METRIC_HX711_READY_US] = { METRIC_KIND_HISTOGRAM, 0, 500 },
+    // 10 SPS bursts land below 128 ms, idle frames (1.4 s) below 2048 ms
+    [METRIC_SENSOR_PERIOD_MS] = { METRIC_KIND_HISTOGRAM, 1, 32 },
+    [METRIC_BLE_CONNECTS] = { METRIC_KIND_COUNTER },
+    [METRIC_BLE_CONNS] = { METRIC_KIND_GAUGE },
+    [METRIC_BLE_TLM_DROPPED] = { METRIC_KIND_COUNTER },
+    [METRIC_BUS_DROPPED] = { METRIC_KIND_COUNTER },
+    [METRIC_BUS_DEPTH_MAX] = { METRIC_KIND_GAUGE },
+    [METRIC_BTN_EDGES_DROPPED] = { METRIC_KIND_COUNTER },
+    [METRIC_HEAP_FREE_MIN] = { METRIC_KIND_GAUGE },
+    [METRIC_STACK_FREE_SENSOR] = { METRIC_KIND_GAUGE },
+    [METRIC_STACK_FREE_EXPORT] = { METRIC_KIND_GAUGE },
+    [METRIC_STACK_FREE_BUS] = { METRIC_KIND_GAUGE },
+    [METRIC_SCHED_MODE] = { METRIC_KIND_GAUGE },
+    [METRIC_SCHED_BURSTS] = { METRIC_KIND_COUNTER },
+    [METRIC_SCHED_POWER_UPS] = { METRIC_KIND_COUNTER },
+    [METRIC_SCHED_IDLE_S] = { METRIC_KIND_COUNTER },
+    [METRIC_SCHED_BURST_S] = { METRIC_KIND_COUNTER },
+};
+
+// header, [id][kind][u32] per metric, histograms add [buckets u8] and the counts
+_Static_assert(6 + METRIC_COUNT * 6 + HIST_COUNT * (1 + 4 * METRICS_HIST_BUCKETS) <= METRICS_ENCODED_MAX,
+               "METRICS_ENCODED_MAX too small");
+
+static atomic_uint scalar[METRIC_COUNT];
+static atomic_uint hist[HIST_COUNT][METRICS_HIST_BUCKETS];
+static void (*sampler)(void);
+
+static bool is_scalar(uint8_t id)
+{
+    return id < METRIC_COUNT && DESC[id].kind != METRIC_KIND_HISTOGRAM;
+}
+
+void metrics_inc(uint8_t id)
+{
+    if (is_scalar(id)) atomic_fetch_add_explicit(&scalar[id], 1, memory_order_relaxed);
+}
+
+void metrics_add(uint8_t id, int32_t delta)
+{
+    if (is_scalar(id)) atomic_fetch_add_explicit(&scalar[id], (unsigned)delta, memory_order_relaxed);
+}
+
+void metrics_set(uint8_t id, int32_t value)
+{
+    if (is_scalar(id)) atomic_store_explicit(&scalar[id], (unsigned)value, memory_order_relaxed);
+}
+
+void metrics_max(uint8_t id, int32_t value)
+{
+    if (!is_scalar(id)) return;
+    unsigned cur = atomic_load_explicit(&scalar[id], memory_order_relaxed);
+    while ((int32_t)cur < value &&
+           !atomic_compare_exchange_weak_explicit(&scalar[id], &cur, (unsigned)value, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+void metrics_observe(uint8_t id, uint32_t value)
+{
+    if (id >= METRIC_COUNT || DESC[id].kind != METRIC_KIND_HISTOGRAM) return;
+    uint32_t bound = DESC[id].base;
+    size_t b = 0;
+    while (b < METRICS_HIST_BUCKETS - 1 && value >= bound) {
+        bound <<= 1;
+        b++;
+    }
+    atomic_fetch_add_explicit(&hist[DESC[id].hist][b], 1, memory_order_relaxed);
+}
+
+int32_t metrics_get(uint8_t id)
+{
+    return is_scalar(id) ? (int32_t)atomic_load_explicit(&scalar[id], memory_order_relaxed) : 0;
+}
+
+void metrics_set_sampler(void (*fn)(void))
+{
+    sampler = fn;
+}
+
+static uint8_t *put_u32le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+    return p + 4;
+}
+
+size_t metrics_encode(uint8_t *buf, size_t len)
+{
+    if (!buf || len < METRICS_ENCODED_MAX) return 0;
+    if (sampler) sampler();
+    // each value is read once; the set is not one atomic snapshot, a counter may move meanwhile
+    uint8_t *p = buf;
+    *p++ = METRICS_VERSION;
+    *p++ = METRIC_COUNT;
+    p = put_u32le(p, (uint32_t)(esp_timer_get_time() / 1000));
+    for (uint8_t id = 0; id < METRIC_COUNT; ++id) {
+        const metric_desc_t *d = &DESC[id];
+        *p++ = id;
+        *p++ = d->kind;
+        if (d->kind != METRIC_KIND_HISTOGRAM) {
+            p = put_u32le(p, atomic_load_explicit(&scalar[id], memory_order_relaxed));
+            continue;
+        }
+        p = put_u32le(p, d->base);
+        *p++ = METRICS_HIST_BUCKETS;
+        for (size_t b = 0; b < METRICS_HIST_BUCKETS; ++b) {
+            p = put_u32le(p, atomic_load_explicit(&hist[d->hist][b], memory_order_relaxed));
+        }
+    }
+    return (size_t)(p - buf);
+}
+
+const uint8_t *metrics_snap_read(metrics_snap_t *snap, size_t *len)
+{
+    if (!snap->valid) {
+        snap->len = (uint16_t)metrics_encode(snap->buf, sizeof(snap->buf));
+        snap->valid = true;
+    }
+    *len = snap->len;
+    return snap->buf;
+}
+
+void metrics_snap_refresh(metrics_snap_t *snap)
+{
+    snap->valid = false;
+}
@@ -0,0 +1,133 @@
+#include "pill_detector.h"
+#include <string.h>
+
+// reference follows slow drift (temperature, creep) by 1/8 of the error per sample
+#define PILL_DET_DRIFT_SHIFT 3
+// A hand on the lid only ever adds weight, and a press held still looks settled.
+// Heavier levels (refills) must hold this many times longer; removals stay fast.
+#define PILL_DET_ADD_HOLD 4
+
+esp_err_t pill_detector_init(pill_detector_t *d, const pill_detector_cfg_t *cfg)
+{
+    if (!d || !cfg) return ESP_ERR_INVALID_ARG;
+    if (cfg->settle_samples == 0 || cfg->settle_band_mg <= 0 || cfg->min_change_mg <= 0) return ESP_ERR_INVALID_ARG;
+    // hysteresis: a disturbance must be wider than the settle band
+    if (cfg->disturb_mg <= cfg->settle_band_mg) return ESP_ERR_INVALID_ARG;
+
+    memset(d, 0, sizeof(*d));
+    d->cfg = *cfg;
+    d->state = PILL_DET_IDLE;
+    d->pill_mg = cfg->pill_mg;
+    return ESP_OK;
+}
+
+static void window_start(pill_detector_t *d, int32_t mg)
+{
+    d->win_sum = mg;
+    d->win_mean = mg;
+    d->win_min = mg;
+    d->win_max = mg;
+    d->win_count = 1;
+}
+
+static int32_t iabs32(int32_t v)
+{
+    return v < 0 ? -v : v;
+}
+
+// A new level has settled; decide whether it is an event.
+static bool level_settled(pill_detector_t *d, uint32_t t_ms, pill_event_t *ev)
+{
+    int32_t level = d->win_mean;
+    int32_t delta = d->ref_mg - level;
+    d->ref_mg = level;
+    d->state = PILL_DET_STABLE;
+
+    if (iabs32(delta) < d->cfg.min_change_mg) return false;  // transient, back to the old level
+
+    pill_event_t e = {
+        .type = delta > 0 ? PILL_EVENT_REMOVED : PILL_EVENT_ADDED,
+        .delta_mg = iabs32(delta),
+        .disturbed_ms = d->disturbed_ms,
+        .settled_ms = t_ms,
+    };
+    if (d->pill_mg <= 0) {
+        if (e.type == PILL_EVENT_REMOVED) d->pill_mg = e.delta_mg;
+        e.count = 1;
+    } else {
+        int32_t n = (e.delta_mg + d->pill_mg / 2) / d->pill_mg;
+        if (n < 1) n = 1;
+        if (n > 255) n = 255;
+        e.count = (uint8_t)n;
+        // refine the learned mass on unambiguous single-pill removals
+        if (e.type == PILL_EVENT_REMOVED && n == 1) d->pill_mg += (e.delta_mg - d->pill_mg) / 4;
+    }
+    if (ev) *ev = e;
+    return true;
+}
+
+bool pill_detector_push(pill_detector_t *d, int32_t mg, uint32_t t_ms, pill_event_t *ev)
+{
+    if (!d) return false;
+
+    switch (d->state) {
+    case PILL_DET_IDLE:
+        if (d->win_count == 0 || iabs32(mg - d->win_mean) > d->cfg.settle_band_mg) {
+            window_start(d, mg);
+            return false;
+        }
+        d->win_sum += mg;
+        d->win_count++;
+        d->win_mean = (int32_t)(d->win_sum / d->win_count);
+        if (d->win_count >= d->cfg.settle_samples) {
+            d->ref_mg = d->win_mean;
+            d->state = PILL_DET_STABLE;
+        }
+        return false;
+
+    case PILL_DET_STABLE:
+        if (iabs32(mg - d->ref_mg) <= d->cfg.disturb_mg) {
+            d->ref_mg += (mg - d->ref_mg) >> PILL_DET_DRIFT_SHIFT;
+            return false;
+        }
+        d->disturbed_ms = t_ms;
+        d->state = PILL_DET_DISTURBED;
+        window_start(d, mg);
+        return false;
+
+    case PILL_DET_DISTURBED:
+    case PILL_DET_SETTLING:
+        if (mg < d->win_min) d->win_min = mg;
+        if (mg > d->win_max) d->win_max = mg;
+        // a slow press passes the mean test near its peak but not the spread one
+        if (iabs32(mg - d->win_mean) > d->cfg.settle_band_mg || d->win_max - d->win_min > d->cfg.settle_band_mg) {
+            d->state = PILL_DET_DISTURBED;
+            window_start(d, mg);
+            return false;
+        }
+        d->state = PILL_DET_SETTLING;
+        d->win_sum += mg;
+        d->win_count++;
+        d->win_mean = (int32_t)(d->win_sum / d->win_count);
+        uint32_t need = d->cfg.settle_samples;
+        if (d->win_mean - d->ref_mg >= d->cfg.min_change_mg) need *= PILL_DET_ADD_HOLD;
+        if (d->win_count < need) return false;
+        return level_settled(d, t_ms, ev);
+    }
+    return false;
+}
+
+int32_t pill_detector_pill_mg(const pill_detector_t *d)
+{
+    return d ? d->pill_mg : 0;
+}
+
+pill_det_state_t pill_detector_state(const pill_detector_t *d)
+{
+    return d ? d->state : PILL_DET_IDLE;
+}
+
+int32_t pill_detector_ref_mg(const pill_detector_t *d)
+{
+    return d ? d->ref_mg : 0;
+}
@@ -0,0 +1,120 @@
+#include "record_codec.h"
+
+size_t record_codec_varint_put(uint8_t *out, size_t cap, uint64_t v)
+{
+    size_t n = 0;
+    do {
+        if (n >= cap) return 0;
+        uint8_t b = v & 0x7F;
+        v >>= 7;
+        out[n++] = b | (v ? 0x80 : 0);
+    } while (v);
+    return n;
+}
+
+size_t record_codec_varint_get(const uint8_t *in, size_t len, uint64_t *v)
+{
+    uint64_t r = 0;
+    for (size_t n = 0; n < len && n < 10; ++n) {
+        r |= (uint64_t)(in[n] & 0x7F) << (7 * n);
+        if (!(in[n] & 0x80)) {
+            *v = r;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+uint64_t record_codec_zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+int64_t record_codec_unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+size_t record_codec_encode_body(const record_t *recs, size_t n, uint32_t tick_ms,
+                                uint8_t *out, size_t cap, size_t *used)
+{
+    if (used) *used = 0;
+    if (!recs || !out || n == 0 || tick_ms == 0) return 0;
+
+    // absolute ticks, so the base costs no more precision than the deltas
+    int64_t prev = (int64_t)(recs[0].ts_ms / tick_ms);
+    size_t pos = record_codec_varint_put(out, cap, (uint64_t)prev);
+    if (pos == 0) return 0;
+
+    size_t i = 0;
+    for (; i < n; ++i) {
+        if (i > 0 && (recs[i].seq != recs[i - 1].seq + 1 || recs[i].boot != recs[0].boot)) break;
+        int64_t q = (int64_t)(recs[i].ts_ms / tick_ms);
+        uint64_t v = (record_codec_zigzag(q - prev) << 4) | (recs[i].val & RECORD_VAL_MASK);
+        size_t k = record_codec_varint_put(out + pos, cap - pos, v);
+        if (k == 0) break;
+        pos += k;
+        prev = q;
+    }
+    if (i == 0) return 0;
+    if (used) *used = pos;
+    return i;
+}
+
+size_t record_codec_decode_body(const uint8_t *in, size_t len, uint32_t first_seq, uint16_t boot,
+                                uint32_t tick_ms, record_t *out, size_t max)
+{
+    if (!in || !out || tick_ms == 0) return 0;
+    uint64_t base;
+    size_t pos = record_codec_varint_get(in, len, &base);
+    if (pos == 0) return 0;
+
+    int64_t q = (int64_t)base;
+    size_t i = 0;
+    for (; i < max && pos < len; ++i) {
+        uint64_t v;
+        size_t k = record_codec_varint_get(in + pos, len - pos, &v);
+        if (k == 0) break;
+        pos += k;
+        q += record_codec_unzigzag(v >> 4);
+        out[i].seq = first_seq + (uint32_t)i;
+        out[i].ts_ms = (uint64_t)(q * (int64_t)tick_ms);
+        out[i].boot = boot;
+        out[i].val = (uint8_t)(v & RECORD_VAL_MASK);
+    }
+    return i;
+}
+
+size_t record_codec_encode(const record_t *recs, size_t n, uint8_t *out, size_t cap, size_t *used)
+{
+    if (used) *used = 0;
+    if (!recs || !out || n == 0 || cap < RECORD_CODEC_HDR_MAX) return 0;
+
+    size_t pos = 0;
+    out[pos++] = RECORD_CODEC_MAGIC;
+    out[pos++] = RECORD_CODEC_VERSION;
+    pos += record_codec_varint_put(out + pos, cap - pos, recs[0].seq);
+    pos += record_codec_varint_put(out + pos, cap - pos, recs[0].boot == RECORD_BOOT_EPOCH ? 0 : recs[0].boot);
+
+    size_t body;
+    size_t cnt = record_codec_encode_body(recs, n, RECORD_CODEC_TICK_MS, out + pos, cap - pos, &body);
+    if (cnt == 0) return 0;
+    if (used) *used = pos + body;
+    return cnt;
+}
+
+int record_codec_decode(const uint8_t *in, size_t len, record_t *out, size_t max)
+{
+    if (!in || len < 2 || in[0] != RECORD_CODEC_MAGIC || in[1] != RECORD_CODEC_VERSION) return -1;
+    size_t pos = 2;
+    uint64_t seq, boot;
+    size_t k = record_codec_varint_get(in + pos, len - pos, &seq);
+    if (k == 0 || seq > UINT32_MAX) return -1;
+    pos += k;
+    k = record_codec_varint_get(in + pos, len - pos, &boot);
+    if (k == 0 || boot > RECORD_BOOT_MAX) return -1;
+    pos += k;
+    if (boot == 0) boot = RECORD_BOOT_EPOCH;
+    return (int)record_codec_decode_body(in + pos, len - pos, (uint32_t)seq, (uint16_t)boot, RECORD_CODEC_TICK_MS,
+                                         out, max);
+}
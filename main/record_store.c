@@ -0,0 +1,80 @@
+#include "record_store.h"
+#include <stdatomic.h>
+
+#define RECORD_STORE_MASK (RECORD_STORE_CAPACITY - 1)
+_Static_assert((RECORD_STORE_CAPACITY & RECORD_STORE_MASK) == 0, "capacity must be a power of two");
+
+typedef struct {
+    atomic_uint ver;  // odd while the producer writes the slot
+    record_t rec;
+} store_slot_t;
+
+static store_slot_t slots[RECORD_STORE_CAPACITY];
+static atomic_uint head_seq;  // seq of the next record to be pushed
+static atomic_uint base_seq;  // first seq after the last gap
+
+void record_store_init(uint32_t next_seq)
+{
+    for (size_t i = 0; i < RECORD_STORE_CAPACITY; ++i) atomic_init(&slots[i].ver, 0);
+    atomic_init(&base_seq, next_seq);
+    atomic_init(&head_seq, next_seq);
+}
+
+esp_err_t record_store_push(const record_t *rec)
+{
+    if (!rec) return ESP_ERR_INVALID_ARG;
+    uint32_t head = atomic_load_explicit(&head_seq, memory_order_relaxed);
+    if (rec->seq < head) return ESP_ERR_INVALID_ARG;
+    if (rec->seq != head) {
+        // older slots are no longer contiguous with the new one; readers clamp to base
+        atomic_store_explicit(&base_seq, rec->seq, memory_order_release);
+        head = rec->seq;
+    }
+
+    store_slot_t *slot = &slots[head & RECORD_STORE_MASK];
+    unsigned v = atomic_load_explicit(&slot->ver, memory_order_relaxed);
+    atomic_store_explicit(&slot->ver, v + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->rec = *rec;
+    atomic_store_explicit(&slot->ver, v + 2, memory_order_release);
+    atomic_store_explicit(&head_seq, head + 1, memory_order_release);
+    return ESP_OK;
+}
+
+static uint32_t first_seq(uint32_t head)
+{
+    uint32_t base = atomic_load_explicit(&base_seq, memory_order_acquire);
+    uint32_t lap = head > RECORD_STORE_CAPACITY ? head - RECORD_STORE_CAPACITY : 0;
+    return base > lap ? base : lap;
+}
+
+size_t record_store_read(uint32_t from_seq, record_t *out, size_t max)
+{
+    if (!out) return 0;
+    uint32_t head = atomic_load_explicit(&head_seq, memory_order_acquire);
+    if (from_seq < first_seq(head)) return 0;
+
+    size_t n = 0;
+    for (uint32_t s = from_seq; s < head && n < max; ++s) {
+        store_slot_t *slot = &slots[s & RECORD_STORE_MASK];
+        unsigned v1 = atomic_load_explicit(&slot->ver, memory_order_acquire);
+        if (v1 & 1) break;
+        record_t copy = slot->rec;
+        atomic_thread_fence(memory_order_acquire);
+        unsigned v2 = atomic_load_explicit(&slot->ver, memory_order_relaxed);
+        // rewritten while copying, or already holds a newer lap: the run ends here
+        if (v1 != v2 || copy.seq != s) break;
+        out[n++] = copy;
+    }
+    return n;
+}
+
+uint32_t record_store_first_seq(void)
+{
+    return first_seq(atomic_load_explicit(&head_seq, memory_order_acquire));
+}
+
+uint32_t record_store_next_seq(void)
+{
+    return atomic_load_explicit(&head_seq, memory_order_acquire);
+}
@@ -0,0 +1,105 @@
+#include "sample_sched.h"
+#include "hx711.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "trace.h"
+
+static sample_sched_cfg_t cfg;
+static SemaphoreHandle_t kick_sem = NULL;
+static sample_mode_t mode = SAMPLE_MODE_BURST;
+static int64_t last_change_us = 0;
+static int64_t mode_since_us = 0;
+static sample_sched_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void set_mode(sample_mode_t m)
+{
+    if (m == mode) return;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&stats_lock);
+    uint64_t spent_ms = (uint64_t)((now - mode_since_us) / 1000);
+    if (mode == SAMPLE_MODE_IDLE) {
+        stats.idle_ms += spent_ms;
+        stats.bursts++;
+    } else {
+        stats.burst_ms += spent_ms;
+    }
+    mode = m;
+    mode_since_us = now;
+    portEXIT_CRITICAL(&stats_lock);
+    TRACE(TRACE_EV_SCHED_MODE, m, 0);
+}
+
+esp_err_t sample_sched_init(const sample_sched_cfg_t *c)
+{
+    if (!c || c->idle_period_ms == 0) return ESP_ERR_INVALID_ARG;
+    if (kick_sem) return ESP_ERR_INVALID_STATE;
+    kick_sem = xSemaphoreCreateBinary();
+    if (!kick_sem) return ESP_ERR_NO_MEM;
+    cfg = *c;
+    // start in burst so the detectors get a reference right after boot
+    mode = SAMPLE_MODE_BURST;
+    last_change_us = mode_since_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+void sample_sched_wait(void)
+{
+    if (mode == SAMPLE_MODE_BURST) {
+        if (cfg.burst_period_ms) vTaskDelay(pdMS_TO_TICKS(cfg.burst_period_ms));
+        return;
+    }
+
+    hx711_power_down();
+    portENTER_CRITICAL(&stats_lock);
+    stats.power_downs++;
+    portEXIT_CRITICAL(&stats_lock);
+    bool kicked = xSemaphoreTake(kick_sem, pdMS_TO_TICKS(cfg.idle_period_ms)) == pdTRUE;
+    hx711_power_up();
+    portENTER_CRITICAL(&stats_lock);
+    stats.power_ups++;
+    portEXIT_CRITICAL(&stats_lock);
+    if (kicked) {
+        last_change_us = esp_timer_get_time();
+        set_mode(SAMPLE_MODE_BURST);
+    }
+    vTaskDelay(pdMS_TO_TICKS(cfg.wake_settle_ms));
+}
+
+void sample_sched_report(bool changed)
+{
+    int64_t now = esp_timer_get_time();
+    // a kick during a burst extends it
+    if (xSemaphoreTake(kick_sem, 0) == pdTRUE) changed = true;
+    if (changed) {
+        last_change_us = now;
+        set_mode(SAMPLE_MODE_BURST);
+    } else if (mode == SAMPLE_MODE_BURST && (now - last_change_us) >= (int64_t)cfg.quiet_timeout_ms * 1000) {
+        set_mode(SAMPLE_MODE_IDLE);
+    }
+}
+
+void sample_sched_kick(void)
+{
+    if (kick_sem) xSemaphoreGive(kick_sem);
+}
+
+sample_mode_t sample_sched_mode(void)
+{
+    return mode;
+}
+
+void sample_sched_get_stats(sample_sched_stats_t *out)
+{
+    if (!out) return;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    out->mode = mode;
+    uint64_t cur_ms = (uint64_t)((now - mode_since_us) / 1000);
+    if (mode == SAMPLE_MODE_IDLE) out->idle_ms += cur_ms;
+    else out->burst_ms += cur_ms;
+    portEXIT_CRITICAL(&stats_lock);
+}
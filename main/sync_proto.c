@@ -0,0 +1,120 @@
+#include "sync_proto.h"
+#include "record_codec.h"
+#include <string.h>
+
+// enough for a 512-byte read at ~3 bytes per record
+#define SYNC_READ_MAX_RECORDS 192
+
+typedef struct {
+    bool used;
+    uint16_t conn;
+    uint32_t cursor;
+    bool snap_valid;
+    size_t snap_len;
+    uint8_t snap[SYNC_PAYLOAD_MAX];
+} sync_session_t;
+
+static sync_store_t store;
+static sync_session_t sessions[SYNC_MAX_SESSIONS];
+static uint32_t acked = 0;
+static record_t read_buf[SYNC_READ_MAX_RECORDS];  // reads come from one task (BLE host)
+
+static sync_session_t *session_find(uint16_t conn)
+{
+    for (size_t i = 0; i < SYNC_MAX_SESSIONS; ++i) {
+        if (sessions[i].used && sessions[i].conn == conn) return &sessions[i];
+    }
+    return NULL;
+}
+
+static uint32_t get_u32le(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+esp_err_t sync_proto_init(const sync_store_t *s, uint32_t acked_seq)
+{
+    if (!s || !s->read) return ESP_ERR_INVALID_ARG;
+    store = *s;
+    acked = acked_seq;
+    memset(sessions, 0, sizeof(sessions));
+    return ESP_OK;
+}
+
+esp_err_t sync_proto_open(uint16_t conn)
+{
+    sync_session_t *ss = session_find(conn);
+    for (size_t i = 0; !ss && i < SYNC_MAX_SESSIONS; ++i) {
+        if (!sessions[i].used) ss = &sessions[i];
+    }
+    if (!ss) return ESP_ERR_NO_MEM;
+    ss->used = true;
+    ss->conn = conn;
+    ss->cursor = acked;
+    ss->snap_valid = false;
+    return ESP_OK;
+}
+
+void sync_proto_close(uint16_t conn)
+{
+    sync_session_t *ss = session_find(conn);
+    if (ss) ss->used = false;
+}
+
+esp_err_t sync_proto_write(uint16_t conn, const uint8_t *data, size_t len)
+{
+    sync_session_t *ss = session_find(conn);
+    if (!ss) return ESP_ERR_INVALID_STATE;
+    if (!data || len != 5) return ESP_ERR_INVALID_ARG;
+
+    uint32_t seq = get_u32le(data + 1);
+    ss->snap_valid = false;
+    switch (data[0]) {
+    case SYNC_OP_FROM:
+    case SYNC_OP_EXPORT:
+        ss->cursor = seq;
+        return ESP_OK;
+    case SYNC_OP_ACK:
+        ss->cursor = seq;
+        if (seq > acked) {
+            acked = seq;
+            if (store.on_ack) store.on_ack(acked);
+        }
+        return ESP_OK;
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+}
+
+static void snapshot_build(sync_session_t *ss)
+{
+    size_t count = store.read(ss->cursor, read_buf, SYNC_READ_MAX_RECORDS);
+    size_t used = 0;
+    if (count == 0 || record_codec_encode(read_buf, count, ss->snap, sizeof(ss->snap), &used) == 0) used = 0;
+    ss->snap_len = used;
+    ss->snap_valid = true;
+}
+
+const uint8_t *sync_proto_read(uint16_t conn, uint16_t mtu, size_t *len)
+{
+    sync_session_t *ss = session_find(conn);
+    if (len) *len = 0;
+    if (!ss || !len) return NULL;
+    if (!ss->snap_valid) snapshot_build(ss);
+    *len = ss->snap_len;
+    // a payload that fits one Read Response is not continued with Read Blob, the next read
+    // takes a fresh snapshot; a longer one is pinned so every blob offset sees the same bytes
+    if (ss->snap_len + 1 < mtu) ss->snap_valid = false;
+    return ss->snap;
+}
+
+uint32_t sync_proto_cursor(uint16_t conn)
+{
+    sync_session_t *ss = session_find(conn);
+    return ss ? ss->cursor : 0;
+}
+
+uint32_t sync_proto_acked(void)
+{
+    return acked;
+}
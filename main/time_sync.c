@@ -0,0 +1,136 @@
+#include "time_sync.h"
+#include "trace.h"
+#include "boot_phase.h"
+#include "clock_map.h"
+#include "event_bus.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <sys/time.h>
+
+static const char *TAG = "time_sync";
+static volatile time_src_t source = TIME_SRC_NONE;
+static volatile int16_t local_tz_min;   // local = UTC + offset, the DOSE_OP_TZ value
+static int16_t cts_tz_min;              // offset the last CTS write was converted with
+
+// days since 1970-01-01 for a proleptic Gregorian date
+static int64_t days_from_civil(int y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+static unsigned days_in_month(int y, unsigned m)
+{
+    static const uint8_t DAYS[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    return DAYS[m - 1] + (m == 2 && leap);
+}
+
+static void civil_from_days(int64_t z, int *y, unsigned *m, unsigned *d)
+{
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = (int)(yoe + era * 400) + (*m <= 2);
+}
+
+esp_err_t time_sync_set(uint64_t epoch_ms, time_src_t src)
+{
+    struct timeval tv = {
+        .tv_sec = (time_t)(epoch_ms / 1000),
+        .tv_usec = (suseconds_t)((epoch_ms % 1000) * 1000),
+    };
+    if (settimeofday(&tv, NULL) != 0) return ESP_FAIL;
+    time_sync_note(src);
+    return ESP_OK;
+}
+
+void time_sync_note(time_src_t src)
+{
+    if (source == TIME_SRC_NONE) ESP_LOGI(TAG, "wall clock set (source %d)", (int)src);
+    // every correction goes into the offset table, records keep their uptime stamps
+    clock_map_sync((uint64_t)(esp_timer_get_time() / 1000), time_sync_epoch_ms());
+    source = src;
+    TRACE(TRACE_EV_TIME_SYNC, src, 0);
+    boot_phase_mark(BOOT_PHASE_TIME_SYNC);
+    app_event_t ev = { .type = APP_EV_TIME_SYNC, .time.src = (uint8_t)src };
+    event_bus_post(&ev);
+}
+
+bool time_sync_valid(void)
+{
+    return source != TIME_SRC_NONE;
+}
+
+time_src_t time_sync_source(void)
+{
+    return source;
+}
+
+void time_sync_set_tz(int16_t offset_min)
+{
+    local_tz_min = offset_min;
+    // a phone clock taken with another offset was off by the difference
+    if (source == TIME_SRC_BLE && offset_min != cts_tz_min) {
+        int64_t shift_ms = ((int64_t)offset_min - cts_tz_min) * 60000;
+        cts_tz_min = offset_min;
+        time_sync_set((uint64_t)((int64_t)time_sync_epoch_ms() - shift_ms), TIME_SRC_BLE);
+    }
+}
+
+uint64_t time_sync_epoch_ms(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000ULL + (uint64_t)(tv.tv_usec / 1000);
+}
+
+esp_err_t time_sync_from_cts(const uint8_t *data, size_t len)
+{
+    if (!data || len < 7) return ESP_ERR_INVALID_SIZE;
+    int year = data[0] | (data[1] << 8);
+    unsigned month = data[2], day = data[3], h = data[4], min = data[5], s = data[6];
+    // year 0 / month 0 / day 0 mean "unknown" in CTS
+    if (year < 2020 || year > 2099 || month < 1 || month > 12 || day < 1 ||
+        day > days_in_month(year, month) || h > 23 || min > 59 || s > 59) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // data[7] is the day of week, derived from the date anyway
+    uint32_t frac_ms = len >= 9 ? (uint32_t)data[8] * 1000 / 256 : 0;
+    int16_t tz = local_tz_min;
+    int64_t secs = days_from_civil(year, month, day) * 86400 + h * 3600 + min * 60 + s - tz * 60;
+    esp_err_t err = time_sync_set((uint64_t)secs * 1000 + frac_ms, TIME_SRC_BLE);
+    if (err == ESP_OK) cts_tz_min = tz;
+    return err;
+}
+
+size_t time_sync_to_cts(uint8_t *out, size_t cap)
+{
+    if (!out || cap < TIME_CTS_LEN) return 0;
+    uint64_t ms = time_sync_epoch_ms() + (int64_t)local_tz_min * 60000;
+    int64_t days = (int64_t)(ms / 86400000ULL);
+    uint32_t rem = (uint32_t)((ms / 1000) % 86400);
+    int y;
+    unsigned m, d;
+    civil_from_days(days, &y, &m, &d);
+    out[0] = (uint8_t)y;
+    out[1] = (uint8_t)(y >> 8);
+    out[2] = (uint8_t)m;
+    out[3] = (uint8_t)d;
+    out[4] = (uint8_t)(rem / 3600);
+    out[5] = (uint8_t)(rem / 60 % 60);
+    out[6] = (uint8_t)(rem % 60);
+    out[7] = (uint8_t)((days + 3) % 7 + 1);  // 1970-01-01 was a Thursday; CTS Monday = 1
+    out[8] = (uint8_t)((ms % 1000) * 256 / 1000);
+    out[9] = 0;
+    return TIME_CTS_LEN;
+}
@@ -0,0 +1,217 @@
+#include "trace.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TRACE_MASK (TRACE_RING_LEN - 1)
+_Static_assert((TRACE_RING_LEN & TRACE_MASK) == 0, "ring length must be a power of two");
+_Static_assert(sizeof(trace_rec_t) == 16, "records are 16 bytes on the wire");
+_Static_assert(1 + TRACE_TASKS_MAX * (4 + TRACE_TASK_NAME_LEN) <= TRACE_WINDOW_MAX, "name window too long");
+
+#define TRACE_CORES 2
+#define TRACE_DUMP_BATCH 16
+
+typedef struct {
+    atomic_uint handle;   // 0 until the name is written
+    char name[TRACE_TASK_NAME_LEN];
+} trace_task_t;
+
+typedef struct {
+    uint32_t handle;
+    char name[TRACE_TASK_NAME_LEN];
+} task_name_t;
+
+static trace_rec_t ring[TRACE_RING_LEN];
+static atomic_uint head;
+static atomic_bool frozen;
+
+// name per task handle, filled the first time a task is switched in
+static trace_task_t tasks[TRACE_TASKS_MAX];
+static atomic_uint task_count;
+static uint32_t last_in[TRACE_CORES];
+
+static uint16_t window_first;
+
+void IRAM_ATTR trace_emit(uint16_t id, int32_t a0, int32_t a1)
+{
+    if (atomic_load_explicit(&frozen, memory_order_relaxed)) return;
+    unsigned idx = atomic_fetch_add_explicit(&head, 1, memory_order_relaxed);
+    trace_rec_t *r = &ring[idx & TRACE_MASK];
+    // a seq no reader expects for this slot, so the payload is never paired with the old one
+    r->seq = (uint16_t)(idx + 0x8000);
+    atomic_thread_fence(memory_order_release);
+    r->ts_us = (uint32_t)esp_timer_get_time();
+    r->id = id;
+    r->a0 = a0;
+    r->a1 = a1;
+    atomic_thread_fence(memory_order_release);
+    r->seq = (uint16_t)idx;
+}
+
+void IRAM_ATTR trace_emit_core(uint16_t id, int32_t a0)
+{
+    trace_emit(id, a0, (int32_t)esp_cpu_get_core_id());
+}
+
+static void IRAM_ATTR task_remember(uint32_t handle, TaskHandle_t task)
+{
+    unsigned n = atomic_load_explicit(&task_count, memory_order_acquire);
+    for (unsigned i = 0; i < n && i < TRACE_TASKS_MAX; ++i) {
+        if (atomic_load_explicit(&tasks[i].handle, memory_order_relaxed) == handle) return;
+    }
+    // both cores may add the same task at once; a duplicate name entry is harmless
+    unsigned slot = atomic_fetch_add_explicit(&task_count, 1, memory_order_relaxed);
+    if (slot >= TRACE_TASKS_MAX) return;
+    strncpy(tasks[slot].name, pcTaskGetName(task), TRACE_TASK_NAME_LEN);
+    atomic_store_explicit(&tasks[slot].handle, handle, memory_order_release);
+}
+
+void IRAM_ATTR trace_task_switched_in(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    uint32_t handle = (uint32_t)(uintptr_t)task;
+    unsigned core = (unsigned)esp_cpu_get_core_id();
+    // the scheduler also runs on ticks that keep the same task: nothing to record
+    if (!task || core >= TRACE_CORES || last_in[core] == handle) return;
+    last_in[core] = handle;
+    task_remember(handle, task);
+    trace_emit(TRACE_EV_TASK_IN, (int32_t)handle, (int32_t)core);
+}
+
+static size_t copy_range(unsigned start, unsigned end, trace_rec_t *out, size_t max)
+{
+    size_t n = 0;
+    for (unsigned i = start; i != end && n < max; ++i) {
+        trace_rec_t r = ring[i & TRACE_MASK];
+        atomic_thread_fence(memory_order_acquire);
+        if (r.seq != (uint16_t)i || ring[i & TRACE_MASK].seq != (uint16_t)i) continue;
+        out[n++] = r;
+    }
+    return n;
+}
+
+static unsigned oldest(unsigned end)
+{
+    return end > TRACE_RING_LEN ? end - TRACE_RING_LEN : 0;
+}
+
+size_t trace_snapshot(trace_rec_t *out, size_t max)
+{
+    if (!out) return 0;
+    unsigned end = atomic_load_explicit(&head, memory_order_acquire);
+    unsigned start = oldest(end);
+    if (end - start > max) start = end - (unsigned)max;
+    return copy_range(start, end, out, max);
+}
+
+void trace_freeze(bool on)
+{
+    atomic_store_explicit(&frozen, on, memory_order_release);
+}
+
+size_t trace_count(void)
+{
+    unsigned end = atomic_load_explicit(&head, memory_order_acquire);
+    return end - oldest(end);
+}
+
+size_t trace_read(size_t first, trace_rec_t *out, size_t max)
+{
+    if (!out) return 0;
+    unsigned end = atomic_load_explicit(&head, memory_order_acquire);
+    unsigned start = oldest(end);
+    if (first >= end - start) return 0;
+    return copy_range(start + (unsigned)first, end, out, max);
+}
+
+static size_t task_names(task_name_t *out)
+{
+    unsigned n = atomic_load_explicit(&task_count, memory_order_acquire);
+    size_t k = 0;
+    for (unsigned i = 0; i < n && i < TRACE_TASKS_MAX; ++i) {
+        uint32_t h = atomic_load_explicit(&tasks[i].handle, memory_order_acquire);
+        if (!h) continue;
+        out[k].handle = h;
+        memcpy(out[k].name, tasks[i].name, TRACE_TASK_NAME_LEN);
+        k++;
+    }
+    return k;
+}
+
+void trace_dump(void)
+{
+    // printed straight from the ring, so no second ring-sized buffer is needed
+    static const char HEX[] = "0123456789abcdef";
+    bool was = atomic_exchange(&frozen, true);
+    trace_rec_t batch[TRACE_DUMP_BATCH];
+    size_t total = trace_count();
+    printf("TRC-BEGIN %u %u\n", (unsigned)total, (unsigned)sizeof(trace_rec_t));
+    size_t got;
+    for (size_t first = 0; (got = trace_read(first, batch, TRACE_DUMP_BATCH)) > 0; first += got) {
+        for (size_t i = 0; i < got; ++i) {
+            // one write per line, so log output of other tasks cannot split a record
+            const uint8_t *b = (const uint8_t *)&batch[i];
+            char line[4 + 2 * sizeof(trace_rec_t) + 2];
+            char *p = line + 4;
+            memcpy(line, "TRC ", 4);
+            for (size_t k = 0; k < sizeof(trace_rec_t); ++k) {
+                *p++ = HEX[b[k] >> 4];
+                *p++ = HEX[b[k] & 0xF];
+            }
+            *p++ = '\n';
+            *p = '\0';
+            fputs(line, stdout);
+        }
+    }
+    static task_name_t names[TRACE_TASKS_MAX];
+    size_t n = task_names(names);
+    for (size_t i = 0; i < n; ++i) {
+        printf("TRC-TASK %08x %.*s\n", (unsigned)names[i].handle, TRACE_TASK_NAME_LEN, names[i].name);
+    }
+    printf("TRC-END\n");
+    atomic_store(&frozen, was);
+}
+
+esp_err_t trace_window_select(const uint8_t *data, size_t len)
+{
+    if (!data || len != 2) return ESP_ERR_INVALID_ARG;
+    window_first = (uint16_t)(data[0] | (data[1] << 8));
+    trace_freeze(window_first != TRACE_WINDOW_DONE);
+    return ESP_OK;
+}
+
+static uint8_t *put_u16le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+size_t trace_window_read(uint8_t *buf, size_t len)
+{
+    if (!buf || len < TRACE_WINDOW_MAX) return 0;
+    uint8_t *p = buf;
+    if (window_first == TRACE_WINDOW_NAMES) {
+        static task_name_t names[TRACE_TASKS_MAX];
+        size_t n = task_names(names);
+        *p++ = (uint8_t)n;
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t h = names[i].handle;
+            p = put_u16le(put_u16le(p, h), h >> 16);
+            memcpy(p, names[i].name, TRACE_TASK_NAME_LEN);
+            p += TRACE_TASK_NAME_LEN;
+        }
+        return (size_t)(p - buf);
+    }
+    if (window_first == TRACE_WINDOW_DONE) return 0;
+    trace_rec_t recs[TRACE_WINDOW_RECORDS];
+    size_t n = trace_read(window_first, recs, TRACE_WINDOW_RECORDS);
+    p = put_u16le(p, (uint32_t)trace_count());
+    p = put_u16le(p, window_first);
+    memcpy(p, recs, n * sizeof(trace_rec_t));
+    return 4 + n * sizeof(trace_rec_t);
+}
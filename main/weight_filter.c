@@ -0,0 +1,93 @@
+#include "weight_filter.h"
+#include <string.h>
+
+esp_err_t weight_filter_init(weight_filter_t *f, const weight_filter_cfg_t *cfg)
+{
+    if (!f || !cfg) return ESP_ERR_INVALID_ARG;
+    if (cfg->median_len == 0 || cfg->median_len > WEIGHT_FILTER_MEDIAN_MAX || !(cfg->median_len & 1)) return ESP_ERR_INVALID_ARG;
+    if (cfg->smooth == WEIGHT_FILTER_SMOOTH_AVG && (cfg->avg_len == 0 || cfg->avg_len > WEIGHT_FILTER_AVG_MAX)) return ESP_ERR_INVALID_ARG;
+    if (cfg->smooth == WEIGHT_FILTER_SMOOTH_IIR && cfg->iir_shift > WEIGHT_FILTER_IIR_SHIFT_MAX) return ESP_ERR_INVALID_ARG;
+    if (cfg->decimate == 0) return ESP_ERR_INVALID_ARG;
+
+    memset(f, 0, sizeof(*f));
+    f->cfg = *cfg;
+    return ESP_OK;
+}
+
+void weight_filter_reset(weight_filter_t *f)
+{
+    if (!f) return;
+    weight_filter_cfg_t cfg = f->cfg;
+    memset(f, 0, sizeof(*f));
+    f->cfg = cfg;
+}
+
+static int32_t median_stage(weight_filter_t *f, int32_t x)
+{
+    uint8_t n = f->cfg.median_len;
+    if (n == 1) return x;
+
+    f->med_buf[f->med_pos] = x;
+    f->med_pos = (f->med_pos + 1) % n;
+    if (f->med_fill < n) f->med_fill++;
+
+    // insertion sort of at most 7 values
+    int32_t tmp[WEIGHT_FILTER_MEDIAN_MAX];
+    uint8_t cnt = f->med_fill;
+    for (uint8_t i = 0; i < cnt; ++i) {
+        int32_t v = f->med_buf[i];
+        int j = i;
+        while (j > 0 && tmp[j - 1] > v) {
+            tmp[j] = tmp[j - 1];
+            --j;
+        }
+        tmp[j] = v;
+    }
+    return tmp[cnt / 2];
+}
+
+static int32_t avg_stage(weight_filter_t *f, int32_t x)
+{
+    uint8_t n = f->cfg.avg_len;
+    if (f->avg_fill == n) {
+        f->avg_sum -= f->avg_buf[f->avg_pos];
+    } else {
+        f->avg_fill++;
+    }
+    f->avg_buf[f->avg_pos] = x;
+    f->avg_sum += x;
+    f->avg_pos = (f->avg_pos + 1) % n;
+    return (int32_t)(f->avg_sum / f->avg_fill);
+}
+
+static int32_t iir_stage(weight_filter_t *f, int32_t x)
+{
+    uint8_t s = f->cfg.iir_shift;
+    if (!f->iir_primed) {
+        f->iir_acc = x * (1 << s);
+        f->iir_primed = true;
+    } else {
+        f->iir_acc += x - (f->iir_acc >> s);
+    }
+    return f->iir_acc >> s;
+}
+
+bool weight_filter_push(weight_filter_t *f, int32_t in, int32_t *out)
+{
+    if (!f) return false;
+    int32_t v = median_stage(f, in);
+    switch (f->cfg.smooth) {
+    case WEIGHT_FILTER_SMOOTH_AVG:
+        v = avg_stage(f, v);
+        break;
+    case WEIGHT_FILTER_SMOOTH_IIR:
+        v = iir_stage(f, v);
+        break;
+    default:
+        break;
+    }
+    if (++f->dec_count < f->cfg.decimate) return false;
+    f->dec_count = 0;
+    if (out) *out = v;
+    return true;
+}
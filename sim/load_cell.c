@@ -0,0 +1,147 @@
+#include "load_cell.h"
+#include "sim.h"
+#include <math.h>
+#include <stdbool.h>
+
+#define CONV_PERIOD_US 100000ULL    // 10 SPS
+#define SETTLE_US 400000ULL         // first conversion after power-up or reset
+#define POWER_DOWN_US 60            // SCK high longer than this
+#define DATA_BITS 24
+
+typedef struct {
+    load_cell_cfg_t cfg;
+    bool attached;
+    int32_t load_mg;
+    uint64_t rng;
+    uint64_t origin_us;     // power-up; conversion k (1-based) ends at origin + settle + (k-1) * period
+    uint64_t consumed;      // conversions already clocked out
+    bool sck_high;
+    uint64_t sck_rise_us;
+    bool shifting;          // a word is being clocked out
+    int pulses;             // SCK pulses of the current read
+    int gain_pulses;        // pulses of the last read select the gain of the next conversion
+    uint32_t word;
+    int dout;
+    load_cell_stats_t stats;
+} cell_t;
+
+static cell_t cells[LOAD_CELL_MAX];
+
+static uint64_t conversions_done(const cell_t *c, uint64_t now)
+{
+    if (now < c->origin_us + SETTLE_US) return 0;
+    return (now - c->origin_us - SETTLE_US) / CONV_PERIOD_US + 1;
+}
+
+static bool powered(const cell_t *c, uint64_t now)
+{
+    return !(c->sck_high && now - c->sck_rise_us > POWER_DOWN_US);
+}
+
+// xorshift64* and Box-Muller: reproducible for a given seed
+static double uniform(cell_t *c)
+{
+    c->rng ^= c->rng >> 12;
+    c->rng ^= c->rng << 25;
+    c->rng ^= c->rng >> 27;
+    return ((c->rng * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gauss(cell_t *c)
+{
+    double u = uniform(c), v = uniform(c);
+    if (u < 1e-300) u = 1e-300;
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static uint32_t sample(cell_t *c, uint64_t now)
+{
+    double drift = c->cfg.drift_mg * sin(2.0 * M_PI * (double)(now % SIM_S(86400)) / (double)SIM_S(86400));
+    double raw = c->cfg.zero_raw + (c->load_mg + drift) * c->cfg.counts_per_g / 1000.0 +
+                 c->cfg.noise_counts * gauss(c);
+    if (c->gain_pulses == 26) raw /= 4;        // channel B, gain 32
+    else if (c->gain_pulses == 27) raw /= 2;   // channel A, gain 64
+    int32_t v = (int32_t)lround(raw);
+    if (v > 0x7FFFFF) v = 0x7FFFFF;
+    if (v < -0x800000) v = -0x800000;
+    return (uint32_t)v & 0xFFFFFF;
+}
+
+static int dout_level(void *ctx)
+{
+    cell_t *c = ctx;
+    uint64_t now = sim_now_us();
+    if (!powered(c, now)) return 1;
+    // a finished read keeps DOUT high until the next conversion completes
+    if (c->shifting && conversions_done(c, now) > c->consumed) c->shifting = false;
+    if (c->shifting) return c->dout;
+    return conversions_done(c, now) > c->consumed ? 0 : 1;
+}
+
+static uint64_t dout_next_edge(void *ctx)
+{
+    cell_t *c = ctx;
+    uint64_t now = sim_now_us();
+    if (!powered(c, now) || dout_level(c) == 0) return SIM_NEVER;
+    uint64_t k = conversions_done(c, now);
+    if (k < c->consumed) k = c->consumed;
+    return c->origin_us + SETTLE_US + k * CONV_PERIOD_US;
+}
+
+static void sck_changed(void *ctx, int pin, int level)
+{
+    cell_t *c = ctx;
+    uint64_t now = sim_now_us();
+    if (level) {
+        c->sck_high = true;
+        c->sck_rise_us = now;
+        if (!c->shifting && dout_level(c) == 0) {
+            c->shifting = true;
+            c->pulses = 0;
+            c->word = sample(c, now);
+            c->consumed = conversions_done(c, now);
+            c->stats.conversions++;
+        }
+        if (!c->shifting) return;
+        c->pulses++;
+        c->dout = c->pulses <= DATA_BITS ? (int)((c->word >> (DATA_BITS - c->pulses)) & 1) : 1;
+        if (c->pulses > DATA_BITS) c->gain_pulses = c->pulses;
+        return;
+    }
+    bool was_down = c->sck_high && now - c->sck_rise_us > POWER_DOWN_US;
+    c->sck_high = false;
+    if (was_down) {
+        // power-up resets to channel A, gain 128, and restarts the settling time
+        c->origin_us = now;
+        c->consumed = 0;
+        c->shifting = false;
+        c->gain_pulses = 25;
+        c->stats.power_ups++;
+    }
+}
+
+void load_cell_attach(size_t idx, const load_cell_cfg_t *cfg)
+{
+    if (idx >= LOAD_CELL_MAX) return;
+    cell_t *c = &cells[idx];
+    *c = (cell_t){ .cfg = *cfg, .attached = true, .rng = cfg->seed * 2654435761ULL + 1, .gain_pulses = 25,
+                   .origin_us = sim_now_us() };
+    const sim_pad_driver_t drv = { .ctx = c, .level = dout_level, .next_edge = dout_next_edge };
+    sim_gpio_attach(cfg->dt, &drv);
+    sim_gpio_watch(cfg->sck, sck_changed, c);
+}
+
+void load_cell_set_mg(size_t idx, int32_t mg)
+{
+    if (idx < LOAD_CELL_MAX) cells[idx].load_mg = mg;
+}
+
+int32_t load_cell_mg(size_t idx)
+{
+    return idx < LOAD_CELL_MAX ? cells[idx].load_mg : 0;
+}
+
+void load_cell_get_stats(size_t idx, load_cell_stats_t *out)
+{
+    if (idx < LOAD_CELL_MAX) *out = cells[idx].stats;
+}
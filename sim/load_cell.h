@@ -0,0 +1,31 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// HX711 plus load cell at the pin level: DOUT/PD_SCK behave like the datasheet
+// (10 SPS, 400 ms settling after power-up, SCK high > 60 us powers down, the
+// 25th..27th pulse selects the next gain) so the firmware's real GPIO backend
+// runs unchanged. The signal is the scripted load plus a daily thermal drift and
+// Gaussian noise from a seeded generator.
+#define LOAD_CELL_MAX 4
+
+typedef struct {
+    int dt;
+    int sck;
+    int32_t zero_raw;       // reading with nothing on the cell, gain 128
+    int32_t counts_per_g;   // sensitivity at gain 128
+    int32_t noise_counts;   // RMS noise
+    int32_t drift_mg;       // amplitude of the 24 h drift
+    uint32_t seed;
+} load_cell_cfg_t;
+
+typedef struct {
+    uint32_t conversions;   // conversions clocked out by the firmware
+    uint32_t power_ups;
+} load_cell_stats_t;
+
+void load_cell_attach(size_t idx, const load_cell_cfg_t *cfg);
+// load on the cell from now on
+void load_cell_set_mg(size_t idx, int32_t mg);
+int32_t load_cell_mg(size_t idx);
+void load_cell_get_stats(size_t idx, load_cell_stats_t *out);
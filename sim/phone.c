@@ -0,0 +1,186 @@
+#include "phone.h"
+#include "sim.h"
+#include "sim_ble.h"
+#include "sync_proto.h"
+#include "export.h"
+#include "record_codec.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PHONE_CONN 1
+#define PHONE_MTU 185
+#define SESSION_MAX_US SIM_S(60)
+#define LINGER_US SIM_S(2)
+
+static int64_t epoch0;
+static int16_t tz;
+static dose_slot_t table[DOSE_SLOTS];
+static size_t table_len;
+static uint32_t next_seq;        // everything below is stored (the log starts at 1)
+static uint32_t session;         // invalidates the timeout of an ended session
+static bool connected;
+static record_t *store;
+static size_t store_len, store_cap;
+static phone_stats_t stats;
+static uint8_t metrics[METRICS_ENCODED_MAX];
+static size_t metrics_len;
+
+static void put_u32le(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void write_ctrl(const uint8_t *data, size_t len)
+{
+    sim_ble_write(PHONE_CONN, SIM_BLE_UUID_CTRL, data, len);
+}
+
+static void write_time(void)
+{
+    // Current Time is local time
+    int64_t us = epoch0 + (int64_t)sim_now_us();
+    time_t secs = (time_t)(us / 1000000) + (time_t)tz * 60;
+    struct tm tm;
+    gmtime_r(&secs, &tm);
+    int year = tm.tm_year + 1900;
+    uint8_t cts[10] = {
+        (uint8_t)year, (uint8_t)(year >> 8), (uint8_t)(tm.tm_mon + 1), (uint8_t)tm.tm_mday,
+        (uint8_t)tm.tm_hour, (uint8_t)tm.tm_min, (uint8_t)tm.tm_sec,
+        (uint8_t)(tm.tm_wday ? tm.tm_wday : 7), (uint8_t)((us % 1000000) * 256 / 1000000), 0,
+    };
+    sim_ble_write(PHONE_CONN, SIM_BLE_UUID_CTS, cts, sizeof(cts));
+}
+
+static void end_session(void *arg)
+{
+    if ((uint32_t)(uintptr_t)arg != session || !connected) return;
+    connected = false;
+    session++;
+    sim_ble_disconnect(PHONE_CONN);
+}
+
+static void begin_session(void)
+{
+    session++;
+    connected = true;
+    stats.sessions++;
+    sim_ble_connect(PHONE_CONN, PHONE_MTU, SIM_BLE_SUB_EVENT | SIM_BLE_SUB_EXPORT);
+    write_time();
+    sim_at(sim_now_us() + SESSION_MAX_US, end_session, (void *)(uintptr_t)session);
+}
+
+static void setup_cb(void *arg)
+{
+    begin_session();
+    uint8_t op[DOSE_OP_SET_LEN] = { DOSE_OP_TZ, (uint8_t)tz, (uint8_t)((uint16_t)tz >> 8) };
+    write_ctrl(op, DOSE_OP_TZ_LEN);
+    for (size_t i = 0; i < table_len; ++i) {
+        const dose_slot_t *s = &table[i];
+        uint8_t set[DOSE_OP_SET_LEN] = { DOSE_OP_SET, (uint8_t)i, s->comp, s->days, (uint8_t)s->minute,
+                                         (uint8_t)(s->minute >> 8), s->early_min, s->on_time_min, s->late_min };
+        write_ctrl(set, sizeof(set));
+    }
+    sim_at(sim_now_us() + LINGER_US, end_session, (void *)(uintptr_t)session);
+}
+
+static void sync_cb(void *arg)
+{
+    begin_session();
+    uint8_t op[5] = { SYNC_OP_EXPORT };
+    put_u32le(op + 1, next_seq);
+    write_ctrl(op, sizeof(op));
+}
+
+static void on_export(void *ctx, uint16_t conn, const uint8_t *data, size_t len)
+{
+    export_chunk_t ch;
+    if (export_parse_chunk(data, len, &ch) != ESP_OK) {
+        stats.bad_chunks++;
+        return;
+    }
+    stats.chunks++;
+    record_t recs[EXPORT_CHUNK_MAX];   // at least one byte per record
+    int n = record_codec_decode(ch.payload, ch.len, recs, sizeof(recs) / sizeof(recs[0]));
+    if (n < 0) {
+        stats.bad_chunks++;
+        return;
+    }
+    for (int i = 0; i < n; ++i) {
+        if (recs[i].seq < next_seq) continue;   // resent: keep the stored copy
+        if (store_len == store_cap) {
+            store_cap = store_cap ? store_cap * 2 : 256;
+            store = realloc(store, store_cap * sizeof(*store));
+            if (!store) abort();
+        }
+        store[store_len++] = recs[i];
+        next_seq = recs[i].seq + 1;
+    }
+    uint8_t ack[5] = { SYNC_OP_ACK };
+    put_u32le(ack + 1, next_seq);
+    write_ctrl(ack, sizeof(ack));
+    if (ch.flags & EXPORT_FLAG_LAST) {
+        sim_ble_read(PHONE_CONN, SIM_BLE_UUID_METRICS);
+        sim_at(sim_now_us() + LINGER_US, end_session, (void *)(uintptr_t)session);
+    }
+}
+
+static void on_read(void *ctx, uint16_t conn, uint16_t uuid, const uint8_t *data, size_t len)
+{
+    if (uuid != SIM_BLE_UUID_METRICS || len > sizeof(metrics)) return;
+    memcpy(metrics, data, len);
+    metrics_len = len;
+}
+
+static void on_event(void *ctx, uint16_t conn, const uint8_t *data, size_t len)
+{
+    stats.events++;
+}
+
+static void on_written(void *ctx, uint16_t conn, uint16_t uuid, esp_err_t err)
+{
+    if (err != ESP_OK) {
+        stats.write_errors++;
+        fprintf(stderr, "phone: write to 0x%04X failed: %s\n", uuid, esp_err_to_name(err));
+    }
+}
+
+void phone_init(int64_t epoch0_us)
+{
+    epoch0 = epoch0_us;
+    const sim_central_t central = { .on_event = on_event, .on_export = on_export, .on_read = on_read,
+                                    .on_written = on_written };
+    sim_ble_set_central(&central);
+}
+
+void phone_setup_at(uint64_t at_us, int16_t tz_min, const dose_slot_t *slots, size_t n)
+{
+    tz = tz_min;
+    table_len = n < DOSE_SLOTS ? n : DOSE_SLOTS;
+    memcpy(table, slots, table_len * sizeof(*slots));
+    sim_at(at_us, setup_cb, NULL);
+}
+
+void phone_sync_at(uint64_t at_us)
+{
+    sim_at(at_us, sync_cb, NULL);
+}
+
+const record_t *phone_records(size_t *count)
+{
+    *count = store_len;
+    return store;
+}
+
+const uint8_t *phone_metrics(size_t *len)
+{
+    *len = metrics_len;
+    return metrics;
+}
+
+void phone_get_stats(phone_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "record.h"
+#include "dose_sched.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Scripted phone app on the stand-in GATT link: sets the clock through the
+// Current Time characteristic, writes the dose table, and pulls the record log
+// with the export stream (acking every chunk) once per session, then reads the
+// metrics characteristic.
+typedef struct {
+    uint32_t sessions;
+    uint32_t chunks;
+    uint32_t bad_chunks;
+    uint32_t events;         // 0xA003 notifications while connected
+    uint32_t write_errors;
+} phone_stats_t;
+
+// The phone's own clock is epoch0_us + virtual uptime.
+void phone_init(int64_t epoch0_us);
+// at at_us: connect, set the time, write tz and slots, disconnect
+void phone_setup_at(uint64_t at_us, int16_t tz_min, const dose_slot_t *slots, size_t n);
+// at at_us: connect, set the time, export everything not acked yet, disconnect
+void phone_sync_at(uint64_t at_us);
+const record_t *phone_records(size_t *count);
+// 0xA006 value of the last session, metrics.h wire format
+const uint8_t *phone_metrics(size_t *len);
+void phone_get_stats(phone_stats_t *out);
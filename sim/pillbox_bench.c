@@ -0,0 +1,82 @@
+#include "bench.h"
+#include "sim.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+// Host run of the firmware microbenchmarks (bench/main). The cases run in a
+// simulated task so FreeRTOS, esp_timer and the GPIO ISR path behave as on
+// target; timings come from the host clock, not the simulation's.
+
+// host timings drift with load and frequency scaling
+#define HOST_THRESHOLD_PCT 50
+#define BASELINE_MAX 32
+
+static bench_baseline_t base[BASELINE_MAX];
+static size_t base_len;
+static bench_result_t results[BASELINE_MAX];
+static unsigned threshold = HOST_THRESHOLD_PCT;
+static int failed;
+
+static void bench_task(void)
+{
+    failed = bench_run_all(base, base_len, threshold, false, results);
+}
+
+static size_t load_baseline(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    static char text[4096];
+    size_t len = fread(text, 1, sizeof(text), f);
+    fclose(f);
+    return bench_baseline_parse(text, len, base, BASELINE_MAX);
+}
+
+static int save_baseline(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    fprintf(f, "# host (sim/ build), pillbox_bench --update: name cycles ns; cycles are TSC ticks on x86\n");
+    for (size_t i = 0; i < bench_case_count; ++i) {
+        fprintf(f, "%s %" PRIu64 " %" PRIu64 "\n", bench_cases[i].name, results[i].cycles, results[i].ns);
+    }
+    return fclose(f);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [--baseline FILE] [--threshold PCT] [--update]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = BENCH_BASELINE_FILE;
+    bool update = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--baseline") && i + 1 < argc) path = argv[++i];
+        else if (!strcmp(argv[i], "--threshold") && i + 1 < argc) threshold = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--update")) update = true;
+        else usage(argv[0]);
+    }
+    esp_log_level_set("*", ESP_LOG_WARN);
+    if (bench_case_count > BASELINE_MAX) return 2;
+    if (!update) base_len = load_baseline(path);
+    printf("baseline %s: %zu cases\n", path, base_len);
+
+    sim_run(bench_task, SIM_NEVER);
+
+    if (update) {
+        if (failed || save_baseline(path) != 0) {
+            fprintf(stderr, "baseline not written\n");
+            return 1;
+        }
+        printf("baseline written to %s\n", path);
+        return 0;
+    }
+    printf(failed ? "BENCH FAIL: %d case(s)\n" : "BENCH PASS\n", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,383 @@
+#include "sim.h"
+#include "sim_ble.h"
+#include "load_cell.h"
+#include "phone.h"
+#include "record.h"
+#include "dose_sched.h"
+#include "crc16.h"
+#include "event_bus.h"
+#include "sample_sched.h"
+#include "button.h"
+#include "metrics.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+// Month replay. The firmware boots at 06:00 local time with four full
+// compartments; a phone sets the clock and the dose table half a minute later.
+// A scripted patient then takes most doses on time, some late, misses a few,
+// presses the compartment button to clear the LED, takes a vitamin from the
+// unscheduled compartment most days and refills compartments that run low.
+// The phone pulls the log every evening. At the end every exported record has
+// to match one scripted action and vice versa; the exit code says whether it did.
+
+void app_main(void);
+
+#define TZ_MIN 180
+#define BOOT_LOCAL_MIN (6 * 60)
+#define SETUP_US SIM_S(30)
+#define SYNC_LOCAL_MIN (23 * 60)
+#define PILL_MG 3000
+#define CONTAINER_MG 25000
+#define FULL_PILLS 14
+#define REFILL_BELOW 6
+#define MATCH_BEFORE_MS 1000
+#define MATCH_AFTER_MS 60000
+
+static const int DT[4] = { 5, 18, 19, 21 };
+static const int SCK[4] = { 4, 23, 22, 25 };
+static const int BTN[4] = { 13, 12, 14, 27 };
+
+// compartment 3 has no schedule: everything taken from it is a plain TAKEN
+static const dose_slot_t SLOTS[] = {
+    { .comp = 0, .days = 0x7F, .minute = 8 * 60, .early_min = 30, .on_time_min = 30, .late_min = 60 },
+    { .comp = 1, .days = 0x7F, .minute = 20 * 60, .early_min = 30, .on_time_min = 30, .late_min = 60 },
+    { .comp = 2, .days = 0x15, .minute = 13 * 60, .early_min = 30, .on_time_min = 30, .late_min = 60 },
+};
+
+typedef struct {
+    uint64_t at_us;
+    uint8_t comp;
+    uint8_t type;
+    bool matched;
+} expect_t;
+
+static int days = 30;
+static uint64_t rng = 1;
+static int64_t epoch0_us;          // wall clock at boot
+static int64_t local_midnight0_s;  // local midnight of day 0, as epoch seconds
+static int pills[4];
+static expect_t *expects;
+static size_t expect_len, expect_cap;
+
+static uint32_t rand32(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (uint32_t)(rng >> 16);
+}
+
+static uint64_t uniform_us(uint64_t lo, uint64_t hi)
+{
+    return lo + ((uint64_t)rand32() << 16 | (rand32() & 0xFFFF)) % (hi - lo + 1);
+}
+
+// local time of day `day` (0 = boot day) as virtual uptime
+static uint64_t local_us(int day, int minute)
+{
+    return SIM_S((int64_t)(day * 1440 + minute - BOOT_LOCAL_MIN) * 60);
+}
+
+static unsigned weekday(int day)   // Monday = 0
+{
+    time_t t = (time_t)(local_midnight0_s + (int64_t)day * 86400);
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    return (unsigned)((tm.tm_wday + 6) % 7);
+}
+
+static void expect(uint64_t at_us, uint8_t comp, uint8_t type)
+{
+    if (expect_len == expect_cap) {
+        expect_cap = expect_cap ? expect_cap * 2 : 256;
+        expects = realloc(expects, expect_cap * sizeof(*expects));
+        if (!expects) abort();
+    }
+    expects[expect_len++] = (expect_t){ .at_us = at_us, .comp = comp, .type = type };
+}
+
+// ---- patient ----
+
+typedef struct {
+    uint8_t comp;
+    int32_t mg;
+} load_step_t;
+
+static void load_cb(void *arg)
+{
+    load_step_t *s = arg;
+    load_cell_set_mg(s->comp, s->mg);
+    free(s);
+}
+
+static void load_at(uint64_t at_us, uint8_t comp, int32_t mg)
+{
+    load_step_t *s = malloc(sizeof(*s));
+    if (!s) abort();
+    *s = (load_step_t){ .comp = comp, .mg = mg };
+    sim_at(at_us, load_cb, s);
+}
+
+// lid pressed, fingers in the compartment, then the new settled weight
+static void touch(uint8_t comp, int delta_pills)
+{
+    uint64_t now = sim_now_us();
+    int32_t base = load_cell_mg(comp);
+    load_cell_set_mg(comp, base + 45000);
+    load_at(now + SIM_MS(400), comp, base + 6000);
+    load_at(now + SIM_MS(700), comp, base + delta_pills * PILL_MG);
+    pills[comp] += delta_pills;
+}
+
+static void take_cb(void *arg)
+{
+    touch((uint8_t)(uintptr_t)arg, -1);
+}
+
+static void refill_cb(void *arg)
+{
+    for (uint8_t c = 0; c < 4; ++c) {
+        if (pills[c] < REFILL_BELOW) touch(c, FULL_PILLS - pills[c]);
+    }
+}
+
+static void edge_cb(void *arg)
+{
+    uintptr_t v = (uintptr_t)arg;
+    sim_gpio_set_input((int)(v >> 1), (int)(v & 1));
+}
+
+static void edge_at(uint64_t at_us, int pin, int level)
+{
+    sim_at(at_us, edge_cb, (void *)(uintptr_t)((unsigned)pin << 1 | (unsigned)level));
+}
+
+// active-low button with contact bounce on both edges
+static void press_at(uint64_t at_us, uint8_t comp)
+{
+    int pin = BTN[comp];
+    edge_at(at_us, pin, 0);
+    edge_at(at_us + 300, pin, 1);
+    edge_at(at_us + 700, pin, 0);
+    uint64_t up = at_us + SIM_MS(180);
+    edge_at(up, pin, 1);
+    edge_at(up + 400, pin, 0);
+    edge_at(up + 900, pin, 1);
+}
+
+static void take_at(uint64_t at_us, uint8_t comp, uint8_t type)
+{
+    sim_at(at_us, take_cb, (void *)(uintptr_t)comp);
+    press_at(at_us + uniform_us(SIM_S(15), SIM_S(60)), comp);
+    expect(at_us, comp, type);
+}
+
+static void plan_day(void *arg)
+{
+    int day = (int)(intptr_t)arg;
+    uint64_t now = sim_now_us();
+    for (size_t i = 0; i < sizeof(SLOTS) / sizeof(SLOTS[0]); ++i) {
+        const dose_slot_t *s = &SLOTS[i];
+        if (!(s->days & (1u << weekday(day)))) continue;
+        uint64_t due = local_us(day, s->minute);
+        if (due < SETUP_US + SIM_S(600)) continue;
+        uint32_t r = rand32() % 100;
+        if (r < 72) {
+            take_at(due - SIM_S(20 * 60) + uniform_us(0, SIM_S(45 * 60)), s->comp, RECORD_TYPE_ON_TIME);
+        } else if (r < 88) {
+            take_at(due + uniform_us(SIM_S(35 * 60), SIM_S(80 * 60)), s->comp, RECORD_TYPE_LATE);
+        } else {
+            uint64_t closed = due + SIM_S((s->on_time_min + s->late_min) * 60);
+            expect(closed, s->comp, RECORD_TYPE_MISSED);
+            press_at(closed + uniform_us(SIM_S(15 * 60), SIM_S(120 * 60)), s->comp);
+        }
+    }
+    if (rand32() % 100 < 80) {
+        uint64_t at = local_us(day, 10 * 60) + uniform_us(0, SIM_S(390 * 60));
+        if (at > now) take_at(at, 3, RECORD_TYPE_TAKEN);
+    }
+    uint64_t refill = local_us(day, 17 * 60);
+    if (refill > now) sim_at(refill, refill_cb, NULL);
+    if (day + 1 < days) sim_at(local_us(day + 1, 5), plan_day, (void *)(intptr_t)(day + 1));
+}
+
+// ---- check and report ----
+
+static int check(int64_t *lat_sum, int64_t *lat_max, size_t *lat_n, uint32_t counts[4])
+{
+    size_t n;
+    const record_t *recs = phone_records(&n);
+    int failures = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const record_t *r = &recs[i];
+        uint8_t comp = r->val & RECORD_COMPARTMENT_MASK;
+        uint8_t type = (r->val & RECORD_TYPE_MASK) >> RECORD_TYPE_SHIFT;
+        expect_t *hit = NULL;
+        for (size_t k = 0; k < expect_len && !hit; ++k) {
+            expect_t *e = &expects[k];
+            int64_t at_ms = (epoch0_us + (int64_t)e->at_us) / 1000;
+            int64_t d = (int64_t)r->ts_ms - at_ms;
+            if (!e->matched && e->comp == comp && e->type == type && d >= -MATCH_BEFORE_MS && d <= MATCH_AFTER_MS) {
+                hit = e;
+                if (type != RECORD_TYPE_MISSED) {
+                    *lat_sum += d;
+                    if (d > *lat_max) *lat_max = d;
+                    (*lat_n)++;
+                }
+            }
+        }
+        if (r->boot != RECORD_BOOT_EPOCH) {
+            printf("  record seq %" PRIu32 " not converted to epoch (boot %u)\n", r->seq, (unsigned)r->boot);
+            failures++;
+        }
+        if (!hit) {
+            if (failures++ < 10) {
+                printf("  unexpected record seq %" PRIu32 ": comp %u type %u at +%.1f s\n", r->seq, comp, type,
+                       ((int64_t)r->ts_ms * 1000 - epoch0_us) / 1e6);
+            }
+            continue;
+        }
+        hit->matched = true;
+        counts[type]++;
+    }
+    for (size_t k = 0; k < expect_len; ++k) {
+        const expect_t *e = &expects[k];
+        if (e->matched || e->at_us > sim_now_us()) continue;
+        if (failures++ < 10) {
+            printf("  missing record: comp %u type %u at +%.1f s\n", e->comp, e->type, e->at_us / 1e6);
+        }
+    }
+    return failures;
+}
+
+static void report(double wall_s)
+{
+    static const char *TYPE[4] = { "taken", "on time", "late", "missed" };
+    sim_stats_t st;
+    sim_get_stats(&st);
+    double virt_s = sim_now_us() / 1e6;
+    printf("pillbox_sim: %d days replayed in %.2f s (%.0fx real time)\n", days, wall_s,
+           wall_s > 0 ? virt_s / wall_s : 0.0);
+    printf("  scheduler: %" PRIu64 " task slices, %" PRIu64 " scripted events, %" PRIu64 " timer callbacks\n",
+           st.switches, st.isr_events, st.timer_callbacks);
+    printf("  slices per task:");
+    for (size_t i = 0; i < sim_task_count(); ++i) {
+        uint64_t sw;
+        const char *name = sim_task_info(i, &sw);
+        printf(" %s=%" PRIu64, name, sw);
+    }
+    printf("\n");
+
+    load_cell_stats_t lc;
+    uint32_t conv = 0, ups = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        load_cell_get_stats(i, &lc);
+        conv += lc.conversions;
+        ups += lc.power_ups;
+    }
+    sample_sched_stats_t ss;
+    sample_sched_get_stats(&ss);
+    uint64_t total_ms = ss.idle_ms + ss.burst_ms;
+    printf("  sampling: %" PRIu32 " conversions, %" PRIu32 " power-ups, %" PRIu32 " bursts, burst %.2f %% of the time\n",
+           conv, ups, ss.bursts, total_ms ? 100.0 * (double)ss.burst_ms / (double)total_ms : 0.0);
+
+    event_bus_stats_t bus;
+    event_bus_stats(&bus);
+    printf("  event bus: %" PRIu32 " posted, %" PRIu32 " dropped, depth max %u, latency max %" PRIu32 " us\n",
+           bus.posted, bus.dropped, (unsigned)bus.depth_max, bus.latency_max_us);
+    printf("  buttons: %" PRIu32 " edges dropped\n", button_edges_dropped());
+
+    phone_stats_t ph;
+    phone_get_stats(&ph);
+    sim_ble_stats_t bs;
+    sim_ble_get_stats(&bs);
+    size_t nrec;
+    const record_t *recs = phone_records(&nrec);
+    printf("  phone: %" PRIu32 " sessions, %" PRIu32 " chunks (%" PRIu32 " bad), %" PRIu32 " live events, "
+           "%zu records, %" PRIu32 " GATT writes\n", ph.sessions, ph.chunks, ph.bad_chunks, ph.events, nrec, bs.writes);
+    // the last 0xA006 value the phone read, as a line tools/metrics_decode.py picks up
+    size_t mlen;
+    const uint8_t *met = phone_metrics(&mlen);
+    printf("  metrics: %" PRId32 " HX711 frames, %" PRId32 " channel timeouts, %" PRId32 " connects, %zu bytes read\n",
+           metrics_get(METRIC_HX711_FRAMES), metrics_get(METRIC_HX711_TIMEOUTS), metrics_get(METRIC_BLE_CONNECTS), mlen);
+    printf("MET ");
+    for (size_t i = 0; i < mlen; ++i) printf("%02x", met[i]);
+    printf("\n");
+
+    int64_t lat_sum = 0, lat_max = INT64_MIN;
+    size_t lat_n = 0;
+    uint32_t counts[4] = { 0 };
+    int failures = check(&lat_sum, &lat_max, &lat_n, counts);
+    printf("  doses:");
+    for (int t = 0; t < 4; ++t) printf(" %s %" PRIu32 "%s", TYPE[t], counts[t], t < 3 ? "," : "\n");
+    if (lat_n) {
+        printf("  detection latency: mean %.2f s, max %.2f s\n", (double)lat_sum / (double)lat_n / 1000.0,
+               (double)lat_max / 1000.0);
+    }
+    printf("  record digest: %04x\n", crc16_ccitt(CRC16_INIT, recs, nrec * sizeof(*recs)));
+    if (failures || ph.bad_chunks || ph.write_errors) {
+        printf("FAIL: %d mismatches, %" PRIu32 " bad chunks, %" PRIu32 " write errors\n", failures, ph.bad_chunks,
+               ph.write_errors);
+        exit(1);
+    }
+    printf("PASS: %zu records match the script\n", nrec);
+}
+
+static void console_trace(void *arg)
+{
+    sim_console_input("trace\n");
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [--days N] [--seed N] [--log 0..5] [-v] [--trace]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    esp_log_level_t level = ESP_LOG_WARN;
+    bool dump_trace = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--days") && i + 1 < argc) days = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) rng = strtoull(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--log") && i + 1 < argc) level = (esp_log_level_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-v")) level = ESP_LOG_INFO;
+        else if (!strcmp(argv[i], "--trace")) dump_trace = true;
+        else usage(argv[0]);
+    }
+    if (days < 1 || rng == 0) usage(argv[0]);
+    esp_log_level_set("*", level);
+
+    struct tm tm = { .tm_year = 2026 - 1900, .tm_mon = 3 - 1, .tm_mday = 2 };   // a Monday
+    local_midnight0_s = (int64_t)timegm(&tm);
+    epoch0_us = (local_midnight0_s + (BOOT_LOCAL_MIN - TZ_MIN) * 60) * 1000000;
+
+    for (size_t i = 0; i < 4; ++i) {
+        const load_cell_cfg_t cfg = {
+            .dt = DT[i], .sck = SCK[i], .zero_raw = 84000 + 9000 * (int32_t)i, .counts_per_g = 420,
+            .noise_counts = 40, .drift_mg = 300, .seed = (uint32_t)(rng + i),
+        };
+        load_cell_attach(i, &cfg);
+        pills[i] = FULL_PILLS;
+        load_cell_set_mg(i, CONTAINER_MG + FULL_PILLS * PILL_MG);
+    }
+    phone_init(epoch0_us);
+    phone_setup_at(SETUP_US, TZ_MIN, SLOTS, sizeof(SLOTS) / sizeof(SLOTS[0]));
+    for (int d = 0; d < days; ++d) phone_sync_at(local_us(d, SYNC_LOCAL_MIN));
+    sim_at(0, plan_day, (void *)(intptr_t)0);
+    const uint64_t end_us = local_us(days - 1, SYNC_LOCAL_MIN + 30);
+    // the tail of the run as TRC lines for tools/trace_decode.py, through the console command
+    if (dump_trace) sim_at(end_us - SIM_S(1), console_trace, NULL);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    sim_run(app_main, end_us);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    report((double)(t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <stdint.h>
+
+// Host build: one core.
+static inline int esp_cpu_get_core_id(void)
+{
+    return 0;
+}
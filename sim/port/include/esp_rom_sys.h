@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+// Busy wait: advances the virtual clock without letting other tasks run.
+void esp_rom_delay_us(uint32_t us);
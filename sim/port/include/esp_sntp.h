@@ -0,0 +1,15 @@
+#pragma once
+#include <sys/time.h>
+
+// Host build: there is no network; the callback is kept so a scenario can fire it.
+typedef enum {
+    SNTP_OPMODE_POLL = 0,
+    SNTP_OPMODE_LISTENONLY,
+} sntp_operatingmode_t;
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback);
+void esp_sntp_setoperatingmode(sntp_operatingmode_t mode);
+void esp_sntp_setservername(unsigned char idx, const char *server);
+void esp_sntp_init(void);
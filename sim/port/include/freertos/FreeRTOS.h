@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Host build: tasks are coroutines scheduled by priority on the virtual clock (sim.h).
+// Stack depths are in bytes, as in ESP-IDF.
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+typedef struct { void *dummy[4]; } StaticTask_t;
+typedef struct { void *dummy[8]; } StaticQueue_t;
+typedef StaticQueue_t StaticSemaphore_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define errQUEUE_FULL 0
+
+#define configTICK_RATE_HZ 100
+#define configMAX_PRIORITIES 25
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+// One OS thread and no preemption inside a task: critical sections only check
+// that nobody blocks while holding one.
+typedef struct {
+    uint32_t owner;
+    uint32_t count;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0, 0 }
+
+void sim_critical_enter(portMUX_TYPE *mux);
+void sim_critical_exit(portMUX_TYPE *mux);
+void sim_yield(void);
+
+#define portENTER_CRITICAL(mux) sim_critical_enter(mux)
+#define portEXIT_CRITICAL(mux) sim_critical_exit(mux)
+#define portENTER_CRITICAL_ISR(mux) sim_critical_enter(mux)
+#define portEXIT_CRITICAL_ISR(mux) sim_critical_exit(mux)
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+#define portYIELD() sim_yield()
+#define taskYIELD() sim_yield()
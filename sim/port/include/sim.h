@@ -0,0 +1,74 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Deterministic host simulation. All FreeRTOS tasks run as coroutines on one OS
+// thread against a virtual microsecond clock. Firmware code runs in zero virtual
+// time: the clock only moves when every task is blocked, or inside
+// esp_rom_delay_us(). Scripted stimuli run in "interrupt" context between task
+// slices, at their scheduled time.
+
+#define SIM_NEVER UINT64_MAX
+#define SIM_MS(x) ((uint64_t)(x) * 1000ULL)
+#define SIM_S(x) ((uint64_t)(x) * 1000000ULL)
+
+typedef void (*sim_fn_t)(void *arg);
+
+uint64_t sim_now_us(void);
+// Run fn in interrupt context at at_us (never earlier than now); equal times run in FIFO order.
+void sim_at(uint64_t at_us, sim_fn_t fn, void *arg);
+// Start fn in the "main" task (priority 1, like app_main) and run until the clock
+// would pass until_us or nothing is left to happen.
+void sim_run(void (*main_fn)(void), uint64_t until_us);
+bool sim_in_isr(void);
+
+typedef struct {
+    uint64_t switches;         // task slices started
+    uint64_t isr_events;       // sim_at callbacks fired
+    uint64_t timer_callbacks;  // esp_timer callbacks
+    uint32_t tasks;
+} sim_stats_t;
+
+void sim_get_stats(sim_stats_t *out);
+// per-task slice counts, for the report
+size_t sim_task_count(void);
+const char *sim_task_info(size_t idx, uint64_t *switches);
+
+// GPIO pads. A device model drives input pads; edge interrupts on pads whose
+// level changes by itself (data ready) are found through next_edge().
+typedef struct {
+    void *ctx;
+    int (*level)(void *ctx);                // level the device drives now
+    uint64_t (*next_edge)(void *ctx);       // time of the next spontaneous level change, SIM_NEVER if none
+} sim_pad_driver_t;
+
+typedef void (*sim_pad_watch_t)(void *ctx, int pin, int level);
+
+void sim_gpio_attach(int pin, const sim_pad_driver_t *drv);
+// called for every change of the level the chip drives on an output pin
+void sim_gpio_watch(int pin, sim_pad_watch_t fn, void *ctx);
+// scripted input level (buttons); runs edge interrupts
+void sim_gpio_set_input(int pin, int level);
+// a device changed its pad right now (in reaction to the firmware)
+void sim_gpio_changed(int pin);
+// level the chip drives: GPIO output register, or the LEDC duty (>= 50 %) when routed there
+int sim_gpio_output(int pin);
+
+// Flash power cut: after `bytes` more programmed bytes the partition write in
+// progress stops and the process exits with SIM_POWER_CUT_EXIT. tail_first
+// programs the end of that write first (the payload before the header).
+// Partitions are shared with forked children, so the parent can remount what a
+// child left behind.
+#define SIM_POWER_CUT_EXIT 86
+void sim_flash_power_cut(size_t bytes, bool tail_first);
+
+// wall clock seen by gettimeofday/settimeofday, advancing with the virtual clock
+void sim_wall_set_us(int64_t epoch_us);
+int64_t sim_wall_us(void);
+
+// SNTP callback registered by the firmware, NULL before esp_sntp_init
+void sim_sntp_fire(void);
+
+// bytes typed on the console UART (uart_read_bytes), e.g. "trace\n"; interrupt context
+void sim_console_input(const char *text);
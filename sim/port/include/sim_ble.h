@@ -0,0 +1,49 @@
+#pragma once
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Stand-in for ble.c: implements ble.h for the firmware and lets a scripted
+// central drive it. GATT operations are queued and run in a "nimble_host" task,
+// so firmware callbacks see the same task context as under NimBLE; notifications
+// reach the central synchronously from whichever task sends them.
+
+#define SIM_BLE_UUID_DATA 0xA001
+#define SIM_BLE_UUID_CTRL 0xA002
+#define SIM_BLE_UUID_METRICS 0xA006
+#define SIM_BLE_UUID_TRACE 0xA007
+#define SIM_BLE_UUID_CTS 0x2A2B
+
+#define SIM_BLE_SUB_EVENT 0x01      // 0xA003
+#define SIM_BLE_SUB_TELEMETRY 0x02  // 0xA004
+#define SIM_BLE_SUB_EXPORT 0x04     // 0xA005
+
+#define SIM_BLE_WRITE_MAX 32
+
+typedef struct {
+    void *ctx;
+    void (*on_event)(void *ctx, uint16_t conn, const uint8_t *data, size_t len);
+    void (*on_export)(void *ctx, uint16_t conn, const uint8_t *data, size_t len);
+    // response to sim_ble_read (long read, all of it)
+    void (*on_read)(void *ctx, uint16_t conn, uint16_t uuid, const uint8_t *data, size_t len);
+    // result of sim_ble_write
+    void (*on_written)(void *ctx, uint16_t conn, uint16_t uuid, esp_err_t err);
+} sim_central_t;
+
+typedef struct {
+    uint32_t connects;
+    uint32_t writes;
+    uint32_t reads;
+    uint32_t notifications;
+    uint32_t telemetry_samples;
+} sim_ble_stats_t;
+
+void sim_ble_set_central(const sim_central_t *central);
+// Queue a GATT operation; callable from any context once ble_init has run.
+void sim_ble_connect(uint16_t conn, uint16_t mtu, uint8_t subscribe);
+void sim_ble_disconnect(uint16_t conn);
+void sim_ble_write(uint16_t conn, uint16_t uuid, const uint8_t *data, size_t len);
+void sim_ble_read(uint16_t conn, uint16_t uuid);
+bool sim_ble_advertising(void);
+void sim_ble_get_stats(sim_ble_stats_t *out);
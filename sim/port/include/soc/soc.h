@@ -0,0 +1,9 @@
+#pragma once
+#include <stdint.h>
+
+// Host build: register accesses go to the simulated GPIO matrix.
+uint32_t sim_reg_read(uint32_t addr);
+void sim_reg_write(uint32_t addr, uint32_t value);
+
+#define REG_READ(addr) sim_reg_read((uint32_t)(addr))
+#define REG_WRITE(addr, val) sim_reg_write((uint32_t)(addr), (uint32_t)(val))
@@ -0,0 +1,241 @@
+#include "sim_ble.h"
+#include "ble.h"
+#include "time_sync.h"
+#include "metrics.h"
+#include "trace.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include <string.h>
+
+#define HOST_TASK_PRIO 21   // NimBLE host task on ESP-IDF: configMAX_PRIORITIES - 4
+#define HOST_QUEUE_LEN 32
+#define MAX_CONNS 3
+
+enum { OP_CONNECT = 0, OP_DISCONNECT, OP_WRITE, OP_READ };
+
+typedef struct {
+    uint8_t op;
+    uint8_t subscribe;
+    uint16_t conn;
+    uint16_t uuid;
+    uint16_t mtu;
+    uint8_t len;
+    uint8_t data[SIM_BLE_WRITE_MAX];
+} host_op_t;
+
+typedef struct {
+    bool used;
+    uint16_t handle;
+    uint16_t mtu;
+    uint8_t subscribe;
+    metrics_snap_t metrics;
+} conn_t;
+
+static const char *TAG = "sim_ble";
+static ble_read_cb_t g_read_cb;
+static ble_write_cb_t g_write_cb;
+static ble_conn_cb_t g_conn_cb;
+static QueueHandle_t host_queue;
+static sim_central_t central;
+static conn_t conns[MAX_CONNS];
+static bool advertising;
+static sim_ble_stats_t stats;
+
+static conn_t *conn_find(uint16_t handle)
+{
+    for (size_t i = 0; i < MAX_CONNS; ++i) {
+        if (conns[i].used && conns[i].handle == handle) return &conns[i];
+    }
+    return NULL;
+}
+
+static void host_op(const host_op_t *op)
+{
+    conn_t *c = conn_find(op->conn);
+    if (op->op == OP_CONNECT) {
+        if (c) return;
+        for (size_t i = 0; i < MAX_CONNS && !c; ++i) {
+            if (!conns[i].used) c = &conns[i];
+        }
+        if (!c) {
+            ESP_LOGW(TAG, "no room for conn %d", op->conn);
+            return;
+        }
+        *c = (conn_t){ .used = true, .handle = op->conn, .mtu = op->mtu, .subscribe = op->subscribe };
+        advertising = false;
+        stats.connects++;
+        if (g_conn_cb) g_conn_cb(op->conn, true);
+    } else if (op->op == OP_DISCONNECT) {
+        if (!c) return;
+        c->used = false;
+        if (g_conn_cb) g_conn_cb(op->conn, false);
+    } else if (op->op == OP_WRITE) {
+        if (!c) return;
+        esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+        stats.writes++;
+        if (op->uuid == SIM_BLE_UUID_CTRL && g_write_cb) err = g_write_cb(op->conn, op->data, op->len);
+        else if (op->uuid == SIM_BLE_UUID_CTS) err = time_sync_from_cts(op->data, op->len);
+        else if (op->uuid == SIM_BLE_UUID_TRACE) err = trace_window_select(op->data, op->len);
+        else if (op->uuid == SIM_BLE_UUID_METRICS) {
+            metrics_snap_refresh(&c->metrics);
+            err = ESP_OK;
+        }
+        if (central.on_written) central.on_written(central.ctx, op->conn, op->uuid, err);
+    } else if (op->op == OP_READ) {
+        static uint8_t buf[TRACE_WINDOW_MAX];
+        size_t len = 0;
+        const uint8_t *val = buf;
+        if (!c) return;
+        if (op->uuid == SIM_BLE_UUID_DATA && g_read_cb) {
+            TRACE_BEGIN(TRACE_SPAN_GATT_ACCESS);
+            val = g_read_cb(op->conn, c->mtu, &len);
+            TRACE_END(TRACE_SPAN_GATT_ACCESS);
+        } else if (op->uuid == SIM_BLE_UUID_METRICS) {
+            val = metrics_snap_read(&c->metrics, &len);
+        } else if (op->uuid == SIM_BLE_UUID_TRACE) {
+            len = trace_window_read(buf, sizeof(buf));
+        } else {
+            return;
+        }
+        stats.reads++;
+        if (central.on_read) central.on_read(central.ctx, op->conn, op->uuid, val, len);
+    }
+}
+
+static void host_task(void *arg)
+{
+    host_op_t op;
+    for (;;) {
+        if (xQueueReceive(host_queue, &op, portMAX_DELAY) == pdTRUE) host_op(&op);
+    }
+}
+
+static void post(const host_op_t *op)
+{
+    if (!host_queue || xQueueSendFromISR(host_queue, op, NULL) != pdTRUE) {
+        ESP_LOGW(TAG, "GATT operation %d on conn %d dropped", op->op, op->conn);
+    }
+}
+
+// ---- central side ----
+
+void sim_ble_set_central(const sim_central_t *c)
+{
+    central = *c;
+}
+
+void sim_ble_connect(uint16_t conn, uint16_t mtu, uint8_t subscribe)
+{
+    host_op_t op = { .op = OP_CONNECT, .conn = conn, .mtu = mtu, .subscribe = subscribe };
+    post(&op);
+}
+
+void sim_ble_disconnect(uint16_t conn)
+{
+    host_op_t op = { .op = OP_DISCONNECT, .conn = conn };
+    post(&op);
+}
+
+void sim_ble_write(uint16_t conn, uint16_t uuid, const uint8_t *data, size_t len)
+{
+    host_op_t op = { .op = OP_WRITE, .conn = conn, .uuid = uuid };
+    if (len > SIM_BLE_WRITE_MAX) len = SIM_BLE_WRITE_MAX;
+    memcpy(op.data, data, len);
+    op.len = (uint8_t)len;
+    post(&op);
+}
+
+void sim_ble_read(uint16_t conn, uint16_t uuid)
+{
+    host_op_t op = { .op = OP_READ, .conn = conn, .uuid = uuid };
+    post(&op);
+}
+
+bool sim_ble_advertising(void)
+{
+    return advertising;
+}
+
+void sim_ble_get_stats(sim_ble_stats_t *out)
+{
+    *out = stats;
+}
+
+// ---- ble.h ----
+
+esp_err_t ble_init(ble_read_cb_t read_cb, ble_write_cb_t write_cb, ble_conn_cb_t conn_cb)
+{
+    g_read_cb = read_cb;
+    g_write_cb = write_cb;
+    g_conn_cb = conn_cb;
+    host_queue = xQueueCreate(HOST_QUEUE_LEN, sizeof(host_op_t));
+    if (!host_queue) return ESP_ERR_NO_MEM;
+    if (xTaskCreate(host_task, "nimble_host", 4096, NULL, HOST_TASK_PRIO, NULL) != pdPASS) return ESP_ERR_NO_MEM;
+    advertising = true;
+    return ESP_OK;
+}
+
+esp_err_t ble_start_advertising(void)
+{
+    advertising = true;
+    return ESP_OK;
+}
+
+esp_err_t ble_notify_event(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < MAX_CONNS; ++i) {
+        if (!conns[i].used || !(conns[i].subscribe & SIM_BLE_SUB_EVENT)) continue;
+        if (len > (size_t)conns[i].mtu - 3) return ESP_ERR_INVALID_SIZE;
+        stats.notifications++;
+        if (central.on_event) central.on_event(central.ctx, conns[i].handle, data, len);
+    }
+    return ESP_OK;
+}
+
+bool ble_telemetry_active(void)
+{
+    for (size_t i = 0; i < MAX_CONNS; ++i) {
+        if (conns[i].used && (conns[i].subscribe & SIM_BLE_SUB_TELEMETRY)) return true;
+    }
+    return false;
+}
+
+esp_err_t ble_telemetry_push(uint32_t t_ms, const int32_t *mg, size_t channels)
+{
+    if (!mg || channels == 0) return ESP_ERR_INVALID_ARG;
+    if (!ble_telemetry_active()) return ESP_ERR_INVALID_STATE;
+    stats.telemetry_samples++;
+    return ESP_OK;
+}
+
+void ble_telemetry_flush(void)
+{
+}
+
+uint32_t ble_telemetry_dropped(void)
+{
+    return 0;
+}
+
+static size_t export_max_chunk(void *ctx)
+{
+    conn_t *c = conn_find((uint16_t)(uintptr_t)ctx);
+    return (c && (c->subscribe & SIM_BLE_SUB_EXPORT)) ? (size_t)c->mtu - 3 : 0;
+}
+
+static esp_err_t export_send(void *ctx, const uint8_t *data, size_t len)
+{
+    uint16_t conn = (uint16_t)(uintptr_t)ctx;
+    if (!conn_find(conn)) return ESP_ERR_INVALID_STATE;
+    stats.notifications++;
+    if (central.on_export) central.on_export(central.ctx, conn, data, len);
+    return ESP_OK;
+}
+
+const export_transport_t ble_export_transport = {
+    .name = "sim",
+    .max_chunk = export_max_chunk,
+    .send = export_send,
+};
@@ -0,0 +1,375 @@
+#include "sim_internal.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "esp_rom_gpio.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "soc/gpio_sig_map.h"
+#include <string.h>
+
+// GPIO matrix of the ESP32 as far as the firmware uses it: output and input
+// registers for both banks, per-pin edge interrupts through the ISR service,
+// and LEDC channels that take over a pad's output.
+
+#define PINS 40
+
+typedef struct {
+    gpio_mode_t mode;
+    bool pull_up;
+    int out;                    // GPIO output register bit
+    int in;                     // scripted input level
+    int seen;                   // last level the edge detector saw
+    gpio_int_type_t intr;
+    bool intr_on;
+    gpio_isr_t isr;
+    void *isr_arg;
+    uint32_t check_gen;         // invalidates scheduled edge checks
+    int ledc;                   // channel routed to the pad, -1 for GPIO
+    sim_pad_driver_t drv;
+    bool has_drv;
+    sim_pad_watch_t watch;
+    void *watch_ctx;
+} pad_t;
+
+typedef struct {
+    int pin;
+    ledc_timer_t timer;
+    uint32_t duty;
+    uint32_t duty_pending;
+    bool invert;
+    bool running;
+} ledc_ch_t;
+
+static pad_t pads[PINS];
+static ledc_ch_t ledc_ch[LEDC_CHANNEL_MAX];
+static bool isr_service;
+static uint8_t ledc_bits[LEDC_TIMER_MAX];
+
+static bool valid(int pin)
+{
+    return pin >= 0 && pin < PINS;
+}
+
+static int pad_level(int pin)
+{
+    pad_t *p = &pads[pin];
+    if (p->mode & GPIO_MODE_OUTPUT) return sim_gpio_output(pin);
+    if (p->has_drv) return p->drv.level(p->drv.ctx);
+    return p->in;
+}
+
+static bool edge_fires(gpio_int_type_t type, int from, int to)
+{
+    if (from == to) return false;
+    if (type == GPIO_INTR_ANYEDGE) return true;
+    if (type == GPIO_INTR_POSEDGE) return to == 1;
+    if (type == GPIO_INTR_NEGEDGE) return to == 0;
+    return false;
+}
+
+static void schedule_check(int pin);
+
+// edge detector: compare with the last seen level and run the handler
+static void evaluate(int pin)
+{
+    pad_t *p = &pads[pin];
+    int lvl = pad_level(pin);
+    int was = p->seen;
+    p->seen = lvl;
+    if (isr_service && p->isr && p->intr_on && edge_fires(p->intr, was, lvl)) {
+        struct sim_task *t = sim_isr_enter();
+        p->isr(p->isr_arg);
+        sim_isr_exit(t);
+    }
+    schedule_check(pin);
+}
+
+typedef struct {
+    int pin;
+    uint32_t gen;
+} check_t;
+
+static check_t checks[PINS];
+
+static void check_cb(void *arg)
+{
+    check_t *c = arg;
+    if (pads[c->pin].check_gen == c->gen) evaluate(c->pin);
+}
+
+// devices that change their pad on their own are only polled while their interrupt is enabled
+static void schedule_check(int pin)
+{
+    pad_t *p = &pads[pin];
+    p->check_gen++;
+    if (!p->has_drv || !p->intr_on || !p->isr || !p->drv.next_edge) return;
+    uint64_t at = p->drv.next_edge(p->drv.ctx);
+    if (at == SIM_NEVER) return;
+    checks[pin] = (check_t){ .pin = pin, .gen = p->check_gen };
+    sim_at(at, check_cb, &checks[pin]);
+}
+
+static void output_changed(int pin, int before)
+{
+    pad_t *p = &pads[pin];
+    int now = sim_gpio_output(pin);
+    if (now != before && p->watch) p->watch(p->watch_ctx, pin, now);
+    // an input/output pad sees its own output, edge interrupt included
+    if (now != before && (p->mode & GPIO_MODE_INPUT)) evaluate(pin);
+}
+
+static void write_out(int pin, int level)
+{
+    int before = sim_gpio_output(pin);
+    pads[pin].out = level ? 1 : 0;
+    output_changed(pin, before);
+}
+
+// ---- simulation side ----
+
+void sim_gpio_attach(int pin, const sim_pad_driver_t *drv)
+{
+    if (!valid(pin) || !drv) return;
+    pads[pin].drv = *drv;
+    pads[pin].has_drv = true;
+    pads[pin].seen = drv->level(drv->ctx);
+}
+
+void sim_gpio_watch(int pin, sim_pad_watch_t fn, void *ctx)
+{
+    if (!valid(pin)) return;
+    pads[pin].watch = fn;
+    pads[pin].watch_ctx = ctx;
+}
+
+void sim_gpio_set_input(int pin, int level)
+{
+    if (!valid(pin)) return;
+    pads[pin].in = level ? 1 : 0;
+    evaluate(pin);
+}
+
+void sim_gpio_changed(int pin)
+{
+    if (valid(pin)) evaluate(pin);
+}
+
+int sim_gpio_output(int pin)
+{
+    if (!valid(pin)) return 0;
+    pad_t *p = &pads[pin];
+    if (p->ledc >= 0) {
+        const ledc_ch_t *c = &ledc_ch[p->ledc];
+        uint32_t full = 1u << ledc_bits[c->timer];
+        return (c->running && c->duty * 2 >= full) != c->invert;
+    }
+    return p->out;
+}
+
+static void __attribute__((constructor)) pads_init(void)
+{
+    for (int i = 0; i < PINS; ++i) {
+        pads[i].ledc = -1;
+        pads[i].in = 1;
+        pads[i].seen = 1;
+    }
+}
+
+// ---- registers ----
+
+uint32_t sim_reg_read(uint32_t addr)
+{
+    int base;
+    if (addr == GPIO_IN_REG) base = 0;
+    else if (addr == GPIO_IN1_REG) base = 32;
+    else if (addr == GPIO_OUT_REG || addr == GPIO_OUT1_REG) {
+        base = addr == GPIO_OUT_REG ? 0 : 32;
+        uint32_t v = 0;
+        for (int i = base; i < PINS && i < base + 32; ++i) v |= (uint32_t)pads[i].out << (i - base);
+        return v;
+    } else {
+        return 0;
+    }
+    uint32_t v = 0;
+    for (int i = base; i < PINS && i < base + 32; ++i) {
+        if (pad_level(i)) v |= 1u << (i - base);
+    }
+    return v;
+}
+
+void sim_reg_write(uint32_t addr, uint32_t value)
+{
+    int base = (addr == GPIO_OUT1_W1TS_REG || addr == GPIO_OUT1_W1TC_REG || addr == GPIO_OUT1_REG) ? 32 : 0;
+    for (int i = base; i < PINS && i < base + 32; ++i) {
+        bool bit = (value >> (i - base)) & 1;
+        if (addr == GPIO_OUT_W1TS_REG || addr == GPIO_OUT1_W1TS_REG) {
+            if (bit) write_out(i, 1);
+        } else if (addr == GPIO_OUT_W1TC_REG || addr == GPIO_OUT1_W1TC_REG) {
+            if (bit) write_out(i, 0);
+        } else if (addr == GPIO_OUT_REG || addr == GPIO_OUT1_REG) {
+            write_out(i, bit);
+        }
+    }
+}
+
+// ---- driver/gpio.h ----
+
+esp_err_t gpio_config(const gpio_config_t *cfg)
+{
+    if (!cfg) return ESP_ERR_INVALID_ARG;
+    for (int i = 0; i < PINS; ++i) {
+        if (!(cfg->pin_bit_mask & (1ULL << i))) continue;
+        pads[i].mode = cfg->mode;
+        pads[i].pull_up = cfg->pull_up_en;
+        if (!pads[i].has_drv && cfg->pull_down_en && !cfg->pull_up_en) pads[i].in = 0;
+        pads[i].intr = cfg->intr_type;
+        pads[i].intr_on = cfg->intr_type != GPIO_INTR_DISABLE;
+        pads[i].seen = pad_level(i);
+        schedule_check(i);
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t pin)
+{
+    if (!valid(pin)) return ESP_ERR_INVALID_ARG;
+    pads[pin].mode = GPIO_MODE_INPUT;
+    pads[pin].pull_up = true;
+    pads[pin].intr = GPIO_INTR_DISABLE;
+    pads[pin].intr_on = false;
+    pads[pin].ledc = -1;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode)
+{
+    if (!valid(pin)) return ESP_ERR_INVALID_ARG;
+    pads[pin].mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+    if (!valid(pin)) return ESP_ERR_INVALID_ARG;
+    write_out(pin, level != 0);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin)
+{
+    return valid(pin) ? pad_level(pin) : 0;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t pin, gpio_int_type_t type)
+{
+    if (!valid(pin)) return ESP_ERR_INVALID_ARG;
+    pads[pin].intr = type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t pin)
+{
+    if (!valid(pin)) return ESP_ERR_INVALID_ARG;
+    pads[pin].intr_on = true;
+    pads[pin].seen = pad_level(pin);
+    schedule_check(pin);
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t pin)
+{
+    if (!valid(pin)) return ESP_ERR_INVALID_ARG;
+    pads[pin].intr_on = false;
+    pads[pin].check_gen++;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+    if (isr_service) return ESP_ERR_INVALID_STATE;
+    isr_service = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t handler, void *arg)
+{
+    if (!valid(pin)) return ESP_ERR_INVALID_ARG;
+    if (!isr_service) return ESP_ERR_INVALID_STATE;
+    pads[pin].isr = handler;
+    pads[pin].isr_arg = arg;
+    pads[pin].seen = pad_level(pin);
+    schedule_check(pin);
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t pin)
+{
+    if (!valid(pin)) return ESP_ERR_INVALID_ARG;
+    pads[pin].isr = NULL;
+    pads[pin].check_gen++;
+    return ESP_OK;
+}
+
+void esp_rom_gpio_connect_out_signal(uint32_t gpio_num, uint32_t signal_idx, bool out_inv, bool oen_inv)
+{
+    if (!valid((int)gpio_num) || signal_idx != SIG_GPIO_OUT_IDX) return;
+    int before = sim_gpio_output((int)gpio_num);
+    pads[gpio_num].ledc = -1;
+    output_changed((int)gpio_num, before);
+}
+
+// ---- driver/ledc.h ----
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *cfg)
+{
+    if (!cfg || cfg->timer_num >= LEDC_TIMER_MAX || !cfg->freq_hz) return ESP_ERR_INVALID_ARG;
+    ledc_bits[cfg->timer_num] = (uint8_t)cfg->duty_resolution;
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *cfg)
+{
+    if (!cfg || cfg->channel >= LEDC_CHANNEL_MAX || !valid(cfg->gpio_num)) return ESP_ERR_INVALID_ARG;
+    if (!ledc_bits[cfg->timer_sel]) return ESP_ERR_INVALID_STATE;
+    int pin = cfg->gpio_num;
+    int before = sim_gpio_output(pin);
+    ledc_ch_t *c = &ledc_ch[cfg->channel];
+    c->pin = pin;
+    c->timer = cfg->timer_sel;
+    c->duty = c->duty_pending = cfg->duty;
+    c->invert = cfg->flags.output_invert;
+    c->running = true;
+    pads[pin].ledc = cfg->channel;
+    output_changed(pin, before);
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty)
+{
+    if (channel >= LEDC_CHANNEL_MAX) return ESP_ERR_INVALID_ARG;
+    ledc_ch[channel].duty_pending = duty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t mode, ledc_channel_t channel)
+{
+    if (channel >= LEDC_CHANNEL_MAX) return ESP_ERR_INVALID_ARG;
+    ledc_ch_t *c = &ledc_ch[channel];
+    int before = c->running ? sim_gpio_output(c->pin) : 0;
+    c->duty = c->duty_pending;
+    c->running = true;
+    if (pads[c->pin].ledc == (int)channel) output_changed(c->pin, before);
+    return ESP_OK;
+}
+
+esp_err_t ledc_stop(ledc_mode_t mode, ledc_channel_t channel, uint32_t idle_level)
+{
+    if (channel >= LEDC_CHANNEL_MAX) return ESP_ERR_INVALID_ARG;
+    ledc_ch_t *c = &ledc_ch[channel];
+    int before = sim_gpio_output(c->pin);
+    c->running = false;
+    c->duty = 0;
+    c->invert = idle_level != 0;
+    if (pads[c->pin].ledc == (int)channel) output_changed(c->pin, before);
+    return ESP_OK;
+}
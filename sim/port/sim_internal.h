@@ -0,0 +1,23 @@
+#pragma once
+#include "sim.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Between the scheduler (sim_rtos.c) and the other port modules.
+struct sim_task;
+
+struct sim_task *sim_self(void);
+// Park the current task until sim_wake() or the deadline; false on timeout.
+bool sim_park(uint64_t deadline_us);
+void sim_wake(struct sim_task *t);
+// Clock read by firmware code. A task that polls it without ever blocking would
+// spin forever on a clock that cannot move, so heavy polling nudges it forward.
+uint64_t sim_clock_read(void);
+void sim_delay(uint64_t us);
+// Run an interrupt handler raised from task context (a pad the task drives):
+// wake-ups inside it switch tasks only at sim_isr_exit, like portYIELD_FROM_ISR.
+struct sim_task *sim_isr_enter(void);
+void sim_isr_exit(struct sim_task *interrupted);
+
+void sim_timer_start(void);
+void sim_count_timer_callback(void);
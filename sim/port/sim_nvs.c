@@ -0,0 +1,267 @@
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "esp_partition.h"
+#include "sim.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// NVS as a RAM table and the partition table of partitions.csv in RAM.
+
+#define NVS_ENTRIES 64
+#define NVS_VALUE_MAX 512
+#define NVS_NAME_MAX 15
+#define NVS_HANDLES 8
+
+enum { TYPE_U32 = 1, TYPE_BLOB };
+
+typedef struct {
+    bool used;
+    uint8_t type;
+    char ns[NVS_NAME_MAX + 1];
+    char key[NVS_NAME_MAX + 1];
+    size_t len;
+    uint8_t data[NVS_VALUE_MAX];
+} nvs_entry_t;
+
+typedef struct {
+    bool open;
+    bool writable;
+    char ns[NVS_NAME_MAX + 1];
+} nvs_open_t;
+
+static nvs_entry_t entries[NVS_ENTRIES];
+static nvs_open_t handles[NVS_HANDLES];
+static bool nvs_ready;
+
+esp_err_t nvs_flash_init(void)
+{
+    nvs_ready = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    memset(entries, 0, sizeof(entries));
+    return ESP_OK;
+}
+
+static bool ns_exists(const char *ns)
+{
+    for (size_t i = 0; i < NVS_ENTRIES; ++i) {
+        if (entries[i].used && !strcmp(entries[i].ns, ns)) return true;
+    }
+    return false;
+}
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    if (!nvs_ready) return ESP_ERR_NVS_NOT_INITIALIZED;
+    if (!ns || !out || strlen(ns) > NVS_NAME_MAX) return ESP_ERR_NVS_INVALID_NAME;
+    // like the real store: a namespace only exists once something was written to it
+    if (mode == NVS_READONLY && !ns_exists(ns)) return ESP_ERR_NVS_NOT_FOUND;
+    for (size_t i = 0; i < NVS_HANDLES; ++i) {
+        if (handles[i].open) continue;
+        handles[i].open = true;
+        handles[i].writable = mode == NVS_READWRITE;
+        strcpy(handles[i].ns, ns);
+        *out = (nvs_handle_t)(i + 1);
+        return ESP_OK;
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+static nvs_open_t *handle(nvs_handle_t h)
+{
+    return (h >= 1 && h <= NVS_HANDLES && handles[h - 1].open) ? &handles[h - 1] : NULL;
+}
+
+void nvs_close(nvs_handle_t h)
+{
+    nvs_open_t *o = handle(h);
+    if (o) o->open = false;
+}
+
+esp_err_t nvs_commit(nvs_handle_t h)
+{
+    return handle(h) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+static nvs_entry_t *find(const nvs_open_t *o, const char *key)
+{
+    for (size_t i = 0; i < NVS_ENTRIES; ++i) {
+        if (entries[i].used && !strcmp(entries[i].ns, o->ns) && !strcmp(entries[i].key, key)) return &entries[i];
+    }
+    return NULL;
+}
+
+static esp_err_t set(nvs_handle_t h, const char *key, uint8_t type, const void *value, size_t len)
+{
+    nvs_open_t *o = handle(h);
+    if (!o) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!o->writable) return ESP_ERR_NVS_READ_ONLY;
+    if (!key || strlen(key) > NVS_NAME_MAX) return ESP_ERR_NVS_KEY_TOO_LONG;
+    if (len > NVS_VALUE_MAX) return ESP_ERR_NVS_VALUE_TOO_LONG;
+    nvs_entry_t *e = find(o, key);
+    for (size_t i = 0; !e && i < NVS_ENTRIES; ++i) {
+        if (!entries[i].used) e = &entries[i];
+    }
+    if (!e) return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    e->used = true;
+    e->type = type;
+    strcpy(e->ns, o->ns);
+    strcpy(e->key, key);
+    e->len = len;
+    memcpy(e->data, value, len);
+    return ESP_OK;
+}
+
+static esp_err_t get(nvs_handle_t h, const char *key, uint8_t type, nvs_entry_t **out)
+{
+    nvs_open_t *o = handle(h);
+    if (!o) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!key) return ESP_ERR_NVS_INVALID_NAME;
+    nvs_entry_t *e = find(o, key);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    if (e->type != type) return ESP_ERR_NVS_TYPE_MISMATCH;
+    *out = e;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t h, const char *key, uint32_t value)
+{
+    return set(h, key, TYPE_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t h, const char *key, uint32_t *out)
+{
+    nvs_entry_t *e;
+    esp_err_t err = get(h, key, TYPE_U32, &e);
+    if (err == ESP_OK) memcpy(out, e->data, sizeof(*out));
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t len)
+{
+    return set(h, key, TYPE_BLOB, value, len);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    nvs_entry_t *e;
+    esp_err_t err = get(h, key, TYPE_BLOB, &e);
+    if (err != ESP_OK) return err;
+    if (!out) {
+        *len = e->len;
+        return ESP_OK;
+    }
+    if (*len < e->len) {
+        *len = e->len;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out, e->data, e->len);
+    *len = e->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *key)
+{
+    nvs_open_t *o = handle(h);
+    if (!o) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!o->writable) return ESP_ERR_NVS_READ_ONLY;
+    nvs_entry_t *e = find(o, key);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    e->used = false;
+    return ESP_OK;
+}
+
+// ---- partitions ----
+
+#define SECTOR 4096
+
+typedef struct {
+    esp_partition_t info;
+    uint8_t *data;
+} part_t;
+
+static part_t parts[] = {
+    { .info = { .type = ESP_PARTITION_TYPE_DATA, .subtype = 0x40, .address = 0x110000,
+                .size = 64 * 1024, .erase_size = SECTOR, .label = "evlog" } },
+};
+
+// bytes left to program before the power cut, SIZE_MAX when none is armed
+static size_t cut_budget = SIZE_MAX;
+static bool cut_tail_first;
+
+// shared with forked children, so what a child programmed before its power cut stays
+static uint8_t *part_data(part_t *p)
+{
+    if (!p->data) {
+        void *m = mmap(NULL, p->info.size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (m == MAP_FAILED) return NULL;
+        p->data = m;
+        memset(p->data, 0xFF, p->info.size);
+    }
+    return p->data;
+}
+
+void sim_flash_power_cut(size_t bytes, bool tail_first)
+{
+    cut_budget = bytes;
+    cut_tail_first = tail_first;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); ++i) {
+        part_t *p = &parts[i];
+        if (p->info.type != type) continue;
+        if (subtype != ESP_PARTITION_SUBTYPE_ANY && p->info.subtype != subtype) continue;
+        if (label && strcmp(p->info.label, label)) continue;
+        return part_data(p) ? &p->info : NULL;
+    }
+    return NULL;
+}
+
+static part_t *part_of(const esp_partition_t *info, size_t offset, size_t size)
+{
+    part_t *p = (part_t *)info;   // info is the first member
+    if (!info || offset > info->size || size > info->size - offset) return NULL;
+    return p;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *info, size_t offset, void *dst, size_t size)
+{
+    part_t *p = part_of(info, offset, size);
+    if (!p || !dst) return ESP_ERR_INVALID_ARG;
+    memcpy(dst, p->data + offset, size);
+    return ESP_OK;
+}
+
+// NOR flash: programming can only clear bits
+esp_err_t esp_partition_write(const esp_partition_t *info, size_t offset, const void *src, size_t size)
+{
+    part_t *p = part_of(info, offset, size);
+    if (!p || !src) return ESP_ERR_INVALID_ARG;
+    const uint8_t *s = src;
+    if (size > cut_budget) {
+        // power lost part way through: only some of the bytes are programmed
+        size_t from = cut_tail_first ? size - cut_budget : 0;
+        for (size_t i = from; i < from + cut_budget; ++i) p->data[offset + i] &= s[i];
+        _exit(SIM_POWER_CUT_EXIT);
+    }
+    if (cut_budget != SIZE_MAX) cut_budget -= size;
+    for (size_t i = 0; i < size; ++i) p->data[offset + i] &= s[i];
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *info, size_t offset, size_t size)
+{
+    part_t *p = part_of(info, offset, size);
+    if (!p || offset % SECTOR || size % SECTOR) return ESP_ERR_INVALID_ARG;
+    memset(p->data + offset, 0xFF, size);
+    return ESP_OK;
+}
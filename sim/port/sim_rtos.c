@@ -0,0 +1,605 @@
+#include "sim_internal.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "trace.h"
+#include <ucontext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Cooperative scheduler: the highest-priority ready task runs until it blocks,
+// yields or wakes a task of higher priority. Equal priorities run in the order
+// they became ready. With nothing ready, the clock jumps to the next timeout or
+// scripted event. Everything is single-threaded, so every run is reproducible.
+
+#define SIM_MAX_TASKS 16
+#define SIM_STACK_BYTES (256 * 1024)   // host code needs far more than the target stack depths
+#define TICK_US (1000000ULL / configTICK_RATE_HZ)
+#define SPIN_READS 100000
+
+enum { T_READY = 0, T_BLOCKED, T_DONE };
+enum { W_NONE = 0, W_RECV, W_SEND, W_NOTIFY, W_SLEEP, W_PARK };
+
+struct sim_task {
+    ucontext_t ctx;
+    void *stack;
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+    UBaseType_t prio;
+    uint8_t state;
+    uint8_t wait;
+    struct sim_queue *wait_q;
+    uint64_t wake_us;
+    bool timed_out;
+    uint32_t notify;
+    uint64_t order;
+    uint64_t switches;
+    uint32_t stack_depth;
+};
+
+struct sim_queue {
+    uint8_t *buf;
+    bool own_buf;
+    UBaseType_t item;
+    UBaseType_t cap;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+typedef struct {
+    uint64_t at;
+    uint64_t seq;
+    sim_fn_t fn;
+    void *arg;
+} sim_event_t;
+
+static struct sim_task *tasks[SIM_MAX_TASKS];
+static size_t task_n;
+static struct sim_task *current;
+static ucontext_t sched_ctx;
+static uint64_t now_us;
+static uint64_t order_seq;
+static uint32_t critical_depth;
+static bool switch_pending;   // a task woke inside a critical section or an ISR raised by a task
+static uint32_t spin_reads;
+static sim_stats_t stats;
+
+static sim_event_t *events;
+static size_t ev_len, ev_cap;
+static uint64_t ev_seq;
+
+static void fatal(const char *what)
+{
+    fprintf(stderr, "sim: %s (task %s, t=%llu us)\n", what, current ? current->name : "isr",
+            (unsigned long long)now_us);
+    abort();
+}
+
+// ---- scripted events: binary min-heap on (at, seq) ----
+
+static bool ev_before(const sim_event_t *a, const sim_event_t *b)
+{
+    return a->at < b->at || (a->at == b->at && a->seq < b->seq);
+}
+
+void sim_at(uint64_t at_us, sim_fn_t fn, void *arg)
+{
+    if (ev_len == ev_cap) {
+        ev_cap = ev_cap ? ev_cap * 2 : 64;
+        events = realloc(events, ev_cap * sizeof(*events));
+        if (!events) fatal("out of memory");
+    }
+    size_t i = ev_len++;
+    events[i] = (sim_event_t){ .at = at_us > now_us ? at_us : now_us, .seq = ev_seq++, .fn = fn, .arg = arg };
+    while (i > 0) {
+        size_t p = (i - 1) / 2;
+        if (!ev_before(&events[i], &events[p])) break;
+        sim_event_t t = events[i];
+        events[i] = events[p];
+        events[p] = t;
+        i = p;
+    }
+}
+
+static sim_event_t ev_pop(void)
+{
+    sim_event_t top = events[0];
+    events[0] = events[--ev_len];
+    size_t i = 0;
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < ev_len && ev_before(&events[l], &events[m])) m = l;
+        if (r < ev_len && ev_before(&events[r], &events[m])) m = r;
+        if (m == i) break;
+        sim_event_t t = events[i];
+        events[i] = events[m];
+        events[m] = t;
+        i = m;
+    }
+    return top;
+}
+
+// ---- scheduler ----
+
+static void make_ready(struct sim_task *t)
+{
+    t->state = T_READY;
+    t->wait = W_NONE;
+    t->wait_q = NULL;
+    t->wake_us = SIM_NEVER;
+    t->order = ++order_seq;
+}
+
+static struct sim_task *pick(void)
+{
+    struct sim_task *best = NULL;
+    for (size_t i = 0; i < task_n; ++i) {
+        struct sim_task *t = tasks[i];
+        if (t->state != T_READY) continue;
+        if (!best || t->prio > best->prio || (t->prio == best->prio && t->order < best->order)) best = t;
+    }
+    return best;
+}
+
+static void to_scheduler(void)
+{
+    swapcontext(&current->ctx, &sched_ctx);
+}
+
+// a task became ready: run it now if it outranks the running one
+static void after_wake(struct sim_task *t, BaseType_t *woken)
+{
+    if (!t) return;
+    if (!current) {
+        if (woken) *woken = pdTRUE;
+        switch_pending = true;
+    } else if (t->prio > current->prio) {
+        if (critical_depth) switch_pending = true;
+        else to_scheduler();
+    }
+}
+
+// end of a critical section or of an ISR that interrupted a task: the scheduler
+// picks the highest ready task, the running one stays ready
+static void switch_if_pending(void)
+{
+    if (!switch_pending || !current || critical_depth) return;
+    switch_pending = false;
+    to_scheduler();
+}
+
+static bool block(uint8_t wait, struct sim_queue *q, uint64_t deadline)
+{
+    if (!current) fatal("blocking call from interrupt context");
+    if (critical_depth) fatal("blocking call inside a critical section");
+    current->state = T_BLOCKED;
+    current->wait = wait;
+    current->wait_q = q;
+    current->wake_us = deadline;
+    current->timed_out = false;
+    current->order = ++order_seq;
+    to_scheduler();
+    return !current->timed_out;
+}
+
+static uint64_t deadline_of(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? SIM_NEVER : now_us + (uint64_t)ticks * TICK_US;
+}
+
+static void trampoline(void)
+{
+    current->fn(current->arg);
+    current->state = T_DONE;
+    to_scheduler();
+}
+
+static void (*main_entry)(void);
+
+static void main_task(void *arg)
+{
+    main_entry();
+}
+
+void sim_run(void (*main_fn)(void), uint64_t until_us)
+{
+    main_entry = main_fn;
+    sim_timer_start();
+    xTaskCreate(main_task, "main", 3584, NULL, 1, NULL);
+    for (;;) {
+        while (ev_len && events[0].at <= now_us) {
+            sim_event_t ev = ev_pop();
+            stats.isr_events++;
+            ev.fn(ev.arg);
+        }
+        struct sim_task *t = pick();
+        if (t) {
+            current = t;
+            if (TRACE_ON(TRACE_EV_TASK_IN)) trace_task_switched_in();
+            switch_pending = false;
+            spin_reads = 0;
+            t->switches++;
+            stats.switches++;
+            swapcontext(&sched_ctx, &t->ctx);
+            if (t->state == T_DONE && t->stack) {
+                free(t->stack);
+                t->stack = NULL;
+            }
+            current = NULL;
+            continue;
+        }
+        uint64_t next = ev_len ? events[0].at : SIM_NEVER;
+        for (size_t i = 0; i < task_n; ++i) {
+            if (tasks[i]->state == T_BLOCKED && tasks[i]->wake_us < next) next = tasks[i]->wake_us;
+        }
+        if (next == SIM_NEVER || next > until_us) break;
+        if (next > now_us) now_us = next;
+        for (size_t i = 0; i < task_n; ++i) {
+            struct sim_task *b = tasks[i];
+            if (b->state != T_BLOCKED || b->wake_us > now_us) continue;
+            b->timed_out = true;
+            make_ready(b);
+        }
+    }
+    if (now_us < until_us) now_us = until_us;
+}
+
+uint64_t sim_now_us(void)
+{
+    return now_us;
+}
+
+bool sim_in_isr(void)
+{
+    return current == NULL;
+}
+
+struct sim_task *sim_isr_enter(void)
+{
+    struct sim_task *t = current;
+    current = NULL;
+    return t;
+}
+
+void sim_isr_exit(struct sim_task *interrupted)
+{
+    current = interrupted;
+    switch_if_pending();
+}
+
+void sim_get_stats(sim_stats_t *out)
+{
+    *out = stats;
+    out->tasks = (uint32_t)task_n;
+}
+
+size_t sim_task_count(void)
+{
+    return task_n;
+}
+
+const char *sim_task_info(size_t idx, uint64_t *switches)
+{
+    if (idx >= task_n) return NULL;
+    if (switches) *switches = tasks[idx]->switches;
+    return tasks[idx]->name;
+}
+
+struct sim_task *sim_self(void)
+{
+    return current;
+}
+
+bool sim_park(uint64_t deadline_us)
+{
+    return block(W_PARK, NULL, deadline_us);
+}
+
+void sim_wake(struct sim_task *t)
+{
+    if (t && t->state == T_BLOCKED && t->wait == W_PARK) {
+        make_ready(t);
+        after_wake(t, NULL);
+    }
+}
+
+uint64_t sim_clock_read(void)
+{
+    if (current && ++spin_reads > SPIN_READS) now_us++;
+    return now_us;
+}
+
+void sim_delay(uint64_t us)
+{
+    now_us += us;
+}
+
+void sim_critical_enter(portMUX_TYPE *mux)
+{
+    mux->count++;
+    critical_depth++;
+}
+
+void sim_critical_exit(portMUX_TYPE *mux)
+{
+    if (!mux->count || !critical_depth) fatal("unbalanced critical section");
+    mux->count--;
+    critical_depth--;
+    switch_if_pending();
+}
+
+void sim_yield(void)
+{
+    if (!current) return;
+    current->order = ++order_seq;
+    to_scheduler();
+}
+
+// ---- tasks ----
+
+// getcontext() is returns_twice: kept apart so no caller's locals live across it
+static __attribute__((noinline)) void context_init(ucontext_t *ctx)
+{
+    getcontext(ctx);
+}
+
+static struct sim_task *task_new(TaskFunction_t fn, const char *name, void *arg, UBaseType_t prio)
+{
+    if (task_n == SIM_MAX_TASKS) return NULL;
+    struct sim_task *t = calloc(1, sizeof(*t));
+    if (!t) return NULL;
+    t->stack = malloc(SIM_STACK_BYTES);
+    if (!t->stack) {
+        free(t);
+        return NULL;
+    }
+    t->fn = fn;
+    t->arg = arg;
+    t->prio = prio;
+    snprintf(t->name, sizeof(t->name), "%s", name ? name : "task");
+    context_init(&t->ctx);
+    t->ctx.uc_stack.ss_sp = t->stack;
+    t->ctx.uc_stack.ss_size = SIM_STACK_BYTES;
+    t->ctx.uc_link = NULL;
+    makecontext(&t->ctx, trampoline, 0);
+    make_ready(t);
+    tasks[task_n++] = t;
+    return t;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t prio, TaskHandle_t *out)
+{
+    struct sim_task *t = task_new(fn, name, arg, prio);
+    if (out) *out = t;
+    if (!t) return pdFAIL;
+    t->stack_depth = stack_depth;
+    if (current && prio > current->prio) sim_yield();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *out, BaseType_t core)
+{
+    return xTaskCreate(fn, name, stack_depth, arg, prio, out);
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                               UBaseType_t prio, StackType_t *stack, StaticTask_t *tcb)
+{
+    if (!stack || !tcb) return NULL;
+    TaskHandle_t h = NULL;
+    xTaskCreate(fn, name, stack_depth, arg, prio, &h);
+    return h;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    struct sim_task *t = task ? task : current;
+    if (!t) fatal("vTaskDelete(NULL) from interrupt context");
+    t->state = T_DONE;
+    if (t == current) to_scheduler();
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0) {
+        sim_yield();
+        return;
+    }
+    block(W_SLEEP, NULL, deadline_of(ticks));
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(now_us / TICK_US);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current;
+}
+
+const char *pcTaskGetName(TaskHandle_t task)
+{
+    struct sim_task *t = task ? task : current;
+    return t ? t->name : "isr";
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    struct sim_task *t = task ? task : current;
+    return t ? t->stack_depth : 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    if (!current) fatal("ulTaskNotifyTake from interrupt context");
+    if (current->notify == 0 && ticks) block(W_NOTIFY, NULL, deadline_of(ticks));
+    uint32_t v = current->notify;
+    if (v) current->notify = clear_on_exit ? 0 : v - 1;
+    return v;
+}
+
+static void notify_give(struct sim_task *t, BaseType_t *woken)
+{
+    if (!t) return;
+    t->notify++;
+    if (t->state == T_BLOCKED && t->wait == W_NOTIFY) {
+        make_ready(t);
+        after_wake(t, woken);
+    }
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    notify_give(task, NULL);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_prio_woken)
+{
+    notify_give(task, higher_prio_woken);
+}
+
+// ---- queues and semaphores ----
+
+static struct sim_task *wake_one(struct sim_queue *q, uint8_t wait)
+{
+    struct sim_task *best = NULL;
+    for (size_t i = 0; i < task_n; ++i) {
+        struct sim_task *t = tasks[i];
+        if (t->state != T_BLOCKED || t->wait != wait || t->wait_q != q) continue;
+        if (!best || t->prio > best->prio || (t->prio == best->prio && t->order < best->order)) best = t;
+    }
+    if (best) make_ready(best);
+    return best;
+}
+
+static struct sim_queue *queue_new(UBaseType_t cap, UBaseType_t item, uint8_t *storage)
+{
+    struct sim_queue *q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+    q->cap = cap;
+    q->item = item;
+    if (item) {
+        q->own_buf = storage == NULL;
+        q->buf = storage ? storage : malloc((size_t)cap * item);
+        if (!q->buf) {
+            free(q);
+            return NULL;
+        }
+    }
+    return q;
+}
+
+static BaseType_t queue_send(struct sim_queue *q, const void *item, TickType_t ticks, BaseType_t *woken)
+{
+    uint64_t deadline = deadline_of(ticks);
+    for (;;) {
+        if (q->count < q->cap) {
+            if (q->item && item) memcpy(q->buf + ((q->head + q->count) % q->cap) * q->item, item, q->item);
+            q->count++;
+            after_wake(wake_one(q, W_RECV), woken);
+            return pdTRUE;
+        }
+        if (ticks == 0 || !current) return errQUEUE_FULL;
+        if (!block(W_SEND, q, deadline)) return errQUEUE_FULL;
+    }
+}
+
+static BaseType_t queue_receive(struct sim_queue *q, void *out, TickType_t ticks)
+{
+    uint64_t deadline = deadline_of(ticks);
+    for (;;) {
+        if (q->count) {
+            if (q->item && out) memcpy(out, q->buf + q->head * q->item, q->item);
+            q->head = (q->head + 1) % q->cap;
+            q->count--;
+            after_wake(wake_one(q, W_SEND), NULL);
+            return pdTRUE;
+        }
+        if (ticks == 0) return pdFALSE;
+        if (!block(W_RECV, q, deadline)) return pdFALSE;
+    }
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    return length ? queue_new(length, item_size, NULL) : NULL;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage, StaticQueue_t *buf)
+{
+    if (!length || !buf || (item_size && !storage)) return NULL;
+    return queue_new(length, item_size, storage);
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (!q) return;
+    if (q->own_buf) free(q->buf);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    return queue_send(q, item, ticks, NULL);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *higher_prio_woken)
+{
+    return queue_send(q, item, 0, higher_prio_woken);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *out, TickType_t ticks)
+{
+    return queue_receive(q, out, ticks);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    return q->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    struct sim_queue *q = queue_new(1, 0, NULL);
+    if (q) q->count = 1;
+    return q;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return queue_new(1, 0, NULL);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    struct sim_queue *q = max ? queue_new(max, 0, NULL) : NULL;
+    if (q) q->count = initial <= max ? initial : max;
+    return q;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks)
+{
+    return queue_receive(s, NULL, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    return queue_send(s, NULL, 0, NULL);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t s, BaseType_t *higher_prio_woken)
+{
+    return queue_send(s, NULL, 0, higher_prio_woken);
+}
+
+void sim_count_timer_callback(void)
+{
+    stats.timer_callbacks++;
+}
@@ -0,0 +1,171 @@
+#include "sim.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_sntp.h"
+#include "driver/uart.h"
+#include "freertos/task.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+// Logging, error names, reset reason, heap figures, SNTP hooks, the wall clock and
+// console input.
+
+// typical free heap of the firmware on an ESP32 with NimBLE up
+#define SIM_HEAP_FREE (150 * 1024)
+
+static esp_log_level_t log_level = ESP_LOG_INFO;
+static int64_t wall_offset_us;   // epoch minus virtual uptime
+static sntp_sync_time_cb_t sntp_cb;
+static bool sntp_started;
+static char console_in[64];
+static size_t console_len;
+static TaskHandle_t console_reader;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char LETTER[] = "NEWIDV";
+    if (level > log_level) return;
+    uint64_t t = sim_now_us();
+    printf("%c (%llu.%03llu) %s: ", LETTER[level], (unsigned long long)(t / 1000000),
+           (unsigned long long)(t / 1000 % 1000), tag);
+    va_list ap;
+    va_start(ap, format);
+    vprintf(format, ap);
+    va_end(ap);
+    putchar('\n');
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_NOT_FINISHED: return "ESP_ERR_NOT_FINISHED";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return ESP_RST_POWERON;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return SIM_HEAP_FREE;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return SIM_HEAP_FREE;
+}
+
+// ---- wall clock: firmware sources are built with gettimeofday/settimeofday renamed to these ----
+
+void sim_wall_set_us(int64_t epoch_us)
+{
+    wall_offset_us = epoch_us - (int64_t)sim_now_us();
+}
+
+int64_t sim_wall_us(void)
+{
+    return (int64_t)sim_now_us() + wall_offset_us;
+}
+
+int sim_gettimeofday(struct timeval *tv, void *tz)
+{
+    (void)tz;
+    if (tv) {
+        int64_t us = sim_wall_us();
+        tv->tv_sec = (time_t)(us / 1000000);
+        tv->tv_usec = (suseconds_t)(us % 1000000);
+    }
+    return 0;
+}
+
+int sim_settimeofday(const struct timeval *tv, const void *tz)
+{
+    (void)tz;
+    if (tv) sim_wall_set_us((int64_t)tv->tv_sec * 1000000 + tv->tv_usec);
+    return 0;
+}
+
+// ---- SNTP: no network; a scenario stands in for the server ----
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback)
+{
+    sntp_cb = callback;
+}
+
+void esp_sntp_setoperatingmode(sntp_operatingmode_t mode)
+{
+    (void)mode;
+}
+
+void esp_sntp_setservername(unsigned char idx, const char *server)
+{
+    (void)idx;
+    (void)server;
+}
+
+void esp_sntp_init(void)
+{
+    sntp_started = true;
+}
+
+void sim_sntp_fire(void)
+{
+    if (!sntp_started || !sntp_cb) return;
+    struct timeval tv;
+    sim_gettimeofday(&tv, NULL);
+    sntp_cb(&tv);
+}
+
+esp_err_t uart_driver_install(uart_port_t port, int rx_buffer_size, int tx_buffer_size, int queue_size,
+                              QueueHandle_t *queue, int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+// one reader, like the console task
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    if (!console_len) {
+        console_reader = xTaskGetCurrentTaskHandle();
+        ulTaskNotifyTake(pdTRUE, ticks_to_wait);
+        console_reader = NULL;
+    }
+    size_t n = length < console_len ? length : console_len;
+    memcpy(buf, console_in, n);
+    memmove(console_in, console_in + n, console_len - n);
+    console_len -= n;
+    return (int)n;
+}
+
+void sim_console_input(const char *text)
+{
+    size_t n = strlen(text);
+    if (n > sizeof(console_in) - console_len) n = sizeof(console_in) - console_len;
+    memcpy(console_in + console_len, text, n);
+    console_len += n;
+    if (console_reader) vTaskNotifyGiveFromISR(console_reader, NULL);
+}
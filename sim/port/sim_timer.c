@@ -0,0 +1,125 @@
+#include "sim_internal.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+
+// esp_timer on the virtual clock: one high-priority "esp_timer" task runs the
+// callbacks in deadline order, like ESP_TIMER_TASK dispatch on the target.
+
+#define TIMER_TASK_PRIO 22
+
+struct esp_timer {
+    esp_timer_cb_t cb;
+    void *arg;
+    const char *name;
+    uint64_t due_us;
+    uint64_t period_us;     // 0 for one-shot
+    bool active;
+    struct esp_timer *next;
+};
+
+static struct esp_timer *timers;
+static struct sim_task *timer_task;
+
+static struct esp_timer *earliest(void)
+{
+    struct esp_timer *best = NULL;
+    for (struct esp_timer *t = timers; t; t = t->next) {
+        if (t->active && (!best || t->due_us < best->due_us)) best = t;
+    }
+    return best;
+}
+
+static void timer_task_fn(void *arg)
+{
+    timer_task = sim_self();
+    for (;;) {
+        struct esp_timer *t = earliest();
+        if (!t || t->due_us > sim_now_us()) {
+            sim_park(t ? t->due_us : SIM_NEVER);
+            continue;
+        }
+        if (t->period_us) t->due_us += t->period_us;
+        else t->active = false;
+        sim_count_timer_callback();
+        t->cb(t->arg);
+    }
+}
+
+void sim_timer_start(void)
+{
+    xTaskCreate(timer_task_fn, "esp_timer", 3584, NULL, TIMER_TASK_PRIO, NULL);
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    if (!args || !args->callback || !out) return ESP_ERR_INVALID_ARG;
+    struct esp_timer *t = calloc(1, sizeof(*t));
+    if (!t) return ESP_ERR_NO_MEM;
+    t->cb = args->callback;
+    t->arg = args->arg;
+    t->name = args->name;
+    t->next = timers;
+    timers = t;
+    *out = t;
+    return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t t, uint64_t delay_us, uint64_t period_us)
+{
+    if (!t) return ESP_ERR_INVALID_ARG;
+    if (t->active) return ESP_ERR_INVALID_STATE;
+    t->due_us = sim_now_us() + delay_us;
+    t->period_us = period_us;
+    t->active = true;
+    sim_wake(timer_task);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    return timer_start(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    if (!timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    for (struct esp_timer **p = &timers; *p; p = &(*p)->next) {
+        if (*p == timer) {
+            *p = timer->next;
+            break;
+        }
+    }
+    free(timer);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer && timer->active;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)sim_clock_read();
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    sim_delay(us);
+}
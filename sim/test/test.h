@@ -0,0 +1,30 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+
+// Checks for the module tests in sim/test. A failed check prints where and
+// why and the test keeps going; main() ends with `return TEST_RESULT();`.
+
+static int test_failures;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            test_failures++;                                                     \
+        }                                                                        \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                       \
+    do {                                                                                     \
+        long long a_ = (long long)(a), b_ = (long long)(b);                                  \
+        if (a_ != b_) {                                                                      \
+            fprintf(stderr, "%s:%d: %s == %s failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, \
+                    a_, b_);                                                                 \
+            test_failures++;                                                                 \
+        }                                                                                    \
+    } while (0)
+
+#define TEST_RESULT()                                                                  \
+    (test_failures ? (fprintf(stderr, "FAIL: %d check(s)\n", test_failures), 1)        \
+                   : (printf("PASS\n"), 0))
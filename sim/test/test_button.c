@@ -0,0 +1,247 @@
+#include "test.h"
+#include "sim.h"
+#include "button.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Bounce patterns in the shape of scope captures of tactile switches (a clean
+// edge, a few fast chatters, a long tail out to 6 ms, a scratchy contact with 25
+// edges) played on the sim pads for press and release. Every gesture must come
+// out exactly once, and the callback must follow the first edge by no more than
+// the burst plus the debounce time. Also glitches, double clicks, long presses,
+// chords and a burst on several buttons at once that overflows the ISR ring.
+
+#define NBTN 3
+#define DEBOUNCE_MS 20
+#define SLACK_US 1000   // timer and callback dispatch
+
+static const gpio_num_t PINS[NBTN] = { GPIO_NUM_13, GPIO_NUM_12, GPIO_NUM_14 };
+
+typedef struct {
+    const char *name;
+    uint8_t n;             // odd: the pad ends on the other level
+    uint32_t edge_us[25];  // from the first edge
+} bounce_t;
+
+static const bounce_t PATTERNS[] = {
+    { "clean", 1, { 0 } },
+    { "chatter", 5, { 0, 40, 90, 300, 350 } },
+    { "long tail", 11, { 0, 120, 400, 410, 900, 1500, 2600, 2650, 4100, 4300, 6200 } },
+    { "scratchy", 25, { 0,    150,  310,  500,  720,  950,  1200, 1480, 1790, 2130, 2500, 2900, 3340,
+                        3810, 4320, 4870, 5460, 6090, 6760, 7470, 8220, 9010, 9840, 10710, 11620 } },
+};
+#define NPATTERNS (sizeof(PATTERNS) / sizeof(PATTERNS[0]))
+
+typedef struct {
+    size_t idx;
+    button_event_t ev;
+    uint64_t t_us;
+} logged_t;
+
+static logged_t events[64];
+static size_t nevents;
+
+static void on_button(size_t idx, button_event_t ev)
+{
+    if (nevents < sizeof(events) / sizeof(events[0])) events[nevents++] = (logged_t){ idx, ev, sim_now_us() };
+}
+
+typedef struct {
+    int pin;
+    int level;
+} pad_set_t;
+
+static pad_set_t sets[1024];
+static size_t nsets;
+
+static void set_cb(void *arg)
+{
+    const pad_set_t *s = arg;
+    sim_gpio_set_input(s->pin, s->level);
+}
+
+static void edge_at(uint64_t t, size_t btn, int level)
+{
+    pad_set_t *s = &sets[nsets++ % (sizeof(sets) / sizeof(sets[0]))];
+    *s = (pad_set_t){ PINS[btn], level };
+    sim_at(t, set_cb, s);
+}
+
+// press (pad low) or release (pad high) of button btn starting at t
+static void play(uint64_t t, size_t btn, bool press, const bounce_t *b)
+{
+    for (uint8_t k = 0; k < b->n; ++k) edge_at(t + b->edge_us[k], btn, (k & 1) == press);
+}
+
+static uint64_t burst_us(const bounce_t *b)
+{
+    return b->edge_us[b->n - 1];
+}
+
+static void start(void)
+{
+    nevents = 0;
+}
+
+static void wait_ms(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+// event i is `ev` of button idx, delivered within [t0 + debounce, t0 + span + debounce]
+static uint64_t worst_latency;
+static void expect(size_t i, size_t idx, button_event_t ev, uint64_t t0, uint64_t span_us)
+{
+    CHECK(i < nevents);
+    if (i >= nevents) return;
+    CHECK_EQ(events[i].idx, idx);
+    CHECK_EQ(events[i].ev, ev);
+    uint64_t lat = events[i].t_us - t0;
+    CHECK(events[i].t_us >= t0 + SIM_MS(DEBOUNCE_MS));
+    CHECK(lat <= span_us + SIM_MS(DEBOUNCE_MS) + SLACK_US);
+    if (ev == BUTTON_EVENT_PRESS || ev == BUTTON_EVENT_RELEASE) {
+        if (lat > worst_latency) worst_latency = lat;
+    }
+}
+
+static void test_patterns(void)
+{
+    for (size_t p = 0; p < NPATTERNS; ++p) {
+        const bounce_t *b = &PATTERNS[p];
+        start();
+        uint64_t t = sim_now_us() + SIM_MS(10);
+        play(t, 0, true, b);
+        play(t + SIM_MS(150), 0, false, b);
+        wait_ms(1000);
+        CHECK_EQ(nevents, 3);
+        expect(0, 0, BUTTON_EVENT_PRESS, t, burst_us(b));
+        expect(1, 0, BUTTON_EVENT_RELEASE, t + SIM_MS(150), burst_us(b));
+        // the double-click window counts from the release's first edge
+        expect(2, 0, BUTTON_EVENT_CLICK, t + SIM_MS(150 + 300) - SIM_MS(DEBOUNCE_MS), SIM_MS(DEBOUNCE_MS));
+        printf("  %-10s %2u edges over %5.1f ms: press after %.1f ms, release after %.1f ms\n", b->name, b->n,
+               burst_us(b) / 1000.0, (events[0].t_us - t) / 1000.0, (events[1].t_us - t - SIM_MS(150)) / 1000.0);
+    }
+}
+
+static void test_glitch(void)
+{
+    // chatter that ends where it started, shorter and longer than the debounce
+    static const bounce_t glitch = { "glitch", 4, { 0, 50, 2000, 2100 } };
+    static const bounce_t slow = { "slow", 2, { 0, 15000 } };
+    start();
+    uint64_t t = sim_now_us() + SIM_MS(10);
+    play(t, 1, true, &glitch);
+    play(t + SIM_MS(100), 1, true, &slow);
+    wait_ms(1000);
+    CHECK_EQ(nevents, 0);
+}
+
+static void test_double_click(void)
+{
+    const bounce_t *b = &PATTERNS[2];
+    start();
+    uint64_t t = sim_now_us() + SIM_MS(10);
+    play(t, 2, true, b);
+    play(t + SIM_MS(100), 2, false, b);
+    play(t + SIM_MS(200), 2, true, b);
+    play(t + SIM_MS(300), 2, false, b);
+    wait_ms(1000);
+    CHECK_EQ(nevents, 5);
+    expect(0, 2, BUTTON_EVENT_PRESS, t, burst_us(b));
+    expect(1, 2, BUTTON_EVENT_RELEASE, t + SIM_MS(100), burst_us(b));
+    expect(2, 2, BUTTON_EVENT_PRESS, t + SIM_MS(200), burst_us(b));
+    expect(3, 2, BUTTON_EVENT_RELEASE, t + SIM_MS(300), burst_us(b));
+    expect(4, 2, BUTTON_EVENT_DOUBLE_CLICK, t + SIM_MS(300), burst_us(b));
+}
+
+static void test_long_press(void)
+{
+    const bounce_t *b = &PATTERNS[3];
+    start();
+    uint64_t t = sim_now_us() + SIM_MS(10);
+    play(t, 0, true, b);
+    play(t + SIM_S(6), 0, false, b);
+    wait_ms(7000);
+    CHECK_EQ(nevents, 3);
+    expect(0, 0, BUTTON_EVENT_PRESS, t, burst_us(b));
+    // measured from the first edge, not from the end of the bounce
+    CHECK(nevents > 1 && events[1].ev == BUTTON_EVENT_LONG_PRESS && events[1].t_us >= t + SIM_S(5) &&
+          events[1].t_us <= t + SIM_S(5) + burst_us(b) + SIM_MS(DEBOUNCE_MS) + SLACK_US);
+    expect(2, 0, BUTTON_EVENT_RELEASE, t + SIM_S(6), burst_us(b));
+}
+
+static void test_chord(void)
+{
+    start();
+    uint64_t t = sim_now_us() + SIM_MS(10);
+    play(t, 0, true, &PATTERNS[1]);
+    play(t + SIM_MS(30), 1, true, &PATTERNS[2]);
+    play(t + SIM_MS(500), 0, false, &PATTERNS[3]);
+    play(t + SIM_MS(520), 1, false, &PATTERNS[0]);
+    wait_ms(1500);
+    CHECK_EQ(nevents, 5);
+    expect(0, 0, BUTTON_EVENT_PRESS, t, burst_us(&PATTERNS[1]));
+    expect(1, 1, BUTTON_EVENT_PRESS, t + SIM_MS(30), burst_us(&PATTERNS[2]));
+    expect(2, 0x3, BUTTON_EVENT_CHORD, t + SIM_MS(30), burst_us(&PATTERNS[2]));
+    // no clicks after a chord
+    expect(3, 0, BUTTON_EVENT_RELEASE, t + SIM_MS(500), burst_us(&PATTERNS[3]));
+    expect(4, 1, BUTTON_EVENT_RELEASE, t + SIM_MS(520), 0);
+}
+
+// three scratchy presses at once are 75 edges for a 64-entry ring
+static void test_ring_overflow(void)
+{
+    const bounce_t *b = &PATTERNS[3];
+    uint32_t dropped0 = button_edges_dropped();
+    start();
+    uint64_t t = sim_now_us() + SIM_MS(10);
+    for (size_t i = 0; i < NBTN; ++i) play(t + i * 100, i, true, b);
+    for (size_t i = 0; i < NBTN; ++i) play(t + SIM_MS(200) + i * 100, i, false, b);
+    wait_ms(1000);
+    CHECK(button_edges_dropped() > dropped0);
+    size_t presses = 0, releases = 0, chords = 0;
+    for (size_t i = 0; i < nevents; ++i) {
+        if (events[i].ev == BUTTON_EVENT_CHORD) {
+            chords++;
+            continue;
+        }
+        // the burst restarts at the drain: at most one more debounce time
+        uint64_t t0 = t + (events[i].ev == BUTTON_EVENT_RELEASE ? SIM_MS(200) : 0) + events[i].idx * 100;
+        CHECK(events[i].t_us <= t0 + burst_us(b) + 2 * SIM_MS(DEBOUNCE_MS) + SLACK_US);
+        presses += events[i].ev == BUTTON_EVENT_PRESS;
+        releases += events[i].ev == BUTTON_EVENT_RELEASE;
+    }
+    CHECK_EQ(presses, NBTN);
+    CHECK_EQ(releases, NBTN);
+    // the second button makes a chord, the third extends it
+    CHECK_EQ(chords, 2);
+    CHECK_EQ(nevents, NBTN * 2 + chords);
+    printf("  overflow: %u edges dropped, all %d buttons pressed and released once\n",
+           (unsigned)(button_edges_dropped() - dropped0), NBTN);
+}
+
+static void test_main(void)
+{
+    for (size_t i = 0; i < NBTN; ++i) sim_gpio_set_input(PINS[i], 1);
+    button_config_t cfg = BUTTON_CONFIG_DEFAULT();
+    cfg.debounce_ms = DEBOUNCE_MS;
+    CHECK_EQ(button_init_cfg(PINS, NBTN, on_button, &cfg), ESP_OK);
+
+    test_patterns();
+    test_glitch();
+    test_double_click();
+    test_long_press();
+    test_chord();
+    test_ring_overflow();
+    printf("edge to callback: worst %.1f ms for a %.1f ms burst and %d ms debounce\n", worst_latency / 1000.0,
+           burst_us(&PATTERNS[3]) / 1000.0, DEBOUNCE_MS);
+    CHECK_EQ(button_deinit(), ESP_OK);
+}
+
+int main(void)
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+    sim_run(test_main, SIM_NEVER);
+    return TEST_RESULT();
+}
@@ -0,0 +1,184 @@
+#include "test.h"
+#include "sim.h"
+#include "clock_map.h"
+#include "esp_log.h"
+#include <string.h>
+
+// Records stamped with (boot, uptime) across several reboots, with the table kept
+// in a RAM stand-in for NVS between them. Each boot syncs at some point, some
+// never do, some drift and get corrected; every record must convert to the wall
+// time it was taken at (within the correction step) no matter how many boots
+// later it is exported, and a boot that filled the table with corrections must
+// not push earlier boots out.
+
+#define EPOCH0 1700000000000ULL
+#define MIN_MS 60000ULL
+
+static uint8_t nvs_blob[1024];
+static size_t nvs_len;
+static int saves;
+
+static esp_err_t ram_load(void *ctx, void *buf, size_t *len)
+{
+    if (!nvs_len) return ESP_ERR_NOT_FOUND;
+    if (*len > nvs_len) *len = nvs_len;
+    memcpy(buf, nvs_blob, *len);
+    return ESP_OK;
+}
+
+static esp_err_t ram_save(void *ctx, const void *buf, size_t len)
+{
+    if (len > sizeof(nvs_blob)) return ESP_ERR_NO_MEM;
+    memcpy(nvs_blob, buf, len);
+    nvs_len = len;
+    saves++;
+    return ESP_OK;
+}
+
+static const clock_map_store_t STORE = { .load = ram_load, .save = ram_save };
+
+static record_t rec(uint16_t boot, uint64_t mono_ms)
+{
+    return (record_t){ .seq = 1, .ts_ms = mono_ms, .boot = boot };
+}
+
+static uint64_t epoch_of(record_t r)
+{
+    CHECK_EQ(clock_map_rebase(&r, 1), 1);
+    CHECK_EQ(r.boot, RECORD_BOOT_EPOCH);
+    return r.ts_ms;
+}
+
+static void test_reboots(void)
+{
+    nvs_len = 0;
+    // boot 1 powers up at EPOCH0, learns the time after 10 min, then is found
+    // 5 s slow after two hours
+    CHECK_EQ(clock_map_init(&STORE), ESP_OK);
+    uint16_t b1 = clock_map_boot();
+    CHECK_EQ(b1, 1);
+    record_t before_sync = rec(b1, 2 * MIN_MS);
+    record_t r = before_sync;
+    CHECK_EQ(clock_map_rebase(&r, 1), 0);   // nothing known yet
+    CHECK_EQ(r.boot, b1);
+    CHECK_EQ(clock_map_sync(10 * MIN_MS, EPOCH0 + 10 * MIN_MS), ESP_OK);
+    CHECK_EQ(clock_map_sync(120 * MIN_MS, EPOCH0 + 120 * MIN_MS + 5000), ESP_OK);
+    // a small step is not worth an entry
+    int s0 = saves;
+    CHECK_EQ(clock_map_sync(180 * MIN_MS, EPOCH0 + 180 * MIN_MS + 5000 + CLOCK_MAP_MIN_STEP_MS - 1), ESP_OK);
+    CHECK_EQ(saves, s0);
+    CHECK_EQ(epoch_of(before_sync), EPOCH0 + 2 * MIN_MS);   // the first offset applies backwards
+    CHECK_EQ(epoch_of(rec(b1, 60 * MIN_MS)), EPOCH0 + 60 * MIN_MS);
+    CHECK_EQ(epoch_of(rec(b1, 150 * MIN_MS)), EPOCH0 + 150 * MIN_MS + 5000);
+
+    // boot 2 starts a day later and never syncs: its records stay in uptime
+    CHECK_EQ(clock_map_init(&STORE), ESP_OK);
+    uint16_t b2 = clock_map_boot();
+    CHECK_EQ(b2, 2);
+    r = rec(b2, 5 * MIN_MS);
+    CHECK_EQ(clock_map_rebase(&r, 1), 0);
+
+    // boot 3 syncs; boot 1 still converts from the persisted table
+    const uint64_t boot3_at = EPOCH0 + 2 * 1440 * MIN_MS;
+    CHECK_EQ(clock_map_init(&STORE), ESP_OK);
+    uint16_t b3 = clock_map_boot();
+    CHECK_EQ(b3, 3);
+    CHECK_EQ(clock_map_sync(1000, boot3_at + 1000), ESP_OK);
+    record_t mixed[] = { rec(b1, 150 * MIN_MS), rec(b2, 5 * MIN_MS), rec(b3, 30 * MIN_MS),
+                         { .ts_ms = EPOCH0 + 7, .boot = RECORD_BOOT_EPOCH } };
+    CHECK_EQ(clock_map_rebase(mixed, 4), 2);
+    CHECK_EQ(mixed[0].ts_ms, EPOCH0 + 150 * MIN_MS + 5000);
+    CHECK_EQ(mixed[1].boot, b2);   // unknown stays as it was
+    CHECK_EQ(mixed[1].ts_ms, 5 * MIN_MS);
+    CHECK_EQ(mixed[2].ts_ms, boot3_at + 30 * MIN_MS);
+    CHECK_EQ(mixed[3].ts_ms, EPOCH0 + 7);   // already converted, not counted
+
+    // an unreadable table starts over, boot ids from 1
+    nvs_blob[0] ^= 0xFF;
+    CHECK_EQ(clock_map_init(&STORE), ESP_OK);
+    CHECK_EQ(clock_map_boot(), 1);
+    CHECK(!clock_map_to_epoch(b3, 0, &(uint64_t){ 0 }));
+}
+
+// a boot id that wrapped around drops the entries of the old boot with that id
+static void test_boot_wrap(void)
+{
+    nvs_len = 0;
+    CHECK_EQ(clock_map_init(&STORE), ESP_OK);
+    CHECK_EQ(clock_map_sync(0, EPOCH0), ESP_OK);
+    for (int i = 1; i < RECORD_BOOT_MAX; ++i) CHECK_EQ(clock_map_init(&STORE), ESP_OK);
+    CHECK_EQ(clock_map_boot(), RECORD_BOOT_MAX);
+    CHECK(clock_map_to_epoch(1, 0, &(uint64_t){ 0 }));
+    CHECK_EQ(clock_map_init(&STORE), ESP_OK);
+    CHECK_EQ(clock_map_boot(), 1);
+    CHECK(!clock_map_to_epoch(1, 0, &(uint64_t){ 0 }));
+}
+
+// a week-long boot corrected every hour must not evict the boots before it
+static void test_full_table(void)
+{
+    nvs_len = 0;
+    const int old_boots = 6;
+    for (int b = 1; b <= old_boots; ++b) {
+        CHECK_EQ(clock_map_init(&STORE), ESP_OK);
+        CHECK_EQ(clock_map_sync(MIN_MS, EPOCH0 + b * 1440 * MIN_MS), ESP_OK);
+        CHECK_EQ(clock_map_sync(2 * MIN_MS, EPOCH0 + b * 1440 * MIN_MS + MIN_MS + 3000), ESP_OK);
+    }
+    CHECK_EQ(clock_map_init(&STORE), ESP_OK);
+    uint16_t cur = clock_map_boot();
+    const uint64_t at = EPOCH0 + 30 * 1440 * MIN_MS;
+    int64_t drift = 0;
+    for (int h = 0; h < 7 * 24; ++h) {
+        drift += 2000;   // the RTC loses 2 s an hour
+        CHECK_EQ(clock_map_sync(h * 60 * MIN_MS, at + h * 60 * MIN_MS + drift), ESP_OK);
+    }
+    for (int b = 1; b <= old_boots; ++b) {
+        uint64_t e;
+        CHECK(clock_map_to_epoch(b, 90 * MIN_MS, &e));
+        CHECK_EQ(e, EPOCH0 + b * 1440 * MIN_MS + 89 * MIN_MS + 3000);
+        CHECK(clock_map_to_epoch(b, 0, &e));
+        CHECK_EQ(e, EPOCH0 + b * 1440 * MIN_MS - MIN_MS);
+    }
+    // the first offset still covers the start of the boot, the latest one its end
+    CHECK_EQ(epoch_of(rec(cur, 0)), at + 2000);
+    CHECK_EQ(epoch_of(rec(cur, 167 * 60 * MIN_MS + 1)), at + 167 * 60 * MIN_MS + 1 + drift);
+
+    // and the next boot survives a reboot with the table full
+    CHECK_EQ(clock_map_init(&STORE), ESP_OK);
+    CHECK_EQ(epoch_of(rec(cur, 167 * 60 * MIN_MS)), at + 167 * 60 * MIN_MS + drift);
+    CHECK_EQ(epoch_of(rec(1, 0)), EPOCH0 + 1440 * MIN_MS - MIN_MS);
+}
+
+// with no corrections of its own to collapse, the oldest earlier boot goes
+static void test_evict_oldest(void)
+{
+    nvs_len = 0;
+    for (int b = 1; b < CLOCK_MAP_MAX_SEGS; ++b) {
+        CHECK_EQ(clock_map_init(&STORE), ESP_OK);
+        CHECK_EQ(clock_map_sync(0, EPOCH0 + b * MIN_MS), ESP_OK);
+    }
+    CHECK_EQ(clock_map_init(&STORE), ESP_OK);
+    uint16_t cur = clock_map_boot();
+    CHECK_EQ(clock_map_sync(0, EPOCH0), ESP_OK);   // the 32nd entry
+    CHECK(clock_map_to_epoch(1, 0, &(uint64_t){ 0 }));
+    CHECK_EQ(clock_map_sync(MIN_MS, EPOCH0 + 2 * MIN_MS), ESP_OK);
+    CHECK(!clock_map_to_epoch(1, 0, &(uint64_t){ 0 }));
+    CHECK(clock_map_to_epoch(2, 0, &(uint64_t){ 0 }));
+    CHECK_EQ(epoch_of(rec(cur, 0)), EPOCH0);
+    CHECK_EQ(epoch_of(rec(cur, MIN_MS)), EPOCH0 + 2 * MIN_MS);
+}
+
+static void test_main(void)
+{
+    test_reboots();
+    test_boot_wrap();
+    test_full_table();
+    test_evict_oldest();
+}
+
+int main(void)
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+    sim_run(test_main, SIM_NEVER);
+    return TEST_RESULT();
+}
@@ -0,0 +1,257 @@
+#include "test.h"
+#include "dose_sched.h"
+#include "esp_log.h"
+#include <string.h>
+
+// Two weeks of a dose schedule on a virtual clock, driven the way dose_task does
+// it: one timer for dose_sched_next(), weight events in between, and reboots
+// that reload the table from a RAM stand-in for NVS. Every reminder, late
+// reminder and missed dose must come at its deadline, once; a dose taken before a
+// reboot must not be reminded again after it.
+
+#define MON 1704067200000ULL   // 2024-01-01 00:00 UTC, a Monday
+#define MIN DOSE_MIN_MS
+#define HOUR (60 * MIN)
+#define DAY (24 * HOUR)
+#define TZ_MIN 120             // local = UTC + 2 h
+#define LOG_MAX 256
+
+static uint8_t nvs_blob[512];
+static size_t nvs_len;
+
+static esp_err_t ram_load(void *ctx, void *buf, size_t *len)
+{
+    if (!nvs_len) return ESP_ERR_NOT_FOUND;
+    if (*len > nvs_len) *len = nvs_len;
+    memcpy(buf, nvs_blob, *len);
+    return ESP_OK;
+}
+
+static esp_err_t ram_save(void *ctx, const void *buf, size_t len)
+{
+    if (len > sizeof(nvs_blob)) return ESP_ERR_NO_MEM;
+    memcpy(nvs_blob, buf, len);
+    nvs_len = len;
+    return ESP_OK;
+}
+
+static const dose_sched_store_t STORE = { .load = ram_load, .save = ram_save };
+
+typedef struct {
+    uint64_t t;
+    dose_action_t a;
+} logged_t;
+
+static logged_t acts[LOG_MAX];
+static size_t nacts;
+static uint64_t now;
+
+static void log_acts(const dose_action_t *a, size_t n)
+{
+    for (size_t i = 0; i < n && nacts < LOG_MAX; ++i) acts[nacts++] = (logged_t){ now, a[i] };
+}
+
+// the dose timer fires at every deadline up to t
+static void advance_to(uint64_t t)
+{
+    dose_action_t a[4];
+    uint64_t at;
+    while (dose_sched_next(&at) && at <= t) {
+        CHECK(at >= now);
+        now = at;
+        size_t n;
+        do {
+            n = dose_sched_advance(now, a, 4);
+            log_acts(a, n);
+        } while (n == 4);
+    }
+    now = t;
+}
+
+static uint8_t take(uint8_t comp, uint64_t t)
+{
+    advance_to(t);
+    return dose_sched_taken(comp, t);
+}
+
+// powered off from now until t: no deadline fires in between
+static void reboot(uint64_t t)
+{
+    now = t;
+    dose_action_t a[DOSE_SLOTS];
+    CHECK_EQ(dose_sched_init(&STORE), ESP_OK);
+    log_acts(a, dose_sched_start(t, a, DOSE_SLOTS));
+}
+
+static size_t count(uint8_t slot, uint8_t type, uint64_t due, uint64_t t)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < nacts; ++i) {
+        const logged_t *l = &acts[i];
+        if (l->a.slot == slot && l->a.type == type && l->a.due_ms == due && l->t == t) n++;
+    }
+    return n;
+}
+
+static size_t count_slot(uint8_t slot)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < nacts; ++i) n += acts[i].a.slot == slot;
+    return n;
+}
+
+// the phone's table: DOSE_OP_SET and DOSE_OP_TZ as written to the control characteristic
+static void configure(void)
+{
+    // slot 0: compartment 1 every day at 08:00 local, 30 min early, 30 on time, 60 late
+    static const uint8_t morning[] = { DOSE_OP_SET, 0, 1, 0x7F, 0xE0, 0x01, 30, 30, 60 };
+    // slot 1: compartment 2 Mon, Wed, Fri at 20:30 local, 15 on time, 15 late
+    static const uint8_t evening[] = { DOSE_OP_SET, 1, 2, 0x15, 0xCE, 0x04, 0, 15, 15 };
+    static const uint8_t tz[] = { DOSE_OP_TZ, TZ_MIN, 0 };
+    CHECK_EQ(dose_sched_command(morning, sizeof(morning)), ESP_OK);
+    CHECK_EQ(dose_sched_command(evening, sizeof(evening)), ESP_OK);
+    CHECK_EQ(dose_sched_command(tz, sizeof(tz)), ESP_OK);
+    CHECK_EQ(dose_sched_command(tz, 2), ESP_ERR_INVALID_SIZE);
+    static const uint8_t bad_minute[] = { DOSE_OP_SET, 2, 0, 1, 0xA0, 0x05, 0, 1, 1 };   // 24:00
+    CHECK_EQ(dose_sched_command(bad_minute, sizeof(bad_minute)), ESP_ERR_INVALID_ARG);
+    static const uint8_t bad_comp[] = { DOSE_OP_SET, 2, 4, 1, 0, 0, 0, 1, 1 };
+    CHECK_EQ(dose_sched_command(bad_comp, sizeof(bad_comp)), ESP_ERR_INVALID_ARG);
+    uint8_t sync_op = 0x01;
+    CHECK_EQ(dose_sched_command(&sync_op, 1), ESP_ERR_NOT_SUPPORTED);
+}
+
+static uint64_t morning(int day)
+{
+    return MON + day * DAY + 8 * HOUR - TZ_MIN * MIN;
+}
+
+static uint64_t evening(int day)
+{
+    return MON + day * DAY + 20 * HOUR + 30 * MIN - TZ_MIN * MIN;
+}
+
+static void test_two_weeks(void)
+{
+    nvs_len = 0;
+    nacts = 0;
+    CHECK_EQ(dose_sched_init(&STORE), ESP_OK);
+    configure();
+    now = MON;
+    dose_action_t a[DOSE_SLOTS];
+    CHECK_EQ(dose_sched_start(now, a, DOSE_SLOTS), 0);
+
+    // day 0: taken 10 min after the reminder
+    CHECK_EQ(take(1, morning(0) + 10 * MIN), RECORD_TYPE_ON_TIME);
+    CHECK_EQ(count(0, DOSE_ACT_REMIND, morning(0), morning(0)), 1);
+    // day 1: taken early, so no reminder at all
+    CHECK_EQ(take(1, morning(1) - 20 * MIN), RECORD_TYPE_ON_TIME);
+    // day 2: taken after the late reminder
+    CHECK_EQ(take(1, morning(2) + 45 * MIN), RECORD_TYPE_LATE);
+    CHECK_EQ(count(0, DOSE_ACT_LATE, morning(2), morning(2) + 30 * MIN), 1);
+    // day 3: forgotten; day 4: a pill from the compartment long before the window
+    CHECK_EQ(take(1, morning(4) - 3 * HOUR), RECORD_TYPE_TAKEN);
+    // other compartments do not close the window
+    CHECK_EQ(take(2, morning(4) + 5 * MIN), RECORD_TYPE_TAKEN);
+    advance_to(morning(5) - HOUR);
+    for (int d = 3; d <= 4; ++d) {
+        CHECK_EQ(count(0, DOSE_ACT_REMIND, morning(d), morning(d)), 1);
+        CHECK_EQ(count(0, DOSE_ACT_LATE, morning(d), morning(d) + 30 * MIN), 1);
+        CHECK_EQ(count(0, DOSE_ACT_MISSED, morning(d), morning(d) + 90 * MIN), 1);
+    }
+
+    // day 5: taken, then a reboot inside the same window: the dose stays closed
+    CHECK_EQ(take(1, morning(5) + 2 * MIN), RECORD_TYPE_ON_TIME);
+    size_t before = count_slot(0);
+    reboot(morning(5) + 5 * MIN);
+    advance_to(morning(6) - MIN);
+    CHECK_EQ(count_slot(0), before);
+    CHECK_EQ(take(1, morning(5) + 20 * MIN), RECORD_TYPE_TAKEN);
+
+    // day 6: off over the due time, back in the late part: reported as late once
+    reboot(morning(6) + 40 * MIN);
+    CHECK_EQ(count(0, DOSE_ACT_LATE, morning(6), morning(6) + 40 * MIN), 1);
+    advance_to(morning(6) + 2 * HOUR);
+    CHECK_EQ(count(0, DOSE_ACT_MISSED, morning(6), morning(6) + 90 * MIN), 1);
+
+    // the second week untouched: a reminder, late and missed per day, on time
+    advance_to(MON + 14 * DAY);
+    for (int d = 7; d < 14; ++d) {
+        CHECK_EQ(count(0, DOSE_ACT_REMIND, morning(d), morning(d)), 1);
+        CHECK_EQ(count(0, DOSE_ACT_LATE, morning(d), morning(d) + 30 * MIN), 1);
+        CHECK_EQ(count(0, DOSE_ACT_MISSED, morning(d), morning(d) + 90 * MIN), 1);
+    }
+    // day 0..14: 1 + 0 + 2 + 3 + 3 + 1 + 1 (late at power-up) + 1 (missed) + 7 * 3
+    CHECK_EQ(count_slot(0), 33);
+
+    // slot 1 only on Mondays, Wednesdays and Fridays, never taken
+    size_t evenings = 0;
+    for (int d = 0; d < 14; ++d) {
+        int wd = d % 7;
+        size_t want = wd == 0 || wd == 2 || wd == 4;
+        CHECK_EQ(count(1, DOSE_ACT_REMIND, evening(d), evening(d)), want);
+        CHECK_EQ(count(1, DOSE_ACT_MISSED, evening(d), evening(d) + 30 * MIN), want);
+        evenings += want;
+    }
+    CHECK_EQ(count_slot(1), evenings * 3);
+    uint64_t at;
+    CHECK(dose_sched_next(&at));
+    CHECK_EQ(at, morning(14));
+    printf("14 days: %zu actions, %zu evening doses\n", nacts, evenings);
+}
+
+// the closed occurrence comes from the saved table, not from RAM
+static void test_closed_persists(void)
+{
+    nvs_len = 0;
+    nacts = 0;
+    CHECK_EQ(dose_sched_init(&STORE), ESP_OK);
+    configure();
+    dose_action_t a[DOSE_SLOTS];
+    now = morning(0) + 5 * MIN;
+    CHECK_EQ(dose_sched_start(now, a, DOSE_SLOTS), 1);
+    CHECK_EQ(a[0].type, DOSE_ACT_REMIND);
+    CHECK_EQ(dose_sched_taken(1, now), RECORD_TYPE_ON_TIME);
+
+    // power cycle: a fresh engine, a table read back from flash
+    CHECK_EQ(dose_sched_init(&STORE), ESP_OK);
+    CHECK_EQ(dose_sched_start(now + MIN, a, DOSE_SLOTS), 0);
+    uint64_t at;
+    CHECK(dose_sched_next(&at));
+    CHECK_EQ(at, evening(0));
+}
+
+// a table edit waits for the next start: the slot in the heap keeps its window
+static void test_edit_staged(void)
+{
+    nvs_len = 0;
+    nacts = 0;
+    CHECK_EQ(dose_sched_init(&STORE), ESP_OK);
+    configure();
+    dose_action_t a[DOSE_SLOTS];
+    now = morning(0) + 5 * MIN;
+    CHECK_EQ(dose_sched_start(now, a, DOSE_SLOTS), 1);
+    uint64_t at;
+    CHECK(dose_sched_next(&at));
+    CHECK_EQ(at, morning(0) + 30 * MIN);
+
+    // the phone moves slot 0 to 12:00 with a 5 + 5 min window while 08:00 is open
+    static const uint8_t noon[] = { DOSE_OP_SET, 0, 1, 0x7F, 0xD0, 0x02, 0, 5, 5 };
+    CHECK_EQ(dose_sched_command(noon, sizeof(noon)), ESP_OK);
+    CHECK(dose_sched_next(&at));
+    CHECK_EQ(at, morning(0) + 30 * MIN);
+    CHECK_EQ(dose_sched_taken(1, now + MIN), RECORD_TYPE_ON_TIME);
+
+    // the rebuild after the command picks it up
+    CHECK_EQ(dose_sched_start(now + 2 * MIN, a, DOSE_SLOTS), 0);
+    CHECK(dose_sched_next(&at));
+    CHECK_EQ(at, morning(0) + 4 * HOUR);
+}
+
+int main(void)
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+    test_two_weeks();
+    test_closed_persists();
+    test_edit_staged();
+    return TEST_RESULT();
+}
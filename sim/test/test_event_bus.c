@@ -0,0 +1,167 @@
+#include "test.h"
+#include "sim.h"
+#include "event_bus.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// The application bus with producers above and below the dispatcher's priority:
+// events come out in the order they were posted, each to the subscribers of its
+// type in table order; a full queue drops at the tail and counts it, and the
+// waiting post loses nothing.
+
+#define LOG_MAX 256
+
+typedef struct {
+    uint8_t sub;
+    uint8_t type;
+    uint16_t n;   // producer's running number
+} delivery_t;
+
+static delivery_t deliveries[LOG_MAX];
+static size_t ndeliveries;
+static esp_err_t nested_err = ESP_OK;
+
+static void log_delivery(uint8_t sub, const app_event_t *ev)
+{
+    if (ndeliveries < LOG_MAX) {
+        deliveries[ndeliveries++] = (delivery_t){ sub, ev->type, ev->type == APP_EV_PILL ? ev->pill.count : ev->button.index };
+    }
+}
+
+static void sub_a(const app_event_t *ev)
+{
+    log_delivery(0, ev);
+}
+
+static void sub_b(const app_event_t *ev)
+{
+    log_delivery(1, ev);
+}
+
+// a subscriber may post, but not wait on its own queue
+static void sub_c(const app_event_t *ev)
+{
+    app_event_t again = *ev;
+    nested_err = event_bus_post_wait(&again, 10);
+}
+
+static const event_sub_t SUBS[] = {
+    { APP_EV_BIT(APP_EV_BUTTON) | APP_EV_BIT(APP_EV_PILL), sub_a },
+    { APP_EV_BIT(APP_EV_BUTTON), sub_b },
+    { APP_EV_BIT(APP_EV_TIME_SYNC), sub_c },
+};
+
+static app_event_t button(uint16_t n)
+{
+    return (app_event_t){ .type = APP_EV_BUTTON, .button = { .index = n } };
+}
+
+typedef struct {
+    uint16_t count;
+    uint32_t wait_ms;   // 0: event_bus_post
+    uint16_t accepted;
+    uint16_t refused;
+    TaskHandle_t notify;
+} burst_t;
+
+// posts `count` button events without yielding, from above the dispatcher's priority
+static void producer(void *arg)
+{
+    burst_t *b = arg;
+    for (uint16_t n = 0; n < b->count; ++n) {
+        app_event_t ev = button(n);
+        esp_err_t err = b->wait_ms ? event_bus_post_wait(&ev, b->wait_ms) : event_bus_post(&ev);
+        if (err == ESP_OK) b->accepted++;
+        else b->refused++;
+    }
+    xTaskNotifyGive(b->notify);
+    vTaskDelete(NULL);
+}
+
+static void run_burst(burst_t *b)
+{
+    ndeliveries = 0;
+    b->notify = xTaskGetCurrentTaskHandle();
+    xTaskCreate(producer, "producer", 4096, b, EVENT_BUS_PRIO + 2, NULL);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    vTaskDelay(pdMS_TO_TICKS(10));   // let the dispatcher drain
+}
+
+// button n went to A then B, in posting order
+static void check_order(size_t events)
+{
+    CHECK_EQ(ndeliveries, 2 * events);
+    for (size_t i = 0; i < ndeliveries && i < 2 * events; ++i) {
+        CHECK_EQ(deliveries[i].sub, i & 1);
+        CHECK_EQ(deliveries[i].n, i / 2);
+    }
+}
+
+static void test_main(void)
+{
+    app_event_t ev = button(0);
+    CHECK_EQ(event_bus_post(&ev), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(event_bus_init(SUBS, sizeof(SUBS) / sizeof(SUBS[0])), ESP_OK);
+    CHECK_EQ(event_bus_init(SUBS, 1), ESP_ERR_INVALID_STATE);
+    ev.type = APP_EV_COUNT;
+    CHECK_EQ(event_bus_post(&ev), ESP_ERR_INVALID_ARG);
+
+    // below the dispatcher each post is delivered before the next one
+    ndeliveries = 0;
+    for (uint16_t n = 0; n < 40; ++n) {
+        ev = button(n);
+        CHECK_EQ(event_bus_post(&ev), ESP_OK);
+    }
+    check_order(40);
+    event_bus_stats_t st;
+    event_bus_stats(&st);
+    CHECK_EQ(st.dropped, 0);
+    CHECK(st.depth_max <= 1);
+
+    // a burst fills the queue: the tail is dropped, the head arrives in order
+    burst_t drop = { .count = EVENT_BUS_DEPTH + 5 };
+    run_burst(&drop);
+    CHECK_EQ(drop.accepted, EVENT_BUS_DEPTH);
+    CHECK_EQ(drop.refused, 5);
+    check_order(EVENT_BUS_DEPTH);
+    event_bus_stats(&st);
+    CHECK_EQ(st.dropped, 5);
+    CHECK_EQ(st.depth_max, EVENT_BUS_DEPTH);
+
+    // the waiting post blocks until the dispatcher makes room
+    burst_t wait = { .count = 3 * EVENT_BUS_DEPTH, .wait_ms = 100 };
+    run_burst(&wait);
+    CHECK_EQ(wait.accepted, 3 * EVENT_BUS_DEPTH);
+    CHECK_EQ(wait.refused, 0);
+    check_order(3 * EVENT_BUS_DEPTH);
+
+    // other types reach only their subscribers; a pill event only A
+    ndeliveries = 0;
+    ev = (app_event_t){ .type = APP_EV_PILL, .pill = { .count = 7 } };
+    CHECK_EQ(event_bus_post(&ev), ESP_OK);
+    ev = (app_event_t){ .type = APP_EV_BLE_CONN };
+    CHECK_EQ(event_bus_post(&ev), ESP_OK);
+    CHECK_EQ(ndeliveries, 1);
+    CHECK_EQ(deliveries[0].sub, 0);
+    CHECK_EQ(deliveries[0].n, 7);
+
+    // a subscriber that waits on its own queue is refused instead of deadlocking
+    ev = (app_event_t){ .type = APP_EV_TIME_SYNC };
+    CHECK_EQ(event_bus_post(&ev), ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    CHECK_EQ(nested_err, ESP_ERR_INVALID_STATE);
+
+    event_bus_stats(&st);
+    CHECK_EQ(st.posted, st.delivered + st.dropped);
+    CHECK_EQ(st.dropped, 5);
+    printf("%u posted, %u delivered, %u dropped, depth max %u, latency max %u us\n", (unsigned)st.posted,
+           (unsigned)st.delivered, (unsigned)st.dropped, st.depth_max, (unsigned)st.latency_max_us);
+}
+
+int main(void)
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+    sim_run(test_main, SIM_S(10));
+    return TEST_RESULT();
+}
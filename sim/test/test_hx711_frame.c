@@ -0,0 +1,187 @@
+#include "test.h"
+#include "sim.h"
+#include "hx711.h"
+#include "hx711_backend.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <string.h>
+
+// The frame reader through the GPIO backend against a fake HX711 per channel on
+// the sim pads: each fake converts its own input, holds DOUT low when the word is
+// ready and shifts it out MSB first on SCK, and takes the pulse count of a read
+// as the gain of the next conversion. Every frame puts a different word on every
+// channel, so a swapped pin or bit plane shows up, and the rails and the chip's
+// saturation beyond them must come out sign-extended. With --bank1 one DOUT sits
+// on GPIO 34, which turns off the lock-step register path and reads channel by
+// channel.
+
+#define CHANNELS 4
+#define CONV_US 1000   // next conversion ready this long after a read (fast enough for the test)
+#define BURST_GAP_US 10   // SCK low this long ends a read
+
+static const gpio_num_t SCK[CHANNELS] = { GPIO_NUM_4, GPIO_NUM_23, GPIO_NUM_22, GPIO_NUM_25 };
+static gpio_num_t DT[CHANNELS] = { GPIO_NUM_5, GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_21 };
+
+typedef struct {
+    int dt;
+    int32_t input;        // at gain 128, channel A
+    bool stuck;           // never finishes a conversion (DOUT stays high)
+    uint64_t ready_at;
+    int gain;             // pulses of the last read: 25 A/128, 27 A/64
+    int pulses;           // SCK pulses of the read in progress
+    uint64_t last_edge;
+    uint32_t word;
+    uint32_t conversions; // words clocked out
+} fake_t;
+
+static fake_t fake[CHANNELS];
+
+// the chip saturates outside its 24-bit range
+static uint32_t convert(const fake_t *f)
+{
+    int64_t v = f->gain == HX711_GAIN_A_64 ? f->input / 2 : f->input;
+    if (v > 0x7FFFFF) v = 0x7FFFFF;
+    if (v < -0x800000) v = -0x800000;
+    return (uint32_t)v & 0xFFFFFF;
+}
+
+// a finished burst: the pulse count picks the gain and a new conversion starts
+static void settle(fake_t *f)
+{
+    if (f->pulses < HX711_DATA_BITS + 1 || sim_now_us() - f->last_edge < BURST_GAP_US) return;
+    f->gain = f->pulses;
+    f->pulses = 0;
+    f->conversions++;
+    f->ready_at = f->last_edge + CONV_US;
+}
+
+static bool ready(const fake_t *f)
+{
+    return !f->stuck && sim_now_us() >= f->ready_at;
+}
+
+static int fake_level(void *ctx)
+{
+    fake_t *f = ctx;
+    settle(f);
+    if (f->pulses == 0) return ready(f) ? 0 : 1;
+    if (f->pulses <= HX711_DATA_BITS) return (f->word >> (HX711_DATA_BITS - f->pulses)) & 1;
+    return 1;
+}
+
+static void fake_sck(void *ctx, int pin, int level)
+{
+    fake_t *f = ctx;
+    if (!level) return;
+    settle(f);
+    if (f->pulses == 0) {
+        if (!ready(f)) return;
+        f->word = convert(f);   // sampled when the read starts
+    }
+    f->pulses++;
+    f->last_edge = sim_now_us();
+}
+
+// input at gain 128 and the word the chip puts out for it
+static const struct {
+    int32_t in;
+    int32_t out;
+} CASES[] = {
+    { 0, 0 },
+    { 1, 1 },
+    { -1, -1 },
+    { 0x7FFFFF, 0x7FFFFF },
+    { -0x800000, -0x800000 },
+    { 0x800000, 0x7FFFFF },      // saturates at the positive rail
+    { -0x800001, -0x800000 },    // and at the negative one
+    { 0x123456, 0x123456 },
+    { -0x123456, -0x123456 },
+    { 0x5A5A5A, 0x5A5A5A },
+    { -0x5A5A5B, -0x5A5A5B },    // 0xA5A5A5
+    { 0x0F0F0F, 0x0F0F0F },
+    { 0x400000, 0x400000 },
+    { -0x400000, -0x400000 },
+};
+#define NCASES (sizeof(CASES) / sizeof(CASES[0]))
+
+// conversions counted once the last burst on every channel has ended
+static void settle_all(void)
+{
+    vTaskDelay(1);
+    for (size_t i = 0; i < CHANNELS; ++i) settle(&fake[i]);
+}
+
+static void set_inputs(int32_t v)
+{
+    for (size_t i = 0; i < CHANNELS; ++i) fake[i].input = v;
+}
+
+static void test_main(void)
+{
+    for (size_t i = 0; i < CHANNELS; ++i) {
+        fake[i] = (fake_t){ .dt = DT[i], .gain = HX711_GAIN_A_128 };
+        sim_pad_driver_t drv = { .ctx = &fake[i], .level = fake_level };
+        sim_gpio_attach(DT[i], &drv);
+        sim_gpio_watch(SCK[i], fake_sck, &fake[i]);
+    }
+    CHECK_EQ(hx711_init_with_backend(DT, SCK, CHANNELS, &hx711_backend_gpio), ESP_OK);
+    CHECK_EQ(hx711_count(), CHANNELS);
+
+    // every case on every channel, the channels out of phase with each other
+    for (size_t k = 0; k < NCASES; ++k) {
+        int32_t frame[CHANNELS];
+        for (size_t i = 0; i < CHANNELS; ++i) fake[i].input = CASES[(k + i) % NCASES].in;
+        CHECK_EQ(hx711_read_frame(frame), ESP_OK);
+        for (size_t i = 0; i < CHANNELS; ++i) {
+            int32_t want = CASES[(k + i) % NCASES].out;
+            CHECK_EQ(frame[i], want);
+            CHECK_EQ(hx711_read_raw(i), want);
+        }
+    }
+
+    // one frame clocks every channel once, the single reads one channel each
+    uint32_t before[CHANNELS];
+    int32_t frame[CHANNELS];
+    settle_all();
+    for (size_t i = 0; i < CHANNELS; ++i) before[i] = fake[i].conversions;
+    CHECK_EQ(hx711_read_frame(frame), ESP_OK);
+    hx711_read_raw(2);
+    settle_all();
+    CHECK_EQ(fake[0].conversions - before[0], 1);
+    CHECK_EQ(fake[1].conversions - before[1], 1);
+    CHECK_EQ(fake[2].conversions - before[2], 2);
+    CHECK_EQ(fake[3].conversions - before[3], 1);
+
+    // the gain picked by the extra pulses applies from the following conversion
+    set_inputs(-0x200000);
+    CHECK_EQ(hx711_set_gain(HX711_GAIN_A_64), ESP_OK);
+    CHECK_EQ(hx711_read_frame(frame), ESP_OK);
+    CHECK_EQ(frame[0], -0x200000);
+    CHECK_EQ(hx711_read_frame(frame), ESP_OK);
+    for (size_t i = 0; i < CHANNELS; ++i) CHECK_EQ(frame[i], -0x100000);
+    CHECK_EQ(hx711_read_raw(3), -0x100000);
+    CHECK_EQ(hx711_set_gain(HX711_GAIN_A_128), ESP_OK);
+    hx711_read_frame(frame);
+
+    // a channel that is not ready is skipped, not decoded from all ones
+    fake[1].stuck = true;
+    CHECK_EQ(hx711_read_frame(frame), ESP_ERR_TIMEOUT);
+    CHECK_EQ(frame[0], -0x200000);
+    CHECK_EQ(frame[1], HX711_RAW_INVALID);
+    CHECK_EQ(frame[2], -0x200000);
+    CHECK_EQ(hx711_read_raw(1), HX711_RAW_INVALID);
+    CHECK_EQ(hx711_read_raw(0), -0x200000);
+    fake[1].stuck = false;
+    CHECK_EQ(hx711_read_frame(frame), ESP_OK);
+    CHECK_EQ(frame[1], -0x200000);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && !strcmp(argv[1], "--bank1")) DT[3] = GPIO_NUM_34;
+    esp_log_level_set("*", ESP_LOG_WARN);
+    sim_run(test_main, SIM_NEVER);
+    return TEST_RESULT();
+}
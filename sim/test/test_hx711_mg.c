@@ -0,0 +1,116 @@
+#include "test.h"
+#include "sim.h"
+#include "hx711.h"
+#include "hx711_backend.h"
+#include "esp_log.h"
+#include <math.h>
+
+// The fixed-point milligram API against the float API, which divides by the
+// calibration factor in float on its own: the two must agree to within one
+// count (or 1 mg when a count is smaller) over the whole 24-bit range, for
+// small and large factors and tared channels. Results beyond int32 must
+// saturate at HX711_MG_MIN/MAX, never wrap or read as HX711_MG_INVALID.
+
+#define CHANNELS 4
+
+static const gpio_num_t DT[CHANNELS] = { GPIO_NUM_5, GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_21 };
+static const gpio_num_t SCK[CHANNELS] = { GPIO_NUM_4, GPIO_NUM_23, GPIO_NUM_22, GPIO_NUM_25 };
+static const int32_t ZERO[CHANNELS] = { 84000, -5000, 0, 0x7FF000 };
+static const float FACTORS[] = { 420.0f, -420.0f, 1.0f, 7.3f, 97.25f, 1000.0f, 2500.0f, 16000.0f };
+#define NFACTORS (sizeof(FACTORS) / sizeof(FACTORS[0]))
+
+static uint32_t lcg = 12345;
+
+static int32_t next_raw(void)
+{
+    lcg = lcg * 1664525u + 1013904223u;
+    return (int32_t)(lcg >> 8) - 0x800000;   // 24-bit two's complement range
+}
+
+static unsigned compared, saturated;
+static double worst;   // largest difference, as a fraction of the tolerance
+
+static void check_raw(size_t ch, float factor, int32_t raw)
+{
+    double exact_mg = ((double)raw - ZERO[ch]) * 1000.0 / factor;
+    int32_t mg = hx711_raw_to_mg(ch, raw);
+    if (exact_mg > HX711_MG_MAX + 0.5 || exact_mg < HX711_MG_MIN - 0.5) {
+        CHECK_EQ(mg, exact_mg > 0 ? HX711_MG_MAX : HX711_MG_MIN);
+        saturated++;
+        return;
+    }
+    double float_mg = (double)hx711_raw_to_weight(ch, raw) * 1000.0;
+    double count_mg = 1000.0 / fabs(factor);
+    double tol = count_mg > 1.0 ? count_mg : 1.0;
+    double diff = fabs((double)mg - float_mg);
+    if (diff > tol) {
+        fprintf(stderr, "ch %zu factor %g raw %d: %d mg vs %.3f mg\n", ch, factor, (int)raw, (int)mg, float_mg);
+    }
+    CHECK(diff <= tol);
+    // and the integer path itself rounds to the nearest mg
+    CHECK(fabs((double)mg - exact_mg) <= 0.5 + 1e-3);
+    if (diff / tol > worst) worst = diff / tol;
+    compared++;
+}
+
+static void test_main(void)
+{
+    CHECK_EQ(hx711_init_with_backend(DT, SCK, CHANNELS, &hx711_backend_sim), ESP_OK);
+    for (size_t i = 0; i < CHANNELS; ++i) hx711_sim_set_raw(i, ZERO[i]);
+    CHECK_EQ(hx711_tare_all(3), ESP_OK);
+
+    for (size_t k = 0; k < NFACTORS; ++k) {
+        for (size_t ch = 0; ch < CHANNELS; ++ch) {
+            CHECK_EQ(hx711_set_calibration(ch, FACTORS[k]), ESP_OK);
+            // the rails, around zero, and a spread of the range
+            static const int32_t EDGES[] = { -0x800000, -0x7FFFFF, -1, 0, 1, 0x7FFFFE, 0x7FFFFF };
+            for (size_t e = 0; e < sizeof(EDGES) / sizeof(EDGES[0]); ++e) check_raw(ch, FACTORS[k], EDGES[e]);
+            for (int n = -50; n <= 50; ++n) check_raw(ch, FACTORS[k], ZERO[ch] + n);
+            for (int n = 0; n < 2000; ++n) check_raw(ch, FACTORS[k], next_raw());
+        }
+
+        // the frame call converts exactly like the per-channel one
+        int32_t raw[CHANNELS], mg[CHANNELS];
+        for (size_t ch = 0; ch < CHANNELS; ++ch) raw[ch] = next_raw();
+        raw[2] = HX711_RAW_INVALID;
+        CHECK_EQ(hx711_frame_to_mg(raw, mg, CHANNELS), ESP_OK);
+        for (size_t ch = 0; ch < CHANNELS; ++ch) CHECK_EQ(mg[ch], hx711_raw_to_mg(ch, raw[ch]));
+        CHECK_EQ(mg[2], HX711_MG_INVALID);
+    }
+
+    // invalid samples and factors
+    CHECK_EQ(hx711_raw_to_mg(0, HX711_RAW_INVALID), HX711_MG_INVALID);
+    CHECK(hx711_raw_to_weight(0, HX711_RAW_INVALID) == 0.0f);
+    CHECK_EQ(hx711_set_calibration(0, 0.0f), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(hx711_set_calibration(0, 0.01f), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(hx711_set_calibration(CHANNELS, 420.0f), ESP_ERR_INVALID_ARG);
+
+    // the int32 boundary at 1 count/g on the untared channel: 2147483 g fits, one more count does not
+    CHECK_EQ(hx711_set_calibration(2, 1.0f), ESP_OK);
+    CHECK_EQ(hx711_raw_to_mg(2, 2147483), 2147483000);
+    CHECK_EQ(hx711_raw_to_mg(2, 2147484), HX711_MG_MAX);
+    CHECK_EQ(hx711_raw_to_mg(2, -2147483), -2147483000);
+    CHECK_EQ(hx711_raw_to_mg(2, -2147484), HX711_MG_MIN);
+    // and at the smallest accepted factor every count is ~32 kg, the rails far beyond
+    CHECK_EQ(hx711_set_calibration(2, 0.031f), ESP_OK);
+    CHECK_EQ(hx711_raw_to_mg(2, 0x7FFFFF), HX711_MG_MAX);
+    CHECK_EQ(hx711_raw_to_mg(2, -0x800000), HX711_MG_MIN);
+    check_raw(2, 0.031f, 66571);   // the last count below the top
+    check_raw(2, 0.031f, 66572);
+    int32_t raw[CHANNELS] = { 0, 0, -0x800000, 0 }, mg[CHANNELS];
+    CHECK_EQ(hx711_frame_to_mg(raw, mg, CHANNELS), ESP_OK);
+    CHECK_EQ(mg[2], HX711_MG_MIN);
+
+    printf("%u conversions compared, worst at %.0f%% of the tolerance, %u saturated\n", compared, 100.0 * worst,
+           saturated);
+    // small factors leave part of the range beyond int32 mg
+    CHECK(compared > NFACTORS * CHANNELS * 1500);
+    CHECK(saturated > 0);
+}
+
+int main(void)
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+    sim_run(test_main, SIM_NEVER);
+    return TEST_RESULT();
+}
@@ -0,0 +1,149 @@
+#include "test.h"
+#include "sim.h"
+#include "hx711.h"
+#include "hx711_backend.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Data-ready interrupts through the GPIO backend. A fake HX711 on the sim pads
+// holds DOUT high until the test injects a ready edge, then shifts out its word
+// on SCK. The reader must sleep until the edge instead of polling, take the
+// sample right after it, and still see an edge that came before it armed the
+// interrupt.
+
+#define CHANNELS 3
+
+static const gpio_num_t DT[CHANNELS] = { GPIO_NUM_5, GPIO_NUM_18, GPIO_NUM_19 };
+static const gpio_num_t SCK[CHANNELS] = { GPIO_NUM_4, GPIO_NUM_23, GPIO_NUM_22 };
+
+typedef struct {
+    int dt;
+    uint64_t ready_at;   // conversion done, DOUT low until clocked
+    int pulses;          // SCK pulses of the read in progress, 0 when idle
+    uint32_t word;       // 24-bit conversion
+} fake_t;
+
+static fake_t fake[CHANNELS];
+static volatile uint32_t idle_runs;
+
+static int fake_level(void *ctx)
+{
+    const fake_t *f = ctx;
+    if (f->pulses == 0) return sim_now_us() >= f->ready_at ? 0 : 1;
+    if (f->pulses <= HX711_DATA_BITS) return (f->word >> (HX711_DATA_BITS - f->pulses)) & 1;
+    return 1;   // the 25th pulse ends the conversion
+}
+
+static void fake_sck(void *ctx, int pin, int level)
+{
+    fake_t *f = ctx;
+    if (!level) return;
+    if (f->pulses == 0 && sim_now_us() < f->ready_at) return;
+    f->pulses++;
+    f->ready_at = SIM_NEVER;
+}
+
+// the falling DOUT edge, for the interrupt
+static void edge_cb(void *arg)
+{
+    fake_t *f = arg;
+    sim_gpio_changed(f->dt);
+}
+
+// conversion `raw` of channel idx completes `delay_us` from now
+static void inject(size_t idx, uint64_t delay_us, int32_t raw)
+{
+    fake[idx].ready_at = sim_now_us() + delay_us;
+    fake[idx].pulses = 0;
+    fake[idx].word = (uint32_t)raw & 0xFFFFFF;
+    sim_gpio_changed(fake[idx].dt);
+    sim_at(fake[idx].ready_at, edge_cb, &fake[idx]);
+}
+
+// runs only while the reader is blocked
+static void idle_task(void *arg)
+{
+    for (;;) {
+        idle_runs++;
+        vTaskDelay(1);
+    }
+}
+
+static int64_t timed_read(size_t idx, int32_t *raw)
+{
+    int64_t t0 = esp_timer_get_time();
+    *raw = hx711_read_raw(idx);
+    return esp_timer_get_time() - t0;
+}
+
+static void test_main(void)
+{
+    for (size_t i = 0; i < CHANNELS; ++i) {
+        fake[i].dt = DT[i];
+        fake[i].ready_at = SIM_NEVER;
+        sim_pad_driver_t drv = { .ctx = &fake[i], .level = fake_level };
+        sim_gpio_attach(DT[i], &drv);
+        sim_gpio_watch(SCK[i], fake_sck, &fake[i]);
+    }
+    CHECK_EQ(hx711_init_with_backend(DT, SCK, CHANNELS, &hx711_backend_gpio), ESP_OK);
+    xTaskCreate(idle_task, "idle", 2048, NULL, 0, NULL);
+
+    // polling: the reader spins (nothing else runs) and gives up after 20 ms
+    int32_t raw;
+    inject(0, 5000, -12345);
+    uint32_t idle0 = idle_runs;
+    int64_t dt = timed_read(0, &raw);
+    CHECK_EQ(raw, -12345);
+    CHECK(dt >= 5000 && dt < 6000);
+    CHECK_EQ(idle_runs, idle0);
+    inject(0, 40000, 1);
+    CHECK_EQ(hx711_read_raw(0), HX711_RAW_INVALID);
+    vTaskDelay(pdMS_TO_TICKS(50));
+
+    // interrupt mode: the reader sleeps through a full 10 SPS period
+    CHECK_EQ(hx711_set_ready_irq(true), ESP_OK);
+    inject(1, 80000, 0x7FFFFF);
+    idle0 = idle_runs;
+    dt = timed_read(1, &raw);
+    CHECK_EQ(raw, 0x7FFFFF);
+    CHECK(dt >= 80000 && dt < 80000 + 1000);   // the edge plus one SCK burst
+    CHECK(idle_runs - idle0 >= 5);
+
+    // an edge before the interrupt is armed is seen at the level check
+    inject(2, 0, -0x800000);
+    vTaskDelay(pdMS_TO_TICKS(20));
+    dt = timed_read(2, &raw);
+    CHECK_EQ(raw, -0x800000);
+    CHECK(dt < 1000);
+
+    // no edge at all: the reader wakes on its timeout
+    inject(0, SIM_S(10), 0);
+    dt = timed_read(0, &raw);
+    CHECK_EQ(raw, HX711_RAW_INVALID);
+    CHECK(dt >= 150000 && dt < 170000);
+    vTaskDelay(pdMS_TO_TICKS(10000));
+
+    // a frame waits for the last channel, one edge after the other
+    inject(0, 10000, 100);
+    inject(1, 30000, -200);
+    inject(2, 60000, 300);
+    int32_t frame[CHANNELS];
+    int64_t t0 = esp_timer_get_time();
+    CHECK_EQ(hx711_read_frame(frame), ESP_OK);
+    dt = esp_timer_get_time() - t0;
+    CHECK_EQ(frame[0], 100);
+    CHECK_EQ(frame[1], -200);
+    CHECK_EQ(frame[2], 300);
+    CHECK(dt >= 60000 && dt < 61000);
+
+    CHECK_EQ(hx711_set_ready_irq(false), ESP_OK);
+}
+
+int main(void)
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+    sim_run(test_main, SIM_S(60));
+    return TEST_RESULT();
+}
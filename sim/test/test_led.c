@@ -0,0 +1,173 @@
+#include "test.h"
+#include "sim.h"
+#include "led.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Pattern timing as seen on the pads. Every level change of the LED pins is
+// logged with its virtual time; the on/off durations must match the pattern
+// table to within one effects tick, LEDs started together must switch together
+// (one write per bank, pins on both banks), replaying a pattern keeps its phase,
+// and the tick timer must stop once nothing animates.
+
+#define NLED 4
+#define TICK_US SIM_MS(LED_FX_TICK_MS)
+#define EDGE_MAX 512
+
+static const gpio_num_t PINS[NLED] = { GPIO_NUM_32, GPIO_NUM_33, GPIO_NUM_16, GPIO_NUM_17 };
+
+typedef struct {
+    uint8_t led;
+    uint8_t level;
+    uint64_t t_us;
+} edge_t;
+
+static edge_t edges[EDGE_MAX];
+static size_t nedges;
+
+static void on_pad(void *ctx, int pin, int level)
+{
+    if (nedges < EDGE_MAX) edges[nedges++] = (edge_t){ (uint8_t)(uintptr_t)ctx, (uint8_t)level, sim_now_us() };
+}
+
+static void start(void)
+{
+    nedges = 0;
+}
+
+static void wait_ms(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+// the edges of one LED from t0 on must follow `ms` (on first) to within a tick,
+// without drift: each edge is checked against its ideal time
+static size_t check_timing(uint8_t led, uint64_t t0, const uint16_t *ms, size_t steps, int lit_level)
+{
+    size_t k = 0;
+    uint64_t ideal = t0;
+    for (size_t i = 0; i < nedges; ++i) {
+        if (edges[i].led != led || edges[i].t_us < t0) continue;
+        CHECK_EQ(edges[i].level, (k & 1) ? !lit_level : lit_level);
+        CHECK(edges[i].t_us >= ideal && edges[i].t_us < ideal + TICK_US);
+        if (edges[i].t_us < ideal || edges[i].t_us >= ideal + TICK_US) {
+            fprintf(stderr, "led %u edge %zu at %llu us, ideal %llu us\n", led, k, (unsigned long long)edges[i].t_us,
+                    (unsigned long long)ideal);
+        }
+        ideal += SIM_MS(ms[k % steps]);
+        k++;
+    }
+    return k;
+}
+
+static void test_blink(void)
+{
+    static const uint16_t BLINK[] = { 500, 500 };
+    static const uint16_t FAST[] = { 100, 100 };
+    static const uint16_t DOUBLE[] = { 100, 150, 100, 650 };
+    start();
+    uint64_t t0 = sim_now_us();
+    CHECK_EQ(led_play(0, LED_PATTERN_BLINK), ESP_OK);
+    CHECK_EQ(led_play(2, LED_PATTERN_BLINK_FAST), ESP_OK);
+    CHECK_EQ(led_play(3, LED_PATTERN_DOUBLE_BLINK), ESP_OK);
+    wait_ms(10000 - 10);
+    size_t n0 = check_timing(0, t0, BLINK, 2, 1);
+    size_t n2 = check_timing(2, t0, FAST, 2, 1);
+    size_t n3 = check_timing(3, t0, DOUBLE, 4, 1);
+    CHECK_EQ(n0, 20);
+    CHECK_EQ(n2, 100);
+    CHECK_EQ(n3, 40);
+    printf("10 s: blink %zu edges, fast %zu, double %zu\n", n0, n2, n3);
+
+    // replaying the running pattern keeps its phase
+    for (size_t i = 0; i < NLED; ++i) led_stop(i);
+    start();
+    uint64_t t1 = sim_now_us();
+    CHECK_EQ(led_play(0, LED_PATTERN_BLINK), ESP_OK);
+    wait_ms(250);
+    CHECK_EQ(led_play(0, LED_PATTERN_BLINK), ESP_OK);
+    wait_ms(2000 - 10);
+    CHECK_EQ(check_timing(0, t1, BLINK, 2, 1), 5);
+
+    // LEDs started together switch together, across both GPIO banks
+    for (size_t i = 0; i < NLED; ++i) led_stop(i);
+    start();
+    t0 = sim_now_us();
+    for (size_t i = 0; i < NLED; ++i) CHECK_EQ(led_play(i, LED_PATTERN_BLINK_FAST), ESP_OK);
+    wait_ms(1000 - 10);
+    for (uint8_t i = 0; i < NLED; ++i) CHECK_EQ(check_timing(i, t0, FAST, 2, 1), 10);
+    for (size_t i = 0; i + NLED <= nedges; i += NLED) {
+        for (size_t j = 1; j < NLED; ++j) CHECK_EQ(edges[i + j].t_us, edges[i].t_us);
+    }
+    for (size_t i = 0; i < NLED; ++i) led_stop(i);
+}
+
+static void test_breathe(void)
+{
+    // the pad reads high while the duty is >= 50 %: once per 2 s period
+    start();
+    CHECK_EQ(led_play(1, LED_PATTERN_BREATHE), ESP_OK);
+    wait_ms(10000);
+    size_t rises = 0;
+    uint64_t first = 0, last = 0;
+    for (size_t i = 0; i < nedges; ++i) {
+        if (edges[i].led != 1 || !edges[i].level) continue;
+        if (!rises++) first = edges[i].t_us;
+        last = edges[i].t_us;
+    }
+    CHECK_EQ(rises, 5);
+    CHECK(rises > 1 && last - first >= SIM_S(8) - TICK_US && last - first <= SIM_S(8) + TICK_US);
+    // back to a plain output with the steady level
+    CHECK_EQ(led_set(1, 1), ESP_OK);
+    CHECK_EQ(sim_gpio_output(PINS[1]), 1);
+    CHECK_EQ(led_stop(1), ESP_OK);
+    CHECK_EQ(sim_gpio_output(PINS[1]), 0);
+}
+
+static void test_idle(void)
+{
+    // steady levels do not need the tick, and nothing else is playing
+    CHECK_EQ(led_set(0, 1), ESP_OK);
+    CHECK_EQ(led_set(2, 1), ESP_OK);
+    sim_stats_t a, b;
+    sim_get_stats(&a);
+    start();
+    wait_ms(5000);
+    sim_get_stats(&b);
+    CHECK_EQ(b.timer_callbacks, a.timer_callbacks);
+    CHECK_EQ(nedges, 0);
+    CHECK_EQ(sim_gpio_output(PINS[0]), 1);
+
+    // active-low wiring inverts the pad, not the pattern
+    led_set_active_low(true);
+    CHECK_EQ(sim_gpio_output(PINS[0]), 0);
+    CHECK_EQ(sim_gpio_output(PINS[3]), 1);
+    static const uint16_t FAST[] = { 100, 100 };
+    start();
+    uint64_t t0 = sim_now_us();
+    CHECK_EQ(led_play(3, LED_PATTERN_BLINK_FAST), ESP_OK);
+    wait_ms(1000 - 10);
+    CHECK_EQ(check_timing(3, t0, FAST, 2, 0), 10);
+    led_set_active_low(false);
+    for (size_t i = 0; i < NLED; ++i) led_stop(i);
+}
+
+static void test_main(void)
+{
+    CHECK_EQ(led_init(PINS, NLED), ESP_OK);
+    for (size_t i = 0; i < NLED; ++i) sim_gpio_watch(PINS[i], on_pad, (void *)(uintptr_t)i);
+    CHECK_EQ(led_play(NLED, LED_PATTERN_BLINK), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(led_play(0, LED_PATTERN_COUNT), ESP_ERR_INVALID_ARG);
+
+    test_blink();
+    test_breathe();
+    test_idle();
+}
+
+int main(void)
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+    sim_run(test_main, SIM_S(120));
+    return TEST_RESULT();
+}
@@ -0,0 +1,107 @@
+#include "test.h"
+#include "metrics.h"
+#include <stdbool.h>
+#include <string.h>
+
+// The 0xA006 value against a stand-in for the GATT layer: a long read is a Read
+// Request then Read Blob requests at growing offsets, each answered with MTU-1
+// bytes of the whole value, and the metrics move between the requests. A
+// snapshot encoded again for each request tears; the pinned one must come out
+// whole after an abandoned read and an MTU change, and move on only after a
+// refresh write.
+
+#define MTU_MIN 23
+#define MTU_BIG 247
+
+static metrics_snap_t snap;
+
+typedef const uint8_t *(*read_fn_t)(size_t *len);
+
+static const uint8_t *pinned_read(size_t *len)
+{
+    return metrics_snap_read(&snap, len);
+}
+
+// what the access callback did without a pinned value
+static const uint8_t *fresh_read(size_t *len)
+{
+    static uint8_t buf[METRICS_ENCODED_MAX];
+    *len = metrics_encode(buf, sizeof(buf));
+    return buf;
+}
+
+static void move_on(void)
+{
+    metrics_inc(METRIC_HX711_FRAMES);
+    metrics_observe(METRIC_SENSOR_PERIOD_MS, 100);
+}
+
+// the client side of one long read, giving up after `max_requests` (0: never)
+static size_t gatt_long_read(read_fn_t read, uint16_t mtu, int max_requests, uint8_t *out)
+{
+    size_t off = 0;
+    for (int requests = 1;; ++requests) {
+        size_t len;
+        const uint8_t *val = read(&len);
+        size_t chunk = off < len ? len - off : 0;
+        if (chunk > (size_t)mtu - 1) chunk = mtu - 1;
+        memcpy(out + off, val + off, chunk);
+        off += chunk;
+        if (chunk < (size_t)mtu - 1 || requests == max_requests) return off;
+        move_on();
+    }
+}
+
+static uint32_t frames_of(const uint8_t *v)
+{
+    // [version][count][uptime u32], then metric 0 as [id][kind][u32]
+    return (uint32_t)v[8] | (uint32_t)v[9] << 8 | (uint32_t)v[10] << 16 | (uint32_t)v[11] << 24;
+}
+
+static void test_fresh_tears(void)
+{
+    uint8_t whole[METRICS_ENCODED_MAX], got[METRICS_ENCODED_MAX];
+    size_t len;
+    const uint8_t *v = fresh_read(&len);
+    memcpy(whole, v, len);
+    CHECK(len > MTU_MIN - 1);
+    CHECK_EQ(gatt_long_read(fresh_read, MTU_MIN, 0, got), len);
+    // the header chunk is the first encode, the histogram chunks later ones
+    CHECK_EQ(frames_of(got), frames_of(whole));
+    CHECK(memcmp(got, whole, len) != 0);
+}
+
+static void test_pinned(void)
+{
+    uint8_t first[METRICS_ENCODED_MAX], got[METRICS_ENCODED_MAX];
+    size_t len;
+    metrics_snap_refresh(&snap);
+    const uint8_t *v = pinned_read(&len);
+    memcpy(first, v, len);
+    uint32_t frames = frames_of(first);
+
+    // abandoned after the first chunk, then read again at a larger MTU
+    CHECK_EQ(gatt_long_read(pinned_read, MTU_MIN, 1, got), MTU_MIN - 1);
+    move_on();
+    CHECK_EQ(gatt_long_read(pinned_read, MTU_BIG, 0, got), len);
+    CHECK(memcmp(got, first, len) == 0);
+    // and once more at the small MTU, many requests with the metrics moving in between
+    CHECK_EQ(gatt_long_read(pinned_read, MTU_MIN, 0, got), len);
+    CHECK(memcmp(got, first, len) == 0);
+
+    // a write asks for a new value
+    metrics_snap_refresh(&snap);
+    CHECK_EQ(gatt_long_read(pinned_read, MTU_MIN, 0, got), len);
+    CHECK(frames_of(got) > frames);
+    uint8_t again[METRICS_ENCODED_MAX];
+    CHECK_EQ(gatt_long_read(pinned_read, MTU_BIG, 0, again), len);
+    CHECK(memcmp(again, got, len) == 0);
+}
+
+int main(void)
+{
+    CHECK_EQ(METRIC_HX711_FRAMES, 0);
+    test_fresh_tears();
+    test_pinned();
+    return TEST_RESULT();
+}
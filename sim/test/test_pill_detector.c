@@ -0,0 +1,178 @@
+#include "test.h"
+#include "pill_detector.h"
+#include "weight_filter.h"
+#include <math.h>
+
+// Replay of weight traces through sensor_task's filter chain and detector at
+// 10 SPS. Each trace is a scripted compartment history with Gaussian noise: a
+// hand in the box, pills taken or put back, a pressed lid, creep, single bad
+// samples. Reports removal latency from the moment the weight is back at rest,
+// and fails on a false or missed event. Run with other seeds by changing `rng`:
+// the traces must pass for any of them.
+
+#define SAMPLE_MS 100
+#define NOISE_MG 150
+#define TREMOR_MG 800
+#define PILL_MG 2500
+#define MAX_LATENCY_MS 1500   // median and average delay plus five settled samples
+#define MAX_ADD_LATENCY_MS 5000   // a heavier level holds four times as long, and noise restarts its window more often
+
+// main.c's configuration
+static const weight_filter_cfg_t FILTER_CFG = {
+    .median_len = 5,
+    .smooth = WEIGHT_FILTER_SMOOTH_AVG,
+    .avg_len = 4,
+    .decimate = 1,
+};
+static const pill_detector_cfg_t DETECTOR_CFG = {
+    .disturb_mg = 1000,
+    .settle_band_mg = 400,
+    .settle_samples = 5,
+    .min_change_mg = 2000,
+    .pill_mg = 0,
+};
+
+typedef enum {
+    SEG_REST,    // level with noise
+    SEG_HAND,    // fingers in the box: a press of 6..14 g with tremor on top of the level
+    SEG_RAMP,    // level moves linearly to `to_mg` (creep, temperature)
+    SEG_GLITCH,  // one sample far off (bad conversion)
+} seg_kind_t;
+
+typedef struct {
+    seg_kind_t kind;
+    uint32_t ms;
+    int32_t to_mg;   // level at the end of the segment
+} seg_t;
+
+typedef struct {
+    const char *name;
+    seg_t segs[6];
+    int expect;                // events expected, 0 or 1
+    pill_event_type_t type;
+    uint8_t count;
+} trace_t;
+
+static const trace_t TRACES[] = {
+    { "take one", { { SEG_REST, 20000, 30000 }, { SEG_HAND, 1200, 27500 }, { SEG_REST, 10000, 27500 } },
+      1, PILL_EVENT_REMOVED, 1 },
+    { "take two", { { SEG_REST, 5000, 27500 }, { SEG_HAND, 1500, 22500 }, { SEG_REST, 10000, 22500 } },
+      1, PILL_EVENT_REMOVED, 2 },
+    { "lid pressed", { { SEG_REST, 5000, 22500 }, { SEG_HAND, 1500, 22500 }, { SEG_REST, 10000, 22500 } }, 0, 0, 0 },
+    { "lid held down", { { SEG_REST, 5000, 22500 }, { SEG_HAND, 3000, 22500 }, { SEG_REST, 10000, 22500 } },
+      0, 0, 0 },
+    { "put one back", { { SEG_REST, 5000, 22500 }, { SEG_HAND, 1000, 25000 }, { SEG_REST, 10000, 25000 } },
+      1, PILL_EVENT_ADDED, 1 },
+    { "creep", { { SEG_REST, 5000, 25000 }, { SEG_RAMP, 60000, 23500 }, { SEG_REST, 10000, 23500 } }, 0, 0, 0 },
+    { "bad samples", { { SEG_REST, 5000, 23500 }, { SEG_GLITCH, SAMPLE_MS, -60000 }, { SEG_REST, 3000, 23500 },
+                       { SEG_GLITCH, SAMPLE_MS, 90000 }, { SEG_REST, 10000, 23500 } }, 0, 0, 0 },
+    { "take one again", { { SEG_REST, 5000, 23500 }, { SEG_HAND, 1500, 21000 }, { SEG_REST, 10000, 21000 } },
+      1, PILL_EVENT_REMOVED, 1 },
+};
+#define NTRACES (sizeof(TRACES) / sizeof(TRACES[0]))
+
+static uint32_t rng = 2024;
+
+static double uniform(void)
+{
+    rng = rng * 1664525u + 1013904223u;
+    return ((rng >> 8) + 0.5) / 16777216.0;
+}
+
+static int32_t gauss_mg(int32_t sigma)
+{
+    return (int32_t)(sigma * sqrt(-2.0 * log(uniform())) * cos(6.283185307 * uniform()));
+}
+
+static weight_filter_t filter;
+static pill_detector_t det;
+static uint32_t now_ms;
+static int false_events, missed, latencies, latency_sum, latency_max;
+
+static void feed(int32_t mg, const trace_t *t, int32_t *events, uint32_t rest_ms)
+{
+    int32_t filtered;
+    pill_event_t ev;
+    now_ms += SAMPLE_MS;
+    if (!weight_filter_push(&filter, mg, &filtered)) return;
+    if (!pill_detector_push(&det, filtered, now_ms, &ev)) return;
+    (*events)++;
+    if (!t->expect || *events > 1) {
+        fprintf(stderr, "%s: unexpected %s of %u at %u ms\n", t->name, ev.type == PILL_EVENT_REMOVED ? "removal" : "addition",
+                ev.count, (unsigned)now_ms);
+        false_events++;
+        return;
+    }
+    CHECK_EQ(ev.type, t->type);
+    CHECK_EQ(ev.count, t->count);
+    CHECK(ev.settled_ms >= ev.disturbed_ms);
+    int latency = (int)(ev.settled_ms - rest_ms);
+    if (ev.type == PILL_EVENT_ADDED) {
+        CHECK(latency <= MAX_ADD_LATENCY_MS);
+    } else {
+        latencies++;
+        latency_sum += latency;
+        if (latency > latency_max) latency_max = latency;
+    }
+    printf("  %-16s %s x%u (%d mg), %d ms after rest\n", t->name, ev.type == PILL_EVENT_REMOVED ? "removed" : "added",
+           ev.count, (int)ev.delta_mg, latency);
+}
+
+static void replay(const trace_t *t, int32_t *level)
+{
+    int32_t events = 0;
+    uint32_t rest_ms = now_ms;   // the weight is back at rest from here on
+    for (size_t s = 0; s < sizeof(t->segs) / sizeof(t->segs[0]) && t->segs[s].ms; ++s) {
+        const seg_t *g = &t->segs[s];
+        uint32_t n = g->ms / SAMPLE_MS;
+        int32_t from = *level;
+        double press_mg = 6000 + uniform() * 8000;
+        for (uint32_t i = 0; i < n; ++i) {
+            int32_t base = from;
+            int32_t mg;
+            switch (g->kind) {
+            case SEG_HAND:
+                base = i < n / 2 ? from : g->to_mg;   // pills leave or arrive mid-way
+                mg = base + (int32_t)(press_mg * sin(3.14159265 * (i + 0.5) / n)) + gauss_mg(TREMOR_MG);
+                break;
+            case SEG_RAMP:
+                base = from + (int32_t)((int64_t)(g->to_mg - from) * (i + 1) / n);
+                mg = base + gauss_mg(NOISE_MG);
+                break;
+            case SEG_GLITCH:
+                mg = g->to_mg;
+                break;
+            default:
+                base = g->to_mg;
+                mg = base + gauss_mg(NOISE_MG);
+                break;
+            }
+            feed(mg, t, &events, rest_ms);
+        }
+        if (g->kind != SEG_GLITCH) *level = g->to_mg;
+        if (g->kind == SEG_HAND) rest_ms = now_ms;
+    }
+    if (events < t->expect) {
+        fprintf(stderr, "%s: event missed\n", t->name);
+        missed++;
+    }
+}
+
+int main(void)
+{
+    CHECK_EQ(weight_filter_init(&filter, &FILTER_CFG), ESP_OK);
+    CHECK_EQ(pill_detector_init(&det, &DETECTOR_CFG), ESP_OK);
+
+    int32_t level = TRACES[0].segs[0].to_mg;
+    for (size_t i = 0; i < NTRACES; ++i) replay(&TRACES[i], &level);
+
+    printf("%d removals, %d false events, %d missed, latency mean %d ms, max %d ms\n", latencies, false_events, missed,
+           latencies ? latency_sum / latencies : 0, latency_max);
+    CHECK_EQ(false_events, 0);
+    CHECK_EQ(missed, 0);
+    CHECK(latency_max <= MAX_LATENCY_MS);
+    // the mass learned on the first removal counted the later ones
+    CHECK(pill_detector_pill_mg(&det) > PILL_MG - 300 && pill_detector_pill_mg(&det) < PILL_MG + 300);
+    CHECK(pill_detector_ref_mg(&det) > 21000 - 300 && pill_detector_ref_mg(&det) < 21000 + 300);
+    return TEST_RESULT();
+}
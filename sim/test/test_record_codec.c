@@ -0,0 +1,181 @@
+#include "test.h"
+#include "record.h"
+#include "record_codec.h"
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+// Round trips of the record codec: the body at 1 ms ticks must be exact,
+// the wire format at 1 s ticks within one tick without drift. Also the
+// records per read against the legacy 9 bytes per record, and the
+// encode/decode throughput on the host.
+
+#define N 4096
+#define LEGACY_RECORD_BYTES 9
+#define ATT_MAX 512
+
+static record_t in[N], out[N + 1];
+static uint8_t buf[N * 12];
+static uint32_t lcg = 7;
+
+static uint32_t rnd(void)
+{
+    lcg = lcg * 1664525u + 1013904223u;
+    return lcg >> 8;
+}
+
+// consecutive seqs, one boot; gaps from back-to-back to weeks, some backwards
+// (clock rebased after an SNTP sync)
+static void make(record_t *r, size_t n, uint32_t seq0, uint16_t boot, uint64_t ts0)
+{
+    uint64_t ts = ts0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t k = rnd() % 100;
+        if (k < 5) ts += 0;
+        else if (k < 60) ts += rnd() % 600000;
+        else if (k < 90) ts += 3600000ULL * (1 + rnd() % 12);
+        else if (k < 97) ts += 86400000ULL * (1 + rnd() % 30) + rnd() % 1000;
+        else if (ts > 5000000) ts -= rnd() % 5000000;
+        r[i] = (record_t){ .seq = seq0 + (uint32_t)i, .ts_ms = ts, .boot = boot, .val = rnd() & RECORD_VAL_MASK };
+    }
+}
+
+static bool same_but_ts(const record_t *a, const record_t *b)
+{
+    return a->seq == b->seq && a->boot == b->boot && a->val == b->val;
+}
+
+static void test_body_exact(void)
+{
+    make(in, N, 1, 3, 123456789ULL);
+    size_t used;
+    CHECK_EQ(record_codec_encode_body(in, N, 1, buf, sizeof(buf), &used), N);
+    CHECK_EQ(record_codec_decode_body(buf, used, 1, 3, 1, out, N), N);
+    for (size_t i = 0; i < N; ++i) {
+        CHECK(same_but_ts(&in[i], &out[i]));
+        CHECK_EQ(out[i].ts_ms, in[i].ts_ms);
+    }
+    // truncated input decodes a prefix, never more
+    CHECK(record_codec_decode_body(buf, used / 2, 1, 3, 1, out, N) < N);
+    CHECK_EQ(record_codec_decode_body(buf, 0, 1, 3, 1, out, N), 0);
+}
+
+static void test_wire_ticks(void)
+{
+    make(in, N, 1000, 42, 1700000000123ULL);
+    size_t done = 0, pos = 0, payloads = 0;
+    while (done < N) {
+        size_t used;
+        size_t n = record_codec_encode(in + done, N - done, buf, ATT_MAX, &used);
+        CHECK(n > 0 && used <= ATT_MAX);
+        if (!n) return;
+        int got = record_codec_decode(buf, used, out + done, N);
+        CHECK_EQ(got, n);
+        done += n;
+        pos += used;
+        payloads++;
+    }
+    for (size_t i = 0; i < N; ++i) {
+        CHECK(same_but_ts(&in[i], &out[i]));
+        // quantized on an absolute grid, so the error never builds up
+        CHECK(out[i].ts_ms <= in[i].ts_ms && in[i].ts_ms - out[i].ts_ms < RECORD_CODEC_TICK_MS);
+    }
+    printf("wire: %d records in %zu payloads of <= %d bytes, %.2f bytes per record\n", N, payloads, ATT_MAX,
+           (double)pos / N);
+}
+
+static void test_header(void)
+{
+    make(in, 8, 77, 9, 5000);
+    in[5].boot = 10;   // a reboot ends the payload
+    size_t used;
+    CHECK_EQ(record_codec_encode(in, 8, buf, sizeof(buf), &used), 5);
+    CHECK_EQ(buf[0], RECORD_CODEC_MAGIC);
+    CHECK_EQ(buf[1], RECORD_CODEC_VERSION);
+    CHECK_EQ(buf[2], 77);   // base seq, then the boot id
+    CHECK_EQ(buf[3], 9);
+    CHECK_EQ(record_codec_decode(buf, used, out, N), 5);
+    CHECK_EQ(out[0].seq, 77);
+    CHECK_EQ(out[4].seq, 81);
+    CHECK_EQ(out[4].boot, 9);
+    // the reader's buffer bounds the count
+    out[2].seq = 0;
+    CHECK_EQ(record_codec_decode(buf, used, out, 2), 2);
+    CHECK_EQ(out[2].seq, 0);
+
+    in[3].seq = 100;   // so does a seq gap
+    CHECK_EQ(record_codec_encode(in, 5, buf, sizeof(buf), &used), 3);
+
+    // converted records travel as boot 0
+    make(in, 3, 5, RECORD_BOOT_EPOCH, 1700000000000ULL);
+    CHECK_EQ(record_codec_encode(in, 3, buf, sizeof(buf), &used), 3);
+    CHECK_EQ(buf[3], 0);
+    CHECK_EQ(record_codec_decode(buf, used, out, N), 3);
+    CHECK_EQ(out[2].boot, RECORD_BOOT_EPOCH);
+
+    uint8_t future[] = { RECORD_CODEC_MAGIC, RECORD_CODEC_VERSION + 1, 1, 0, 0, 0 };
+    CHECK_EQ(record_codec_decode(future, sizeof(future), out, N), -1);
+    uint8_t bad_boot[] = { RECORD_CODEC_MAGIC, RECORD_CODEC_VERSION, 1, 0xFF, 0xFF, 0x01, 0, 0 };
+    CHECK_EQ(record_codec_decode(bad_boot, sizeof(bad_boot), out, N), -1);
+    uint8_t no_body[] = { RECORD_CODEC_MAGIC, RECORD_CODEC_VERSION, 1, 0 };
+    CHECK_EQ(record_codec_decode(no_body, sizeof(no_body), out, N), 0);
+}
+
+// records per 512-byte ATT read against the legacy 56. Doses hours apart take
+// three bytes each and the header plus base fit in the rest, so 3x holds;
+// events minutes apart (openings, refills) take two.
+static size_t per_read(uint64_t gap_ms, uint64_t jitter_ms)
+{
+    uint64_t ts = 1700000000000ULL;
+    for (size_t i = 0; i < N; ++i) {
+        ts += gap_ms + rnd() % jitter_ms;
+        in[i] = (record_t){ .seq = 1 + (uint32_t)i, .ts_ms = ts, .boot = RECORD_BOOT_EPOCH, .val = i & 3 };
+    }
+    size_t used;
+    return record_codec_encode(in, N, buf, ATT_MAX, &used);
+}
+
+static void test_density(void)
+{
+    const size_t legacy = ATT_MAX / LEGACY_RECORD_BYTES;
+    size_t doses = per_read(6 * 3600000ULL, 1800000);
+    size_t minutes = per_read(60000, 240000);
+    printf("density: %zu records per %d-byte read 6 h apart, %zu minutes apart, legacy %zu\n", doses, ATT_MAX,
+           minutes, legacy);
+    CHECK(doses >= 3 * legacy);
+    CHECK(minutes >= 4 * legacy);
+}
+
+static double secs(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+static void test_throughput(void)
+{
+    make(in, N, 1, 1, 1000);
+    size_t used = 0, n = 0;
+    const int reps = 200;
+    double t0 = secs();
+    for (int r = 0; r < reps; ++r) n += record_codec_encode_body(in, N, 1, buf, sizeof(buf), &used);
+    double t1 = secs();
+    size_t m = 0;
+    for (int r = 0; r < reps; ++r) m += record_codec_decode_body(buf, used, 1, 1, 1, out, N);
+    double t2 = secs();
+    CHECK_EQ(n, (size_t)reps * N);
+    CHECK_EQ(m, (size_t)reps * N);
+    printf("throughput: encode %.1f M records/s, decode %.1f M records/s (%.2f bytes per record)\n",
+           n / (t1 - t0) / 1e6, m / (t2 - t1) / 1e6, (double)used / N);
+}
+
+int main(void)
+{
+    test_body_exact();
+    test_wire_ticks();
+    test_header();
+    test_density();
+    test_throughput();
+    return TEST_RESULT();
+}
@@ -0,0 +1,225 @@
+#include "test.h"
+#include "sync_proto.h"
+#include "record_codec.h"
+#include <stdbool.h>
+#include <string.h>
+
+// The sync protocol against a stand-in for the GATT layer: a long read is a Read
+// Request then Read Blob requests at growing offsets, each answered with MTU-1
+// bytes of the whole value, as NimBLE slices it. Records arrive between the
+// chunks. The reassembled payload must decode to consecutive records from the
+// cursor; the same exchange over a value rebuilt for every chunk from the newest
+// records (what the access callback did before the cursor and the snapshot)
+// comes apart.
+
+#define LOG_MAX 2048
+#define MTU_MIN 23
+#define MTU_BIG 247
+
+static record_t log_recs[LOG_MAX];
+static size_t log_len;
+static uint32_t persisted;
+static int persists;
+
+static size_t store_read(uint32_t from_seq, record_t *out, size_t max)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < log_len && n < max; ++i) {
+        if (log_recs[i].seq >= from_seq) out[n++] = log_recs[i];
+    }
+    return n;
+}
+
+static void store_ack(uint32_t next_seq)
+{
+    persisted = next_seq;
+    persists++;
+}
+
+static const sync_store_t STORE = { .read = store_read, .on_ack = store_ack };
+
+// seq 1.. one event a minute
+static void append(size_t n)
+{
+    for (size_t i = 0; i < n && log_len < LOG_MAX; ++i, ++log_len) {
+        log_recs[log_len] = (record_t){ .seq = (uint32_t)log_len + 1, .ts_ms = 1700000000000ULL + log_len * 61000ULL,
+                                        .boot = RECORD_BOOT_EPOCH, .val = log_len & 7 };
+    }
+}
+
+static void ctrl(uint16_t conn, uint8_t op, uint32_t seq)
+{
+    uint8_t cmd[5] = { op, (uint8_t)seq, (uint8_t)(seq >> 8), (uint8_t)(seq >> 16), (uint8_t)(seq >> 24) };
+    CHECK_EQ(sync_proto_write(conn, cmd, sizeof(cmd)), ESP_OK);
+}
+
+typedef const uint8_t *(*read_fn_t)(uint16_t conn, uint16_t mtu, size_t *len);
+
+// the client side of one long read; `between` new records land before every blob request
+static size_t gatt_long_read(read_fn_t read, uint16_t conn, uint16_t mtu, size_t between, uint8_t *out,
+                             int *requests)
+{
+    size_t off = 0;
+    *requests = 0;
+    for (;;) {
+        size_t len;
+        const uint8_t *val = read(conn, mtu, &len);
+        ++*requests;
+        size_t chunk = off < len ? len - off : 0;
+        if (chunk > (size_t)mtu - 1) chunk = mtu - 1;
+        memcpy(out + off, val + off, chunk);
+        off += chunk;
+        // a response shorter than MTU-1 ends the long read
+        if (chunk < (size_t)mtu - 1 || off >= SYNC_PAYLOAD_MAX) return off;
+        append(between);
+    }
+}
+
+// the old access callback: the 64-entry ring encoded again for every request
+#define NAIVE_RING 64
+static const uint8_t *naive_read(uint16_t conn, uint16_t mtu, size_t *len)
+{
+    static record_t recs[NAIVE_RING];
+    static uint8_t buf[SYNC_PAYLOAD_MAX];
+    size_t n = store_read(log_len > NAIVE_RING ? (uint32_t)(log_len - NAIVE_RING + 1) : 1, recs, NAIVE_RING);
+    *len = 0;
+    if (n) record_codec_encode(recs, n, buf, sizeof(buf), len);
+    return buf;
+}
+
+// records decoded from `p` are exactly seq from.. in order and match the log
+static bool consistent(const uint8_t *p, size_t len, uint32_t from, int *count)
+{
+    static record_t out[256];
+    int n = record_codec_decode(p, len, out, 256);
+    *count = n;
+    if (n < 0) return false;
+    for (int i = 0; i < n; ++i) {
+        const record_t *want = &log_recs[from - 1 + i];
+        if (out[i].seq != from + (uint32_t)i || out[i].val != want->val || out[i].boot != want->boot ||
+            want->ts_ms - out[i].ts_ms >= RECORD_CODEC_TICK_MS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_torn_read(void)
+{
+    uint8_t payload[SYNC_PAYLOAD_MAX];
+    int requests, n;
+
+    // reproduce: the ring moves on between chunks, so the header and the first
+    // deltas come from one window and the rest from a later one
+    log_len = 0;
+    append(100);
+    size_t len = gatt_long_read(naive_read, 1, MTU_MIN, 3, payload, &requests);
+    CHECK(requests > 1);
+    CHECK(!consistent(payload, len, 100 - NAIVE_RING + 1, &n));
+
+    log_len = 0;
+    append(100);
+    CHECK_EQ(sync_proto_init(&STORE, 1), ESP_OK);
+    CHECK_EQ(sync_proto_open(1), ESP_OK);
+    ctrl(1, SYNC_OP_FROM, 50);
+    len = gatt_long_read(sync_proto_read, 1, MTU_MIN, 3, payload, &requests);
+    CHECK(requests > 1);
+    CHECK(consistent(payload, len, 50, &n));
+    CHECK_EQ(n, 51);   // the snapshot taken at offset 0: seq 50..100
+    printf("torn read: %zu bytes in %d requests at MTU %d, %d records, %zu arrived meanwhile\n", len, requests,
+           MTU_MIN, n, log_len - 100);
+
+    // pinned until the client writes: a repeated read sees the same bytes
+    uint8_t again[SYNC_PAYLOAD_MAX];
+    CHECK_EQ(gatt_long_read(sync_proto_read, 1, MTU_MIN, 0, again, &requests), len);
+    CHECK(memcmp(again, payload, len) == 0);
+
+    // the ack moves the cursor and the next read picks up what came in between
+    ctrl(1, SYNC_OP_ACK, 101);
+    len = gatt_long_read(sync_proto_read, 1, MTU_BIG, 0, payload, &requests);
+    CHECK(consistent(payload, len, 101, &n));
+    CHECK_EQ(n, (int)log_len - 100);
+    sync_proto_close(1);
+}
+
+static void test_incremental(void)
+{
+    uint8_t payload[SYNC_PAYLOAD_MAX];
+    int requests, n;
+    log_len = 0;
+    persists = 0;
+    append(1000);
+    CHECK_EQ(sync_proto_init(&STORE, 1), ESP_OK);
+    CHECK_EQ(sync_proto_open(7), ESP_OK);
+    CHECK_EQ(sync_proto_cursor(7), 1);
+
+    // pull the whole history, acknowledging each payload
+    uint32_t next = 1;
+    int reads = 0;
+    for (;;) {
+        size_t len = gatt_long_read(sync_proto_read, 7, MTU_BIG, 0, payload, &requests);
+        if (!len) break;
+        CHECK(consistent(payload, len, next, &n));
+        CHECK(n > 0);
+        if (n <= 0) break;
+        next += (uint32_t)n;
+        ctrl(7, SYNC_OP_ACK, next);
+        reads++;
+    }
+    CHECK_EQ(next, 1001);
+    CHECK_EQ(sync_proto_acked(), 1001);
+    CHECK_EQ(persisted, 1001);
+    CHECK_EQ(persists, reads);
+    printf("history: 1000 records in %d reads\n", reads);
+
+    // up to date: empty reads, and a short value is taken fresh every time
+    size_t len;
+    sync_proto_read(7, MTU_BIG, &len);
+    CHECK_EQ(len, 0);
+    append(2);
+    sync_proto_read(7, MTU_BIG, &len);
+    CHECK(len > 0 && len < MTU_BIG - 1);
+    const uint8_t *p = sync_proto_read(7, MTU_BIG, &len);
+    CHECK(consistent(p, len, 1001, &n));
+    CHECK_EQ(n, 2);
+    sync_proto_close(7);
+
+    // a new connection starts at the acknowledged position; an older ack changes nothing
+    CHECK_EQ(sync_proto_open(8), ESP_OK);
+    CHECK_EQ(sync_proto_cursor(8), 1001);
+    ctrl(8, SYNC_OP_ACK, 500);
+    CHECK_EQ(sync_proto_acked(), 1001);
+    CHECK_EQ(sync_proto_cursor(8), 500);
+    ctrl(8, SYNC_OP_FROM, 999);
+    p = sync_proto_read(8, MTU_BIG, &len);
+    CHECK(consistent(p, len, 999, &n));
+    CHECK_EQ(n, 4);
+    sync_proto_close(8);
+}
+
+static void test_sessions(void)
+{
+    CHECK_EQ(sync_proto_init(&STORE, 1), ESP_OK);
+    for (uint16_t c = 0; c < SYNC_MAX_SESSIONS; ++c) CHECK_EQ(sync_proto_open(c), ESP_OK);
+    CHECK_EQ(sync_proto_open(SYNC_MAX_SESSIONS), ESP_ERR_NO_MEM);
+    CHECK_EQ(sync_proto_open(0), ESP_OK);   // reopening takes no new slot
+    sync_proto_close(2);
+    CHECK_EQ(sync_proto_open(SYNC_MAX_SESSIONS), ESP_OK);
+
+    // bad writes, unknown connections
+    uint8_t bad_op[5] = { 0x7F, 0, 0, 0, 0 };
+    CHECK_EQ(sync_proto_write(0, bad_op, sizeof(bad_op)), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(sync_proto_write(0, bad_op, 4), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(sync_proto_write(2, bad_op, sizeof(bad_op)), ESP_ERR_INVALID_STATE);
+    size_t len = 1;
+    CHECK(sync_proto_read(2, MTU_BIG, &len) == NULL);
+    CHECK_EQ(len, 0);
+}
+
+int main(void)
+{
+    test_torn_read();
+    test_incremental();
+    test_sessions();
+    return TEST_RESULT();
+}
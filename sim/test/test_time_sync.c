@@ -0,0 +1,96 @@
+#include "test.h"
+#include "sim.h"
+#include "time_sync.h"
+#include "esp_log.h"
+#include <string.h>
+
+// The Current Time characteristic as the phone writes it: local time per the
+// DOSE_OP_TZ offset, converted to UTC on the way in and back on the way out. A
+// date that does not exist must be refused, not rolled into the next month, and
+// an offset that arrives after the time (the phone writes Current Time first on
+// connect) must correct a clock the phone set, and only that.
+
+#define MIN_MS 60000LL
+#define HOUR_MS (60 * MIN_MS)
+#define T_2024_06_01 1717200000000LL   // 2024-06-01 00:00 UTC
+
+static uint8_t cts_buf[TIME_CTS_LEN];
+
+static const uint8_t *cts(int y, int mo, int d, int h, int mi, int s)
+{
+    const uint8_t v[TIME_CTS_LEN] = { (uint8_t)y, (uint8_t)(y >> 8), (uint8_t)mo, (uint8_t)d,
+                                      (uint8_t)h, (uint8_t)mi, (uint8_t)s, 0, 0, 0 };
+    memcpy(cts_buf, v, sizeof(v));
+    return cts_buf;
+}
+
+static esp_err_t write_cts(int y, int mo, int d, int h, int mi, int s)
+{
+    return time_sync_from_cts(cts(y, mo, d, h, mi, s), TIME_CTS_LEN);
+}
+
+static void test_dates(void)
+{
+    CHECK_EQ(write_cts(2024, 2, 29, 12, 0, 0), ESP_OK);   // leap year
+    CHECK_EQ(write_cts(2023, 2, 29, 12, 0, 0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(write_cts(2024, 2, 30, 12, 0, 0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(write_cts(2024, 2, 31, 12, 0, 0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(write_cts(2024, 4, 31, 12, 0, 0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(write_cts(2024, 4, 30, 12, 0, 0), ESP_OK);
+    CHECK_EQ(write_cts(2024, 12, 31, 23, 59, 59), ESP_OK);
+    CHECK_EQ(write_cts(2024, 12, 32, 0, 0, 0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(write_cts(2024, 13, 1, 0, 0, 0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(write_cts(2024, 1, 0, 0, 0, 0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(write_cts(2024, 1, 1, 24, 0, 0), ESP_ERR_INVALID_ARG);
+}
+
+static void test_local(void)
+{
+    time_sync_set_tz(120);
+    CHECK_EQ(write_cts(2024, 6, 1, 12, 0, 0), ESP_OK);
+    CHECK_EQ((int64_t)time_sync_epoch_ms(), T_2024_06_01 + 10 * HOUR_MS);
+    uint8_t out[TIME_CTS_LEN];
+    CHECK_EQ(time_sync_to_cts(out, sizeof(out)), TIME_CTS_LEN);
+    CHECK(memcmp(out, cts(2024, 6, 1, 12, 0, 0), 7) == 0);
+    CHECK_EQ(out[7], 6);   // Saturday
+
+    // west of UTC the local date is still the previous day
+    time_sync_set_tz(-300);
+    CHECK_EQ(write_cts(2024, 5, 31, 22, 30, 0), ESP_OK);
+    CHECK_EQ((int64_t)time_sync_epoch_ms(), T_2024_06_01 + 3 * HOUR_MS + 30 * MIN_MS);
+    CHECK_EQ(time_sync_to_cts(out, sizeof(out)), TIME_CTS_LEN);
+    CHECK(memcmp(out, cts(2024, 5, 31, 22, 30, 0), 7) == 0);
+}
+
+static void test_late_offset(void)
+{
+    // the time came with the old offset, the new one moves the clock by the difference
+    time_sync_set_tz(0);
+    CHECK_EQ(write_cts(2024, 6, 1, 12, 0, 0), ESP_OK);
+    time_sync_set_tz(180);
+    CHECK_EQ((int64_t)time_sync_epoch_ms(), T_2024_06_01 + 9 * HOUR_MS);
+    CHECK_EQ(time_sync_source(), TIME_SRC_BLE);
+    // the same offset again is not a correction
+    time_sync_set_tz(180);
+    CHECK_EQ((int64_t)time_sync_epoch_ms(), T_2024_06_01 + 9 * HOUR_MS);
+
+    // a clock from SNTP is UTC already
+    CHECK_EQ(time_sync_set(T_2024_06_01, TIME_SRC_SNTP), ESP_OK);
+    time_sync_set_tz(60);
+    CHECK_EQ((int64_t)time_sync_epoch_ms(), T_2024_06_01);
+}
+
+static void test_main(void)
+{
+    CHECK(!time_sync_valid());
+    test_dates();
+    test_local();
+    test_late_offset();
+}
+
+int main(void)
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+    sim_run(test_main, SIM_NEVER);
+    return TEST_RESULT();
+}
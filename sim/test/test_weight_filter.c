@@ -0,0 +1,129 @@
+#include "test.h"
+#include "weight_filter.h"
+
+// Each stage of the filter chain on its own and sensor_task's chain. Cycles
+// per sample of the same stages are the filter_* cases of pillbox_bench.
+
+static int push_all(weight_filter_t *f, const int32_t *in, size_t n, int32_t *out)
+{
+    int emitted = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (weight_filter_push(f, in[i], &out[emitted])) emitted++;
+    }
+    return emitted;
+}
+
+static void test_config(void)
+{
+    weight_filter_t f;
+    CHECK_EQ(weight_filter_init(&f, &(weight_filter_cfg_t){ .median_len = 4, .decimate = 1 }), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(weight_filter_init(&f, &(weight_filter_cfg_t){ .median_len = 9, .decimate = 1 }), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(weight_filter_init(&f, &(weight_filter_cfg_t){ .median_len = 1, .decimate = 0 }), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(weight_filter_init(&f, &(weight_filter_cfg_t){ .median_len = 1, .smooth = WEIGHT_FILTER_SMOOTH_AVG,
+                                                            .avg_len = 17, .decimate = 1 }),
+             ESP_ERR_INVALID_ARG);
+    CHECK_EQ(weight_filter_init(&f, &(weight_filter_cfg_t){ .median_len = 1, .smooth = WEIGHT_FILTER_SMOOTH_IIR,
+                                                            .iir_shift = 8, .decimate = 1 }),
+             ESP_ERR_INVALID_ARG);
+    CHECK_EQ(weight_filter_init(&f, &(weight_filter_cfg_t){ .median_len = 7, .decimate = 1 }), ESP_OK);
+}
+
+static void test_median(void)
+{
+    weight_filter_t f;
+    weight_filter_init(&f, &(weight_filter_cfg_t){ .median_len = 5, .decimate = 1 });
+    // two spikes in any window of five are rejected, in both directions
+    static const int32_t in[] = { 100, 100, 90000, 100, -90000, 100, 100, 100, 90000, 90000, 100, 100 };
+    int32_t out[12];
+    CHECK_EQ(push_all(&f, in, 12, out), 12);
+    for (int i = 0; i < 12; ++i) CHECK_EQ(out[i], 100);
+    // a step passes once it holds for three samples
+    weight_filter_reset(&f);
+    static const int32_t step[] = { 100, 100, 100, 100, 100, 500, 500, 500 };
+    push_all(&f, step, 8, out);
+    CHECK_EQ(out[6], 100);
+    CHECK_EQ(out[7], 500);
+    // negative counts sort like any other
+    weight_filter_reset(&f);
+    static const int32_t neg[] = { -5, -7, -6 };
+    push_all(&f, neg, 3, out);
+    CHECK_EQ(out[0], -5);
+    CHECK_EQ(out[1], -5);   // median of the two held, upper one
+    CHECK_EQ(out[2], -6);
+}
+
+static void test_average(void)
+{
+    weight_filter_t f;
+    weight_filter_init(&f, &(weight_filter_cfg_t){ .median_len = 1, .smooth = WEIGHT_FILTER_SMOOTH_AVG,
+                                                   .avg_len = 4, .decimate = 1 });
+    static const int32_t in[] = { 40, 80, 120, 160, 200, 0 };
+    int32_t out[6];
+    push_all(&f, in, 6, out);
+    // the window fills first, then slides
+    CHECK_EQ(out[0], 40);
+    CHECK_EQ(out[1], 60);
+    CHECK_EQ(out[2], 80);
+    CHECK_EQ(out[3], 100);
+    CHECK_EQ(out[4], 140);
+    CHECK_EQ(out[5], 120);
+    // the running sum is 64 bits: full-scale counts do not overflow
+    weight_filter_reset(&f);
+    static const int32_t big[] = { 0x7FFFFF, 0x7FFFFF, 0x7FFFFF, 0x7FFFFF };
+    push_all(&f, big, 4, out);
+    CHECK_EQ(out[3], 0x7FFFFF);
+}
+
+static void test_iir(void)
+{
+    weight_filter_t f;
+    weight_filter_init(&f, &(weight_filter_cfg_t){ .median_len = 1, .smooth = WEIGHT_FILTER_SMOOTH_IIR,
+                                                   .iir_shift = 3, .decimate = 1 });
+    int32_t out[64];
+    int32_t in[64];
+    for (int i = 0; i < 64; ++i) in[i] = i == 0 ? 1000 : 9000;
+    push_all(&f, in, 64, out);
+    // primed with the first sample, then a monotonic approach to the step
+    CHECK_EQ(out[0], 1000);
+    CHECK_EQ(out[1], 2000);
+    for (int i = 2; i < 64; ++i) CHECK(out[i] >= out[i - 1] && out[i] <= 9000);
+    CHECK(out[63] >= 9000 - 8);
+}
+
+static void test_decimate(void)
+{
+    weight_filter_t f;
+    weight_filter_init(&f, &(weight_filter_cfg_t){ .median_len = 3, .decimate = 4 });
+    int32_t in[16], out[16];
+    for (int i = 0; i < 16; ++i) in[i] = i * 10;
+    CHECK_EQ(push_all(&f, in, 16, out), 4);
+    // every 4th median of three, i.e. the sample before it
+    CHECK_EQ(out[0], 20);
+    CHECK_EQ(out[3], 140);
+}
+
+// sensor_task: median-5 then average-4 keeps a spike out entirely and settles
+// on a step within median delay plus window
+static void test_sensor_chain(void)
+{
+    weight_filter_t f;
+    weight_filter_init(&f, &(weight_filter_cfg_t){ .median_len = 5, .smooth = WEIGHT_FILTER_SMOOTH_AVG,
+                                                   .avg_len = 4, .decimate = 1 });
+    int32_t in[20], out[20];
+    for (int i = 0; i < 20; ++i) in[i] = i < 10 ? 84000 : 0;
+    in[4] = 200000;
+    push_all(&f, in, 20, out);
+    for (int i = 0; i < 10; ++i) CHECK_EQ(out[i], 84000);
+    CHECK_EQ(out[10 + 2 + 3], 0);
+}
+
+int main(void)
+{
+    test_config();
+    test_median();
+    test_average();
+    test_iir();
+    test_decimate();
+    test_sensor_chain();
+    return TEST_RESULT();
+}
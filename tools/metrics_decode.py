@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Decode the metrics characteristic (0xA006).
+
+    python3 tools/metrics_decode.py 010e80...              # value as hex, e.g. copied from nRF Connect
+    python3 tools/metrics_decode.py --file value.bin       # raw value saved by a BLE client
+    ./_sim_build/pillbox_sim | python3 tools/metrics_decode.py   # "MET <hex>" lines
+
+Metric names come from the METRIC_* defines in main/include/metrics.h.
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+
+VERSION = 1
+KIND_COUNTER, KIND_GAUGE, KIND_HISTOGRAM = 0, 1, 2
+DEFAULT_HEADER = os.path.join(os.path.dirname(__file__), "..", "main", "include", "metrics.h")
+
+
+def load_names(header):
+    names = {}
+    with open(header, encoding="utf-8") as f:
+        for m in re.finditer(r"#define\s+METRIC_(\w+)\s+(0x[0-9a-fA-F]+)", f.read()):
+            if m.group(1) != "COUNT":
+                names[int(m.group(2), 16)] = m.group(1).lower()
+    return names
+
+
+def decode(data):
+    """Return (uptime_ms, [(id, kind, value)]); a histogram value is (base, [counts])."""
+    if len(data) < 6 or data[0] != VERSION:
+        raise ValueError(f"not a version {VERSION} metrics value")
+    count, uptime = data[1], struct.unpack_from("<I", data, 2)[0]
+    pos, out = 6, []
+    for _ in range(count):
+        mid, kind = data[pos], data[pos + 1]
+        pos += 2
+        if kind == KIND_HISTOGRAM:
+            base, nb = struct.unpack_from("<IB", data, pos)
+            pos += 5
+            counts = list(struct.unpack_from(f"<{nb}I", data, pos))
+            pos += 4 * nb
+            out.append((mid, kind, (base, counts)))
+        else:
+            fmt = "<i" if kind == KIND_GAUGE else "<I"
+            out.append((mid, kind, struct.unpack_from(fmt, data, pos)[0]))
+            pos += 4
+    return uptime, out
+
+
+def hist_lines(base, counts):
+    lines = []
+    for b, n in enumerate(counts):
+        lo = 0 if b == 0 else base << (b - 1)
+        label = f">= {lo}" if b == len(counts) - 1 else f"{lo}..{(base << b) - 1}"
+        lines.append(f"    {label:>16}  {n}")
+    return lines
+
+
+def print_value(data, names):
+    uptime, metrics = decode(data)
+    print(f"# uptime {uptime / 1000:.1f} s, {len(metrics)} metrics")
+    for mid, kind, value in metrics:
+        name = names.get(mid, f"0x{mid:02x}")
+        if kind == KIND_HISTOGRAM:
+            base, counts = value
+            print(f"{name:<20} {sum(counts)} samples")
+            print("\n".join(hist_lines(base, counts)))
+        else:
+            print(f"{name:<20} {value}")
+
+
+def values_from_text(lines):
+    for line in lines:
+        m = re.search(r"MET\s+([0-9a-fA-F]+)", line)
+        if m:
+            yield bytes.fromhex(m.group(1))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("hex", nargs="*", help="value as hex; separators such as '-', ':' or spaces are ignored")
+    ap.add_argument("--file", help="raw binary value")
+    ap.add_argument("--header", default=DEFAULT_HEADER, help="metrics.h with the metric ids")
+    args = ap.parse_args()
+
+    names = load_names(args.header)
+    if args.file:
+        with open(args.file, "rb") as f:
+            values = [f.read()]
+    elif args.hex:
+        values = [bytes.fromhex(re.sub(r"0x|[^0-9a-fA-F]", "", "".join(args.hex)))]
+    else:
+        values = list(values_from_text(sys.stdin))
+    for data in values:
+        print_value(data, names)
+
+
+if __name__ == "__main__":
+    main()
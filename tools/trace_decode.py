@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""Decode trace_dump() output from a serial log.
+
+    idf.py monitor | tee log.txt
+    python3 tools/trace_decode.py log.txt
+    python3 tools/trace_decode.py log.txt --chrome trace.json     # open in ui.perfetto.dev
+    python3 tools/trace_decode.py --ble trace.bin --chrome trace.json
+
+--ble takes the 0xA007 values as a BLE client read them, concatenated: the
+names window (0xFFFE) first, then the record windows from 0 up. Event, span and
+ISR names come from the TRACE_EV_*, TRACE_SPAN_* and TRACE_ISR_* defines in
+main/include/trace.h.
+"""
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+
+REC = struct.Struct("<IHHii")  # ts_us, id, seq, a0, a1
+TASK_NAME_LEN = 16
+WINDOW_RECORDS = 31
+ISR_TID = 1       # task handles are pointers, never 0 or 1
+NO_TASK_TID = 0   # before the first switch seen on a core
+DEFAULT_HEADER = os.path.join(os.path.dirname(__file__), "..", "main", "include", "trace.h")
+
+
+def load_names(header):
+    """Return {prefix: {value: name}} for the EV, SPAN and ISR defines."""
+    names = {"EV": {}, "SPAN": {}, "ISR": {}}
+    with open(header, encoding="utf-8") as f:
+        for m in re.finditer(r"#define\s+TRACE_(EV|SPAN|ISR)_(\w+)\s+(0x[0-9a-fA-F]+|\d+)\b", f.read()):
+            names[m.group(1)][int(m.group(3), 0)] = m.group(2).lower()
+    return names
+
+
+def read_dumps(lines):
+    """Yield (records, {handle: task name}) per TRC-BEGIN..TRC-END block."""
+    recs, tasks = None, {}
+    for line in lines:
+        m = re.search(r"TRC-TASK\s+([0-9a-fA-F]+) ?(.*)", line)
+        if m:
+            if recs is not None:
+                tasks[int(m.group(1), 16)] = m.group(2).rstrip("\r\n")
+            continue
+        m = re.search(r"TRC(-BEGIN|-END)?\s*([0-9a-fA-F]*)", line)
+        if not m:
+            continue
+        if m.group(1) == "-BEGIN":
+            recs, tasks = [], {}
+        elif m.group(1) == "-END":
+            if recs is not None:
+                yield recs, tasks
+            recs = None
+        elif recs is not None and len(m.group(2)) == REC.size * 2:
+            recs.append(REC.unpack(bytes.fromhex(m.group(2))))
+
+
+def read_ble(data):
+    """Parse the names window followed by the record windows."""
+    count, pos, tasks = data[0], 1, {}
+    for _ in range(count):
+        handle = struct.unpack_from("<I", data, pos)[0]
+        name = data[pos + 4:pos + 4 + TASK_NAME_LEN].split(b"\0")[0].decode(errors="replace")
+        tasks[handle] = name
+        pos += 4 + TASK_NAME_LEN
+    recs = []
+    while pos + 4 <= len(data):
+        total, first = struct.unpack_from("<HH", data, pos)
+        n = max(0, min(WINDOW_RECORDS, total - first))
+        pos += 4
+        for _ in range(n):
+            if pos + REC.size > len(data):
+                break
+            recs.append(REC.unpack_from(data, pos))
+            pos += REC.size
+    return recs, tasks
+
+
+def unwrap(recs):
+    """Turn 32-bit µs stamps into a monotonic 64-bit timeline."""
+    out, base, prev = [], 0, None
+    for ts, *rest in recs:
+        if prev is not None and ts < prev:
+            base += 1 << 32
+        prev = ts
+        out.append((base + ts, *rest))
+    return out
+
+
+def chrome_events(recs, tasks, names):
+    """Build Chrome trace events: one process per core, one thread per task plus an ISR track.
+
+    A task runs from its TASK_IN to the next TASK_IN on the same core. Spans are
+    drawn on the task that was running on their core; a span still open when the
+    task is switched out is closed there and reopened when it comes back.
+    """
+    ev_names, span_names, isr_names = names["EV"], names["SPAN"], names["ISR"]
+    by_name = {v: k for k, v in ev_names.items()}
+    task_in, isr_enter, isr_exit = by_name.get("task_in"), by_name.get("isr_enter"), by_name.get("isr_exit")
+    span_begin, span_end = by_name.get("span_begin"), by_name.get("span_end")
+    t0 = recs[0][0] if recs else 0
+    out, threads = [], set()
+    running = {}   # core -> (tid, since)
+    spans = {}     # (core, tid) -> stack of open span names
+
+    def thread(core, tid):
+        if (core, tid) not in threads:
+            threads.add((core, tid))
+            name = {ISR_TID: "ISR", NO_TASK_TID: "(unknown)"}.get(tid) or tasks.get(tid, f"task {tid:08x}")
+            out.append({"ph": "M", "name": "thread_name", "pid": core, "tid": tid, "args": {"name": name}})
+        return tid
+
+    def edge(ph, name, core, tid, ts):
+        out.append({"ph": ph, "name": name, "cat": "span", "pid": core, "tid": thread(core, tid), "ts": ts})
+
+    for ts, ev, _seq, a0, a1 in recs:
+        ts = ts - t0
+        if ev == task_in:
+            core, tid = a1, a0 & 0xFFFFFFFF
+            prev = running.get(core)
+            if prev:
+                for name in reversed(spans.get((core, prev[0]), [])):
+                    edge("E", name, core, prev[0], ts)
+                out.append({"ph": "X", "name": "running", "cat": "sched", "pid": core,
+                            "tid": thread(core, prev[0]), "ts": prev[1], "dur": ts - prev[1]})
+            running[core] = (tid, ts)
+            for name in spans.get((core, tid), []):
+                edge("B", name, core, tid, ts)
+        elif ev in (isr_enter, isr_exit):
+            edge("B" if ev == isr_enter else "E", isr_names.get(a0, f"isr {a0}"), a1, ISR_TID, ts)
+        elif ev in (span_begin, span_end):
+            core, name = a1, span_names.get(a0, f"span {a0}")
+            tid = running.get(core, (NO_TASK_TID,))[0]
+            stack = spans.setdefault((core, tid), [])
+            if ev == span_begin:
+                stack.append(name)
+            elif name in stack:
+                stack.remove(name)
+            else:
+                continue   # began before the oldest record
+            edge("B" if ev == span_begin else "E", name, core, tid, ts)
+        else:
+            out.append({"ph": "i", "s": "g", "name": ev_names.get(ev, f"0x{ev:04x}"), "cat": "event",
+                        "pid": 0, "tid": 0, "ts": ts, "args": {"a0": a0, "a1": a1}})
+    end = recs[-1][0] - t0 if recs else 0
+    for core, (tid, since) in running.items():
+        out.append({"ph": "X", "name": "running", "cat": "sched", "pid": core, "tid": tid, "ts": since,
+                    "dur": end - since})
+    for core in sorted({c for c, _ in threads} | {0}):
+        out.append({"ph": "M", "name": "process_name", "pid": core, "args": {"name": f"core {core}"}})
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("log", nargs="?", help="captured console output (default: stdin)")
+    ap.add_argument("--ble", help="concatenated 0xA007 values instead of a console log")
+    ap.add_argument("--chrome", metavar="OUT", help="write the last dump as Chrome trace JSON")
+    ap.add_argument("--header", default=DEFAULT_HEADER, help="trace.h with the event ids")
+    args = ap.parse_args()
+
+    names = load_names(args.header)
+    if args.ble:
+        with open(args.ble, "rb") as f:
+            dumps = [read_ble(f.read())]
+    else:
+        src = open(args.log, encoding="utf-8", errors="replace") if args.log else sys.stdin
+        dumps = list(read_dumps(src))
+    if args.chrome:
+        recs, tasks = dumps[-1] if dumps else ([], {})
+        with open(args.chrome, "w", encoding="utf-8") as f:
+            json.dump({"traceEvents": chrome_events(unwrap(recs), tasks, names), "displayTimeUnit": "ms"}, f)
+        print(f"{args.chrome}: {len(recs)} records, {len(tasks)} tasks")
+        return
+    for n, (dump, tasks) in enumerate(dumps):
+        recs = unwrap(dump)
+        if not recs:
+            continue
+        t0 = recs[0][0]
+        print(f"# dump {n}: {len(recs)} records")
+        for ts, ev, _seq, a0, a1 in recs:
+            name = names["EV"].get(ev, f"0x{ev:04x}")
+            if name == "task_in":
+                a0 = tasks.get(a0 & 0xFFFFFFFF, a0)
+            print(f"{(ts - t0) / 1000:12.3f} ms  {name:<16} {a0!s:>8} {a1:>10}")
+
+
+if __name__ == "__main__":
+    main()